@@ -10,3 +10,4 @@ $VULKAN_SDK/bin/glslc ./shaders/offscreen_shader.vert -o ./shaders/offscreen_sha
 $VULKAN_SDK/bin/glslc ./shaders/offscreen_shader.frag -o ./shaders/offscreen_shader.frag.spv;
 $VULKAN_SDK/bin/glslc ./shaders/debug_shader.vert -o ./shaders/debug_shader.vert.spv;
 $VULKAN_SDK/bin/glslc ./shaders/debug_shader.frag -o ./shaders/debug_shader.frag.spv;
+$VULKAN_SDK/bin/glslc ./shaders/cull_shader.comp -o ./shaders/cull_shader.comp.spv;
@@ -9,4 +9,5 @@
 %VULKAN_SDK%/bin/glslc.exe ./shaders/offscreen_shader.vert -o ./shaders/offscreen_shader.vert.spv
 %VULKAN_SDK%/bin/glslc.exe ./shaders/offscreen_shader.frag -o ./shaders/offscreen_shader.frag.spv
 %VULKAN_SDK%/bin/glslc.exe ./shaders/debug_shader.vert -o ./shaders/debug_shader.vert.spv
-%VULKAN_SDK%/bin/glslc.exe ./shaders/debug_shader.frag -o ./shaders/debug_shader.frag.spv
\ No newline at end of file
+%VULKAN_SDK%/bin/glslc.exe ./shaders/debug_shader.frag -o ./shaders/debug_shader.frag.spv
+%VULKAN_SDK%/bin/glslc.exe ./shaders/cull_shader.comp -o ./shaders/cull_shader.comp.spv
\ No newline at end of file
@@ -1,13 +1,49 @@
 #include "my_application.h"
+#include "my_benchmark.h"
 
 // std
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main()
+int main(int argc, char* argv[])
 {
-    MyApplication app{};
+    if (argc > 1 && myRunBenchmark(argv[1]))
+    {
+        return EXIT_SUCCESS;
+    }
+
+    bool bLodScene = false;
+    bool bStreamTest = false;
+    bool bSyncLoad = false;
+    bool bCheckAllocations = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        // Packed vertex streams (half float UVs), compare e.g. the shadow pass time in the GUI
+        if (arg == "--packed-vertices")
+            MyModel::setVertexFormat(MyModel::VERTEX_FORMAT_PACKED);
+
+        // Many distant objects, change "LOD pixel error" in the GUI to compare
+        else if (arg == "--lod-scene")
+            bLodScene = true;
+
+        // 50 more assets streamed in while rendering, prints the time to first frame and the frame times until they are loaded
+        else if (arg == "--stream-test")
+            bStreamTest = true;
+
+        // Load everything before the first frame, with --stream-test compare the time to first frame with streaming
+        else if (arg == "--sync-load")
+            bSyncLoad = true;
+
+        // Report (and assert in debug builds) heap allocations in the frame loop once nothing is loading
+        else if (arg == "--check-allocations")
+            bCheckAllocations = true;
+    }
+
+    MyApplication app{ bLodScene, bStreamTest, bSyncLoad, bCheckAllocations };
 
     try 
     {
@@ -11,6 +11,7 @@
 #include "my_keyboard_controller.h"
 #include "my_buffer.h"
 #include "my_texture.h"
+#include "my_heap_stats.h"
 
 // use radian rather degree for angle
 #define GLM_FORCE_RADIANS
@@ -21,6 +22,7 @@
 #include "glm/ext/matrix_transform.hpp"
 
 // Std
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <cassert>
@@ -38,29 +40,30 @@ const std::string TEXTURE_PATH_2 = "./textures/checkerboard-pattern.jpg";
 // Move MyGlobalUBO to my_frame_info.h
 #define RENDER_SHADOW 1
 
-MyApplication::MyApplication() :
+const std::string STREAM_TEST_MODELS[] = { MODEL_PATH_1, MODEL_PATH_3, "models/flat_vase.obj" };
+const std::string STREAM_TEST_TEXTURES[] = { TEXTURE_PATH_1, TEXTURE_PATH_2, "./textures/texture.jpg" };
+
+// Frames slower than this count as a hitch while streaming (~30 fps)
+const float HITCH_FRAME_TIME = 1.0f / 30.0f;
+
+// With --check-allocations, frames after this many undisturbed ones must not allocate
+const uint32_t ALLOCATION_WARMUP_FRAMES = 16;
+
+MyApplication::MyApplication(bool bLodScene, bool bStreamTest, bool bSyncLoad, bool bCheckAllocations) :
     m_bPerspectiveProjection(true),
+    m_bLodScene(bLodScene),
+    m_bStreamTest(bStreamTest),
+    m_bSyncLoad(bSyncLoad),
+    m_bCheckAllocations(bCheckAllocations),
     m_fPickID(0.0f)
 {
-    // Pool for normal rendering
-    m_pMyGlobalPool = // TODO: need to adjust the pool size to fix the crash when resizing window
-        MyDescriptorPool::Builder(m_myDevice)
-        .setMaxSets(MySwapChain::MAX_FRAMES_IN_FLIGHT+6) // for descriptor set
-        .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) // allow recreate
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MySwapChain::MAX_FRAMES_IN_FLIGHT) // for normal rendering
-		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1) // for picking
-        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MySwapChain::MAX_FRAMES_IN_FLIGHT+1) // for texure and shadow map
-		.build();
-
-    // Pool for offscreen rendering
-    m_pMyOffscreenPool =
-        MyDescriptorPool::Builder(m_myDevice)
-        .setMaxSets(MySwapChain::MAX_FRAMES_IN_FLIGHT) // for descriptor set
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MySwapChain::MAX_FRAMES_IN_FLIGHT) // for shadow map rendering
-        .build();
+    m_pMyAssetLoader = std::make_unique<MyAssetLoader>(m_myDevice);
 
     _loadGameObjects();
 
+    if (m_bStreamTest)
+        _loadStreamTest();
+
     m_fMousePos[0] = -1.0f;
     m_fMousePos[1] = -1.0f;
 }
@@ -68,38 +71,41 @@ MyApplication::MyApplication() :
 void MyApplication::run() 
 {
     // Since texture image don't change every frame, only create one
-	MyTexture myTexture1(m_myDevice, TEXTURE_PATH_1);
-	MyTexture myTexture2(m_myDevice, TEXTURE_PATH_2);
+    // The textures stream in, until then the descriptors point to a white placeholder
+    const unsigned char WHITE_PIXEL[4] = { 255, 255, 255, 255 };
+    MyTexture placeholderTexture(m_myDevice, WHITE_PIXEL, 1, 1);
+    MyTextureHandle textures[2];
+    m_myDefragmenter.track(m_myResources.textures());
+
+    // Bumped when a texture arrives or moves, the cached descriptor sets are dropped when it changes
+    uint32_t textureGeneration = 0;
+    uint32_t cacheTextureGeneration = 0;
+
+    const std::string texturePaths[2] = { TEXTURE_PATH_1, TEXTURE_PATH_2 };
+    for (int i = 0; i < 2; i++)
+    {
+        m_pMyAssetLoader->loadTexture(texturePaths[i], [this, &textures, &textureGeneration, i](std::shared_ptr<MyTexture> pTexture)
+        {
+            textures[i] = m_myResources.textures().create(std::move(*pTexture));
+            textureGeneration++;
+        });
+    }
 
-#if RENDER_SHADOW
-	VkDescriptorImageInfo textureDescriptorImageInfos[3];
-	textureDescriptorImageInfos[0] = myTexture1.descriptorInfo();
-	textureDescriptorImageInfos[1] = myTexture2.descriptorInfo();
-	textureDescriptorImageInfos[2] = m_myRenderer.shadowMapDescriptorInfo();
-#else
-	VkDescriptorImageInfo textureDescriptorImageInfos[2];
-	textureDescriptorImageInfos[0] = myTexture1.descriptorInfo();
-	textureDescriptorImageInfos[1] = myTexture2.descriptorInfo();
-	//textureDescriptorImageInfos[2] = m_myRenderer.shadowMapDescriptorInfo();
-#endif
+    if (m_bSyncLoad)
+        m_pMyAssetLoader->finish();
+
+    auto textureInfo = [&](int i)
+    {
+        MyTexture* pTexture = m_myResources.textures().get(textures[i]);
+        return pTexture ? pTexture->descriptorInfo() : placeholderTexture.descriptorInfo();
+    };
 
 	m_myGUIData.init();
+	m_myGUIData.bGpuCullingSupported = m_myDevice.drawIndirectCount();
 
-    // Create buffer for each frame to avoid memory accessing issue
-    // Note: with the new map function, we don't need to worry about
-    // offset alignment for UBO buffer
-    std::vector<std::unique_ptr<MyBuffer>> uboBuffers(MySwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < uboBuffers.size(); i++) 
-    {
-        uboBuffers[i] = std::make_unique<MyBuffer>(
-            m_myDevice,
-            sizeof(MyGlobalUBO),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT); // no host coherience bit but we could do it here, so we don't need to use flush. We need to revisit here and see if we can remove the last aurgment
-
-        uboBuffers[i]->map();
-    }
+    // Uniform data of each frame comes from its region of the frame allocator, the
+    // descriptor sets use dynamic offsets so they never have to be rewritten for it
+    MyFrameAllocator frameAllocator{ m_myDevice, static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
 
     // Create SSBO for picking
     std::unique_ptr<MyBuffer> ssboBuffer;
@@ -115,49 +121,29 @@ void MyApplication::run()
     // Create descriptor set layout object for scene rendering
     auto globalSetLayout =
         MyDescriptorSetLayout::Builder(m_myDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS) // Unfirom buffer can be accessed all shader stages
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS) // Unfirom buffer can be accessed all shader stages
 		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // can be accessed by fragment shader
 #if RENDER_SHADOW
 		.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3) // can be accessed by fragment shader for shadow map
 #else
         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2) // can be accessed by fragment shader for shadow map
 #endif
+        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // the render queue's instances
         .build();
 
     // Create decriptor set layout object for shadow map
     auto offscreenSetLayout =
         MyDescriptorSetLayout::Builder(m_myDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS) // can be accessed all shader stages
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS) // can be accessed all shader stages
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // the render queue's instances
         .build();
 
-    // Create one descriptor set per frame
-    std::vector<VkDescriptorSet> globalDescriptorSets(MySwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++)
-	{
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-        auto ssbobufferInfo = ssboBuffer->descriptorInfo();
-
-        MyDescriptorWriter(*globalSetLayout, *m_pMyGlobalPool)
-            .writeBuffer(0, &bufferInfo)      // ubo bind to 0
-            .writeBuffer(1, &ssbobufferInfo)  // ssbo bind to 1
-#if RENDER_SHADOW
-            .writeImages(2, textureDescriptorImageInfos, 3) // only need to write the first two textures
-#else
-            .writeImages(2, textureDescriptorImageInfos, 2) // only need to write the first two textures
-#endif
-            .build(globalDescriptorSets[i]);
-    }
-
-    // Create one descriptor set per frame
-    std::vector<VkDescriptorSet> offscreenDescriptorSets(MySwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < offscreenDescriptorSets.size(); i++)
-    {
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-
-        MyDescriptorWriter(*offscreenSetLayout, *m_pMyOffscreenPool)
-            .writeBuffer(0, &bufferInfo)      // ubo bind to 0
-            .build(offscreenDescriptorSets[i]);
-    }
+    // The descriptor sets come from the allocator's cache in the frame loop. Every frame
+    // writes the same buffers, the dynamic offsets select the frame's uniform data.
+    // The instances are indexed from the start of the buffer (firstInstance), so they see all of it
+    VkDescriptorBufferInfo uboBufferInfo = frameAllocator.descriptorInfo(sizeof(MyGlobalUBO));
+    VkDescriptorBufferInfo instanceBufferInfo = frameAllocator.descriptorInfo(VK_WHOLE_SIZE);
+    VkDescriptorBufferInfo ssboBufferInfo = ssboBuffer->descriptorInfo();
 
     MySimpleRenderFactory simpleRenderFactory
     {
@@ -221,57 +207,25 @@ void MyApplication::run()
 
     int resize = 0;
 
+    // Frame times until every asset is loaded, reported with --stream-test
+    bool bFirstFrame = true;
+    bool bStreaming = m_bStreamTest;
+    uint32_t streamFrames = 0;
+    uint32_t streamHitches = 0;
+    float streamFrameTimeTotal = 0.0f;
+    float streamFrameTimeMax = 0.0f;
+
+    // Frames since the last one that was allowed to allocate (resize, loads, descriptor writes, moves)
+    uint32_t steadyFrames = 0;
+
     while (!m_myWindow.shouldClose()) 
     {
         if (resize)
         {
             vkDeviceWaitIdle(m_myDevice.device());
 
-            for (int i = 0; i < uboBuffers.size(); i++)
-            {
-                uboBuffers[i]->unmap();
-            }
-
-            m_pMyGlobalPool->freeDescriptors(globalDescriptorSets);
-
-            globalDescriptorSets.clear();
-            //globalDescriptorSets.shrink_to_fit();
-            globalDescriptorSets.resize(MySwapChain::MAX_FRAMES_IN_FLIGHT);
-
-#if RENDER_SHADOW
-            VkDescriptorImageInfo updateTextureDescriptorImageInfos[3];
-            updateTextureDescriptorImageInfos[0] = myTexture1.descriptorInfo();
-            updateTextureDescriptorImageInfos[1] = myTexture2.descriptorInfo();
-            updateTextureDescriptorImageInfos[2] = m_myRenderer.shadowMapDescriptorInfo();
-#else
-            VkDescriptorImageInfo updateTextureDescriptorImageInfos[2];
-            updateTextureDescriptorImageInfos[0] = myTexture1.descriptorInfo();
-            updateTextureDescriptorImageInfos[1] = myTexture2.descriptorInfo();
-            //updateTextureDescriptorImageInfos[2] = m_myRenderer.shadowMapDescriptorInfo();
-#endif
-
-            for (int i = 0; i < uboBuffers.size(); i++)
-            {
-                uboBuffers[i]->map();
-            }
-
-            for (int i = 0; i < globalDescriptorSets.size(); i++)
-            {
-                auto bufferInfo = uboBuffers[i]->descriptorInfo();
-                auto ssbobufferInfo = ssboBuffer->descriptorInfo();
-
-                MyDescriptorWriter(*globalSetLayout, *m_pMyGlobalPool)
-                    .writeBuffer(0, &bufferInfo)      // ubo bind to 0
-                    .writeBuffer(1, &ssbobufferInfo)  // ssbo bind to 1
-#if RENDER_SHADOW
-                    .writeImages(2, updateTextureDescriptorImageInfos, 3) // only need to write the first two textures
-#else
-                    .writeImages(2, updateTextureDescriptorImageInfos, 2) // only need to write the first two textures
-#endif
-                    .build(globalDescriptorSets[i]);
-            }
-
-            vkDeviceWaitIdle(m_myDevice.device());
+            // The shadow map has a new image view, and the old one's handle may come back
+            m_myDescriptors.clearCache();
 
             // The main reason we need to do all these because we put the render pass in swap chain
             // when resizing window, we destroy swap chain so we have to recreate render pass and therefore
@@ -286,6 +240,7 @@ void MyApplication::run()
             vkDeviceWaitIdle(m_myDevice.device());
 
             resize = 0;
+            steadyFrames = 0;
         }
 
         // Note: depending on the platform (Windows, Linux or Mac), this function
@@ -294,11 +249,37 @@ void MyApplication::run()
         // contents of the window when necessary during such operation.
         m_myWindow.pollEvents();
 
+        // Hand out the assets that finished loading, never waits on the GPU
+        m_pMyAssetLoader->update();
+
         // Need to get the call after glfwPollEvants because the call above may take time
         auto newTime = std::chrono::high_resolution_clock::now();
         float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
         currentTime = newTime;
 
+        if (bStreaming && !bFirstFrame)
+        {
+            streamFrames++;
+            streamFrameTimeTotal += frameTime;
+            streamFrameTimeMax = std::max(streamFrameTimeMax, frameTime);
+            if (frameTime > HITCH_FRAME_TIME)
+                streamHitches++;
+        }
+
+        if (bStreaming && m_pMyAssetLoader->pendingCount() == 0)
+        {
+            bStreaming = false;
+            float loadTime = std::chrono::duration<float, std::milli>(newTime - m_startTime).count();
+            std::cout << "All assets loaded " << loadTime << " ms after startup, " << streamFrames << " frames meanwhile";
+            if (streamFrames > 0)
+            {
+                std::cout << ": average " << streamFrameTimeTotal / streamFrames * 1000.0f << " ms, max "
+                          << streamFrameTimeMax * 1000.0f << " ms, " << streamHitches << " over "
+                          << HITCH_FRAME_TIME * 1000.0f << " ms";
+            }
+            std::cout << std::endl;
+        }
+
         cameraController.moveInPlaneXZ(m_myWindow, frameTime, viewerObject);
         camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
@@ -314,6 +295,10 @@ void MyApplication::run()
             // Also, near and far will automatically apply negative values
             camera.setOrthographicProjection(-apsectRatio * 2.0f, apsectRatio * 2.0f, -2.0f, 2.0f, -5.0f, 5.0f);
 
+        // Heap allocations of this thread from here to the end of the frame
+        uint64_t frameAllocations = MyHeapStats::threadAllocations();
+        uint64_t frameAllocatedBytes = MyHeapStats::threadAllocatedBytes();
+
         // Please note that commandBuffer could be null pointer
         // if the swapChain needs to be recreated
         if (auto commandBuffer = m_myRenderer.beginFrame())
@@ -324,16 +309,73 @@ void MyApplication::run()
             // end offscreen shadow pass
 
             int frameIndex = m_myRenderer.frameIndex();
+            frameAllocator.beginFrame(frameIndex);
+            m_myGpuCuller.beginFrame(frameIndex); // reads the frame's last counts before anything reuses the region
+            m_myDefragmenter.beginFrame(frameIndex);
+            m_myResources.beginFrame(frameIndex);
+            m_myDescriptors.beginFrame(frameIndex);
+            m_myFrameArena.reset();
+            m_myRecorder.beginFrame(frameIndex);
+            m_myDevice.memoryAllocator().updateBudget();
+
+            // Finished loads, texture moves and descriptor writes may allocate, the warmup covers growing containers
+            bool bSteadyFrame = !bFirstFrame && m_pMyAssetLoader->pendingCount() == 0;
+
+            // Moved textures have new image views, so the descriptor sets are rewritten as for new ones
+            if (m_myGUIData.bDefragment && m_pMyAssetLoader->pendingCount() == 0 && m_myDefragmenter.record(commandBuffer))
+            {
+                textureGeneration++;
+                bSteadyFrame = false;
+            }
+
+            // A new or moved texture has a new image view, and a destroyed view's handle may come back
+            if (cacheTextureGeneration != textureGeneration)
+            {
+                m_myDescriptors.clearCache();
+                cacheTextureGeneration = textureGeneration;
+                bSteadyFrame = false;
+            }
+
+            // The same writes every frame until a texture changes, so the cache returns
+            // the existing sets without allocations or updates
+#if RENDER_SHADOW
+            VkDescriptorImageInfo imageInfos[3] = { textureInfo(0), textureInfo(1), m_myRenderer.shadowMapDescriptorInfo() };
+#else
+            VkDescriptorImageInfo imageInfos[2] = { textureInfo(0), textureInfo(1) };
+#endif
+            VkDescriptorSet globalDescriptorSet = MyDescriptorWriter(*globalSetLayout, m_myDescriptors)
+                .writeBuffer(0, &uboBufferInfo)   // ubo bind to 0
+                .writeBuffer(1, &ssboBufferInfo)  // ssbo bind to 1
+                .writeImages(2, imageInfos, static_cast<uint32_t>(std::size(imageInfos)))
+                .writeBuffer(3, &instanceBufferInfo)
+                .buildCached();
+
+            VkDescriptorSet offscreenDescriptorSet = MyDescriptorWriter(*offscreenSetLayout, m_myDescriptors)
+                .writeBuffer(0, &uboBufferInfo)   // ubo bind to 0
+                .writeBuffer(1, &instanceBufferInfo)
+                .buildCached();
+
+            // The render queue is built from a flat list, the map only changes when assets arrive
+            MyFrameVector<MyGameObject*> objects{ m_myFrameArena };
+            objects.reserve(m_mapGameObjects.size());
+            for (auto& kv : m_mapGameObjects)
+                objects.push_back(&kv.second);
+
             MyFrameInfo frameInfo
             {
               frameIndex,
               frameTime,
               commandBuffer,
               camera,
-              globalDescriptorSets[frameIndex],
-              offscreenDescriptorSets[frameIndex],
-              m_mapGameObjects
+              globalDescriptorSet,
+              offscreenDescriptorSet,
+              m_myRenderQueue,
+              m_myResources.models()
             };
+            frameInfo.viewportHeight = static_cast<float>(m_myRenderer.swapChainExtent().height);
+            frameInfo.lodPixelError = m_myGUIData.fLodPixelError;
+            frameInfo.pFrameAllocator = &frameAllocator;
+            frameInfo.pFrameArena = &m_myFrameArena;
 
             // update UBO to GPU
             MyGlobalUBO ubo{};
@@ -373,13 +415,68 @@ void MyApplication::run()
             // update light position from keyboard (K & L)
 			pointLightFactory.update(ubo, m_v3LightOffset);
 
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
+            // All draws of the frame, built and sorted once for the passes below
+            bool bPick = m_myGUIData.bPickMode && m_fMousePos[0] >= 0.0f && m_fMousePos[1] >= 0.0f;
 
-            // becasue we don't use host coherence flag, we need to call flash
-            uboBuffers[frameIndex]->flush();
+            // The GPU culls the shadow and main pass objects against the same frustums, the CPU culls nothing
+            bool bGpuCulling = m_myGUIData.bGpuCullingSupported && m_myGUIData.bGpuCulling && !bPick;
+
+            // Frustum culling of the objects (main and pick pass against the camera, shadow pass against
+            // the light) and optionally of their meshlets; the shadow pass sees back faces from the light
+            // so it only tests the frustum
+            if (m_myGUIData.bFrustumCulling || bGpuCulling)
+            {
+                m_myViewCuller.resetStats();
+                m_myViewCuller.setView(camera.projectionMatrix() * camera.viewMatrix(), glm::vec3(camera.inverseViewMatrix()[3]));
+                m_myViewCuller.setBackfaceCulling(m_myGUIData.bMeshletBackfaceCulling);
+                m_myViewCuller.setMeshletCulling(m_myGUIData.bMeshletCulling);
+                frameInfo.pViewCuller = &m_myViewCuller;
+
+                m_myShadowCuller.resetStats();
+                m_myShadowCuller.setView(ubo.pointLight.lightMVP, glm::vec3(ubo.pointLight.position));
+                m_myShadowCuller.setBackfaceCulling(false);
+                m_myShadowCuller.setMeshletCulling(m_myGUIData.bMeshletCulling);
+                frameInfo.pShadowCuller = &m_myShadowCuller;
+            }
+
+            // The render queue keeps every object, the planes go to the GPU
+            if (bGpuCulling)
+            {
+                frameInfo.pViewCuller = nullptr;
+                frameInfo.pShadowCuller = nullptr;
+            }
+
+            frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+
+            uint32_t passMask = MyRenderQueue::passBit(MyRenderQueue::PASS_PICK);
+            if (!bPick)
+            {
+#if RENDER_SHADOW
+                passMask = MyRenderQueue::passBit(MyRenderQueue::PASS_SHADOW);
+#else
+                passMask = 0;
+#endif
+                if (m_myGUIData.bShowDebug)
+                    passMask |= MyRenderQueue::passBit(MyRenderQueue::PASS_DEBUG);
+                else
+                    passMask |= MyRenderQueue::passBit(MyRenderQueue::PASS_TEXTURE) | MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE);
+            }
+            m_myRenderQueue.setInstancing(m_myGUIData.bInstancing);
+            m_myRenderQueue.build(frameInfo, objects.data(), static_cast<uint32_t>(objects.size()), passMask, lightPos);
+            m_myGUIData.renderQueueStats = m_myRenderQueue.stats();
+
+            // Outside the render passes, the draws of both wait for it
+            if (bGpuCulling)
+            {
+                uint32_t gpuPasses = passMask & (MyRenderQueue::passBit(MyRenderQueue::PASS_SHADOW) |
+                    MyRenderQueue::passBit(MyRenderQueue::PASS_TEXTURE) | MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE));
+                m_myGpuCuller.cull(frameInfo, gpuPasses, m_myDescriptors, m_myViewCuller, m_myShadowCuller);
+                frameInfo.pGpuCuller = &m_myGpuCuller;
+            }
+            m_myGUIData.gpuCullStats = m_myGpuCuller.stats();
 
             // Picking
-			if (m_myGUIData.bPickMode && m_fMousePos[0] >= 0.0f && m_fMousePos[1] >= 0.0f)
+			if (bPick)
 			{
 			    MySSBO ssbo{};
                 ssbo.id = 0.0f;
@@ -394,38 +491,104 @@ void MyApplication::run()
 			}
             else // Normal rendering
             {
+                // The objects are recorded into secondary buffers, one share per thread
+                bool bParallel = m_myGUIData.bParallelRecording;
+                VkSubpassContents contents = bParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
 #if RENDER_SHADOW
                 // First render shadow map
-                m_myRenderer.beginOffscreenRenderPass(commandBuffer);
-                offscreenRenderFactory.renderGameObjects(frameInfo);
+                m_myRenderer.beginOffscreenRenderPass(commandBuffer, contents);
+                if (bParallel)
+                {
+                    m_myRecorder.record(frameInfo, m_myRenderer.offscreenInheritance(), [&](MyFrameInfo& shareInfo)
+                    {
+                        m_myRenderer.setOffscreenDynamicState(shareInfo.commandBuffer);
+                        offscreenRenderFactory.renderGameObjects(shareInfo);
+                    });
+                }
+                else
+                {
+                    offscreenRenderFactory.renderGameObjects(frameInfo);
+                }
                 m_myRenderer.endOffscreenRenderPass(commandBuffer);
 #endif
                 // render normal scene
-                m_myRenderer.beginSwapChainRenderPass(commandBuffer);
+                m_myRenderer.beginSwapChainRenderPass(commandBuffer, contents);
 
                 // render game objects
-                if (m_myGUIData.bShowDebug)
+                auto renderGameObjects = [&](MyFrameInfo& info)
+                {
+                    if (m_myGUIData.bShowDebug)
+                    {
+                        debugFactory.renderGameObjects(info);
+                    }
+                    else
+                    {
+                        textureFactory.render(info);
+                        simpleRenderFactory.render(info);
+                    }
+                };
+
+                // The light and the GUI stay on this thread, in a secondary buffer of their own
+                MyFrameInfo overlayInfo = frameInfo;
+                if (bParallel)
                 {
-                    debugFactory.renderGameObjects(frameInfo);
+                    VkCommandBufferInheritanceInfo inheritance = m_myRenderer.swapChainInheritance();
+                    m_myRecorder.record(frameInfo, inheritance, [&](MyFrameInfo& shareInfo)
+                    {
+                        m_myRenderer.setSwapChainDynamicState(shareInfo.commandBuffer);
+                        renderGameObjects(shareInfo);
+                    });
+
+                    overlayInfo.commandBuffer = m_myRecorder.beginSecondary(inheritance);
+                    m_myRenderer.setSwapChainDynamicState(overlayInfo.commandBuffer);
                 }
                 else
                 {
-                    textureFactory.render(frameInfo);
-					simpleRenderFactory.render(frameInfo);
+                    renderGameObjects(frameInfo);
                 }
 
                 // render light
                 if (m_myGUIData.bShowLight)
-                    pointLightFactory.render(frameInfo);
+                    pointLightFactory.render(overlayInfo);
 
                 // render GUI last so it shows on top
-                m_myGUI.draw(commandBuffer, m_myGUIData);
+                m_myGUIData.fShadowPassTime = m_myRenderer.shadowPassTime();
+                m_myGUIData.iTriangleCount = frameInfo.triangleCount;
+                m_myGUIData.viewCullStats = frameInfo.pViewCuller ? m_myViewCuller.stats() : MyMeshletCuller::Stats{};
+                m_myGUIData.shadowCullStats = frameInfo.pShadowCuller ? m_myShadowCuller.stats() : MyMeshletCuller::Stats{};
+                m_myGUIData.geometryStats = MyModel::geometryArenaStats();
+                m_myGUIData.memoryStats = m_myDevice.memoryStats();
+                m_myGUIData.bDriverBudget = m_myDevice.hasMemoryBudget();
+                m_myGUIData.heapBudgets.resize(m_myDevice.memoryAllocator().heapCount());
+                for (uint32_t i = 0; i < m_myGUIData.heapBudgets.size(); i++)
+                    m_myGUIData.heapBudgets[i] = m_myDevice.memoryAllocator().heapBudget(i);
+                m_myGUIData.defragStats = m_myDefragmenter.stats();
+                m_myGUIData.iFrameArenaBytes = m_myFrameArena.used();
+                m_myGUIData.descriptorStats = m_myDescriptors.stats();
+                m_myGUIData.iRecordingThreads = m_myRecorder.threadCount();
+                m_myGUI.draw(overlayInfo.commandBuffer, m_myGUIData);
+
+                if (bParallel)
+                {
+                    m_myRecorder.executeSecondary(commandBuffer, overlayInfo.commandBuffer);
+                }
 
                 m_myRenderer.endSwapChainRenderPass(commandBuffer);
             }
 
             resize = m_myRenderer.endFrame();
 
+            if (bFirstFrame)
+            {
+                bFirstFrame = false;
+                if (m_bStreamTest)
+                {
+                    float firstFrameTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_startTime).count();
+                    std::cout << "Time to first frame " << firstFrameTime << " ms" << std::endl;
+                }
+            }
+
             // After the rendering, get the result from SSBO
             if (m_myGUIData.bPickMode)
             {
@@ -437,20 +600,42 @@ void MyApplication::run()
                 //std::cout << "pick id = " << ssbo.id << std::endl;
                 m_fPickID = ssbo.id;
 
-                if (m_fPickID == 0)
+                // The pick ID is per object, its model says what it is
+                auto it = m_mapPickModelIDs.find(static_cast<uint32_t>(m_fPickID));
+                unsigned int modelID = it != m_mapPickModelIDs.end() ? it->second : 0;
+
+                if (modelID == 0)
                     m_myGUIData.sPickObject = "None";
-                else if (m_fPickID == 100)
+                else if (modelID == 100)
                     m_myGUIData.sPickObject = "Viking Room";
-                else if (m_fPickID == 200)
+                else if (modelID == 200)
                     m_myGUIData.sPickObject = "Floor";
-                else if (m_fPickID == 300)
+                else if (modelID == 300)
                     m_myGUIData.sPickObject = "Smooth Vase";
             }
+
+            // Shown in the next frame's GUI
+            frameAllocations = MyHeapStats::threadAllocations() - frameAllocations;
+            frameAllocatedBytes = MyHeapStats::threadAllocatedBytes() - frameAllocatedBytes;
+            m_myGUIData.iFrameAllocations = static_cast<uint32_t>(frameAllocations);
+            m_myGUIData.iFrameAllocatedBytes = frameAllocatedBytes;
+
+            steadyFrames = bSteadyFrame && !resize ? steadyFrames + 1 : 0;
+            if (m_bCheckAllocations && steadyFrames > ALLOCATION_WARMUP_FRAMES && frameAllocations > 0)
+            {
+                std::cerr << "Warning: " << frameAllocations << " heap allocation(s), " << frameAllocatedBytes
+                          << " bytes in a steady-state frame" << std::endl;
+                assert(false && "Heap allocation in the frame loop");
+                steadyFrames = 0; // report again after the next warmup, not every frame
+            }
         }
     }
 
     // GPU will block until all CPU is complete
     vkDeviceWaitIdle(m_myDevice.device());
+
+    // The texture callbacks write to this frame, none may run after it is gone
+    m_pMyAssetLoader->cancel();
 }
 
 void MyApplication::switchProjectionMatrix()
@@ -466,54 +651,136 @@ void MyApplication::updateLightPosition(glm::vec3 updateLightPos)
 
 void MyApplication::_loadGameObjects()
 {
-    std::shared_ptr<MyModel> mymodel1 =
-        MyModel::createModelFromFile(m_myDevice, MODEL_PATH_1, 100);
+    // Note: the models load in the background, compare the startup with and without the
+    // *.meshcache files. The objects are created here anyway so their IDs do not depend
+    // on the order the models arrive in
 
     // Note: +X to the right, +Y down and +Z inside the screen
 
     // Load first texture model
     auto viking_room = MyGameObject::createGameObject(MyGameObject::TEXTURE);
-    viking_room.model = mymodel1;
 
     viking_room.transform.translation = { 0.f, 0.0f, 0.f };
     viking_room.transform.scale = { 1.0f, 1.0f, 1.0f };
     viking_room.transform.rotation.x = -glm::pi<float>() / 2.0f; // rotate 90
     viking_room.transform.rotation.y = glm::pi<float>(); // rotate 180
-
-    m_mapGameObjects.emplace(viking_room.getID(), std::move(viking_room));
+    viking_room.textureIndex = 0;
 
     // Load second texture model - floor
-    // Please note that MyTextureRenderFactory::render assume first texture applies to model1
-    // and the second texture applies to model2
-    std::shared_ptr<MyModel> mymodel3 =
-        MyModel::createModelFromFile(m_myDevice, MODEL_PATH_2, 200);
-
+    // Please note that the texture descriptor array has the first texture at 0 and
+    // the second texture at 1, see textureInfo() in run()
     auto floor = MyGameObject::createGameObject(MyGameObject::TEXTURE);
-    floor.model = mymodel3;
+    floor.textureIndex = 1;
 
     floor.transform.translation = { 0.f, 0.0f, 0.f };
     floor.transform.scale = { 5.f, 1.f, 5.f };
     floor.transform.rotation.x = glm::pi<float>(); // rotate 180
 
-    m_mapGameObjects.emplace(floor.getID(), std::move(floor));
-
     // Load a third simple model
-    std::shared_ptr<MyModel> mymodel2 = MyModel::createModelFromFile(m_myDevice, MODEL_PATH_3, 300);
     auto smoothVase = MyGameObject::createGameObject(MyGameObject::SIMPLE);
-    smoothVase.model = mymodel2;
     smoothVase.transform.translation = { -0.6f, 0.1f, 0.5f };
     smoothVase.transform.scale = { 1.5f, 0.75f, 1.5f };
     smoothVase.transform.rotation.x = glm::pi<float>(); // rotate 180 so Y is up
-    m_mapGameObjects.emplace(smoothVase.getID(), std::move(smoothVase));
 
     // Create debug model
 	auto debugfloor = MyGameObject::createGameObject(MyGameObject::DEBUG);
-    debugfloor.model = mymodel3;
 
     debugfloor.transform.translation = { 0.f, 0.0f, 0.f };
     debugfloor.transform.scale = { 5.f, 1.f, 5.f };
     debugfloor.transform.rotation.x = glm::pi<float>(); // rotate 180
-    m_mapGameObjects.emplace(debugfloor.getID(), std::move(debugfloor));
+
+    std::vector<MyGameObject> roomObjects;
+    std::vector<MyGameObject> floorObjects;
+    std::vector<MyGameObject> vaseObjects;
+    roomObjects.push_back(std::move(viking_room));
+    floorObjects.push_back(std::move(floor));
+    vaseObjects.push_back(std::move(smoothVase));
+    floorObjects.push_back(std::move(debugfloor));
+
+    // LOD benchmark scene: rows of copies behind the room, up to the far plane
+    if (m_bLodScene)
+    {
+        const int GRID = 24;
+        for (int z = 0; z < GRID; z++)
+        {
+            for (int x = 0; x < GRID; x++)
+            {
+                bool bVase = (x + z) % 2 == 0;
+                auto copy = MyGameObject::createGameObject(MyGameObject::SIMPLE);
+                copy.transform.translation = { (x - GRID / 2) * 2.5f, 0.0f, 4.0f + z * 3.5f };
+                copy.transform.scale = bVase ? glm::vec3{ 1.5f, 0.75f, 1.5f } : glm::vec3{ 1.0f };
+                copy.transform.rotation.x = bVase ? glm::pi<float>() : -glm::pi<float>() / 2.0f;
+                (bVase ? vaseObjects : roomObjects).push_back(std::move(copy));
+            }
+        }
+    }
+
+    // Note: the optimize flag also reorders the mesh for the vertex cache, overdraw and
+    // vertex fetch, and builds the LOD chain and the meshlets
+    _loadModel(MODEL_PATH_1, 100, true, std::move(roomObjects));
+    _loadModel(MODEL_PATH_2, 200, false, std::move(floorObjects));
+    _loadModel(MODEL_PATH_3, 300, true, std::move(vaseObjects));
+}
+
+void MyApplication::_loadStreamTest()
+{
+    // 40 models and 10 textures, loaded again from their files as separate assets
+    const int MODEL_COUNT = 40;
+    const int TEXTURE_COUNT = 10;
+    const int MODEL_COUNT_X = 8;
+    const int MODEL_PATH_COUNT = static_cast<int>(std::size(STREAM_TEST_MODELS));
+    const int TEXTURE_PATH_COUNT = static_cast<int>(std::size(STREAM_TEST_TEXTURES));
+
+    for (int i = 0; i < MODEL_COUNT; i++)
+    {
+        bool bRoom = i % MODEL_PATH_COUNT == 0;
+        auto copy = MyGameObject::createGameObject(MyGameObject::SIMPLE);
+        copy.transform.translation = { (i % MODEL_COUNT_X - MODEL_COUNT_X / 2) * 1.5f, 0.0f, -3.0f - (i / MODEL_COUNT_X) * 1.5f };
+        copy.transform.scale = bRoom ? glm::vec3{ 0.5f } : glm::vec3{ 0.75f, 0.4f, 0.75f };
+        copy.transform.rotation.x = bRoom ? -glm::pi<float>() / 2.0f : glm::pi<float>();
+
+        std::vector<MyGameObject> objects;
+        objects.push_back(std::move(copy));
+        _loadModel(STREAM_TEST_MODELS[i % MODEL_PATH_COUNT], 0, true, std::move(objects));
+    }
+
+    for (int i = 0; i < TEXTURE_COUNT; i++)
+    {
+        m_pMyAssetLoader->loadTexture(STREAM_TEST_TEXTURES[i % TEXTURE_PATH_COUNT], [this](std::shared_ptr<MyTexture> pTexture)
+        {
+            m_streamedTextures.push_back(m_myResources.textures().create(std::move(*pTexture)));
+        });
+    }
+}
+
+void MyApplication::_loadModel(const std::string& filepath, unsigned int id, bool bOptimize, std::vector<MyGameObject>&& objects)
+{
+    // std::function needs a copyable callback and the game objects are move only
+    auto pObjects = std::make_shared<std::vector<MyGameObject>>(std::move(objects));
+
+    m_pMyAssetLoader->loadModel(filepath, id, bOptimize, bOptimize, bOptimize, [this, filepath, id, pObjects](std::shared_ptr<MyModel> pModel)
+    {
+        // The model moves into the pool, every object holds a reference to it
+        MyResourcePool<MyModel>& models = m_myResources.models();
+        MyModelHandle model = models.create(std::move(*pModel));
+        for (auto& obj : *pObjects)
+        {
+            models.addRef(model);
+            obj.model = model;
+            m_mapPickModelIDs[MyRenderQueue::pickID(obj.getID())] = id;
+            m_mapGameObjects.emplace(obj.getID(), std::move(obj));
+        }
+        pObjects->clear();
+
+        if (m_bStreamTest)
+        {
+            float loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_startTime).count();
+            std::cout << filepath << " loaded after " << loadTime << " ms: vertex memory " << models[model].vertexMemorySize() / 1024.0
+                      << " KB, index memory " << models[model].indexMemorySize() / 1024.0 << " KB ("
+                      << (MyModel::vertexFormat() == MyModel::VERTEX_FORMAT_PACKED ? "packed" : "float") << " vertices)" << std::endl;
+        }
+        models.release(model);
+    });
 }
 
 void MyApplication::togglePickMode()
@@ -7,8 +7,19 @@
 #include "my_renderer.h"
 #include "my_game_object.h"
 #include "my_gui.h"
+#include "my_meshlet_culler.h"
+#include "my_asset_loader.h"
+#include "my_defragmenter.h"
+#include "my_resource_manager.h"
+#include "my_frame_arena.h"
+#include "my_parallel_recorder.h"
+#include "my_render_queue.h"
+#include "my_gpu_culler.h"
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class MyApplication 
@@ -17,7 +28,11 @@ public:
 	static constexpr int WIDTH = 800;
 	static constexpr int HEIGHT = 600;
 
-	MyApplication();
+	// bLodScene adds a few hundred distant objects to compare the LOD pixel error settings
+	// bStreamTest streams 50 more assets in while rendering, to measure the frame time hitches
+	// bSyncLoad waits for every asset before the first frame, to compare with streaming
+	// bCheckAllocations reports heap allocations in steady-state frames, see run()
+	MyApplication(bool bLodScene = false, bool bStreamTest = false, bool bSyncLoad = false, bool bCheckAllocations = false);
 
 	void run();
 	void switchProjectionMatrix();
@@ -27,6 +42,13 @@ public:
 
 private:
 	void _loadGameObjects();
+	void _loadStreamTest();
+
+	// The objects enter the scene once their model is on the GPU
+	void _loadModel(const std::string& filepath, unsigned int id, bool bOptimize, std::vector<MyGameObject>&& objects);
+
+	// Time to first frame
+	std::chrono::high_resolution_clock::time_point m_startTime = std::chrono::high_resolution_clock::now();
 
 	MyWindow                  m_myWindow{ WIDTH, HEIGHT, "Hello Vulkan!" };
 	MyDevice                  m_myDevice{ m_myWindow };
@@ -35,16 +57,47 @@ private:
 	MyGUI					  m_myGUI{ "My UI", m_myDevice, m_myWindow, m_myRenderer};
 
 	// Note: the order matters, because the destructor is called in the reversed order
-	// globalPool needs to delete before m_myDevice
-	std::unique_ptr<MyDescriptorPool> m_pMyGlobalPool{};
-	std::unique_ptr<MyDescriptorPool> m_pMyOffscreenPool{};
+	// the descriptor allocator needs to delete before m_myDevice
+	MyDescriptorAllocator             m_myDescriptors{ m_myDevice, static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
+	std::unique_ptr<MyAssetLoader>    m_pMyAssetLoader{};
+
+	// Models and textures of the scene, addressed by handle. Released ones are
+	// destroyed once the frames in flight are done with them
+	MyResourceManager                 m_myResources{ static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
+
+	// Moves textures and geometry out of sparse memory blocks, between loads
+	MyDefragmenter                    m_myDefragmenter{ m_myDevice, static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
 
 	MyGameObject::Map                 m_mapGameObjects;
 	bool                              m_bPerspectiveProjection;
+	bool                              m_bLodScene;
+	bool                              m_bStreamTest;
+	bool                              m_bSyncLoad;
+	bool                              m_bCheckAllocations;
 	glm::vec3                         m_v3LightOffset{ 0.0f };
 
+	// Meshlet culling for the main (and picking) pass and the shadow pass
+	MyMeshletCuller                   m_myViewCuller;
+	MyMeshletCuller                   m_myShadowCuller;
+
+	// Transient host containers of the frame being recorded
+	MyFrameArena                      m_myFrameArena;
+
+	// The frame's draws of all passes, sorted by state
+	MyRenderQueue                     m_myRenderQueue;
+
+	// Culls the render queue's shadow and main pass draws on the GPU, see MyGUIData::bGpuCulling
+	MyGpuCuller                       m_myGpuCuller{ m_myDevice, static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
+
+	// Records the shadow and main pass objects on all cores, see MyGUIData::bParallelRecording
+	MyParallelRecorder                m_myRecorder{ m_myDevice, static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT) };
+
+	// Kept alive for --stream-test, nothing samples them
+	std::vector<MyTextureHandle>      m_streamedTextures;
+
 	// Picking
-	float                             m_fPickID;
+	float                             m_fPickID;       // MyRenderQueue::pickID of the picked object
+	std::unordered_map<uint32_t, unsigned int> m_mapPickModelIDs; // pick ID -> id of the object's model, names the picked object
 	float                             m_fMousePos[2];
 };
 
@@ -0,0 +1,320 @@
+#include "my_asset_loader.h"
+
+// libs
+#include "stb_image.h"
+
+// Std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+MyAssetLoader::MyAssetLoader(MyDevice& device, unsigned int threadCount) :
+	m_myDevice{ device }
+{
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	poolInfo.queueFamilyIndex = m_myDevice.graphicsQueueFamily();
+	if (vkCreateCommandPool(m_myDevice.device(), &poolInfo, nullptr, &m_vkGraphicsCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create loader command pool!");
+	}
+
+	m_vkTransferCommandPool = m_vkGraphicsCommandPool;
+	if (m_myDevice.hasTransferQueue())
+	{
+		poolInfo.queueFamilyIndex = m_myDevice.transferQueueFamily();
+		if (vkCreateCommandPool(m_myDevice.device(), &poolInfo, nullptr, &m_vkTransferCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create loader transfer command pool!");
+		}
+	}
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&MyAssetLoader::_workerLoop, this);
+}
+
+MyAssetLoader::~MyAssetLoader()
+{
+	cancel();
+
+	if (m_vkTransferCommandPool != m_vkGraphicsCommandPool)
+		vkDestroyCommandPool(m_myDevice.device(), m_vkTransferCommandPool, nullptr);
+	vkDestroyCommandPool(m_myDevice.device(), m_vkGraphicsCommandPool, nullptr);
+}
+
+void MyAssetLoader::cancel()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_bStop = true;
+		m_jobs.clear();
+	}
+	m_condition.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	// Assets still in flight are dropped without their callbacks
+	for (auto& submission : m_submissions)
+	{
+		vkWaitForFences(m_myDevice.device(), 1, &submission.vkFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		_release(submission);
+	}
+	m_submissions.clear();
+	m_staged.clear();
+	m_workers.clear();
+	m_iPendingCount = 0;
+}
+
+void MyAssetLoader::loadModel(
+	const std::string& filepath, unsigned int id, bool bOptimize, bool bGenerateLods, bool bBuildMeshlets,
+	ModelCallback onLoaded)
+{
+	MyDevice& device = m_myDevice;
+	_enqueue([&device, filepath, id, bOptimize, bGenerateLods, bBuildMeshlets, onLoaded]()
+	{
+		// The OBJ text is larger than the vertices and indices it turns into
+		std::error_code error;
+		std::uintmax_t fileSize = std::filesystem::file_size(filepath, error);
+		_checkBudget(device, error ? 0 : static_cast<VkDeviceSize>(fileSize), filepath);
+
+		auto pBatch = std::make_unique<MyUploadBatch>(device);
+		std::shared_ptr<MyModel> pModel = MyModel::createModelFromFile(
+			device, filepath, id, bOptimize, bGenerateLods, bBuildMeshlets, pBatch.get());
+
+		return Upload{ std::move(pBatch), [pModel, onLoaded]() { onLoaded(pModel); } };
+	});
+}
+
+void MyAssetLoader::loadTexture(const std::string& filepath, TextureCallback onLoaded)
+{
+	MyDevice& device = m_myDevice;
+	_enqueue([&device, filepath, onLoaded]()
+	{
+		// RGBA8 with the mip chain, from the header only
+		int width = 0, height = 0, channels = 0;
+		if (stbi_info(filepath.c_str(), &width, &height, &channels))
+			_checkBudget(device, VkDeviceSize(width) * height * 4 * 4 / 3, filepath);
+
+		auto pBatch = std::make_unique<MyUploadBatch>(device);
+		auto pTexture = std::make_shared<MyTexture>(device, filepath, pBatch.get());
+
+		return Upload{ std::move(pBatch), [pTexture, onLoaded]() { onLoaded(pTexture); } };
+	});
+}
+
+void MyAssetLoader::_checkBudget(MyDevice& device, VkDeviceSize size, const std::string& filepath)
+{
+	VkDeviceSize remaining = device.remainingBudget();
+	if (size > remaining)
+	{
+		throw std::runtime_error("not enough device memory budget for " + filepath + " (" +
+			std::to_string(size / (1024 * 1024)) + " MB needed, " + std::to_string(remaining / (1024 * 1024)) + " MB left)");
+	}
+}
+
+void MyAssetLoader::_enqueue(std::function<Upload()> job)
+{
+	assert(!m_bStop && "Request after cancel");
+	m_iPendingCount++;
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_jobs.push_back(std::move(job));
+	}
+	m_condition.notify_one();
+}
+
+void MyAssetLoader::_workerLoop()
+{
+	for (;;)
+	{
+		std::function<Upload()> job;
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_condition.wait(lock, [this]() { return m_bStop || !m_jobs.empty(); });
+			if (m_bStop)
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		Upload upload{};
+		try
+		{
+			upload = job();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Warning: asset loading failed: " << e.what() << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_staged.push_back(std::move(upload));
+	}
+}
+
+void MyAssetLoader::update()
+{
+	_poll();
+
+	// Take what the workers have staged, within the per frame budget
+	std::vector<Upload> uploads;
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		VkDeviceSize size = 0;
+		size_t count = 0;
+		for (; count < m_staged.size(); count++)
+		{
+			const auto& pBatch = m_staged[count].pBatch;
+			VkDeviceSize batchSize = pBatch ? pBatch->size() : 0;
+			if (!uploads.empty() && size + batchSize > MAX_UPLOAD_BYTES_PER_UPDATE)
+				break;
+
+			size += batchSize;
+			uploads.push_back(std::move(m_staged[count]));
+		}
+		m_staged.erase(m_staged.begin(), m_staged.begin() + count);
+	}
+
+	// Failed loads were reported by the worker
+	auto failed = std::remove_if(uploads.begin(), uploads.end(), [](const Upload& upload) { return !upload.pBatch; });
+	m_iPendingCount -= static_cast<uint32_t>(std::distance(failed, uploads.end()));
+	uploads.erase(failed, uploads.end());
+
+	if (!uploads.empty())
+		_submit(std::move(uploads), m_myDevice.hasTransferQueue());
+}
+
+void MyAssetLoader::finish()
+{
+	while (m_iPendingCount > 0)
+	{
+		update();
+
+		if (!m_submissions.empty())
+		{
+			std::vector<VkFence> fences;
+			for (const auto& submission : m_submissions)
+				fences.push_back(submission.vkFence);
+
+			vkWaitForFences(m_myDevice.device(), static_cast<uint32_t>(fences.size()), fences.data(), VK_FALSE, std::numeric_limits<uint64_t>::max());
+		}
+		else
+		{
+			// Still parsing
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+void MyAssetLoader::_submit(std::vector<Upload>&& uploads, bool bTransferStage)
+{
+	Submission submission{};
+	submission.vkCommandPool = bTransferStage ? m_vkTransferCommandPool : m_vkGraphicsCommandPool;
+	submission.bTransferStage = bTransferStage;
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = submission.vkCommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(m_myDevice.device(), &allocInfo, &submission.vkCommandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate loader command buffer!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(submission.vkCommandBuffer, &beginInfo);
+
+	// Without a transfer family everything runs in one submission on the graphics queue
+	uint32_t transferFamily = m_myDevice.transferQueueFamily();
+	uint32_t graphicsFamily = m_myDevice.graphicsQueueFamily();
+	for (const auto& upload : uploads)
+	{
+		if (bTransferStage || !m_myDevice.hasTransferQueue())
+			upload.pBatch->recordTransfer(submission.vkCommandBuffer, transferFamily, graphicsFamily);
+		if (!bTransferStage)
+			upload.pBatch->recordGraphics(submission.vkCommandBuffer, transferFamily, graphicsFamily);
+	}
+
+	vkEndCommandBuffer(submission.vkCommandBuffer);
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(m_myDevice.device(), &fenceInfo, nullptr, &submission.vkFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create loader fence!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &submission.vkCommandBuffer;
+
+	VkQueue queue = bTransferStage ? m_myDevice.transferQueue() : m_myDevice.graphicsQueue();
+	if (vkQueueSubmit(queue, 1, &submitInfo, submission.vkFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit loader command buffer!");
+	}
+
+	submission.uploads = std::move(uploads);
+	m_submissions.push_back(std::move(submission));
+}
+
+bool MyAssetLoader::_poll()
+{
+	std::vector<Submission> finished;
+	for (auto it = m_submissions.begin(); it != m_submissions.end(); )
+	{
+		if (vkGetFenceStatus(m_myDevice.device(), it->vkFence) == VK_SUCCESS)
+		{
+			finished.push_back(std::move(*it));
+			it = m_submissions.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (auto& submission : finished)
+	{
+		_release(submission);
+
+		// The fence wait orders the release on the transfer queue before the acquire
+		if (submission.bTransferStage)
+		{
+			_submit(std::move(submission.uploads), false);
+			continue;
+		}
+
+		for (auto& upload : submission.uploads)
+		{
+			upload.onComplete();
+			m_iPendingCount--;
+		}
+	}
+
+	return !finished.empty();
+}
+
+void MyAssetLoader::_release(Submission& submission)
+{
+	vkDestroyFence(m_myDevice.device(), submission.vkFence, nullptr);
+	vkFreeCommandBuffers(m_myDevice.device(), submission.vkCommandPool, 1, &submission.vkCommandBuffer);
+}
+
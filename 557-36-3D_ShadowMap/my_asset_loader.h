@@ -0,0 +1,113 @@
+#ifndef __MY_ASSET_LOADER_H__
+#define __MY_ASSET_LOADER_H__
+
+#include "my_device.h"
+#include "my_model.h"
+#include "my_texture.h"
+#include "my_upload_batch.h"
+
+// Std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Loads models and textures without blocking the frame loop.
+//
+// Worker threads read and parse the files, create the Vulkan resources and
+// fill a MyUploadBatch per asset. update() runs on the main thread once per
+// frame: it records the staged batches into one command buffer for the
+// transfer queue, and polls the fences of earlier submissions. When the
+// device has a dedicated transfer family, a finished transfer is followed
+// by a graphics queue submission that acquires the resources and builds the
+// texture mipmaps. Once that fence has signalled, the asset is handed to
+// its callback, still on the main thread, so the callback may add objects
+// to the scene. update() never waits on the GPU.
+// An asset whose estimated size is over the remaining device memory budget
+// fails to load, instead of running the device out of memory.
+//
+class MyAssetLoader
+{
+public:
+	using ModelCallback = std::function<void(std::shared_ptr<MyModel>)>;
+	using TextureCallback = std::function<void(std::shared_ptr<MyTexture>)>;
+
+	// Keep the staging memory of one update() below this, unless a single asset is larger
+	static constexpr VkDeviceSize MAX_UPLOAD_BYTES_PER_UPDATE = 32 * 1024 * 1024;
+
+	// threadCount 0 = half the hardware threads, the OBJ parser is multithreaded itself
+	MyAssetLoader(MyDevice& device, unsigned int threadCount = 0);
+	~MyAssetLoader();
+
+	MyAssetLoader(const MyAssetLoader&) = delete;
+	MyAssetLoader& operator=(const MyAssetLoader&) = delete;
+
+	// Same arguments as MyModel::createModelFromFile
+	void loadModel(
+		const std::string& filepath, unsigned int id, bool bOptimize, bool bGenerateLods, bool bBuildMeshlets,
+		ModelCallback onLoaded);
+	void loadTexture(const std::string& filepath, TextureCallback onLoaded);
+
+	void update();
+
+	// Blocks until every request so far has been handed out
+	void finish();
+
+	// Drops the requests not handed out yet without their callbacks, after the
+	// workers and the GPU are done with them. Takes no requests afterwards
+	void cancel();
+
+	// Requests not handed out yet
+	uint32_t pendingCount() const { return m_iPendingCount; }
+
+private:
+	// One asset, staged by a worker
+	struct Upload
+	{
+		std::unique_ptr<MyUploadBatch> pBatch;      // nullptr = the load failed
+		std::function<void()>          onComplete;
+	};
+
+	// Uploads in flight on one queue
+	struct Submission
+	{
+		std::vector<Upload> uploads;
+		VkCommandPool       vkCommandPool;
+		VkCommandBuffer     vkCommandBuffer;
+		VkFence             vkFence;
+		bool                bTransferStage;        // the graphics stage comes next
+	};
+
+	// Throws if 'size' bytes are over the device local budget
+	static void _checkBudget(MyDevice& device, VkDeviceSize size, const std::string& filepath);
+
+	void _enqueue(std::function<Upload()> job);
+	void _workerLoop();
+	void _submit(std::vector<Upload>&& uploads, bool bTransferStage);
+	bool _poll();
+	void _release(Submission& submission);
+
+	MyDevice&                          m_myDevice;
+	VkCommandPool                      m_vkTransferCommandPool = VK_NULL_HANDLE;
+	VkCommandPool                      m_vkGraphicsCommandPool = VK_NULL_HANDLE;
+
+	// Shared with the workers
+	std::mutex                         m_mutex;
+	std::condition_variable            m_condition;
+	std::deque<std::function<Upload()>> m_jobs;
+	std::vector<Upload>                m_staged;
+	bool                               m_bStop = false;
+	std::vector<std::thread>           m_workers;
+
+	// Main thread only
+	std::vector<Submission>            m_submissions;
+	uint32_t                           m_iPendingCount = 0;
+};
+
+#endif
+
@@ -0,0 +1,2329 @@
+#include "my_benchmark.h"
+#include "my_bounds_culler.h"
+#include "my_defragmenter.h"
+#include "my_descriptors.h"
+#include "my_device.h"
+#include "my_frame_allocator.h"
+#include "my_frame_arena.h"
+#include "my_free_list_allocator.h"
+#include "my_game_object.h"
+#include "my_geometry_arena.h"
+#include "my_gpu_culler.h"
+#include "my_heap_stats.h"
+#include "my_mesh_cache.h"
+#include "my_mesh_optimizer.h"
+#include "my_mesh_simplifier.h"
+#include "my_meshlet_builder.h"
+#include "my_meshlet_culler.h"
+#include "my_obj_parser.h"
+#include "my_parallel_recorder.h"
+#include "my_render_queue.h"
+#include "my_renderer.h"
+#include "my_resource_pool.h"
+#include "my_simple_render_factory.h"
+#include "my_texture.h"
+#include "my_tlsf_allocator.h"
+#include "my_upload_batch.h"
+#include "my_utils.h"
+#include "my_vertex_welder.h"
+#include "my_window.h"
+
+// libs
+#include "tiny_obj_loader.h"
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Hash used by the original std::unordered_map dedup, kept as the welder baseline
+namespace std {
+	template <>
+	struct hash<MyModel::Vertex> {
+		size_t operator()(MyModel::Vertex const& vertex) const {
+			size_t seed = 0;
+			myHashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+			return seed;
+		}
+	};
+}
+
+namespace
+{
+	const char* BENCH_MODELS[] = { "./models/viking_room.obj", "./models/smooth_vase.obj", "./models/flat_vase.obj" };
+
+	// Compare cold OBJ loads against warm mesh cache loads (CPU side only,
+	// both end with a copy of the arrays as the staging upload would do)
+	void benchmarkMeshCache()
+	{
+		const int iterations = 5;
+
+		for (const char* model : BENCH_MODELS)
+		{
+			std::vector<char> staging;
+
+			// make sure the cache is up to date before timing the warm loads
+			MyModel::Builder builder{};
+			builder.loadModel(model, 0);
+			staging.resize(builder.vertices.size() * sizeof(MyModel::Vertex) + builder.indices.size() * sizeof(uint32_t));
+
+			MyMeshCache::setEnabled(false);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				MyModel::Builder cold{};
+				cold.loadModel(model, 0);
+				std::memcpy(staging.data(), cold.vertices.data(), cold.vertices.size() * sizeof(MyModel::Vertex));
+				std::memcpy(staging.data() + cold.vertices.size() * sizeof(MyModel::Vertex), cold.indices.data(), cold.indices.size() * sizeof(uint32_t));
+			}
+			auto coldTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+			MyMeshCache::setEnabled(true);
+			start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				auto pWarm = MyMeshCache::open(model, 0);
+				if (!pWarm)
+				{
+					std::cerr << model << ": no mesh cache available" << std::endl;
+					return;
+				}
+				std::memcpy(staging.data(), pWarm->vertices(), pWarm->vertexCount() * sizeof(MyModel::Vertex));
+				std::memcpy(staging.data() + pWarm->vertexCount() * sizeof(MyModel::Vertex), pWarm->indices(), pWarm->indexCount() * sizeof(uint32_t));
+			}
+			auto warmTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+			std::cout << model << ": " << builder.vertices.size() << " vertices, " << builder.indices.size() << " indices, "
+					  << "cold " << coldTime << " ms, warm " << warmTime << " ms (x" << coldTime / warmTime << ")" << std::endl;
+		}
+	}
+
+	// MyObjParser gives the attributes and triangle corners of tinyobj::LoadObj, or both fail
+	bool matchesTinyObj(const char* model)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+		bool bTinyObjLoaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model);
+
+		MyObjParser parser{};
+		bool bParsed = true;
+		try
+		{
+			parser.parse(model);
+		}
+		catch (const std::exception&)
+		{
+			bParsed = false;
+		}
+
+		if (!bTinyObjLoaded || !bParsed)
+			return bTinyObjLoaded == bParsed;
+
+		size_t corner = 0;
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				if (corner == parser.indices.size())
+					return false;
+
+				const MyObjParser::Index& other = parser.indices[corner++];
+				if (index.vertex_index != other.vertex_index || index.normal_index != other.normal_index ||
+					index.texcoord_index != other.texcoord_index)
+					return false;
+			}
+		}
+
+		return corner == parser.indices.size() && attrib.vertices == parser.vertices && attrib.colors == parser.colors &&
+			attrib.normals == parser.normals && attrib.texcoords == parser.texcoords;
+	}
+
+	// OBJ parsing throughput of tinyobj::LoadObj against MyObjParser
+	void benchmarkObjParser()
+	{
+		const int iterations = 5;
+
+		// Files tinyobj loads with warnings or fails on
+		const char* EDGE_CASES[][2] = {
+			{ "out of range indices",
+				"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+				"f 1/1/1 2/1/1 3/1/1\n"
+				"f 1/1/1 2/1/1 9/1/1\n"
+				"f 1/1/1 2/1/1 3/1/1 9/1/1\n"
+				"f 1/5/1 2/1/7 3/1/1 4/1/1\n"
+				"f 1/0/1 2/1/0 3 4\n"
+				"f -4 -3 -2\n" },
+			{ "zero vertex index", "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 0 1 2\n" },
+			{ "invalid relative index", "v 0 0 0\nv 1 0 0\nv 1 1 0\nf -1 -2 -4\n" },
+		};
+
+		std::filesystem::path edgeCasePath = std::filesystem::temp_directory_path() / "my_obj_parser_edge_case.obj";
+		for (const auto& edgeCase : EDGE_CASES)
+		{
+			{
+				std::ofstream file{ edgeCasePath, std::ios::binary };
+				file << edgeCase[1];
+			}
+			std::cout << "tinyobj parity, " << edgeCase[0] << ": "
+			          << (matchesTinyObj(edgeCasePath.string().c_str()) ? "identical" : "MISMATCH") << std::endl;
+		}
+		std::filesystem::remove(edgeCasePath);
+
+		for (const char* model : BENCH_MODELS)
+		{
+			double megaBytes = std::filesystem::file_size(model) / (1024.0 * 1024.0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				tinyobj::attrib_t attrib;
+				std::vector<tinyobj::shape_t> shapes;
+				std::vector<tinyobj::material_t> materials;
+				std::string warn, err;
+				tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model);
+			}
+			double tinyObjTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+			double parserTime[2];
+			unsigned int threadCounts[2] = { 1, 0 }; // single thread, all cores
+			for (int t = 0; t < 2; t++)
+			{
+				MyObjParser::setThreadCount(threadCounts[t]);
+				start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i++)
+				{
+					MyObjParser parser{};
+					parser.parse(model);
+				}
+				parserTime[t] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+			}
+			MyObjParser::setThreadCount(0);
+
+			std::cout << model << " (" << megaBytes << " MB): tinyobj " << megaBytes / tinyObjTime << " MB/s, "
+			          << "MyObjParser 1 thread " << megaBytes / parserTime[0] << " MB/s, "
+			          << "all threads " << megaBytes / parserTime[1] << " MB/s, "
+			          << (matchesTinyObj(model) ? "identical" : "MISMATCH") << std::endl;
+		}
+	}
+
+	float halfToFloat(uint16_t half)
+	{
+		int exponent = (half >> 10) & 0x1F;
+		float mantissa = static_cast<float>(half & 0x3FF);
+		float value = exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(mantissa + 1024.0f, exponent - 25);
+		return (half & 0x8000) ? -value : value;
+	}
+
+	// Distance from p to the triangle abc (Ericson, "Real-Time Collision Detection", 5.1.5)
+	float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return glm::length(p - a);
+
+		glm::vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return glm::length(p - b);
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+		glm::vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return glm::length(p - c);
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		float denom = 1.0f / (va + vb + vc);
+		return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+	}
+
+	// One vertex per triangle corner, as MyModel::Builder::loadModel feeds the welder
+	std::vector<MyModel::Vertex> loadCorners(const char* model)
+	{
+		MyObjParser obj{};
+		obj.parse(model);
+
+		std::vector<MyModel::Vertex> corners(obj.indices.size());
+		for (size_t i = 0; i < obj.indices.size(); i++)
+		{
+			const auto& index = obj.indices[i];
+			MyModel::Vertex& vertex = corners[i];
+			if (index.vertex_index >= 0)
+			{
+				vertex.position = { obj.vertices[3 * index.vertex_index + 0], obj.vertices[3 * index.vertex_index + 1], obj.vertices[3 * index.vertex_index + 2] };
+				vertex.color = { obj.colors[3 * index.vertex_index + 0], obj.colors[3 * index.vertex_index + 1], obj.colors[3 * index.vertex_index + 2] };
+			}
+			if (index.normal_index >= 0)
+				vertex.normal = { obj.normals[3 * index.normal_index + 0], obj.normals[3 * index.normal_index + 1], obj.normals[3 * index.normal_index + 2] };
+			if (index.texcoord_index >= 0)
+				vertex.uv = { obj.texcoords[2 * index.texcoord_index + 0], obj.texcoords[2 * index.texcoord_index + 1] };
+			vertex.id = 0.0f;
+		}
+
+		return corners;
+	}
+
+	// Smooth height field of size x size quads (2 * size * size triangles)
+	std::vector<MyModel::Vertex> gridCorners(int size)
+	{
+		auto makeVertex = [size](int x, int z)
+		{
+			MyModel::Vertex vertex{};
+			float u = static_cast<float>(x) / size;
+			float v = static_cast<float>(z) / size;
+			vertex.position = { u * 10.0f, 0.1f * std::sin(u * 40.0f) * std::cos(v * 40.0f), v * 10.0f };
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+			vertex.normal = { 0.0f, -1.0f, 0.0f };
+			vertex.uv = { u, v };
+			vertex.id = 0.0f;
+			return vertex;
+		};
+
+		std::vector<MyModel::Vertex> corners;
+		corners.reserve(static_cast<size_t>(size) * size * 6);
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				corners.push_back(makeVertex(x, z));
+				corners.push_back(makeVertex(x + 1, z));
+				corners.push_back(makeVertex(x + 1, z + 1));
+				corners.push_back(makeVertex(x, z));
+				corners.push_back(makeVertex(x + 1, z + 1));
+				corners.push_back(makeVertex(x, z + 1));
+			}
+		}
+
+		return corners;
+	}
+
+	// Vertex dedup of the original std::unordered_map loop against MyVertexWelder
+	void benchmarkVertexWelder()
+	{
+		struct Mesh
+		{
+			std::string                  name;
+			std::vector<MyModel::Vertex> corners;
+		};
+
+		std::vector<Mesh> meshes;
+		meshes.push_back({ BENCH_MODELS[0], loadCorners(BENCH_MODELS[0]) });
+		meshes.push_back({ "synthetic 1024x1024 grid", gridCorners(1024) });
+
+		for (const Mesh& mesh : meshes)
+		{
+			const auto& corners = mesh.corners;
+			const int iterations = corners.size() > 1000000 ? 1 : 10;
+
+			std::vector<MyModel::Vertex> baseVertices;
+			std::vector<uint32_t> baseIndices;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				baseVertices.clear();
+				baseIndices.clear();
+				std::unordered_map<MyModel::Vertex, uint32_t> uniqueVertices{};
+				for (const auto& vertex : corners)
+				{
+					if (uniqueVertices.count(vertex) == 0)
+					{
+						uniqueVertices[vertex] = static_cast<uint32_t>(baseVertices.size());
+						baseVertices.push_back(vertex);
+					}
+					baseIndices.push_back(uniqueVertices[vertex]);
+				}
+			}
+			double baseTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+			std::cout << mesh.name << ": " << corners.size() / 3 << " triangles, " << baseVertices.size() << " unique vertices" << std::endl;
+			std::cout << "  unordered_map        " << baseTime << " ms" << std::endl;
+
+			struct Run
+			{
+				const char*  label;
+				unsigned int threads;
+				float        epsilon;
+			};
+			const Run runs[] = {
+				{ "welder 1 thread     ", 1, 0.0f },
+				{ "welder all threads  ", 0, 0.0f },
+				{ "welder epsilon 1e-4 ", 0, 1e-4f },
+			};
+
+			for (const Run& run : runs)
+			{
+				MyVertexWelder::setThreadCount(run.threads);
+				std::vector<MyModel::Vertex> vertices;
+				std::vector<uint32_t> indices;
+
+				start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i++)
+				{
+					MyVertexWelder welder{ run.epsilon };
+					welder.weld(corners, vertices, indices);
+				}
+				double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+				std::cout << "  " << run.label << time << " ms (x" << baseTime / time << "), " << vertices.size() << " vertices";
+				if (run.epsilon == 0.0f)
+				{
+					bool bSame = indices == baseIndices && vertices.size() == baseVertices.size() &&
+						std::equal(vertices.begin(), vertices.end(), baseVertices.begin());
+					std::cout << (bSame ? ", identical" : ", MISMATCH");
+				}
+				std::cout << std::endl;
+			}
+			MyVertexWelder::setThreadCount(0);
+		}
+	}
+
+	// ACMR/ATVR of the builder output before and after each MyMeshOptimizer step
+	void benchmarkMeshOptimizer()
+	{
+		MyMeshCache::setEnabled(false);
+
+		auto printStats = [](const char* label, const MyModel::Builder& builder)
+		{
+			auto stats = MyMeshOptimizer::analyzeVertexCache(builder.indices, builder.vertices.size());
+			std::cout << "  " << label << "ACMR " << stats.acmr << ", ATVR " << stats.atvr << std::endl;
+		};
+
+		std::vector<MyModel::Builder> builders;
+		std::vector<std::string> names;
+		for (const char* model : BENCH_MODELS)
+		{
+			builders.emplace_back();
+			builders.back().loadModel(model, 0);
+			names.push_back(model);
+		}
+
+		builders.emplace_back();
+		MyVertexWelder{}.weld(gridCorners(512), builders.back().vertices, builders.back().indices);
+		names.push_back("synthetic 512x512 grid");
+
+		for (size_t m = 0; m < builders.size(); m++)
+		{
+			MyModel::Builder& builder = builders[m];
+			std::cout << names[m] << ": " << builder.indices.size() / 3 << " triangles, " << builder.vertices.size() << " vertices" << std::endl;
+			printStats("OBJ order        ", builder);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			MyMeshOptimizer::optimizeVertexCache(builder.indices, builder.vertices.size());
+			auto cacheTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printStats("vertex cache     ", builder);
+
+			start = std::chrono::high_resolution_clock::now();
+			MyMeshOptimizer::optimizeOverdraw(builder.indices, builder.vertices);
+			auto overdrawTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printStats("+ overdraw       ", builder);
+
+			start = std::chrono::high_resolution_clock::now();
+			MyMeshOptimizer::optimizeVertexFetch(builder.vertices, builder.indices);
+			auto fetchTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printStats("+ vertex fetch   ", builder);
+
+			std::cout << "  time: vertex cache " << cacheTime << " ms, overdraw " << overdrawTime << " ms, vertex fetch " << fetchTime << " ms" << std::endl;
+		}
+
+		MyMeshCache::setEnabled(true);
+	}
+
+	// LOD chain report (triangles, error bound, measured error, switch distance)
+	// and a scene of many distant objects drawn with and without LOD selection
+	void benchmarkLod()
+	{
+		MyMeshCache::setEnabled(false);
+
+		// Same projection and viewport as MyApplication at its default window size
+		const float viewportHeight = 600.0f;
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 96.0f);
+		camera.setViewDirection(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f });
+		const float pixelsPerUnitAt1 = camera.pixelsPerUnit(glm::vec3{ 0.0f, 0.0f, 1.0f }, 0.0f, viewportHeight);
+
+		struct SceneModel
+		{
+			std::vector<MyModel::Lod> lods;
+			glm::vec3                 center;
+			float                     radius;
+		};
+		std::vector<SceneModel> sceneModels;
+
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.optimizeMesh = true;
+			builder.loadModel(model, 0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			MyMeshSimplifier::buildLodChain(builder.vertices, builder.indices, builder.lods, true);
+			double chainTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			glm::vec3 minPosition = builder.vertices[0].position;
+			glm::vec3 maxPosition = builder.vertices[0].position;
+			for (const auto& vertex : builder.vertices)
+			{
+				minPosition = glm::min(minPosition, vertex.position);
+				maxPosition = glm::max(maxPosition, vertex.position);
+			}
+			glm::vec3 center = 0.5f * (minPosition + maxPosition);
+			float radius = 0.0f;
+			for (const auto& vertex : builder.vertices)
+				radius = std::max(radius, glm::length(vertex.position - center));
+
+			std::cout << model << ": " << builder.lods.size() << " LODs in " << chainTime << " ms, radius " << radius << std::endl;
+
+			// Used vertices of LOD 0, at most 4096 of them
+			std::vector<glm::vec3> samples;
+			{
+				std::vector<char> used(builder.vertices.size(), 0);
+				for (uint32_t i = 0; i < builder.lods[0].indexCount; i++)
+					used[builder.indices[i]] = 1;
+				size_t step = std::max<size_t>(builder.vertices.size() / 4096, 1);
+				for (size_t v = 0; v < builder.vertices.size(); v += step)
+				{
+					if (used[v])
+						samples.push_back(builder.vertices[v].position);
+				}
+			}
+
+			const float lod0Triangles = builder.lods[0].indexCount / 3.0f;
+			for (size_t l = 0; l < builder.lods.size(); l++)
+			{
+				const MyModel::Lod& lod = builder.lods[l];
+
+				// One sided Hausdorff distance from LOD 0 to this LOD
+				float measured = 0.0f;
+				for (const glm::vec3& p : samples)
+				{
+					float nearest = std::numeric_limits<float>::max();
+					for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i += 3)
+					{
+						nearest = std::min(nearest, pointTriangleDistance(p,
+							builder.vertices[builder.indices[i + 0]].position,
+							builder.vertices[builder.indices[i + 1]].position,
+							builder.vertices[builder.indices[i + 2]].position));
+					}
+					measured = std::max(measured, nearest);
+				}
+
+				// Beyond this distance the error is below one pixel
+				float switchDistance = lod.error * pixelsPerUnitAt1 + radius;
+
+				std::cout << "  LOD " << l << ": " << lod.indexCount / 3 << " triangles ("
+				          << 100.0f * lod.indexCount / 3 / lod0Triangles << "%), error " << lod.error
+				          << " (" << 100.0f * lod.error / radius << "% of radius), measured " << measured
+				          << ", 1 px beyond " << switchDistance << std::endl;
+			}
+
+			// Note: a flat shaded mesh has a chart corner at every vertex, nothing can move
+			if (builder.lods.size() > 1)
+				sceneModels.push_back({ builder.lods, center, radius });
+		}
+
+		// 32 x 32 objects in front of the camera, up to the far plane
+		const int GRID = 32;
+		std::vector<glm::mat4> transforms;
+		for (int z = 0; z < GRID; z++)
+		{
+			for (int x = 0; x < GRID; x++)
+			{
+				glm::mat4 transform{ 1.0f };
+				transform[3] = glm::vec4{ (x - GRID / 2) * 2.5f, 0.0f, 4.0f + z * 2.8f, 1.0f };
+				transforms.push_back(transform);
+			}
+		}
+
+		std::cout << "Scene: " << transforms.size() << " objects, depth 4 - " << 4.0f + (GRID - 1) * 2.8f << std::endl;
+		for (float pixelError : { 0.0f, 0.5f, 1.0f, 2.0f, 4.0f })
+		{
+			uint64_t triangles = 0;
+			uint32_t lodHistogram[MyMeshSimplifier::MAX_LOD_COUNT] = {};
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < transforms.size(); i++)
+			{
+				const SceneModel& model = sceneModels[i % sceneModels.size()];
+				uint32_t lod = MyModel::selectLod(
+					model.lods.data(), static_cast<uint32_t>(model.lods.size()), model.center, model.radius,
+					transforms[i], camera, viewportHeight, pixelError);
+
+				triangles += model.lods[lod].indexCount / 3;
+				lodHistogram[lod]++;
+			}
+			double selectTime = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+			std::cout << "  " << pixelError << " px: " << triangles << " triangles, objects per LOD";
+			for (uint32_t count : lodHistogram)
+				std::cout << " " << count;
+			std::cout << ", selection " << selectTime << " us" << std::endl;
+		}
+
+		MyMeshCache::setEnabled(true);
+	}
+
+	// Meshlet sizes, and how much the culler rejects from cameras orbiting each
+	// model and from a close up camera that only sees part of it
+	void benchmarkMeshlets()
+	{
+		MyMeshCache::setEnabled(false);
+
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.optimizeMesh = true;
+			builder.loadModel(model, 0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<MyModel::Meshlet> meshlets = MyMeshletBuilder::build(builder.vertices, builder.indices, builder.indices.size());
+			double buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			uint32_t vertexSum = 0;
+			uint32_t triangleSum = 0;
+			uint32_t coneCount = 0;
+			glm::vec3 minPosition = builder.vertices[0].position;
+			glm::vec3 maxPosition = builder.vertices[0].position;
+			for (const auto& meshlet : meshlets)
+			{
+				vertexSum += meshlet.vertexCount;
+				triangleSum += meshlet.indexCount / 3;
+				coneCount += meshlet.coneCutoff < 1.0f ? 1 : 0;
+			}
+			for (const auto& vertex : builder.vertices)
+			{
+				minPosition = glm::min(minPosition, vertex.position);
+				maxPosition = glm::max(maxPosition, vertex.position);
+			}
+			glm::vec3 center = 0.5f * (minPosition + maxPosition);
+			float radius = 0.5f * glm::length(maxPosition - minPosition);
+
+			std::cout << model << ": " << meshlets.size() << " meshlets in " << buildTime << " ms, "
+			          << static_cast<float>(vertexSum) / meshlets.size() << " vertices and "
+			          << static_cast<float>(triangleSum) / meshlets.size() << " triangles on average, "
+			          << coneCount << " with a normal cone" << std::endl;
+
+			struct View
+			{
+				const char* name;
+				glm::vec3   eye;
+				glm::vec3   target;
+			};
+			std::vector<View> views;
+			for (int i = 0; i < 8; i++)
+			{
+				float angle = glm::two_pi<float>() * i / 8.0f;
+				views.push_back({ "orbit", center + 3.0f * radius * glm::vec3{ std::cos(angle), 0.3f, std::sin(angle) }, center });
+			}
+			views.push_back({ "close up", center + glm::vec3{ 0.0f, 0.0f, -0.6f * radius }, center + glm::vec3{ 0.5f * radius, 0.0f, 0.0f } });
+
+			for (bool bBackface : { false, true })
+			{
+				MyMeshletCuller culler;
+				culler.setBackfaceCulling(bBackface);
+
+				uint64_t keptTriangles = 0;
+				uint32_t wrongCulls = 0;
+				double cullTime = 0.0;
+				for (size_t v = 0; v < views.size(); v++)
+				{
+					const View& view = views[v];
+					MyCamera camera{};
+					camera.setPerspectiveProjection(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 96.0f);
+					camera.setViewTarget(view.eye, view.target);
+					culler.setView(camera.projectionMatrix() * camera.viewMatrix(), view.eye);
+
+					auto cullStart = std::chrono::high_resolution_clock::now();
+					const auto& ranges = culler.cull(meshlets, glm::mat4{ 1.0f });
+					cullTime += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - cullStart).count();
+
+					// A visible triangle must never be in a rejected meshlet
+					std::vector<char> kept(builder.indices.size() / 3, 0);
+					for (const auto& range : ranges)
+					{
+						keptTriangles += range.indexCount / 3;
+						std::fill(kept.begin() + range.firstIndex / 3, kept.begin() + (range.firstIndex + range.indexCount) / 3, 1);
+					}
+					for (size_t t = 0; t < kept.size(); t++)
+					{
+						const glm::vec3& p0 = builder.vertices[builder.indices[3 * t + 0]].position;
+						const glm::vec3& p1 = builder.vertices[builder.indices[3 * t + 1]].position;
+						const glm::vec3& p2 = builder.vertices[builder.indices[3 * t + 2]].position;
+						glm::vec4 clip = camera.projectionMatrix() * camera.viewMatrix() * glm::vec4{ p0, 1.0f };
+						bool bInside = std::fabs(clip.x) < clip.w && std::fabs(clip.y) < clip.w && clip.z > 0.0f && clip.z < clip.w;
+						bool bFrontFacing = glm::dot(glm::cross(p1 - p0, p2 - p0), view.eye - p0) > 0.0f;
+						if (!kept[t] && bInside && (bFrontFacing || !bBackface))
+							wrongCulls++;
+					}
+
+					if (v == views.size() - 1 || v == 0)
+					{
+						const auto& stats = culler.stats();
+						std::cout << "  " << (bBackface ? "frustum + backface, " : "frustum, ") << view.name
+						          << ": culled " << stats.frustumCulled << " frustum, " << stats.backfaceCulled << " backface, "
+						          << stats.drawCount << " draws" << std::endl;
+					}
+					culler.resetStats();
+				}
+
+				std::cout << "  " << (bBackface ? "frustum + backface" : "frustum") << " over all views: "
+				          << 100.0 * keptTriangles / (views.size() * builder.indices.size() / 3) << "% of the triangles kept, "
+				          << cullTime / views.size() << " us per cull"
+				          << ", visible triangles culled: " << wrongCulls << std::endl;
+			}
+		}
+
+		MyMeshCache::setEnabled(true);
+	}
+
+	// Vertex/index memory of the float and packed layouts and the packing error
+	void benchmarkVertexFormat()
+	{
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.loadModel(model, 0);
+			const auto& vertices = builder.vertices;
+			uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+			auto start = std::chrono::high_resolution_clock::now();
+			MyModel::PackedVertices packed = MyModel::packVertices(vertices.data(), vertexCount);
+			double packTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// Decode on the CPU the way the vertex shaders do
+			float maxPositionError = 0.0f;
+			float maxNormalError = 0.0f;
+			float maxUVError = 0.0f;
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const auto& p = packed.positions[i];
+				glm::vec4 position = packed.positionTransform * glm::vec4{ p.x / 65535.0f, p.y / 65535.0f, p.z / 65535.0f, 1.0f };
+				maxPositionError = std::max(maxPositionError, glm::length(glm::vec3{ position.x, position.y, position.z } - vertices[i].position));
+
+				const auto& a = packed.attributes[i];
+				glm::vec3 n{ std::max(a.normal[0] / 32767.0f, -1.0f), std::max(a.normal[1] / 32767.0f, -1.0f), 0.0f };
+				n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+				float t = std::max(-n.z, 0.0f);
+				n.x += n.x >= 0.0f ? -t : t;
+				n.y += n.y >= 0.0f ? -t : t;
+				if (glm::length(vertices[i].normal) > 0.0f)
+				{
+					float cosAngle = glm::dot(glm::normalize(n), glm::normalize(vertices[i].normal));
+					maxNormalError = std::max(maxNormalError, std::acos(std::min(cosAngle, 1.0f)) * 57.2957795f);
+				}
+
+				glm::vec2 uv = vertices[i].uv;
+				float u = halfToFloat(static_cast<uint16_t>(a.uv & 0xFFFF));
+				float v = halfToFloat(static_cast<uint16_t>(a.uv >> 16));
+				maxUVError = std::max(maxUVError, std::max(std::fabs(u - uv.x), std::fabs(v - uv.y)));
+			}
+
+			size_t floatBytes = vertexCount * sizeof(MyModel::Vertex);
+			size_t packedBytes = vertexCount * (sizeof(MyModel::PackedPosition) + sizeof(MyModel::PackedAttributes)) +
+				packed.colors.size() * sizeof(uint32_t);
+			size_t indexBytes32 = builder.indices.size() * sizeof(uint32_t);
+			size_t indexBytes = vertexCount <= 0x10000 ? builder.indices.size() * sizeof(uint16_t) : indexBytes32;
+
+			std::cout << model << ": " << vertexCount << " vertices" << (packed.colors.empty() ? ", no vertex colors" : "") << std::endl
+			          << "  vertices " << floatBytes / 1024.0 << " KB -> " << packedBytes / 1024.0 << " KB (" << 100.0 * packedBytes / floatBytes << "%), "
+			          << "shadow pass fetch " << sizeof(MyModel::Vertex) << " -> " << sizeof(MyModel::PackedPosition) << " bytes/vertex" << std::endl
+			          << "  indices " << indexBytes32 / 1024.0 << " KB -> " << indexBytes / 1024.0 << " KB" << std::endl
+			          << "  max error: position " << maxPositionError << ", normal " << maxNormalError << " deg, uv " << maxUVError
+			          << ", packing " << packTime << " ms" << std::endl;
+		}
+	}
+
+	void benchmarkGeometryArena()
+	{
+		// Random loads and unloads of the benchmark models in one arena page, the way
+		// MyGeometryArena allocates them (packed layout: 16 bit indices, 3 streams)
+		struct Mesh
+		{
+			uint32_t     vertexCount;
+			VkDeviceSize indexSize;
+		};
+
+		std::vector<Mesh> meshes;
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.optimizeMesh = true;
+			builder.generateLods = true;
+			builder.loadModel(model, 0);
+			meshes.push_back({ static_cast<uint32_t>(builder.vertices.size()), builder.indices.size() * sizeof(uint16_t) });
+		}
+
+		struct Live
+		{
+			uint32_t     mesh;
+			VkDeviceSize firstVertex;
+			VkDeviceSize indexOffset;
+		};
+
+		MyFreeListAllocator vertexAllocator{ MyGeometryArena::PAGE_VERTICES };
+		MyFreeListAllocator indexAllocator{ MyGeometryArena::PAGE_INDEX_BYTES };
+		std::vector<Live> live;
+		std::mt19937 random{ 1 };
+
+		const int OPERATIONS = 200000;
+		uint32_t failedCount = 0;
+		size_t maxLive = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < OPERATIONS; i++)
+		{
+			// Slightly more loads than unloads, so the page fills up and stays full
+			if (live.empty() || random() % 100 < 52)
+			{
+				Live model{ static_cast<uint32_t>(random() % meshes.size()), 0, 0 };
+				const Mesh& mesh = meshes[model.mesh];
+				if (!vertexAllocator.allocate(mesh.vertexCount, 1, model.firstVertex))
+				{
+					failedCount++;
+					continue;
+				}
+				if (!indexAllocator.allocate(mesh.indexSize, sizeof(uint16_t), model.indexOffset))
+				{
+					vertexAllocator.free(model.firstVertex, mesh.vertexCount);
+					failedCount++;
+					continue;
+				}
+				live.push_back(model);
+				maxLive = std::max(maxLive, live.size());
+			}
+			else
+			{
+				size_t index = random() % live.size();
+				const Mesh& mesh = meshes[live[index].mesh];
+				vertexAllocator.free(live[index].firstVertex, mesh.vertexCount);
+				indexAllocator.free(live[index].indexOffset, mesh.indexSize);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		auto print = [](const char* label, const MyFreeListAllocator::Stats& stats)
+		{
+			std::cout << "  " << label << ": " << 100.0 * stats.used / stats.size << "% used, "
+			          << stats.freeBlockCount << " free blocks, largest " << stats.largestFreeBlock
+			          << ", fragmentation " << 100.0f * stats.fragmentation() << "%" << std::endl;
+		};
+
+		std::cout << OPERATIONS << " loads/unloads in " << time << " ms (" << time * 1000000.0 / OPERATIONS << " ns each), "
+		          << live.size() << " models live (max " << maxLive << "), " << failedCount << " loads did not fit" << std::endl;
+		print("vertices", vertexAllocator.stats());
+		print("index bytes", indexAllocator.stats());
+		std::cout << "  memory allocations: " << live.size() * 4 << " with a buffer per stream and index buffer, 4 with the arena page" << std::endl;
+	}
+
+	void benchmarkMemoryAllocator()
+	{
+		// The same random resource churn in one 64 MB memory block, once with the
+		// best fit free list and once with the TLSF allocator the device memory uses.
+		// Sizes are mostly buffers and small textures with a few large images.
+		const int OPERATIONS = 200000;
+		const VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+
+		struct Request
+		{
+			bool         bAllocate;
+			VkDeviceSize size;
+			VkDeviceSize alignment;
+			uint32_t     victim;   // which live allocation a free releases
+		};
+
+		std::mt19937 random{ 1 };
+		std::vector<Request> requests(OPERATIONS);
+		for (auto& request : requests)
+		{
+			request.bAllocate = random() % 100 < 52;
+			uint32_t kind = random() % 100;
+			request.size = kind < 70 ? 256 + random() % 65536 : kind < 97 ? 65536 + random() % (1024 * 1024) : 4 * 1024 * 1024 + random() % (8 * 1024 * 1024);
+			request.alignment = VkDeviceSize(1) << (8 + random() % 9);
+			request.victim = random();
+		}
+
+		auto run = [&](const char* label, auto allocate, auto free, auto stats)
+		{
+			struct Live
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				uint32_t     handle;
+			};
+
+			std::vector<Live> live;
+			uint32_t failedCount = 0;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const auto& request : requests)
+			{
+				if (request.bAllocate || live.empty())
+				{
+					Live allocation{ 0, request.size, 0 };
+					if (allocate(request.size, request.alignment, allocation.offset, allocation.handle))
+						live.push_back(allocation);
+					else
+						failedCount++;
+				}
+				else
+				{
+					size_t index = request.victim % live.size();
+					free(live[index].offset, live[index].size, live[index].handle);
+					live[index] = live.back();
+					live.pop_back();
+				}
+			}
+			double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			MyFreeListAllocator::Stats blockStats = stats();
+			std::cout << label << ": " << time * 1000000.0 / OPERATIONS << " ns per operation, " << failedCount << " did not fit, "
+			          << 100.0 * blockStats.used / blockStats.size << "% used, " << blockStats.freeBlockCount << " free blocks, "
+			          << "fragmentation " << 100.0f * blockStats.fragmentation() << "%" << std::endl;
+		};
+
+		MyFreeListAllocator freeList{ BLOCK_SIZE };
+		run("free list",
+			[&](VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t&) { return freeList.allocate(size, alignment, offset); },
+			[&](VkDeviceSize offset, VkDeviceSize size, uint32_t) { freeList.free(offset, size); },
+			[&]() { return freeList.stats(); });
+
+		MyTlsfAllocator tlsf{ BLOCK_SIZE };
+		run("TLSF",
+			[&](VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& handle) { return tlsf.allocate(size, alignment, offset, handle); },
+			[&](VkDeviceSize, VkDeviceSize, uint32_t handle) { tlsf.free(handle); },
+			[&]() { return tlsf.stats(); });
+	}
+
+	void benchmarkFrameAllocator()
+	{
+		// Stress test: tens of thousands of small uniform and storage blocks per frame,
+		// once from one thread and once from several. Every block is tagged and the
+		// tags are checked after the frame, an overlap would have overwritten one.
+		// Needs a device for the mapped buffer, nothing is submitted.
+		const uint32_t FRAMES = 200;
+		const uint32_t BLOCKS_PER_FRAME = 50000;
+		const uint32_t FRAMES_IN_FLIGHT = 3;
+
+		MyWindow window{ 320, 240, "Frame allocator stress test" };
+		MyDevice device{ window };
+		MyFrameAllocator allocator{ device, FRAMES_IN_FLIGHT, 16 * 1024 * 1024 };
+
+		struct Block
+		{
+			MyFrameAllocator::Allocation allocation;
+			uint32_t                     size;
+		};
+
+		auto allocateBlocks = [&](std::vector<Block>& blocks, uint32_t first, uint32_t count, uint32_t seed)
+		{
+			std::mt19937 random{ seed };
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				uint32_t size = 16 + random() % 240;
+				Block& block = blocks[i];
+				block.size = size;
+				block.allocation = i % 2 ? allocator.allocateStorage(size) : allocator.allocateUniform(size);
+				memset(block.allocation.pData, static_cast<int>(i & 0xFF), size);
+			}
+		};
+
+		auto run = [&](const char* label, uint32_t threadCount)
+		{
+			std::vector<Block> blocks(BLOCKS_PER_FRAME);
+			uint32_t errorCount = 0;
+			VkDeviceSize maxUsed = 0;
+			double time = 0.0;
+
+			for (uint32_t frame = 0; frame < FRAMES; frame++)
+			{
+				allocator.beginFrame(frame % FRAMES_IN_FLIGHT);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				if (threadCount == 1)
+				{
+					allocateBlocks(blocks, 0, BLOCKS_PER_FRAME, frame);
+				}
+				else
+				{
+					std::vector<std::thread> threads;
+					uint32_t share = BLOCKS_PER_FRAME / threadCount;
+					for (uint32_t t = 0; t < threadCount; t++)
+					{
+						uint32_t count = t + 1 == threadCount ? BLOCKS_PER_FRAME - share * t : share;
+						threads.emplace_back(allocateBlocks, std::ref(blocks), share * t, count, frame * threadCount + t);
+					}
+					for (auto& thread : threads)
+						thread.join();
+				}
+				time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				maxUsed = std::max(maxUsed, allocator.used());
+
+				VkDeviceSize frameBegin = allocator.frameSize() * (frame % FRAMES_IN_FLIGHT);
+				for (uint32_t i = 0; i < BLOCKS_PER_FRAME; i++)
+				{
+					const Block& block = blocks[i];
+					const unsigned char* pData = static_cast<const unsigned char*>(block.allocation.pData);
+					bool bInFrame = block.allocation.offset >= frameBegin && block.allocation.offset + block.size <= frameBegin + allocator.frameSize();
+					VkDeviceSize alignment = i % 2 ? device.limits().minStorageBufferOffsetAlignment : device.limits().minUniformBufferOffsetAlignment;
+					if (!bInFrame || block.allocation.offset % std::max<VkDeviceSize>(alignment, 1) != 0 ||
+						pData[0] != (i & 0xFF) || pData[block.size - 1] != (i & 0xFF))
+					{
+						errorCount++;
+					}
+				}
+			}
+
+			std::cout << label << ": " << BLOCKS_PER_FRAME << " blocks per frame in " << time / FRAMES << " ms ("
+			          << time * 1000000.0 / (double(FRAMES) * BLOCKS_PER_FRAME) << " ns each), up to "
+			          << maxUsed / 1024 << " KB of " << allocator.frameSize() / 1024 << " KB per frame, "
+			          << errorCount << " bad blocks" << std::endl;
+		};
+
+		run("1 thread", 1);
+		run("4 threads", 4);
+	}
+
+	void benchmarkUploads()
+	{
+		// Startup style uploads of the benchmark models and some textures: one submission
+		// per asset against all of them in one MyUploadBatch. The old path did a queue
+		// round trip per copy and per layout transition, it is estimated from the cost
+		// of an empty submission. Needs a GPU, the window stays hidden behind the timing.
+		const int ROUNDS = 5;
+		const uint32_t TEXTURE_COUNT = 8;
+		const uint32_t TEXTURE_SIZE = 1024;
+
+		MyWindow window{ 320, 240, "Upload benchmark" };
+		MyDevice device{ window };
+
+		std::vector<MyModel::Builder> builders;
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.optimizeMesh = true;
+			builder.generateLods = true;
+			builder.loadModel(model, 0);
+			builders.push_back(std::move(builder));
+		}
+
+		std::vector<unsigned char> pixels(TEXTURE_SIZE * TEXTURE_SIZE * 4);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = static_cast<unsigned char>(i * 7);
+
+		auto upload = [&](MyUploadBatch* pUploadBatch)
+		{
+			std::vector<std::unique_ptr<MyModel>> models;
+			std::vector<std::unique_ptr<MyTexture>> textures;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const auto& builder : builders)
+				models.push_back(std::make_unique<MyModel>(device, builder, pUploadBatch));
+			for (uint32_t i = 0; i < TEXTURE_COUNT; i++)
+				textures.push_back(std::make_unique<MyTexture>(device, pixels.data(), TEXTURE_SIZE, TEXTURE_SIZE, pUploadBatch));
+			if (pUploadBatch)
+				device.submitUploads(*pUploadBatch);
+			double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			vkDeviceWaitIdle(device.device());
+			return time;
+		};
+
+		double perAssetTime = 0.0;
+		double batchedTime = 0.0;
+		for (int round = 0; round < ROUNDS; round++)
+		{
+			perAssetTime += upload(nullptr);
+
+			MyUploadBatch batch{ device };
+			batchedTime += upload(&batch);
+		}
+
+		// An empty submission and wait, the way every copy used to end
+		const int SUBMITS = 100;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < SUBMITS; i++)
+			device.endSingleTimeCommands(device.beginSingleTimeCommands());
+		double roundTrip = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / SUBMITS;
+
+		// Per model: a copy per vertex stream and the index copy, per texture: the
+		// transition, the copy and the mipmaps
+		uint32_t oldSubmits = static_cast<uint32_t>(builders.size()) * (MyModel::vertexFormat() == MyModel::VERTEX_FORMAT_PACKED ? 4 : 2) +
+			TEXTURE_COUNT * 3;
+		uint32_t assetCount = static_cast<uint32_t>(builders.size()) + TEXTURE_COUNT;
+
+		std::cout << builders.size() << " models, " << TEXTURE_COUNT << " textures of " << TEXTURE_SIZE << "x" << TEXTURE_SIZE << std::endl
+		          << "  empty submission round trip: " << roundTrip << " ms" << std::endl
+		          << "  per copy submissions (estimated): " << oldSubmits << " submissions, >= " << oldSubmits * roundTrip << " ms of round trips" << std::endl
+		          << "  per asset submissions: " << assetCount << " submissions, " << perAssetTime / ROUNDS << " ms" << std::endl
+		          << "  one batch: 1 submission, " << batchedTime / ROUNDS << " ms" << std::endl;
+
+		// Larger than the whole staging pool, so it goes in chunks of rows and the
+		// batch submits whenever the pool is full
+		const uint32_t LARGE_TEXTURE_SIZE = 8192;
+		std::vector<unsigned char> largePixels(static_cast<size_t>(LARGE_TEXTURE_SIZE) * LARGE_TEXTURE_SIZE * 4, 128);
+
+		start = std::chrono::high_resolution_clock::now();
+		{
+			MyTexture texture{ device, largePixels.data(), LARGE_TEXTURE_SIZE, LARGE_TEXTURE_SIZE };
+		}
+		double largeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::cout << "  " << LARGE_TEXTURE_SIZE << "x" << LARGE_TEXTURE_SIZE << " texture (" << largePixels.size() / (1024 * 1024) << " MB): "
+		          << largeTime << " ms, staging pool " << device.stagingPool().size() / (1024 * 1024) << " MB in "
+		          << MyStagingPool::CHUNK_SIZE / (1024 * 1024) << " MB chunks" << std::endl;
+	}
+
+	void benchmarkDefragmentation()
+	{
+		// Soak test: a long session of random texture and model loads and unloads, then
+		// most of them unloaded. Reports the device memory held (blocks and dedicated
+		// allocations) against the memory of the live resources, once without and once
+		// with MyDefragmenter moving resources between the "frames". Needs a GPU.
+		const int FRAMES = 2000;
+		const int SETTLE_FRAMES = 500;
+		const uint32_t TEXTURE_SIZES[] = { 128, 256, 512, 1024 };
+		const double MB = 1024.0 * 1024.0;
+
+		MyWindow window{ 320, 240, "Defragmentation soak test" };
+		MyDevice device{ window };
+
+		std::vector<unsigned char> pixels(1024 * 1024 * 4, 200);
+
+		// Flat grids of 'side' x 'side' vertices
+		auto gridBuilder = [](uint32_t side)
+		{
+			MyModel::Builder builder{};
+			for (uint32_t z = 0; z < side; z++)
+			{
+				for (uint32_t x = 0; x < side; x++)
+				{
+					MyModel::Vertex vertex{};
+					vertex.position = { static_cast<float>(x), 0.0f, static_cast<float>(z) };
+					vertex.normal = { 0.0f, -1.0f, 0.0f };
+					builder.vertices.push_back(vertex);
+				}
+			}
+			for (uint32_t z = 0; z + 1 < side; z++)
+			{
+				for (uint32_t x = 0; x + 1 < side; x++)
+				{
+					uint32_t i = z * side + x;
+					builder.indices.insert(builder.indices.end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+				}
+			}
+			return builder;
+		};
+
+		auto held = [&device]() { MyMemoryAllocator::Stats stats = device.memoryStats(); return stats.blockBytes + stats.dedicatedBytes; };
+		auto live = [&device]() { MyMemoryAllocator::Stats stats = device.memoryStats(); return stats.usedBytes + stats.dedicatedBytes; };
+
+		auto run = [&](bool bDefragment)
+		{
+			MyDefragmenter defragmenter{ device, 2 };
+			std::vector<std::shared_ptr<MyTexture>> textures;
+			std::vector<std::unique_ptr<MyModel>> models;
+			std::mt19937 random{ 7 };
+			VkDeviceSize peakHeld = 0;
+			VkDeviceSize peakLive = 0;
+
+			// Every frame waits for its submission, so the moves of two frames ago retire
+			int frame = 0;
+			auto endFrame = [&]()
+			{
+				defragmenter.beginFrame(frame % 2);
+				if (bDefragment)
+				{
+					VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+					defragmenter.record(commandBuffer);
+					device.endSingleTimeCommands(commandBuffer);
+				}
+				peakHeld = std::max(peakHeld, held());
+				peakLive = std::max(peakLive, live());
+				frame++;
+			};
+
+			auto unloadOne = [&]()
+			{
+				bool bTexture = models.empty() || (!textures.empty() && random() % 100 < 70);
+				if (bTexture)
+				{
+					size_t index = random() % textures.size();
+					textures[index] = textures.back();
+					textures.pop_back();
+				}
+				else
+				{
+					size_t index = random() % models.size();
+					models[index] = std::move(models.back());
+					models.pop_back();
+				}
+			};
+
+			for (int i = 0; i < FRAMES; i++)
+			{
+				// Loads win below a working set of about 150 assets, unloads above
+				size_t count = textures.size() + models.size();
+				if (count == 0 || random() % 100 < (count < 150 ? 60u : 40u))
+				{
+					if (random() % 100 < 70)
+					{
+						uint32_t size = TEXTURE_SIZES[random() % std::size(TEXTURE_SIZES)];
+						textures.push_back(std::make_shared<MyTexture>(device, pixels.data(), size, size));
+						defragmenter.track(textures.back());
+					}
+					else
+					{
+						models.push_back(std::make_unique<MyModel>(device, gridBuilder(16 + random() % 160)));
+					}
+				}
+				else
+				{
+					unloadOne();
+				}
+				endFrame();
+			}
+
+			VkDeviceSize churnHeld = held();
+			VkDeviceSize churnLive = live();
+
+			// The session moves on, three quarters of the assets go
+			size_t keep = (textures.size() + models.size()) / 4;
+			while (textures.size() + models.size() > keep)
+				unloadOne();
+			for (int i = 0; i < SETTLE_FRAMES; i++)
+				endFrame();
+
+			std::cout << (bDefragment ? "with defragmentation" : "without defragmentation") << std::endl
+			          << "  peak: " << peakHeld / MB << " MB held, " << peakLive / MB << " MB live" << std::endl
+			          << "  after " << FRAMES << " frames of churn: " << churnHeld / MB << " MB held, " << churnLive / MB << " MB live" << std::endl
+			          << "  after unloading 3/4 and " << SETTLE_FRAMES << " frames: " << held() / MB << " MB held, " << live() / MB << " MB live, "
+			          << device.memoryStats().blockCount << " blocks" << std::endl;
+			if (bDefragment)
+			{
+				const MyDefragmenter::Stats& stats = defragmenter.stats();
+				std::cout << "  " << stats.moveCount << " moves, " << stats.movedBytes / MB << " MB copied, "
+				          << stats.evacuatedBlocks << " blocks evacuated" << std::endl;
+			}
+
+			vkDeviceWaitIdle(device.device());
+		};
+
+		run(false);
+		run(true);
+	}
+
+	void benchmarkAttachments()
+	{
+		// Device memory of the render targets MySwapChain creates, at common resolutions.
+		// Before: every target in memory of its own, an MSAA color target even without
+		// MSAA. After: no color target without MSAA, transient targets in lazily allocated
+		// memory (counted as 0, it is only committed if the driver needs it) where the
+		// device has such memory, otherwise the pick targets alias the shadow map.
+		// Sizes come from vkGetImageMemoryRequirements. Needs a GPU.
+		const uint32_t IMAGE_COUNT = 3; // swap chain images, minImageCount + 1 on most drivers
+		const uint32_t SHADOW_MAP_SIZE = 2048;
+		const VkExtent2D RESOLUTIONS[] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+		const double MB = 1024.0 * 1024.0;
+
+		MyWindow window{ 320, 240, "Attachment memory" };
+		MyDevice device{ window };
+
+		VkFormat depthFormat = device.findSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		bool bLazy = device.memoryAllocator().hasMemoryType(
+			UINT32_MAX, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+		auto requirements = [&device](VkFormat format, uint32_t width, uint32_t height, VkSampleCountFlagBits samples, VkImageUsageFlags usage)
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = { width, height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = usage;
+			imageInfo.samples = samples;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VkImage image;
+			if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create image!");
+			}
+			VkMemoryRequirements memRequirements;
+			vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
+			vkDestroyImage(device.device(), image, nullptr);
+			return memRequirements;
+		};
+
+		const VkImageUsageFlags TRANSIENT_COLOR = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		const VkImageUsageFlags TRANSIENT_DEPTH = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		VkDeviceSize shadowMap = requirements(VK_FORMAT_D16_UNORM, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT).size;
+
+		std::cout << "Attachment memory, " << IMAGE_COUNT << " swap chain images, " << SHADOW_MAP_SIZE << "x" << SHADOW_MAP_SIZE
+		          << " shadow map, lazily allocated memory: " << (bLazy ? "yes" : "no") << std::endl;
+
+		std::vector<VkSampleCountFlagBits> sampleCounts{ VK_SAMPLE_COUNT_1_BIT };
+		if (device.msaaSamples() != VK_SAMPLE_COUNT_1_BIT)
+			sampleCounts.push_back(device.msaaSamples());
+
+		for (VkSampleCountFlagBits samples : sampleCounts)
+		{
+			for (const VkExtent2D& extent : RESOLUTIONS)
+			{
+				VkDeviceSize color = requirements(VK_FORMAT_B8G8R8A8_SRGB, extent.width, extent.height, samples, TRANSIENT_COLOR).size;
+				VkDeviceSize depth = requirements(depthFormat, extent.width, extent.height, samples, TRANSIENT_DEPTH).size;
+				VkMemoryRequirements pickColor = requirements(VK_FORMAT_R32_SFLOAT, extent.width, extent.height, VK_SAMPLE_COUNT_1_BIT, TRANSIENT_COLOR);
+				VkMemoryRequirements pickDepth = requirements(depthFormat, extent.width, extent.height, VK_SAMPLE_COUNT_1_BIT, TRANSIENT_DEPTH);
+
+				VkDeviceSize before = IMAGE_COUNT * (color + depth) + pickColor.size + pickDepth.size + shadowMap;
+
+				VkDeviceSize after = shadowMap;
+				if (!bLazy)
+				{
+					VkDeviceSize pickDepthOffset = (pickColor.size + pickDepth.alignment - 1) / pickDepth.alignment * pickDepth.alignment;
+					after = std::max(pickDepthOffset + pickDepth.size, shadowMap);
+					after += IMAGE_COUNT * ((samples != VK_SAMPLE_COUNT_1_BIT ? color : 0) + depth);
+				}
+
+				std::cout << "  " << extent.width << "x" << extent.height << " " << samples << "x MSAA: "
+				          << before / MB << " MB before, " << after / MB << " MB after ("
+				          << 100.0 * (1.0 - static_cast<double>(after) / static_cast<double>(before)) << "% less)" << std::endl;
+			}
+		}
+	}
+
+	void benchmarkUnifiedMemory()
+	{
+		// Asset loads and per-frame updates with the unified memory fast path and
+		// without it. Fast path: the arena pages and the frame allocator are device
+		// local and host visible and written in place, textures use the host image
+		// copy if the device has VK_EXT_host_image_copy. Without it everything goes
+		// through the staging pool and a submission, as on a discrete GPU. Needs a
+		// device with unified memory (integrated GPU, resizable BAR or lavapipe,
+		// e.g. VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json).
+		const int ROUNDS = 5;
+		const uint32_t TEXTURE_COUNT = 8;
+		const uint32_t TEXTURE_SIZE = 1024;
+		const uint32_t FRAMES = 200;
+		const uint32_t DYNAMIC_VERTICES = 64 * 1024; // rewritten every frame, e.g. particles or skinning on the CPU
+		const VkDeviceSize UNIFORM_BYTES = 256 * 1024; // per frame
+
+		MyWindow window{ 320, 240, "Unified memory benchmark" };
+		MyDevice device{ window };
+		if (!device.unifiedMemory())
+		{
+			std::cout << "No host visible device local heap, the fast path is never taken" << std::endl;
+			return;
+		}
+
+		std::vector<MyModel::Builder> builders;
+		for (const char* model : BENCH_MODELS)
+		{
+			MyModel::Builder builder{};
+			builder.optimizeMesh = true;
+			builder.loadModel(model, 0);
+			builders.push_back(std::move(builder));
+		}
+
+		std::vector<unsigned char> pixels(TEXTURE_SIZE * TEXTURE_SIZE * 4);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = static_cast<unsigned char>(i * 7);
+
+		std::vector<MyModel::Vertex> dynamicVertices(DYNAMIC_VERTICES);
+		std::vector<unsigned char> uniforms(static_cast<size_t>(UNIFORM_BYTES), 1);
+
+		auto run = [&](const char* label, bool bUnified)
+		{
+			device.setUnifiedMemory(bUnified);
+
+			double loadTime = 0.0;
+			for (int round = 0; round < ROUNDS; round++)
+			{
+				std::vector<std::unique_ptr<MyModel>> models;
+				std::vector<std::unique_ptr<MyTexture>> textures;
+
+				auto start = std::chrono::high_resolution_clock::now();
+				MyUploadBatch batch{ device, true };
+				for (const auto& builder : builders)
+					models.push_back(std::make_unique<MyModel>(device, builder, &batch));
+				for (uint32_t i = 0; i < TEXTURE_COUNT; i++)
+					textures.push_back(std::make_unique<MyTexture>(device, pixels.data(), TEXTURE_SIZE, TEXTURE_SIZE, &batch));
+				device.submitUploads(batch);
+				loadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+
+			// A vertex stream and the uniforms of every frame. The arena and the frame
+			// allocator pick their memory when they are made, after the switch above
+			MyGeometryArena arena{ device, { static_cast<uint32_t>(sizeof(MyModel::Vertex)) } };
+			MyGeometryArena::Allocation allocation = arena.allocate(DYNAMIC_VERTICES, sizeof(uint32_t), sizeof(uint32_t));
+			MyFrameAllocator frameAllocator{ device, 1, UNIFORM_BYTES + 4096 };
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < FRAMES; frame++)
+			{
+				dynamicVertices[frame % DYNAMIC_VERTICES].position.x = static_cast<float>(frame);
+
+				MyUploadBatch batch{ device };
+				batch.copyToBuffer(dynamicVertices.data(), sizeof(MyModel::Vertex) * DYNAMIC_VERTICES, allocation.pBuffers->vertexBuffers[0],
+					sizeof(MyModel::Vertex) * allocation.firstVertex, allocation.pBuffers->pMappedVertexBuffers[0]);
+				device.submitUploads(batch);
+
+				frameAllocator.beginFrame(0);
+				memcpy(frameAllocator.allocateUniform(UNIFORM_BYTES).pData, uniforms.data(), uniforms.size());
+			}
+			double frameTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			arena.free(allocation);
+
+			std::cout << "  " << label << ": load " << loadTime / ROUNDS << " ms, per frame update "
+			          << frameTime / FRAMES << " ms (" << sizeof(MyModel::Vertex) * DYNAMIC_VERTICES / 1024 << " KB of vertices, "
+			          << UNIFORM_BYTES / 1024 << " KB of uniforms)" << std::endl;
+		};
+
+		std::cout << builders.size() << " models, " << TEXTURE_COUNT << " textures of " << TEXTURE_SIZE << "x" << TEXTURE_SIZE
+		          << ", host image copy: " << (device.hostImageCopy() ? "yes" : "no") << std::endl;
+		run("staging", false);
+		run("unified memory", true);
+	}
+
+	void benchmarkResourceHandles()
+	{
+		// The per object part of the draw loop over 100k objects: resolve the model,
+		// build the model matrix, select the LOD and append a draw. Once with every
+		// object holding a shared_ptr to a model allocated on its own (scattered over
+		// the heap by the allocations in between), once with MyHandle into a
+		// MyResourcePool. The second pass also copies the model reference into the
+		// draw list, as a render queue would: an atomic increment and decrement for
+		// shared_ptr, a 32-bit copy for the handle. CPU only.
+		const uint32_t OBJECT_COUNT = 100000;
+		const uint32_t MODEL_COUNT = 4096;
+		const int FRAMES = 50;
+
+		struct BenchModel
+		{
+			glm::mat4                 positionTransform{ 1.0f };
+			std::vector<MyModel::Lod> lods;
+			glm::vec3                 boundingCenter{ 0.0f };
+			float                     boundingRadius = 1.0f;
+			uint32_t                  firstIndex = 0;
+		};
+
+		struct Draw
+		{
+			glm::mat4 modelMatrix;
+			uint32_t  firstIndex;
+			uint32_t  indexCount;
+		};
+
+		std::mt19937 random{ 1 };
+		auto makeModel = [&random](BenchModel& model)
+		{
+			float scale = 1.0f + random() % 4;
+			model.positionTransform = glm::mat4{ 1.0f };
+			model.positionTransform[0][0] = model.positionTransform[1][1] = model.positionTransform[2][2] = scale;
+			model.lods = { { 0, 3000, 0.0f }, { 3000, 1500, 0.01f }, { 4500, 600, 0.05f }, { 5100, 150, 0.2f } };
+			model.boundingRadius = 0.5f + (random() % 100) / 50.0f;
+			model.firstIndex = random() % 100000;
+		};
+
+		// Another allocation between two models, like the heap of a running application
+		std::vector<std::shared_ptr<BenchModel>> sharedModels;
+		std::vector<std::unique_ptr<char[]>> filler;
+		for (uint32_t i = 0; i < MODEL_COUNT; i++)
+		{
+			auto pModel = std::make_shared<BenchModel>();
+			makeModel(*pModel);
+			sharedModels.push_back(pModel);
+			filler.push_back(std::make_unique<char[]>(64 + random() % 1024));
+		}
+		std::shuffle(sharedModels.begin(), sharedModels.end(), random);
+
+		MyResourcePool<BenchModel> pool{ 1 };
+		std::vector<MyHandle<BenchModel>> handles;
+		for (uint32_t i = 0; i < MODEL_COUNT; i++)
+		{
+			handles.push_back(pool.create());
+			makeModel(pool[handles.back()]);
+		}
+
+		// The objects of both versions use the same models in the same order
+		struct SharedObject
+		{
+			std::shared_ptr<BenchModel> model;
+			TransformComponent          transform;
+		};
+		struct HandleObject
+		{
+			MyHandle<BenchModel>        model;
+			TransformComponent          transform;
+		};
+
+		std::vector<SharedObject> sharedObjects(OBJECT_COUNT);
+		std::vector<HandleObject> handleObjects(OBJECT_COUNT);
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+		{
+			uint32_t model = random() % MODEL_COUNT;
+			TransformComponent transform{};
+			transform.translation = { (random() % 2000) / 10.0f - 100.0f, 0.0f, -(random() % 2000) / 10.0f };
+			transform.rotation.y = (random() % 628) / 100.0f;
+			sharedObjects[i] = { sharedModels[model], transform };
+			handleObjects[i] = { handles[model], transform };
+			pool.addRef(handles[model]);
+		}
+
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+		camera.setViewTarget(glm::vec3{ 0.0f, 5.0f, 10.0f }, glm::vec3{ 0.0f });
+
+		std::vector<Draw> draws;
+		draws.reserve(OBJECT_COUNT);
+
+		auto record = [&](const BenchModel& model, TransformComponent& transform)
+		{
+			glm::mat4 modelMatrix = transform.mat4();
+			uint32_t lod = MyModel::selectLod(model.lods.data(), static_cast<uint32_t>(model.lods.size()),
+				model.boundingCenter, model.boundingRadius, modelMatrix, camera, 1080.0f, 1.0f);
+			const MyModel::Lod& range = model.lods[lod];
+			draws.push_back({ modelMatrix * model.positionTransform, model.firstIndex + range.firstIndex, range.indexCount });
+		};
+
+		auto time = [&](auto loop)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < FRAMES; frame++)
+			{
+				draws.clear();
+				loop();
+			}
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / FRAMES;
+		};
+
+		double sharedTime = time([&]()
+		{
+			for (auto& obj : sharedObjects)
+				record(*obj.model, obj.transform);
+		});
+		double handleTime = time([&]()
+		{
+			for (auto& obj : handleObjects)
+				record(pool[obj.model], obj.transform);
+		});
+
+		std::vector<std::shared_ptr<BenchModel>> sharedQueue;
+		std::vector<MyHandle<BenchModel>> handleQueue;
+		sharedQueue.reserve(OBJECT_COUNT);
+		handleQueue.reserve(OBJECT_COUNT);
+		double sharedQueueTime = time([&]()
+		{
+			sharedQueue.clear();
+			for (auto& obj : sharedObjects)
+			{
+				sharedQueue.push_back(obj.model);
+				record(*sharedQueue.back(), obj.transform);
+			}
+		});
+		double handleQueueTime = time([&]()
+		{
+			handleQueue.clear();
+			for (auto& obj : handleObjects)
+			{
+				handleQueue.push_back(obj.model);
+				record(pool[handleQueue.back()], obj.transform);
+			}
+		});
+
+		std::cout << OBJECT_COUNT << " objects, " << MODEL_COUNT << " models, " << draws.size() << " draws per frame" << std::endl
+		          << "  shared_ptr: " << sharedTime << " ms, " << sharedQueueTime << " ms with a draw queue of references" << std::endl
+		          << "  handles:    " << handleTime << " ms, " << handleQueueTime << " ms with a draw queue of references" << std::endl;
+	}
+
+	// Transient containers of a frame on the heap and in a MyFrameArena: a draw
+	// list and per object lists of visible meshlet ranges, as a culling pass would build
+	void benchmarkFrameArena()
+	{
+		const uint32_t OBJECT_COUNT = 2000;
+		const int FRAMES = 200;
+
+		struct Range
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+
+		std::mt19937 random{ 13 };
+		std::vector<uint32_t> meshletCounts(OBJECT_COUNT);
+		for (auto& count : meshletCounts)
+			count = 1 + random() % 64;
+
+		// Keeps the lists from being optimized away
+		uint64_t checksum = 0;
+
+		auto time = [&](auto frame)
+		{
+			uint64_t allocations = MyHeapStats::threadAllocations();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < FRAMES; i++)
+				frame();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / FRAMES;
+			return std::make_pair(ms, static_cast<double>(MyHeapStats::threadAllocations() - allocations) / FRAMES);
+		};
+
+		auto heapTime = time([&]()
+		{
+			std::vector<uint32_t> draws;
+			for (uint32_t object = 0; object < OBJECT_COUNT; object++)
+			{
+				std::vector<Range> ranges;
+				for (uint32_t m = 0; m < meshletCounts[object]; m += 2)
+					ranges.push_back({ m * 372, 372 });
+				checksum += ranges.size();
+				draws.push_back(object);
+			}
+			checksum += draws.size();
+		});
+
+		MyFrameArena arena;
+		auto arenaTime = time([&]()
+		{
+			arena.reset();
+			MyFrameVector<uint32_t> draws{ arena };
+			for (uint32_t object = 0; object < OBJECT_COUNT; object++)
+			{
+				MyFrameVector<Range> ranges{ arena };
+				for (uint32_t m = 0; m < meshletCounts[object]; m += 2)
+					ranges.push_back({ m * 372, 372 });
+				checksum += ranges.size();
+				draws.push_back(object);
+			}
+			checksum += draws.size();
+		});
+
+		std::cout << OBJECT_COUNT << " objects per frame (checksum " << checksum << ")" << std::endl
+		          << "  heap:        " << heapTime.first << " ms, " << heapTime.second << " allocations per frame" << std::endl
+		          << "  frame arena: " << arenaTime.first << " ms, " << arenaTime.second << " allocations per frame, "
+		          << arena.highWater() / 1024.0f << " KB high water" << std::endl;
+	}
+
+	void benchmarkParallelRecording()
+	{
+		// CPU time to record the main pass for 10k, 50k and 100k cubes with
+		// MySimpleRenderFactory: inline on the primary buffer, and split by
+		// MyParallelRecorder into secondary buffers on 1..N threads. Timed from the
+		// begin of the render pass to its end, the frames are submitted and presented
+		// as in the application. Needs a GPU.
+		const uint32_t OBJECT_COUNTS[] = { 10000, 50000, 100000 };
+		const uint32_t FRAMES_IN_FLIGHT = static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT);
+		const int WARMUP_FRAMES = 5;
+		const int FRAMES = 30;
+
+		MyWindow window{ 320, 240, "Parallel recording" };
+		MyDevice device{ window };
+		MyRenderer renderer{ window, device };
+		MyFrameAllocator frameAllocator{ device, FRAMES_IN_FLIGHT, 16 * 1024 * 1024 }; // 100k instances of MyRenderQueue
+		MyDescriptorAllocator descriptors{ device, FRAMES_IN_FLIGHT };
+		auto setLayout = MyDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+		MySimpleRenderFactory factory{ device, renderer.swapChainRenderPass(), setLayout->descriptorSetLayout() };
+		VkDescriptorBufferInfo uboBufferInfo = frameAllocator.descriptorInfo(sizeof(MyGlobalUBO));
+		VkDescriptorBufferInfo instanceBufferInfo = frameAllocator.descriptorInfo(VK_WHOLE_SIZE);
+
+		// A unit cube, 36 vertices
+		std::vector<MyModel::Vertex> vertices;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (float side : { -0.5f, 0.5f })
+			{
+				glm::vec3 corners[4];
+				for (int c = 0; c < 4; c++)
+				{
+					corners[c][axis] = side;
+					corners[c][(axis + 1) % 3] = c & 1 ? 0.5f : -0.5f;
+					corners[c][(axis + 2) % 3] = c & 2 ? 0.5f : -0.5f;
+				}
+				for (int corner : { 0, 1, 3, 0, 3, 2 })
+				{
+					MyModel::Vertex vertex{};
+					vertex.position = corners[corner];
+					vertex.normal[axis] = side * 2.0f;
+					vertex.color = glm::vec3{ 0.8f };
+					vertices.push_back(vertex);
+				}
+			}
+		}
+
+		MyResourcePool<MyModel> models{ FRAMES_IN_FLIGHT };
+		MyModelHandle cube = models.create(device, vertices);
+
+		// A grid of cubes in front of the camera
+		const uint32_t MAX_OBJECTS = OBJECT_COUNTS[std::size(OBJECT_COUNTS) - 1];
+		const uint32_t GRID_SIZE = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(MAX_OBJECTS))));
+		std::vector<MyGameObject> objects;
+		std::vector<MyGameObject*> objectList;
+		objects.reserve(MAX_OBJECTS);
+		for (uint32_t i = 0; i < MAX_OBJECTS; i++)
+		{
+			auto object = MyGameObject::createGameObject(MyGameObject::SIMPLE);
+			object.model = cube;
+			object.transform.translation = { (i % GRID_SIZE) * 1.5f - GRID_SIZE * 0.75f, 0.0f, (i / GRID_SIZE) * 1.5f + 2.0f };
+			object.transform.scale = { 0.5f, 0.5f, 0.5f };
+			objects.push_back(std::move(object));
+			objectList.push_back(&objects.back());
+		}
+
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(45.0f), renderer.aspectRatio(), 0.1f, 500.0f);
+		camera.setViewTarget(glm::vec3{ 0.0f, -20.0f, -10.0f }, glm::vec3{ 0.0f, 0.0f, 50.0f });
+
+		MyGlobalUBO ubo{};
+		ubo.projection = camera.projectionMatrix();
+		ubo.view = camera.viewMatrix();
+		ubo.inverseView = camera.inverseViewMatrix();
+
+		MyRenderQueue renderQueue;
+
+		// Average recording time per frame in ms, pRecorder nullptr = inline
+		auto run = [&](uint32_t objectCount, MyParallelRecorder* pRecorder)
+		{
+			double time = 0.0;
+			for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++)
+			{
+				window.pollEvents();
+
+				VkCommandBuffer commandBuffer = renderer.beginFrame();
+				if (!commandBuffer)
+				{
+					frame--; // the swap chain was recreated
+					continue;
+				}
+
+				int frameIndex = renderer.frameIndex();
+				frameAllocator.beginFrame(frameIndex);
+				descriptors.beginFrame(frameIndex);
+				if (pRecorder)
+					pRecorder->beginFrame(frameIndex);
+
+				VkDescriptorSet descriptorSet = MyDescriptorWriter(*setLayout, descriptors)
+					.writeBuffer(0, &uboBufferInfo)
+					.writeBuffer(3, &instanceBufferInfo)
+					.buildCached();
+
+				MyFrameInfo frameInfo
+				{
+					frameIndex,
+					0.0f,
+					commandBuffer,
+					camera,
+					descriptorSet,
+					descriptorSet,
+					renderQueue,
+					models
+				};
+				frameInfo.viewportHeight = 240.0f;
+				frameInfo.pFrameAllocator = &frameAllocator;
+				frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+				renderQueue.build(frameInfo, objectList.data(), objectCount,
+					MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE), glm::vec3{ 0.0f });
+
+				auto start = std::chrono::high_resolution_clock::now();
+				if (pRecorder)
+				{
+					renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					pRecorder->record(frameInfo, renderer.swapChainInheritance(), [&](MyFrameInfo& shareInfo)
+					{
+						renderer.setSwapChainDynamicState(shareInfo.commandBuffer);
+						factory.render(shareInfo);
+					});
+				}
+				else
+				{
+					renderer.beginSwapChainRenderPass(commandBuffer);
+					factory.render(frameInfo);
+				}
+				renderer.endSwapChainRenderPass(commandBuffer);
+				if (frame >= WARMUP_FRAMES)
+					time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+				renderer.endFrame();
+			}
+			vkDeviceWaitIdle(device.device());
+			return time / FRAMES;
+		};
+
+		// 1, 2, 4, ... and all cores
+		std::vector<std::unique_ptr<MyParallelRecorder>> recorders;
+		uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+			recorders.push_back(std::make_unique<MyParallelRecorder>(device, FRAMES_IN_FLIGHT, threads));
+		recorders.push_back(std::make_unique<MyParallelRecorder>(device, FRAMES_IN_FLIGHT, maxThreads));
+
+		for (uint32_t objectCount : OBJECT_COUNTS)
+		{
+			double inlineTime = run(objectCount, nullptr);
+			std::cout << objectCount << " objects, main pass recording per frame" << std::endl
+			          << "  inline:      " << inlineTime << " ms" << std::endl;
+			for (auto& pRecorder : recorders)
+			{
+				double time = run(objectCount, pRecorder.get());
+				std::cout << "  " << pRecorder->threadCount() << " thread(s): " << time << " ms, "
+				          << inlineTime / time << "x" << std::endl;
+			}
+		}
+	}
+
+	void benchmarkRenderQueue()
+	{
+		// Sorting the draws of a frame: 100k objects in the shadow, main and pick
+		// passes over 16 geometry arena pages, 256 models and 64 textures, listed in
+		// random order as the object map iterates. MyRenderQueue::sortDraws (radix
+		// sort) against std::stable_sort on the keys, and the buffer binds and model
+		// changes in object order and in key order. CPU only.
+		const uint32_t OBJECT_COUNT = 100000;
+		const uint32_t PAGE_COUNT = 16;
+		const uint32_t MODEL_COUNT = 256;
+		const uint32_t TEXTURE_COUNT = 64;
+		const MyRenderQueue::Pass PASSES[] = { MyRenderQueue::PASS_SHADOW, MyRenderQueue::PASS_TEXTURE, MyRenderQueue::PASS_PICK };
+		const int RUNS = 20;
+
+		struct BenchObject
+		{
+			uint32_t page;
+			uint32_t model;
+			uint32_t material;
+			float    depth;
+		};
+
+		std::mt19937 random{ 5 };
+		std::vector<BenchObject> objects(OBJECT_COUNT);
+		for (auto& object : objects)
+		{
+			object.model = random() % MODEL_COUNT;
+			object.page = object.model % PAGE_COUNT;
+			object.material = random() % TEXTURE_COUNT;
+			object.depth = std::uniform_real_distribution<float>{ 0.1f, 500.0f }(random);
+		}
+
+		std::vector<MyRenderQueue::Draw> unsorted;
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+		{
+			for (MyRenderQueue::Pass pass : PASSES)
+			{
+				const BenchObject& object = objects[i];
+				unsorted.push_back({ MyRenderQueue::makeKey(pass, object.page, object.model, 0, object.material, object.depth), i });
+			}
+		}
+
+		// Page and model changes between consecutive draws of a pass
+		auto stateChanges = [&](const std::vector<MyRenderQueue::Draw>& draws)
+		{
+			uint32_t binds = 0;
+			uint32_t modelChanges = 0;
+			for (size_t i = 0; i < draws.size(); i++)
+			{
+				const BenchObject& object = objects[draws[i].object];
+				bool bNewPass = i == 0 || (draws[i].key >> 60) != (draws[i - 1].key >> 60);
+				const BenchObject* pLast = bNewPass ? nullptr : &objects[draws[i - 1].object];
+				if (!pLast || pLast->page != object.page)
+					binds++;
+				if (!pLast || pLast->model != object.model)
+					modelChanges++;
+			}
+			return std::make_pair(binds, modelChanges);
+		};
+
+		// In object order the passes are interleaved, group them without sorting first
+		std::vector<MyRenderQueue::Draw> objectOrder;
+		for (MyRenderQueue::Pass pass : PASSES)
+		{
+			for (const auto& draw : unsorted)
+			{
+				if ((draw.key >> 60) == pass)
+					objectOrder.push_back(draw);
+			}
+		}
+
+		std::vector<MyRenderQueue::Draw> radixSorted;
+		std::vector<MyRenderQueue::Draw> scratch(unsorted.size());
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < RUNS; run++)
+		{
+			radixSorted = unsorted;
+			MyRenderQueue::sortDraws(radixSorted.data(), scratch.data(), static_cast<uint32_t>(radixSorted.size()));
+		}
+		double radixTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / RUNS;
+
+		std::vector<MyRenderQueue::Draw> stdSorted;
+		start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < RUNS; run++)
+		{
+			stdSorted = unsorted;
+			std::stable_sort(stdSorted.begin(), stdSorted.end(),
+				[](const MyRenderQueue::Draw& a, const MyRenderQueue::Draw& b) { return a.key < b.key; });
+		}
+		double stdTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / RUNS;
+
+		bool bSame = std::equal(radixSorted.begin(), radixSorted.end(), stdSorted.begin(),
+			[](const MyRenderQueue::Draw& a, const MyRenderQueue::Draw& b) { return a.key == b.key && a.object == b.object; });
+
+		auto before = stateChanges(objectOrder);
+		auto after = stateChanges(radixSorted);
+		std::cout << OBJECT_COUNT << " objects, " << unsorted.size() << " draws in " << std::size(PASSES) << " passes" << std::endl
+		          << "  radix sort:       " << radixTime << " ms" << std::endl
+		          << "  std::stable_sort: " << stdTime << " ms (" << (bSame ? "same order" : "DIFFERENT ORDER") << ")" << std::endl
+		          << "  object order: " << before.first << " buffer binds, " << before.second << " model changes" << std::endl
+		          << "  key order:    " << after.first << " buffer binds, " << after.second << " model changes" << std::endl;
+	}
+
+	void benchmarkFrustumCulling()
+	{
+		// Object frustum culling of 100k objects of various sizes and rotations
+		// scattered around the camera: a bounding sphere test per object
+		// (MyMeshletCuller::isVisible) against MyBoundsCuller, which transforms
+		// the boxes and spheres and tests 4 objects at a time. CPU only.
+		const uint32_t OBJECT_COUNT = 100000;
+		const int RUNS = 20;
+
+		std::mt19937 random{ 9 };
+		std::uniform_real_distribution<float> position{ -200.0f, 200.0f };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+		// Long thin boxes too, where a sphere is loose
+		std::vector<glm::mat4> matrices(OBJECT_COUNT);
+		std::vector<glm::vec3> extents(OBJECT_COUNT);
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+		{
+			TransformComponent transform{};
+			transform.translation = { position(random), position(random) * 0.1f, position(random) };
+			transform.rotation.y = unit(random) * glm::two_pi<float>();
+			transform.scale = glm::vec3{ 0.5f + unit(random) * 2.0f };
+			matrices[i] = transform.mat4();
+			extents[i] = { 0.2f + unit(random) * 3.0f, 0.2f + unit(random), 0.2f + unit(random) * 0.3f };
+		}
+
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+		camera.setViewTarget(glm::vec3{ 0.0f, -5.0f, 0.0f }, glm::vec3{ 40.0f, 0.0f, 60.0f });
+
+		MyMeshletCuller culler;
+		culler.setView(camera.projectionMatrix() * camera.viewMatrix(), glm::vec3{ camera.inverseViewMatrix()[3] });
+
+		uint32_t sphereVisible = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < RUNS; run++)
+		{
+			sphereVisible = 0;
+			for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+			{
+				const glm::mat4& modelMatrix = matrices[i];
+				float scale = std::max({
+					glm::length(glm::vec3{ modelMatrix[0] }),
+					glm::length(glm::vec3{ modelMatrix[1] }),
+					glm::length(glm::vec3{ modelMatrix[2] }) });
+				glm::vec3 center{ modelMatrix[3] };
+				if (culler.isVisible(center, glm::length(extents[i]) * scale))
+					sphereVisible++;
+			}
+		}
+		double sphereTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / RUNS;
+
+		MyBoundsCuller bounds;
+		bounds.reserve(OBJECT_COUNT);
+		std::vector<uint32_t> masks(OBJECT_COUNT);
+		uint32_t batchCulled = 0;
+		double addTime = 0.0;
+		double cullTime = 0.0;
+		for (int run = 0; run < RUNS; run++)
+		{
+			start = std::chrono::high_resolution_clock::now();
+			bounds.clear();
+			for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+				bounds.add(matrices[i], glm::vec3{ 0.0f }, extents[i], glm::length(extents[i]));
+			auto added = std::chrono::high_resolution_clock::now();
+
+			std::fill(masks.begin(), masks.end(), 1u);
+			batchCulled = bounds.cull(culler.planes(), 0u, masks.data());
+			auto culled = std::chrono::high_resolution_clock::now();
+
+			addTime += std::chrono::duration<double, std::milli>(added - start).count() / RUNS;
+			cullTime += std::chrono::duration<double, std::milli>(culled - added).count() / RUNS;
+		}
+
+		std::cout << OBJECT_COUNT << " objects" << std::endl
+		          << "  sphere per object: " << sphereVisible << " visible, " << sphereTime << " ms" << std::endl
+		          << "  MyBoundsCuller:    " << OBJECT_COUNT - batchCulled << " visible, transform " << addTime
+		          << " ms, test " << cullTime << " ms" << std::endl;
+	}
+
+	void benchmarkInstancing()
+	{
+		// A forest of 10k smooth vases drawn by MySimpleRenderFactory, one draw call
+		// per object (instancing off) and one per batch of MyRenderQueue. CPU time of
+		// the queue build (which writes the instances) and of recording the main pass,
+		// and the draw calls. The frames are submitted and presented as in the
+		// application. Needs a GPU.
+		const uint32_t OBJECT_COUNT = 10000;
+		const uint32_t FRAMES_IN_FLIGHT = static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT);
+		const int WARMUP_FRAMES = 5;
+		const int FRAMES = 30;
+
+		MyWindow window{ 320, 240, "Instancing" };
+		MyDevice device{ window };
+		MyRenderer renderer{ window, device };
+		MyFrameAllocator frameAllocator{ device, FRAMES_IN_FLIGHT };
+		MyDescriptorAllocator descriptors{ device, FRAMES_IN_FLIGHT };
+		auto setLayout = MyDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+		MySimpleRenderFactory factory{ device, renderer.swapChainRenderPass(), setLayout->descriptorSetLayout() };
+		VkDescriptorBufferInfo uboBufferInfo = frameAllocator.descriptorInfo(sizeof(MyGlobalUBO));
+		VkDescriptorBufferInfo instanceBufferInfo = frameAllocator.descriptorInfo(VK_WHOLE_SIZE);
+
+		MyResourcePool<MyModel> models{ FRAMES_IN_FLIGHT };
+		MyModelHandle vase = models.create(std::move(*MyModel::createModelFromFile(device, "./models/smooth_vase.obj", 0, true, true)));
+
+		// A square grid of vases in front of the camera, some rotated so that not every
+		// normal matrix is the same
+		const uint32_t GRID_SIZE = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(OBJECT_COUNT))));
+		std::vector<MyGameObject> objects;
+		std::vector<MyGameObject*> objectList;
+		objects.reserve(OBJECT_COUNT);
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+		{
+			auto object = MyGameObject::createGameObject(MyGameObject::SIMPLE);
+			object.model = vase;
+			object.transform.translation = { (i % GRID_SIZE) * 1.0f - GRID_SIZE * 0.5f, 0.0f, (i / GRID_SIZE) * 1.0f + 2.0f };
+			object.transform.rotation.y = (i % 7) * 0.9f;
+			objects.push_back(std::move(object));
+			objectList.push_back(&objects.back());
+		}
+
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(45.0f), renderer.aspectRatio(), 0.1f, 500.0f);
+		camera.setViewTarget(glm::vec3{ 0.0f, -20.0f, -10.0f }, glm::vec3{ 0.0f, 0.0f, 50.0f });
+
+		MyGlobalUBO ubo{};
+		ubo.projection = camera.projectionMatrix();
+		ubo.view = camera.viewMatrix();
+		ubo.inverseView = camera.inverseViewMatrix();
+
+		MyRenderQueue renderQueue;
+
+		struct Result
+		{
+			double   buildTime;
+			double   recordTime;
+			uint32_t drawCalls;
+			uint32_t triangles;
+		};
+
+		auto run = [&](bool bInstancing)
+		{
+			Result result{};
+			renderQueue.setInstancing(bInstancing);
+			for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++)
+			{
+				window.pollEvents();
+
+				VkCommandBuffer commandBuffer = renderer.beginFrame();
+				if (!commandBuffer)
+				{
+					frame--; // the swap chain was recreated
+					continue;
+				}
+
+				int frameIndex = renderer.frameIndex();
+				frameAllocator.beginFrame(frameIndex);
+				descriptors.beginFrame(frameIndex);
+
+				VkDescriptorSet descriptorSet = MyDescriptorWriter(*setLayout, descriptors)
+					.writeBuffer(0, &uboBufferInfo)
+					.writeBuffer(3, &instanceBufferInfo)
+					.buildCached();
+
+				MyFrameInfo frameInfo
+				{
+					frameIndex,
+					0.0f,
+					commandBuffer,
+					camera,
+					descriptorSet,
+					descriptorSet,
+					renderQueue,
+					models
+				};
+				frameInfo.viewportHeight = 240.0f;
+				frameInfo.lodPixelError = 1.0f;
+				frameInfo.pFrameAllocator = &frameAllocator;
+				frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				renderQueue.build(frameInfo, objectList.data(), OBJECT_COUNT,
+					MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE), glm::vec3{ 0.0f });
+				auto built = std::chrono::high_resolution_clock::now();
+
+				renderer.beginSwapChainRenderPass(commandBuffer);
+				factory.render(frameInfo);
+				renderer.endSwapChainRenderPass(commandBuffer);
+				auto recorded = std::chrono::high_resolution_clock::now();
+
+				if (frame >= WARMUP_FRAMES)
+				{
+					result.buildTime += std::chrono::duration<double, std::milli>(built - start).count() / FRAMES;
+					result.recordTime += std::chrono::duration<double, std::milli>(recorded - built).count() / FRAMES;
+				}
+				result.drawCalls = renderQueue.stats().batchCount;
+				result.triangles = frameInfo.triangleCount;
+
+				renderer.endFrame();
+			}
+			vkDeviceWaitIdle(device.device());
+			return result;
+		};
+
+		Result before = run(false);
+		Result after = run(true);
+		std::cout << OBJECT_COUNT << " smooth vases, " << renderQueue.stats().drawCount << " in view" << std::endl
+		          << "  one draw per object: " << before.drawCalls << " draw calls, build " << before.buildTime
+		          << " ms, record " << before.recordTime << " ms, " << before.triangles << " triangles" << std::endl
+		          << "  instanced:           " << after.drawCalls << " draw calls, build " << after.buildTime
+		          << " ms, record " << after.recordTime << " ms, " << after.triangles << " triangles" << std::endl;
+	}
+
+	void benchmarkGpuCulling()
+	{
+		// 100k smooth vases drawn by MySimpleRenderFactory, culled on the CPU (the
+		// render queue tests every object, a draw call per batch) and on the GPU
+		// (MyGpuCuller, an indirect draw per group). CPU time of the frame's queue
+		// build, culling setup and recording of the main pass. The frames are submitted
+		// and presented as in the application. Needs a GPU with VK_KHR_draw_indirect_count.
+		const uint32_t OBJECT_COUNT = 100000;
+		const uint32_t FRAMES_IN_FLIGHT = static_cast<uint32_t>(MySwapChain::MAX_FRAMES_IN_FLIGHT);
+		const int WARMUP_FRAMES = 5;
+		const int FRAMES = 30;
+
+		MyWindow window{ 320, 240, "GPU culling" };
+		MyDevice device{ window };
+		if (!device.drawIndirectCount())
+		{
+			std::cout << "VK_KHR_draw_indirect_count is not supported, nothing to compare" << std::endl;
+			return;
+		}
+
+		MyRenderer renderer{ window, device };
+		MyFrameAllocator frameAllocator{ device, FRAMES_IN_FLIGHT, 32 * 1024 * 1024 }; // instances, records and commands of 100k draws
+		MyDescriptorAllocator descriptors{ device, FRAMES_IN_FLIGHT };
+		MyGpuCuller gpuCuller{ device, FRAMES_IN_FLIGHT };
+		auto setLayout = MyDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+		MySimpleRenderFactory factory{ device, renderer.swapChainRenderPass(), setLayout->descriptorSetLayout() };
+		VkDescriptorBufferInfo uboBufferInfo = frameAllocator.descriptorInfo(sizeof(MyGlobalUBO));
+		VkDescriptorBufferInfo instanceBufferInfo = frameAllocator.descriptorInfo(VK_WHOLE_SIZE);
+
+		MyResourcePool<MyModel> models{ FRAMES_IN_FLIGHT };
+		MyModelHandle vase = models.create(std::move(*MyModel::createModelFromFile(device, "./models/smooth_vase.obj", 0, true, true)));
+
+		// A square grid of vases, the camera sees part of it
+		const uint32_t GRID_SIZE = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(OBJECT_COUNT))));
+		std::vector<MyGameObject> objects;
+		std::vector<MyGameObject*> objectList;
+		objects.reserve(OBJECT_COUNT);
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+		{
+			auto object = MyGameObject::createGameObject(MyGameObject::SIMPLE);
+			object.model = vase;
+			object.transform.translation = { (i % GRID_SIZE) * 1.0f - GRID_SIZE * 0.5f, 0.0f, (i / GRID_SIZE) * 1.0f + 2.0f };
+			object.transform.rotation.y = (i % 7) * 0.9f;
+			objects.push_back(std::move(object));
+			objectList.push_back(&objects.back());
+		}
+
+		MyCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(45.0f), renderer.aspectRatio(), 0.1f, 500.0f);
+		camera.setViewTarget(glm::vec3{ 0.0f, -20.0f, -10.0f }, glm::vec3{ 0.0f, 0.0f, 50.0f });
+
+		MyGlobalUBO ubo{};
+		ubo.projection = camera.projectionMatrix();
+		ubo.view = camera.viewMatrix();
+		ubo.inverseView = camera.inverseViewMatrix();
+
+		MyMeshletCuller viewCuller;
+		viewCuller.setView(camera.projectionMatrix() * camera.viewMatrix(), glm::vec3{ camera.inverseViewMatrix()[3] });
+		viewCuller.setBackfaceCulling(false);
+
+		MyRenderQueue renderQueue;
+
+		struct Result
+		{
+			double   buildTime;   // including MyGpuCuller::cull
+			double   recordTime;
+			uint32_t drawCalls;
+			uint32_t visible;
+		};
+
+		auto run = [&](bool bGpuCulling)
+		{
+			Result result{};
+			for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++)
+			{
+				window.pollEvents();
+
+				VkCommandBuffer commandBuffer = renderer.beginFrame();
+				if (!commandBuffer)
+				{
+					frame--; // the swap chain was recreated
+					continue;
+				}
+
+				int frameIndex = renderer.frameIndex();
+				frameAllocator.beginFrame(frameIndex);
+				gpuCuller.beginFrame(frameIndex);
+				descriptors.beginFrame(frameIndex);
+
+				VkDescriptorSet descriptorSet = MyDescriptorWriter(*setLayout, descriptors)
+					.writeBuffer(0, &uboBufferInfo)
+					.writeBuffer(3, &instanceBufferInfo)
+					.buildCached();
+
+				MyFrameInfo frameInfo
+				{
+					frameIndex,
+					0.0f,
+					commandBuffer,
+					camera,
+					descriptorSet,
+					descriptorSet,
+					renderQueue,
+					models
+				};
+				frameInfo.viewportHeight = 240.0f;
+				frameInfo.lodPixelError = 1.0f;
+				frameInfo.pFrameAllocator = &frameAllocator;
+				frameInfo.pViewCuller = bGpuCulling ? nullptr : &viewCuller;
+				frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				renderQueue.build(frameInfo, objectList.data(), OBJECT_COUNT,
+					MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE), glm::vec3{ 0.0f });
+				if (bGpuCulling)
+				{
+					gpuCuller.cull(frameInfo, MyRenderQueue::passBit(MyRenderQueue::PASS_SIMPLE), descriptors, viewCuller, viewCuller);
+					frameInfo.pGpuCuller = &gpuCuller;
+				}
+				auto built = std::chrono::high_resolution_clock::now();
+
+				renderer.beginSwapChainRenderPass(commandBuffer);
+				factory.render(frameInfo);
+				renderer.endSwapChainRenderPass(commandBuffer);
+				auto recorded = std::chrono::high_resolution_clock::now();
+
+				if (frame >= WARMUP_FRAMES)
+				{
+					result.buildTime += std::chrono::duration<double, std::milli>(built - start).count() / FRAMES;
+					result.recordTime += std::chrono::duration<double, std::milli>(recorded - built).count() / FRAMES;
+				}
+				result.drawCalls = bGpuCulling ? gpuCuller.stats().groupCount : renderQueue.stats().batchCount;
+				result.visible = bGpuCulling ? gpuCuller.stats().visibleCount : renderQueue.stats().drawCount;
+
+				renderer.endFrame();
+			}
+			vkDeviceWaitIdle(device.device());
+			return result;
+		};
+
+		Result cpu = run(false);
+		Result gpu = run(true);
+		std::cout << OBJECT_COUNT << " smooth vases" << std::endl
+		          << "  CPU culling: " << cpu.visible << " visible, " << cpu.drawCalls << " draw calls, build "
+		          << cpu.buildTime << " ms, record " << cpu.recordTime << " ms, frame " << cpu.buildTime + cpu.recordTime << " ms" << std::endl
+		          << "  GPU culling: " << gpu.visible << " visible, " << gpu.drawCalls << " indirect draw(s), build + cull "
+		          << gpu.buildTime << " ms, record " << gpu.recordTime << " ms, frame " << gpu.buildTime + gpu.recordTime << " ms" << std::endl;
+	}
+}
+
+bool myRunBenchmark(const std::string& option)
+{
+	if (option == "--bench-mesh-cache")
+		benchmarkMeshCache();
+	else if (option == "--bench-obj-parser")
+		benchmarkObjParser();
+	else if (option == "--bench-vertex-welder")
+		benchmarkVertexWelder();
+	else if (option == "--bench-mesh-optimizer")
+		benchmarkMeshOptimizer();
+	else if (option == "--bench-vertex-format")
+		benchmarkVertexFormat();
+	else if (option == "--bench-lod")
+		benchmarkLod();
+	else if (option == "--bench-meshlets")
+		benchmarkMeshlets();
+	else if (option == "--bench-geometry-arena")
+		benchmarkGeometryArena();
+	else if (option == "--bench-memory-allocator")
+		benchmarkMemoryAllocator();
+	else if (option == "--bench-frame-allocator")
+		benchmarkFrameAllocator();
+	else if (option == "--bench-uploads")
+		benchmarkUploads();
+	else if (option == "--bench-defragmentation")
+		benchmarkDefragmentation();
+	else if (option == "--bench-attachments")
+		benchmarkAttachments();
+	else if (option == "--bench-unified-memory")
+		benchmarkUnifiedMemory();
+	else if (option == "--bench-resource-handles")
+		benchmarkResourceHandles();
+	else if (option == "--bench-frame-arena")
+		benchmarkFrameArena();
+	else if (option == "--bench-parallel-recording")
+		benchmarkParallelRecording();
+	else if (option == "--bench-render-queue")
+		benchmarkRenderQueue();
+	else if (option == "--bench-frustum-culling")
+		benchmarkFrustumCulling();
+	else if (option == "--bench-instancing")
+		benchmarkInstancing();
+	else if (option == "--bench-gpu-culling")
+		benchmarkGpuCulling();
+	else
+		return false;
+
+	return true;
+}
+
@@ -0,0 +1,16 @@
+#ifndef __MY_BENCHMARK_H__
+#define __MY_BENCHMARK_H__
+
+// Std
+#include <string>
+
+// Command line benchmarks, e.g. "./Vulkan36 --bench-mesh-cache".
+// They only exercise CPU side code and don't open a window, except
+// --bench-uploads, --bench-frame-allocator, --bench-defragmentation,
+// --bench-attachments, --bench-unified-memory, --bench-parallel-recording,
+// --bench-instancing and --bench-gpu-culling which need a device.
+// Returns false if option is not a known benchmark
+bool myRunBenchmark(const std::string& option);
+
+#endif
+
@@ -0,0 +1,138 @@
+#include "my_bounds_culler.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MY_BOUNDS_CULLER_SSE 1
+#include <emmintrin.h>
+#endif
+
+void MyBoundsCuller::clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_radius.clear();
+}
+
+void MyBoundsCuller::reserve(uint32_t count)
+{
+	m_centerX.reserve(count);
+	m_centerY.reserve(count);
+	m_centerZ.reserve(count);
+	m_extentX.reserve(count);
+	m_extentY.reserve(count);
+	m_extentZ.reserve(count);
+	m_radius.reserve(count);
+}
+
+uint32_t MyBoundsCuller::add(const glm::mat4& modelMatrix, const glm::vec3& center, const glm::vec3& extent, float radius)
+{
+	glm::vec3 axes[3] = { glm::vec3{ modelMatrix[0] }, glm::vec3{ modelMatrix[1] }, glm::vec3{ modelMatrix[2] } };
+
+	// Arvo, "Transforming Axis-Aligned Bounding Boxes": each world axis of the box
+	// collects the absolute model axes scaled by the model space extent
+	glm::vec3 worldCenter{ modelMatrix * glm::vec4{ center, 1.0f } };
+	glm::vec3 worldExtent = glm::abs(axes[0]) * extent.x + glm::abs(axes[1]) * extent.y + glm::abs(axes[2]) * extent.z;
+
+	// The largest axis scale bounds the sphere
+	float scale = std::max({ glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) });
+
+	m_centerX.push_back(worldCenter.x);
+	m_centerY.push_back(worldCenter.y);
+	m_centerZ.push_back(worldCenter.z);
+	m_extentX.push_back(worldExtent.x);
+	m_extentY.push_back(worldExtent.y);
+	m_extentZ.push_back(worldExtent.z);
+	m_radius.push_back(radius * scale);
+	return size() - 1;
+}
+
+uint32_t MyBoundsCuller::cull(const glm::vec4* pPlanes, uint32_t keepMask, uint32_t* pMasks) const
+{
+	const uint32_t count = size();
+	uint32_t culled = 0;
+	uint32_t i = 0;
+
+#if MY_BOUNDS_CULLER_SSE
+	// Every plane component in all 4 lanes
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		normalX[p] = _mm_set1_ps(pPlanes[p].x);
+		normalY[p] = _mm_set1_ps(pPlanes[p].y);
+		normalZ[p] = _mm_set1_ps(pPlanes[p].z);
+		distance[p] = _mm_set1_ps(pPlanes[p].w);
+		absX[p] = _mm_set1_ps(std::fabs(pPlanes[p].x));
+		absY[p] = _mm_set1_ps(std::fabs(pPlanes[p].y));
+		absZ[p] = _mm_set1_ps(std::fabs(pPlanes[p].z));
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&m_centerX[i]);
+		__m128 y = _mm_loadu_ps(&m_centerY[i]);
+		__m128 z = _mm_loadu_ps(&m_centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&m_extentX[i]);
+		__m128 ey = _mm_loadu_ps(&m_extentY[i]);
+		__m128 ez = _mm_loadu_ps(&m_extentZ[i]);
+		__m128 radius = _mm_loadu_ps(&m_radius[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(normalX[p], x), _mm_mul_ps(normalY[p], y)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], z), distance[p]));
+
+			// How far the box reaches along the normal
+			__m128 boxRadius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+				_mm_mul_ps(absZ[p], ez));
+
+			// d < -r  <=>  d + r < 0
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, _mm_min_ps(radius, boxRadius)), _mm_setzero_ps()));
+		}
+
+		int outsideBits = _mm_movemask_ps(outside);
+		if (outsideBits == 0)
+			continue;
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if ((outsideBits & (1 << lane)) && (pMasks[i + lane] & ~keepMask) != 0)
+			{
+				pMasks[i + lane] &= keepMask;
+				culled++;
+			}
+		}
+	}
+#endif
+
+	// The rest, or all of them without SSE
+	for (; i < count; i++)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = pPlanes[p];
+			float d = plane.x * m_centerX[i] + plane.y * m_centerY[i] + plane.z * m_centerZ[i] + plane.w;
+			float boxRadius = std::fabs(plane.x) * m_extentX[i] + std::fabs(plane.y) * m_extentY[i] + std::fabs(plane.z) * m_extentZ[i];
+			if (d + std::min(m_radius[i], boxRadius) < 0.0f)
+			{
+				if ((pMasks[i] & ~keepMask) != 0)
+				{
+					pMasks[i] &= keepMask;
+					culled++;
+				}
+				break;
+			}
+		}
+	}
+
+	return culled;
+}
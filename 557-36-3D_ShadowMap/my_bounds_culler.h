@@ -0,0 +1,48 @@
+#ifndef __MY_BOUNDS_CULLER_H__
+#define __MY_BOUNDS_CULLER_H__
+
+// libs
+#include <glm/glm.hpp>
+
+// Std
+#include <cstdint>
+#include <vector>
+
+//
+// Frustum culling of many objects at once (MyRenderQueue). add() transforms an
+// object's model space bounding box and sphere to world space; the bounds are
+// kept as separate arrays per component, so cull() tests 4 objects per SSE
+// instruction against each plane (scalar where SSE2 is not available). An
+// object is outside when a plane has the box or the sphere, whichever reaches
+// less far towards it, completely behind it.
+//
+class MyBoundsCuller
+{
+public:
+	void     clear();
+	void     reserve(uint32_t count);
+	uint32_t size() const { return static_cast<uint32_t>(m_centerX.size()); }
+
+	// Bounds of an object with 'modelMatrix', see MyModel::boundingCenter/Extent/Radius.
+	// Returns its index
+	uint32_t add(const glm::mat4& modelMatrix, const glm::vec3& center, const glm::vec3& extent, float radius);
+
+	// World space center of object 'index'
+	glm::vec3 center(uint32_t index) const { return { m_centerX[index], m_centerY[index], m_centerZ[index] }; }
+
+	// For every object outside the frustum of 'pPlanes' (6, see MyCamera::extractFrustumPlanes)
+	// pMasks[i] &= keepMask. Returns the objects outside that had a bit besides keepMask,
+	// i.e. whose mask changed
+	uint32_t cull(const glm::vec4* pPlanes, uint32_t keepMask, uint32_t* pMasks) const;
+
+private:
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;   // world space box, half its size per axis
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	std::vector<float> m_radius;
+};
+
+#endif
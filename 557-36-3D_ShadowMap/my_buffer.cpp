@@ -45,43 +45,50 @@ MyBuffer::MyBuffer(
     // Get the smallest size required for alignment/padding
     m_vkAlignmentSize = alignmentSize(instanceSize, minOffsetAlignment);
     m_vkBufferSize = m_vkAlignmentSize * instanceCount;
-    m_myDevice.createBuffer(m_vkBufferSize, usageFlags, memoryPropertyFlags, m_vkBuffer, m_vkMemory);
+    m_myDevice.createBuffer(m_vkBufferSize, usageFlags, memoryPropertyFlags, m_vkBuffer, m_memory);
 }
 
 MyBuffer::~MyBuffer()
 {
     unmap();
     vkDestroyBuffer(m_myDevice.device(), m_vkBuffer, nullptr);
-    vkFreeMemory(m_myDevice.device(), m_vkMemory, nullptr);
+    m_myDevice.freeMemory(m_memory);
 }
 
 //
-// Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+// Hand out a pointer into this buffer. If successful, mapped points 'offset' bytes into the buffer.
 //
-// @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
-// buffer range.
+// @note Host visible memory stays mapped by the allocator, the whole allocation remains mapped
+// and only 'offset' is applied
+//
+// @param size (Optional) Size of the range the caller will access, only checked against the
+// allocation. Pass VK_WHOLE_SIZE for the rest of the buffer.
 // @param offset (Optional) Byte offset from beginning
 //
 // @return VkResult of the buffer mapping call
 //
 VkResult MyBuffer::map(VkDeviceSize size, VkDeviceSize offset)
 {
-    assert(m_vkBuffer && m_vkMemory && "Called map on buffer before create");
-    return vkMapMemory(m_myDevice.device(), m_vkMemory, offset, size, 0, &m_pMappedMemeoy);
+    assert(m_vkBuffer && m_memory.memory && "Called map on buffer before create");
+    if (!m_memory.pMapped)
+    {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    assert(offset <= m_memory.size && (size == VK_WHOLE_SIZE || size <= m_memory.size - offset) &&
+        "Mapped range exceeds the allocation");
+
+    m_pMappedMemeoy = static_cast<char*>(m_memory.pMapped) + offset;
+    return VK_SUCCESS;
 }
 
 //
 // Unmap a mapped memory range
 //
-// @note Does not return a result as vkUnmapMemory can't fail
+// @note The memory itself stays mapped until it is freed
 //
 void MyBuffer::unmap() 
 {
-    if (m_pMappedMemeoy)
-    {
-        vkUnmapMemory(m_myDevice.device(), m_vkMemory);
-        m_pMappedMemeoy = nullptr;
-    }
+    m_pMappedMemeoy = nullptr;
 }
 
 //
@@ -141,9 +148,9 @@ VkResult MyBuffer::flush(VkDeviceSize size, VkDeviceSize offset)
 {
     VkMappedMemoryRange mappedRange = {};
     mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = m_vkMemory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
+    mappedRange.memory = m_memory.memory;
+    mappedRange.offset = m_memory.offset + offset;
+    mappedRange.size = size == VK_WHOLE_SIZE ? m_memory.size : size; // the memory is shared with other resources
     return vkFlushMappedMemoryRanges(m_myDevice.device(), 1, &mappedRange);
 }
 
@@ -33,6 +33,9 @@ public:
     VkResult               flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkBuffer               buffer() const { return m_vkBuffer; }
+    void*                  mappedMemory() const { return m_pMappedMemeoy; } // null unless mapped
+    VkDeviceSize           bufferSize() const { return m_vkBufferSize; }
+    const MyMemoryAllocator::Allocation& memory() const { return m_memory; }
 
 private:
     // Need to follow certain memory padding guideline 
@@ -41,11 +44,11 @@ private:
     MyDevice&              m_myDevice;
     void*                  m_pMappedMemeoy = nullptr;
     VkBuffer               m_vkBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory         m_vkMemory = VK_NULL_HANDLE;
+    MyMemoryAllocator::Allocation m_memory;
 
     VkDeviceSize           m_vkBufferSize;
-    uint32_t               m_iInstanceCount;
     VkDeviceSize           m_vkInstanceSize;
+    uint32_t               m_iInstanceCount;
     VkDeviceSize           m_vkAlignmentSize;
     VkBufferUsageFlags     m_vkUsageFlags;
     VkMemoryPropertyFlags  m_vkMemoryPropertyFlags;
@@ -161,3 +161,46 @@ void MyCamera::setViewYXZ(glm::vec3 position, glm::vec3 rotation)
     m_m4InverseViewMatrix[3][2] = position.z;
 }
 
+
+float MyCamera::pixelsPerUnit(const glm::vec3& center, float radius, float viewportHeight) const
+{
+    // [1][1] is the NDC height of one unit at distance 1 (perspective) or anywhere (orthographic),
+    // NDC spans 2 units across the viewport
+    float scale = glm::abs(m_m4ProjectionMatrix[1][1]) * 0.5f * viewportHeight;
+
+    // Orthographic projection has no perspective divide
+    if (m_m4ProjectionMatrix[2][3] == 0.0f)
+        return scale;
+
+    glm::vec3 position{ m_m4InverseViewMatrix[3] };
+    float distance = glm::length(center - position) - radius;
+
+    // Inside the sphere every detail can be right in front of the camera
+    if (distance <= std::numeric_limits<float>::epsilon())
+        return std::numeric_limits<float>::max();
+
+    return scale / distance;
+}
+
+void MyCamera::extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // Gribb, Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+    // World-View-Projection Matrix": planes are sums of the matrix rows
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4{ viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r] };
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // top (Y is down)
+    planes[3] = rows[3] - rows[1]; // bottom
+    planes[4] = rows[3] + rows[2]; // near, for -1..1 depth; looser than needed for 0..1
+    planes[5] = rows[3] - rows[2]; // far
+
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3{ planes[i] });
+        if (length > 0.0f)
+            planes[i] = planes[i] / length;
+    }
+}
@@ -18,6 +18,17 @@ public:
     void setViewTarget(glm::vec3 position, glm::vec3 target, glm::vec3 up = glm::vec3{ 0.0f, 1.0f, 0.0f });
     void setViewYXZ(glm::vec3 position, glm::vec3 rotation);
 
+    // Pixels covered by one world space unit at the near side of a sphere,
+    // for a viewport 'viewportHeight' pixels high
+    float pixelsPerUnit(const glm::vec3& center, float radius, float viewportHeight) const;
+
+    // World space frustum planes (xyz inward normal, w distance) of projection * view:
+    // left, right, top, bottom, near, far
+    void frustumPlanes(glm::vec4 planes[6]) const { extractFrustumPlanes(m_m4ProjectionMatrix * m_m4ViewMatrix, planes); }
+
+    // The same for any view-projection, e.g. MyPointLight::lightMVP
+    static void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
     const glm::mat4& projectionMatrix()  const { return m_m4ProjectionMatrix; }
     const glm::mat4& viewMatrix()        const { return m_m4ViewMatrix; }
     const glm::mat4& inverseViewMatrix() const { return m_m4InverseViewMatrix; }
@@ -0,0 +1,50 @@
+#include "my_compute_pipeline.h"
+#include "my_pipeline.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+MyComputePipeline::MyComputePipeline(MyDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout,
+	const VkSpecializationInfo* pSpecializationInfo)
+	: m_myDevice{ device }
+{
+	assert(pipelineLayout != VK_NULL_HANDLE && "Pipeline cannot be created with null pipeline layout");
+
+	auto compCode = MyPipeline::readFile(compFilepath);
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = compCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+	if (vkCreateShaderModule(m_myDevice.device(), &moduleInfo, nullptr, &m_vkCompShaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Shader Module");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = m_vkCompShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = pSpecializationInfo;
+	pipelineInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(m_myDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_vkComputePipeline) != VK_SUCCESS)
+	{
+		vkDestroyShaderModule(m_myDevice.device(), m_vkCompShaderModule, nullptr);
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+}
+
+MyComputePipeline::~MyComputePipeline()
+{
+	vkDestroyShaderModule(m_myDevice.device(), m_vkCompShaderModule, nullptr);
+	vkDestroyPipeline(m_myDevice.device(), m_vkComputePipeline, nullptr);
+}
+
+void MyComputePipeline::bind(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_vkComputePipeline);
+}
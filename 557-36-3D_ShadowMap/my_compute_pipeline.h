@@ -0,0 +1,31 @@
+#ifndef __MY_COMPUTE_PIPELINE_H__
+#define __MY_COMPUTE_PIPELINE_H__
+
+#include "my_device.h"
+
+// Std
+#include <string>
+
+//
+// A compute shader and its pipeline, the counterpart of MyPipeline for
+// dispatches. The caller owns the pipeline layout, as with PipelineConfigInfo.
+//
+class MyComputePipeline
+{
+public:
+	MyComputePipeline(MyDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout,
+		const VkSpecializationInfo* pSpecializationInfo = nullptr);
+	~MyComputePipeline();
+
+	MyComputePipeline(const MyComputePipeline&) = delete;
+	MyComputePipeline& operator=(const MyComputePipeline&) = delete;
+
+	void bind(VkCommandBuffer commandBuffer);
+
+private:
+	MyDevice&      m_myDevice;
+	VkPipeline     m_vkComputePipeline = VK_NULL_HANDLE;
+	VkShaderModule m_vkCompShaderModule = VK_NULL_HANDLE;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "my_defragmenter.h"
+#include "my_model.h"
+
+// Std
+#include <algorithm>
+
+MyDefragmenter::MyDefragmenter(MyDevice& device, uint32_t frameCount) :
+	m_myDevice{ device },
+	m_retiredImages(frameCount),
+	m_retiredBuffers(frameCount)
+{
+}
+
+MyDefragmenter::~MyDefragmenter()
+{
+	flush();
+	m_myDevice.memoryAllocator().setEvacuating(nullptr);
+}
+
+void MyDefragmenter::track(const std::shared_ptr<MyTexture>& pTexture)
+{
+	m_textures.push_back(pTexture);
+}
+
+void MyDefragmenter::beginFrame(uint32_t frameIndex)
+{
+	m_iFrameIndex = frameIndex;
+
+	for (auto& destroy : m_retiredImages[frameIndex])
+		destroy();
+	m_retiredImages[frameIndex].clear();
+	m_retiredBuffers[frameIndex].clear();
+}
+
+void MyDefragmenter::flush()
+{
+	for (uint32_t i = 0; i < m_retiredImages.size(); i++)
+		beginFrame(i);
+}
+
+const MyMemoryAllocator::Block* MyDefragmenter::_pickBlock()
+{
+	MyMemoryAllocator& allocator = m_myDevice.memoryAllocator();
+
+	// Blocks came or went, the pinned ones may be movable now
+	uint32_t blockCount = allocator.stats().blockCount;
+	if (blockCount != m_iPinnedBlockCount)
+	{
+		m_pinnedBlocks.clear();
+		m_iPinnedBlockCount = blockCount;
+	}
+
+	return allocator.sparsestBlock(MAX_BLOCK_USAGE, m_pinnedBlocks);
+}
+
+void MyDefragmenter::_finishBlock()
+{
+	// If the block is still there once its moves retire, something else lives in it
+	m_pinnedBlocks.push_back(m_pBlock);
+	m_myDevice.memoryAllocator().setEvacuating(nullptr);
+	m_pBlock = nullptr;
+	m_stats.evacuatedBlocks++;
+}
+
+bool MyDefragmenter::record(VkCommandBuffer commandBuffer)
+{
+	// The allocator freed the block once it was empty, a new block may have its address
+	if (m_pBlock != nullptr && m_myDevice.memoryAllocator().evacuatingBlock() != m_pBlock)
+	{
+		m_pBlock = nullptr;
+		m_stats.evacuatedBlocks++;
+	}
+
+	if (m_pBlock == nullptr)
+	{
+		m_pBlock = _pickBlock();
+		if (m_pBlock == nullptr)
+			return false;
+
+		m_myDevice.memoryAllocator().setEvacuating(m_pBlock);
+	}
+
+	m_textures.erase(
+		std::remove_if(m_textures.begin(), m_textures.end(), [](const auto& pTexture) { return pTexture.expired(); }),
+		m_textures.end());
+
+	VkDeviceSize moved = 0;
+	bool bTexturesMoved = false;
+	auto moveTexture = [&](MyTexture& texture)
+	{
+		if (moved >= FRAME_BUDGET || texture.memory().pBlock != m_pBlock)
+			return;
+
+		moved += texture.memory().size;
+		m_retiredImages[m_iFrameIndex].push_back(texture.relocate(commandBuffer));
+		m_stats.moveCount++;
+		bTexturesMoved = true;
+	};
+
+	for (const auto& pWeakTexture : m_textures)
+		moveTexture(*pWeakTexture.lock());
+
+	// Released pool textures are not live, their memory goes when the pool destroys them
+	if (m_pTexturePool)
+		m_pTexturePool->forEach([&](MyHandle<MyTexture>, MyTexture& texture) { moveTexture(texture); });
+
+	if (moved < FRAME_BUDGET)
+	{
+		if (auto pArena = MyModel::geometryArena())
+		{
+			size_t retiredCount = m_retiredBuffers[m_iFrameIndex].size();
+			moved += pArena->relocate(m_pBlock, commandBuffer, FRAME_BUDGET - moved, m_retiredBuffers[m_iFrameIndex]);
+			m_stats.moveCount += m_retiredBuffers[m_iFrameIndex].size() - retiredCount;
+		}
+	}
+
+	m_stats.movedBytes += moved;
+	if (moved == 0)
+		_finishBlock();
+
+	return bTexturesMoved;
+}
+
@@ -0,0 +1,87 @@
+#ifndef __MY_DEFRAGMENTER_H__
+#define __MY_DEFRAGMENTER_H__
+
+#include "my_device.h"
+#include "my_buffer.h"
+#include "my_resource_pool.h"
+#include "my_texture.h"
+
+// Std
+#include <functional>
+#include <memory>
+#include <vector>
+
+//
+// Compacts the device memory of long sessions that load and unload assets.
+// Freed resources leave holes in the MyMemoryAllocator blocks, which are only
+// released once completely empty. The defragmenter picks the sparsest block
+// (below MAX_BLOCK_USAGE) whose contents fit the other blocks of its pool, has
+// the allocator place nothing new there and moves the tracked textures and
+// the geometry arena pages out of it, FRAME_BUDGET bytes per frame. The copies
+// are recorded at the start of the frame's command buffer, before any render
+// pass; from then on the frame draws from the new resources while the frames
+// in flight still read the old ones, which are destroyed when the frame's
+// fence has signaled (beginFrame of the same frame index). The last move out
+// of a block frees it. Resources nobody tracks (e.g. render targets) pin a
+// block, it is skipped until the block count changes.
+// Only for the render thread.
+//
+class MyDefragmenter
+{
+public:
+	static constexpr float        MAX_BLOCK_USAGE = 0.5f;
+	static constexpr VkDeviceSize FRAME_BUDGET = 16 * 1024 * 1024;
+
+	struct Stats
+	{
+		uint64_t     moveCount = 0;
+		VkDeviceSize movedBytes = 0;
+		uint32_t     evacuatedBlocks = 0;   // blocks with nothing movable left
+	};
+
+	MyDefragmenter(MyDevice& device, uint32_t frameCount);
+	~MyDefragmenter();
+
+	MyDefragmenter(const MyDefragmenter&) = delete;
+	MyDefragmenter& operator=(const MyDefragmenter&) = delete;
+
+	// Textures are moved while they are alive, they must be in SHADER_READ_ONLY_OPTIMAL
+	void track(const std::shared_ptr<MyTexture>& pTexture);
+
+	// Every live texture of the pool, it must outlive the defragmenter
+	void track(MyResourcePool<MyTexture>& textures) { m_pTexturePool = &textures; }
+
+	// After the frame's fence has signaled, i.e. after MyRenderer::beginFrame
+	void beginFrame(uint32_t frameIndex);
+
+	// Records this frame's moves, outside a render pass. Uploads into the moved
+	// resources must not be pending, e.g. call it while no asset is loading.
+	// Returns true if textures moved, their descriptors have to be rewritten
+	bool record(VkCommandBuffer commandBuffer);
+
+	// Destroys everything retired, the GPU must be idle
+	void flush();
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+	const MyMemoryAllocator::Block* _pickBlock();
+	void                            _finishBlock();
+
+	MyDevice&                                     m_myDevice;
+	uint32_t                                      m_iFrameIndex = 0;
+	std::vector<std::weak_ptr<MyTexture>>         m_textures;
+	MyResourcePool<MyTexture>*                    m_pTexturePool = nullptr;
+
+	// Per frame in flight: what its command buffer moved away from
+	std::vector<std::vector<std::function<void()>>>          m_retiredImages;
+	std::vector<std::vector<std::unique_ptr<MyBuffer>>>      m_retiredBuffers;
+
+	const MyMemoryAllocator::Block*               m_pBlock = nullptr;   // being evacuated
+	std::vector<const MyMemoryAllocator::Block*>  m_pinnedBlocks;
+	uint32_t                                      m_iPinnedBlockCount = 0;  // block count when they were pinned
+	Stats                                         m_stats;
+};
+
+#endif
+
@@ -1,7 +1,10 @@
 #include "my_descriptors.h"
+#include "my_utils.h"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 
@@ -147,10 +150,262 @@ void MyDescriptorPool::resetPool()
     vkResetDescriptorPool(m_myDevice.device(), m_vkDescriptorPool, 0);
 }
 
+// *************** Descriptor Allocator *********************
+
+namespace
+{
+    // Descriptors per set in each new pool, enough for every layout of the application
+    const VkDescriptorPoolSize POOL_RATIOS[] =
+    {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+    };
+
+    // Handles are pointers or 64-bit integers depending on the platform
+    template<typename T>
+    uint64_t handleWord(T handle)
+    {
+        uint64_t word = 0;
+        memcpy(&word, &handle, sizeof(handle));
+        return word;
+    }
+}
+
+MyDescriptorAllocator::MyDescriptorAllocator(MyDevice& myDevice, uint32_t frameCount)
+    : m_myDevice{ myDevice }, m_transientPools(frameCount), m_retiredSets(frameCount)
+{
+    // Cached sets are freed one by one
+    m_persistentPools.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+}
+
+MyDescriptorAllocator::~MyDescriptorAllocator()
+{
+    for (VkDescriptorPool pool : m_persistentPools.pools)
+    {
+        vkDestroyDescriptorPool(m_myDevice.device(), pool, nullptr);
+    }
+
+    for (auto& list : m_transientPools)
+    {
+        for (VkDescriptorPool pool : list.pools)
+        {
+            vkDestroyDescriptorPool(m_myDevice.device(), pool, nullptr);
+        }
+    }
+}
+
+void MyDescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+    m_iFrameIndex = frameIndex;
+    m_iFrame++;
+
+    PoolList& transient = m_transientPools[frameIndex];
+    for (VkDescriptorPool pool : transient.pools)
+    {
+        vkResetDescriptorPool(m_myDevice.device(), pool, 0);
+    }
+    transient.current = 0;
+
+    for (const RetiredSet& retired : m_retiredSets[frameIndex])
+    {
+        vkFreeDescriptorSets(m_myDevice.device(), retired.pool, 1, &retired.set);
+    }
+    m_retiredSets[frameIndex].clear();
+
+    // Not bound by any frame in flight
+    uint64_t frameCount = m_transientPools.size();
+    for (auto it = m_cache.begin(); it != m_cache.end();)
+    {
+        if (it->second.lastUsedFrame + frameCount < m_iFrame)
+        {
+            vkFreeDescriptorSets(m_myDevice.device(), it->second.pool, 1, &it->second.set);
+            it = m_cache.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    m_stats.cachedSetCount = static_cast<uint32_t>(m_cache.size());
+}
+
+VkDescriptorSet MyDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    return _allocate(m_persistentPools, layout);
+}
+
+VkDescriptorSet MyDescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout)
+{
+    return _allocate(m_transientPools[m_iFrameIndex], layout);
+}
+
+VkDescriptorSet MyDescriptorAllocator::cached(VkDescriptorSetLayout layout, VkWriteDescriptorSet* pWrites, uint32_t writeCount)
+{
+    _buildKey(layout, pWrites, writeCount);
+
+    size_t hash = 0;
+    for (uint64_t word : m_key)
+    {
+        myHashCombine(hash, word);
+    }
+
+    auto it = m_cache.find(hash);
+    if (it != m_cache.end() && it->second.key == m_key)
+    {
+        it->second.lastUsedFrame = m_iFrame;
+        m_stats.cacheHits++;
+        return it->second.set;
+    }
+
+    m_stats.cacheMisses++;
+
+    // Another key with the same hash, its set may be in flight: a set for this frame only
+    VkDescriptorSet set;
+    if (it != m_cache.end())
+    {
+        set = allocateTransient(layout);
+    }
+    else
+    {
+        CachedSet entry{ m_key, VK_NULL_HANDLE, VK_NULL_HANDLE, m_iFrame };
+        entry.set = _allocate(m_persistentPools, layout, &entry.pool);
+        set = entry.set;
+        m_cache.emplace(hash, std::move(entry));
+        m_stats.cachedSetCount = static_cast<uint32_t>(m_cache.size());
+    }
+
+    for (uint32_t i = 0; i < writeCount; i++)
+    {
+        pWrites[i].dstSet = set;
+    }
+    vkUpdateDescriptorSets(m_myDevice.device(), writeCount, pWrites, 0, nullptr);
+
+    return set;
+}
+
+void MyDescriptorAllocator::clearCache()
+{
+    for (auto& kv : m_cache)
+    {
+        m_retiredSets[m_iFrameIndex].push_back({ kv.second.set, kv.second.pool });
+    }
+    m_cache.clear();
+    m_stats.cachedSetCount = 0;
+}
+
+VkDescriptorSet MyDescriptorAllocator::_allocate(PoolList& list, VkDescriptorSetLayout layout, VkDescriptorPool* pPool)
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pSetLayouts = &layout;
+    allocInfo.descriptorSetCount = 1;
+
+    auto tryPool = [&](uint32_t index, VkDescriptorSet& set)
+    {
+        allocInfo.descriptorPool = list.pools[index];
+        VkResult result = vkAllocateDescriptorSets(m_myDevice.device(), &allocInfo, &set);
+        if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+        {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+
+        if (result != VK_SUCCESS)
+            return false;
+
+        list.current = index;
+        if (pPool)
+            *pPool = allocInfo.descriptorPool;
+        m_stats.allocationCount++;
+        return true;
+    };
+
+    // The current pool, then the others (freed sets leave room in persistent ones)
+    VkDescriptorSet set;
+    uint32_t poolCount = static_cast<uint32_t>(list.pools.size());
+    for (uint32_t i = 0; i < poolCount; i++)
+    {
+        if (tryPool((list.current + i) % poolCount, set))
+            return set;
+    }
+
+    list.pools.push_back(_createPool(list.nextPoolSets, list.flags));
+    list.nextPoolSets = std::min(list.nextPoolSets * 2, MAX_POOL_SETS);
+    if (!tryPool(poolCount, set))
+    {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+    return set;
+}
+
+VkDescriptorPool MyDescriptorAllocator::_createPool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
+{
+    VkDescriptorPoolSize poolSizes[std::size(POOL_RATIOS)];
+    for (size_t i = 0; i < std::size(POOL_RATIOS); i++)
+    {
+        poolSizes[i] = { POOL_RATIOS[i].type, POOL_RATIOS[i].descriptorCount * maxSets };
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(std::size(poolSizes));
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+    descriptorPoolInfo.maxSets = maxSets;
+    descriptorPoolInfo.flags = flags;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(m_myDevice.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    if (flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+        m_stats.poolCount++;
+    else
+        m_stats.transientPoolCount++;
+    return pool;
+}
+
+void MyDescriptorAllocator::_buildKey(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* pWrites, uint32_t writeCount)
+{
+    m_key.clear();
+    m_key.push_back(handleWord(layout));
+
+    for (uint32_t i = 0; i < writeCount; i++)
+    {
+        const VkWriteDescriptorSet& write = pWrites[i];
+        m_key.push_back((uint64_t(write.dstBinding) << 32) | uint64_t(write.descriptorType));
+        m_key.push_back((uint64_t(write.dstArrayElement) << 32) | uint64_t(write.descriptorCount));
+
+        for (uint32_t j = 0; j < write.descriptorCount; j++)
+        {
+            if (write.pBufferInfo)
+            {
+                m_key.push_back(handleWord(write.pBufferInfo[j].buffer));
+                m_key.push_back(write.pBufferInfo[j].offset);
+                m_key.push_back(write.pBufferInfo[j].range);
+            }
+            else if (write.pImageInfo)
+            {
+                m_key.push_back(handleWord(write.pImageInfo[j].sampler));
+                m_key.push_back(handleWord(write.pImageInfo[j].imageView));
+                m_key.push_back(write.pImageInfo[j].imageLayout);
+            }
+        }
+    }
+}
+
 // *************** Descriptor Writer *********************
 
 MyDescriptorWriter::MyDescriptorWriter(MyDescriptorSetLayout& setLayout, MyDescriptorPool& pool)
-    : m_myDescriptorSetLayout{ setLayout }, m_myDescriptorPool{ pool }
+    : m_myDescriptorSetLayout{ setLayout }, m_myDevice{ pool.m_myDevice }, m_pMyDescriptorPool{ &pool }
+{
+}
+
+MyDescriptorWriter::MyDescriptorWriter(MyDescriptorSetLayout& setLayout, MyDescriptorAllocator& allocator)
+    : m_myDescriptorSetLayout{ setLayout }, m_myDevice{ setLayout.m_myDevice }, m_pMyDescriptorAllocator{ &allocator }
 {
 }
 
@@ -172,8 +427,7 @@ MyDescriptorWriter& MyDescriptorWriter::writeBuffer(
     write.pBufferInfo = bufferInfo;
     write.descriptorCount = 1;
 
-    m_myDescriptorWrites.push_back(write);
-    return *this;
+    return _addWrite(write);
 }
 
 MyDescriptorWriter& MyDescriptorWriter::writeImage(
@@ -195,8 +449,7 @@ MyDescriptorWriter& MyDescriptorWriter::writeImage(
     write.dstArrayElement = 0;
     write.descriptorCount = 1;
 
-    m_myDescriptorWrites.push_back(write);
-    return *this;
+    return _addWrite(write);
 }
 
 MyDescriptorWriter& MyDescriptorWriter::writeImages(
@@ -218,14 +471,16 @@ MyDescriptorWriter& MyDescriptorWriter::writeImages(
     write.dstArrayElement = 0;
     write.descriptorCount = numImages;
 
-    m_myDescriptorWrites.push_back(write);
-    return *this;
+    return _addWrite(write);
 }
 
 bool MyDescriptorWriter::build(VkDescriptorSet& set) 
 {
-    bool success = m_myDescriptorPool.allocateDescriptorSet(m_myDescriptorSetLayout.descriptorSetLayout(), set);
-    if (!success)
+    if (m_pMyDescriptorAllocator)
+    {
+        set = m_pMyDescriptorAllocator->allocate(m_myDescriptorSetLayout.descriptorSetLayout());
+    }
+    else if (!m_pMyDescriptorPool->allocateDescriptorSet(m_myDescriptorSetLayout.descriptorSetLayout(), set))
     {
         return false;
     }
@@ -234,13 +489,37 @@ bool MyDescriptorWriter::build(VkDescriptorSet& set)
     return true;
 }
 
+VkDescriptorSet MyDescriptorWriter::buildTransient()
+{
+    assert(m_pMyDescriptorAllocator && "Transient descriptor sets need a MyDescriptorAllocator");
+
+    VkDescriptorSet set = m_pMyDescriptorAllocator->allocateTransient(m_myDescriptorSetLayout.descriptorSetLayout());
+    overwrite(set);
+    return set;
+}
+
+VkDescriptorSet MyDescriptorWriter::buildCached()
+{
+    assert(m_pMyDescriptorAllocator && "Cached descriptor sets need a MyDescriptorAllocator");
+
+    return m_pMyDescriptorAllocator->cached(m_myDescriptorSetLayout.descriptorSetLayout(), m_myDescriptorWrites.data(), m_iWriteCount);
+}
+
 void MyDescriptorWriter::overwrite(VkDescriptorSet& set) 
 {
-    for (auto& write : m_myDescriptorWrites)
+    for (uint32_t i = 0; i < m_iWriteCount; i++)
     {
-        write.dstSet = set;
+        m_myDescriptorWrites[i].dstSet = set;
     }
 
-    vkUpdateDescriptorSets(m_myDescriptorPool.m_myDevice.device(), (uint32_t)m_myDescriptorWrites.size(), m_myDescriptorWrites.data(), 0, nullptr);
+    vkUpdateDescriptorSets(m_myDevice.device(), m_iWriteCount, m_myDescriptorWrites.data(), 0, nullptr);
+}
+
+MyDescriptorWriter& MyDescriptorWriter::_addWrite(const VkWriteDescriptorSet& write)
+{
+    assert(m_iWriteCount < MAX_WRITES && "Too many descriptor writes, raise MAX_WRITES");
+
+    m_myDescriptorWrites[m_iWriteCount++] = write;
+    return *this;
 }
 
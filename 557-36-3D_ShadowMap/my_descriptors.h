@@ -4,6 +4,7 @@
 #include "my_device.h"
 
 // std
+#include <array>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -91,10 +92,105 @@ private:
     friend class     MyDescriptorWriter;
 };
 
+//
+// Descriptor sets without hand-sized pools. Pools of every common descriptor
+// type are created as needed, each new one twice as big as the last, whenever
+// the current one runs out (VK_ERROR_OUT_OF_POOL_MEMORY/FRAGMENTED_POOL).
+//
+// - allocate(): persistent sets, they live as long as the allocator
+// - allocateTransient(): sets for the current frame only, the frame's pools
+//   are reset as a whole by beginFrame() instead of freeing sets one by one
+// - cached(): sets looked up by layout and contents, so writing the same
+//   buffers and images again returns the existing set without an update.
+//   A set unused for a whole frames-in-flight cycle is freed; clearCache()
+//   drops all of them, e.g. once image views may have been destroyed and
+//   their handles could be reused.
+//
+// Only for the render thread, like MyResourcePool.
+//
+class MyDescriptorAllocator
+{
+public:
+    static constexpr uint32_t FIRST_POOL_SETS = 16;
+    static constexpr uint32_t MAX_POOL_SETS = 1024;
+
+    struct Stats
+    {
+        uint32_t poolCount = 0;           // persistent and cache pools
+        uint32_t transientPoolCount = 0;  // over all frames in flight
+        uint64_t allocationCount = 0;     // sets allocated so far
+        uint32_t cachedSetCount = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+    };
+
+    MyDescriptorAllocator(MyDevice& myDevice, uint32_t frameCount);
+    ~MyDescriptorAllocator();
+    MyDescriptorAllocator(const MyDescriptorAllocator&) = delete;
+    MyDescriptorAllocator& operator=(const MyDescriptorAllocator&) = delete;
+
+    // After the frame's fence has signaled (MyRenderer::beginFrame): resets the frame's
+    // transient pools and frees the cached sets nothing can use any more
+    void beginFrame(uint32_t frameIndex);
+
+    // Throw if a new, empty pool cannot hold the set either
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);
+
+    // The set with exactly these writes (dstSet is ignored), written on a miss
+    VkDescriptorSet cached(VkDescriptorSetLayout layout, VkWriteDescriptorSet* pWrites, uint32_t writeCount);
+
+    // The cached sets are freed once the frames in flight are done with them
+    void clearCache();
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct PoolList
+    {
+        std::vector<VkDescriptorPool> pools;
+        uint32_t                      current = 0;
+        uint32_t                      nextPoolSets = FIRST_POOL_SETS;
+        VkDescriptorPoolCreateFlags   flags = 0;
+    };
+
+    struct CachedSet
+    {
+        std::vector<uint64_t> key;
+        VkDescriptorSet       set;
+        VkDescriptorPool      pool;
+        uint64_t              lastUsedFrame;
+    };
+
+    struct RetiredSet
+    {
+        VkDescriptorSet  set;
+        VkDescriptorPool pool;
+    };
+
+    VkDescriptorSet _allocate(PoolList& list, VkDescriptorSetLayout layout, VkDescriptorPool* pPool = nullptr);
+    VkDescriptorPool _createPool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags);
+    void _buildKey(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* pWrites, uint32_t writeCount);
+
+    MyDevice&                                     m_myDevice;
+    PoolList                                      m_persistentPools;
+    std::vector<PoolList>                         m_transientPools;   // per frame in flight
+    std::unordered_map<size_t, CachedSet>         m_cache;            // by hash of the key
+    std::vector<std::vector<RetiredSet>>          m_retiredSets;      // per frame in flight
+    std::vector<uint64_t>                         m_key;              // scratch, reused by cached()
+    uint32_t                                      m_iFrameIndex = 0;
+    uint64_t                                      m_iFrame = 0;
+    Stats                                         m_stats;
+};
+
 class MyDescriptorWriter
 {
 public:
+    // Writes are kept in place, so rewriting a frame's set does not allocate
+    static constexpr uint32_t MAX_WRITES = 8;
+
     MyDescriptorWriter(MyDescriptorSetLayout& setLayout, MyDescriptorPool& pool);
+    MyDescriptorWriter(MyDescriptorSetLayout& setLayout, MyDescriptorAllocator& allocator);
 
     MyDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
     MyDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
@@ -103,10 +199,19 @@ public:
     bool build(VkDescriptorSet& set);
     void overwrite(VkDescriptorSet& set);
 
+    // Only with a MyDescriptorAllocator, see there
+    VkDescriptorSet buildTransient();
+    VkDescriptorSet buildCached();
+
 private:
     MyDescriptorSetLayout&            m_myDescriptorSetLayout;
-    MyDescriptorPool&                 m_myDescriptorPool;
-    std::vector<VkWriteDescriptorSet> m_myDescriptorWrites;
+    MyDevice&                         m_myDevice;
+    MyDescriptorPool*                 m_pMyDescriptorPool = nullptr;
+    MyDescriptorAllocator*            m_pMyDescriptorAllocator = nullptr;
+    std::array<VkWriteDescriptorSet, MAX_WRITES> m_myDescriptorWrites;
+    uint32_t                          m_iWriteCount = 0;
+
+    MyDescriptorWriter& _addWrite(const VkWriteDescriptorSet& write);
 };
 
 #endif
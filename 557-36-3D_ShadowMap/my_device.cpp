@@ -1,11 +1,15 @@
 #include "my_device.h"
+#include "my_staging_pool.h"
+#include "my_upload_batch.h"
 #ifdef __DARWIN__
 #include <vulkan/vulkan_beta.h>
 #endif
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -65,10 +69,16 @@ MyDevice::MyDevice(MyWindow &window) :
     _pickPhysicalDevice();  // Pick the graphics hardware device (GPU) that is capable of using VulKan API
     _createLogicalDevice(); // Describe what featues we would like to use for the physical device we just pick
     _createCommandPool();   // Ceate command buffer to send command to the device
+
+    m_pMyMemoryAllocator = std::make_unique<MyMemoryAllocator>(m_vkPhysicalDevice, m_vkDevice, m_bMemoryBudget);
+    m_pMyStagingPool = std::make_unique<MyStagingPool>(*this);
 }
 
 MyDevice::~MyDevice() 
 {
+    m_pMyStagingPool.reset();
+    m_pMyMemoryAllocator.reset();
+
     vkDestroyCommandPool(m_vkDevice, m_vkCommandPool, nullptr);
     vkDestroyDevice(m_vkDevice, nullptr);
 
@@ -184,17 +194,12 @@ void MyDevice::_pickPhysicalDevice()
 
     m_vkPhysicalDevice = bestDevice;
     m_vkMSAASamples = _getMaxUsableSampleCount();
+    m_bUnifiedMemory = _hasUnifiedMemory(m_vkPhysicalDevice);
 
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &properties);
-    std::cout << "picked physical device: " << properties.deviceName << std::endl;
-
-    // For this application, we need push constant size to be more than 2 4x4 matrices
-    unsigned int size = _getMaxPushContantSize();
-    if (size <= 128)
-    {
-        throw std::runtime_error("failed to find a suitable GPU with proper push constant size!");
-    }
+    vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &m_vkProperties);
+    std::cout << "picked physical device: " << m_vkProperties.deviceName << std::endl;
+    if (m_bUnifiedMemory)
+        std::cout << "unified memory: buffers are written in place" << std::endl;
 }
 
 unsigned int MyDevice::_rateDevice(VkPhysicalDevice device) 
@@ -234,12 +239,101 @@ unsigned int MyDevice::_rateDevice(VkPhysicalDevice device)
     return score;
 }
 
+bool MyDevice::_hasUnifiedMemory(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+
+    // The largest device local heap, so the 256 MB BAR window of a discrete GPU does not count
+    uint32_t mainHeap = UINT32_MAX;
+    VkDeviceSize mainHeapSize = 0;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+    {
+        if ((memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memProperties.memoryHeaps[i].size > mainHeapSize)
+        {
+            mainHeap = i;
+            mainHeapSize = memProperties.memoryHeaps[i].size;
+        }
+    }
+
+    const VkMemoryPropertyFlags unified = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        const VkMemoryType& type = memProperties.memoryTypes[i];
+        if (type.heapIndex == mainHeap && (type.propertyFlags & unified) == unified)
+            return true;
+    }
+
+    return false;
+}
+
+bool MyDevice::_checkDrawIndirectCountSupport(VkPhysicalDevice device)
+{
+    if (!_hasDeviceExtension(device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+        return false;
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+
+bool MyDevice::_checkHostImageCopySupport(VkPhysicalDevice device)
+{
+    if (!_hasDeviceExtension(device, VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) ||
+        !_hasDeviceExtension(device, VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME) ||
+        !_hasDeviceExtension(device, VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME))
+        return false;
+
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &hostImageCopyFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    if (!hostImageCopyFeatures.hostImageCopy)
+        return false;
+
+    // The host copy leaves the texture where the staged copy does, in TRANSFER_DST_OPTIMAL
+    VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+    hostImageCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &hostImageCopyProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties);
+
+    std::vector<VkImageLayout> dstLayouts(hostImageCopyProperties.copyDstLayoutCount);
+    hostImageCopyProperties.pCopyDstLayouts = dstLayouts.data();
+    vkGetPhysicalDeviceProperties2(device, &properties);
+    if (std::find(dstLayouts.begin(), dstLayouts.end(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) == dstLayouts.end())
+        return false;
+
+    // Not if host transfer usage makes sampling slower, e.g. by turning off compression
+    VkHostImageCopyDevicePerformanceQueryEXT performance{};
+    performance.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+    VkImageFormatProperties2 formatProperties{};
+    formatProperties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+    formatProperties.pNext = &performance;
+
+    VkPhysicalDeviceImageFormatInfo2 formatInfo{};
+    formatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+    formatInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    formatInfo.type = VK_IMAGE_TYPE_2D;
+    formatInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    formatInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    if (vkGetPhysicalDeviceImageFormatProperties2(device, &formatInfo, &formatProperties) != VK_SUCCESS)
+        return false;
+
+    return performance.optimalDeviceAccess == VK_TRUE;
+}
+
 void MyDevice::_createLogicalDevice() 
 {
     QueueFamilyIndices indices = _findQueueFamilies(m_vkPhysicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    if (indices.transferFamilyHasValue)
+        uniqueQueueFamilies.insert(indices.transferFamily);
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -256,6 +350,11 @@ void MyDevice::_createLogicalDevice()
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.fragmentStoresAndAtomics = VK_TRUE; // This flag is required for SSBO
 
+    // GPU-driven draws: many commands per indirect draw, each with its own first instance
+    m_bDrawIndirectCount = _checkDrawIndirectCountSupport(m_vkPhysicalDevice);
+    deviceFeatures.multiDrawIndirect = m_bDrawIndirectCount;
+    deviceFeatures.drawIndirectFirstInstance = m_bDrawIndirectCount;
+
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -264,8 +363,33 @@ void MyDevice::_createLogicalDevice()
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Heap budgets for the memory statistics, when the driver has them
+    std::vector<const char*> extensions = deviceExtensions;
+    m_bMemoryBudget = _hasDeviceExtension(m_vkPhysicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_bMemoryBudget)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_bDrawIndirectCount)
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+    // Texture uploads without staging memory, only worth it with unified memory
+    // Note: the extension needs copy_commands2 and format_feature_flags2 on Vulkan 1.1
+    const std::vector<const char*> hostImageCopyExtensions = {
+        VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME,
+        VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME,
+        VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME
+    };
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    m_bHostImageCopy = m_bUnifiedMemory && _checkHostImageCopySupport(m_vkPhysicalDevice);
+    if (m_bHostImageCopy)
+    {
+        extensions.insert(extensions.end(), hostImageCopyExtensions.begin(), hostImageCopyExtensions.end());
+        hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+        createInfo.pNext = &hostImageCopyFeatures;
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -282,10 +406,16 @@ void MyDevice::_createLogicalDevice()
 #ifdef __DARWIN__
     // Add required instance extensions to support VK_KHR_portability_subset
     // https://vulkan.lunarg.com/doc/view/1.4.313.0/mac/antora/spec/latest/chapters/devsandqueues.html#VUID-VkDeviceCreateInfo-pProperties-04451
-    const std::vector<const char*> instanceExtensions = {
+    std::vector<const char*> instanceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME // Need to include <vulkan/vulkan_beta.h>
     };
+    if (m_bMemoryBudget)
+        instanceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_bDrawIndirectCount)
+        instanceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (m_bHostImageCopy)
+        instanceExtensions.insert(instanceExtensions.end(), hostImageCopyExtensions.begin(), hostImageCopyExtensions.end());
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
     createInfo.ppEnabledExtensionNames = instanceExtensions.data();
@@ -296,8 +426,27 @@ void MyDevice::_createLogicalDevice()
        throw std::runtime_error("failed to create logical device!");
     }
 
+    if (m_bHostImageCopy)
+    {
+        m_pfnCopyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkCopyMemoryToImageEXT"));
+        m_pfnTransitionImageLayout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(m_vkDevice, "vkTransitionImageLayoutEXT"));
+        m_bHostImageCopy = m_pfnCopyMemoryToImage && m_pfnTransitionImageLayout;
+    }
+
+    if (m_bDrawIndirectCount)
+    {
+        m_pfnCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(m_vkDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+        m_pfnCmdDrawIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndirectCountKHR>(vkGetDeviceProcAddr(m_vkDevice, "vkCmdDrawIndirectCountKHR"));
+        m_bDrawIndirectCount = m_pfnCmdDrawIndexedIndirectCount && m_pfnCmdDrawIndirectCount;
+    }
+
     vkGetDeviceQueue(m_vkDevice, indices.graphicsFamily, 0, &m_vkGraphicsQueue);
     vkGetDeviceQueue(m_vkDevice, indices.presentFamily, 0, &m_vkPresentQueue);
+
+    // Background uploads go to the transfer queue so they don't queue up behind the frames
+    m_iGraphicsQueueFamily = indices.graphicsFamily;
+    m_iTransferQueueFamily = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+    vkGetDeviceQueue(m_vkDevice, m_iTransferQueueFamily, 0, &m_vkTransferQueue);
 }
 
 void MyDevice::_createCommandPool()
@@ -449,6 +598,22 @@ bool MyDevice::_checkDeviceExtensionSupport(VkPhysicalDevice device)
     return requiredExtensions.empty();
 }
 
+bool MyDevice::_hasDeviceExtension(VkPhysicalDevice device, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0)
+            return true;
+    }
+    return false;
+}
+
 QueueFamilyIndices MyDevice::_findQueueFamilies(VkPhysicalDevice device) 
 {
     QueueFamilyIndices indices;
@@ -484,6 +649,23 @@ QueueFamilyIndices MyDevice::_findQueueFamilies(VkPhysicalDevice device)
         i++;
     }
 
+    // A transfer-only family is the DMA engine, a compute family without graphics comes second
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+
+        if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT))
+        {
+            indices.transferFamily = family;
+            indices.transferFamilyHasValue = true;
+        }
+
+        if (!(flags & VK_QUEUE_COMPUTE_BIT))
+            break;
+    }
+
     return indices;
 }
 
@@ -536,19 +718,6 @@ VkSampleCountFlagBits MyDevice::_getMaxUsableSampleCount()
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-unsigned int MyDevice::_getMaxPushContantSize()
-{
-    if (m_vkPhysicalDevice != VK_NULL_HANDLE)
-    {
-        VkPhysicalDeviceProperties physicalDeviceProperties;
-        vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &physicalDeviceProperties);
-
-        return (unsigned int)physicalDeviceProperties.limits.maxPushConstantsSize;
-    }
-
-    return 0;
-}
-
 VkFormat MyDevice::findSupportedFormat(
     const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) 
 {
@@ -570,28 +739,12 @@ VkFormat MyDevice::findSupportedFormat(
     throw std::runtime_error("failed to find supported format!");
 }
 
-uint32_t MyDevice::_findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_vkPhysicalDevice, &memProperties);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-    {
-        if ((typeFilter & (1 << i)) &&
-          (memProperties.memoryTypes[i].propertyFlags & properties) == properties) 
-        {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
-
 void MyDevice::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory)
+    MyMemoryAllocator::Allocation &bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -607,26 +760,30 @@ void MyDevice::createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(m_vkDevice, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = _findMemoryType(memRequirements.memoryTypeBits, properties);
+    // Only for the statistics
+    MyMemoryAllocator::Category category = MyMemoryAllocator::CATEGORY_OTHER;
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+        category = MyMemoryAllocator::CATEGORY_GEOMETRY;
+    else if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        category = MyMemoryAllocator::CATEGORY_UNIFORM;
+    else if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+        category = MyMemoryAllocator::CATEGORY_STAGING;
+
+    bufferMemory = m_pMyMemoryAllocator->allocate(memRequirements, properties, MyMemoryAllocator::RESOURCE_LINEAR, category);
 
-    if (vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+    if (vkBindBufferMemory(m_vkDevice, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+        throw std::runtime_error("failed to bind buffer memory!");
     }
-
-    vkBindBufferMemory(m_vkDevice, buffer, bufferMemory, 0);
 }
 
-void MyDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void MyDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     VkBufferCopy copyRegion{};
     copyRegion.srcOffset = 0;  // Optional
-    copyRegion.dstOffset = 0;  // Optional
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -704,38 +861,129 @@ void MyDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(m_vkGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_vkGraphicsQueue);
+    // A fence only waits for this submission, other work on the queue keeps running
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    if (vkCreateFence(m_vkDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    vkQueueSubmit(m_vkGraphicsQueue, 1, &submitInfo, fence);
+    vkWaitForFences(m_vkDevice, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
 
+    vkDestroyFence(m_vkDevice, fence, nullptr);
     vkFreeCommandBuffers(m_vkDevice, m_vkCommandPool, 1, &commandBuffer);
 }
 
+void MyDevice::submitUploads(const MyUploadBatch& batch)
+{
+    // Everything was written in place
+    if (batch.empty())
+        return;
+
+    // One queue family, so no ownership transfer between the two parts
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    batch.recordTransfer(commandBuffer, m_iGraphicsQueueFamily, m_iGraphicsQueueFamily);
+    batch.recordGraphics(commandBuffer, m_iGraphicsQueueFamily, m_iGraphicsQueueFamily);
+    endSingleTimeCommands(commandBuffer);
+}
+
+void MyDevice::hostCopyToImage(const void* pPixels, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    // All levels, the mipmap blits expect them in TRANSFER_DST_OPTIMAL
+    VkHostImageLayoutTransitionInfoEXT transition{};
+    transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+    transition.image = image;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    transition.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    transition.subresourceRange.baseMipLevel = 0;
+    transition.subresourceRange.levelCount = mipLevels;
+    transition.subresourceRange.baseArrayLayer = 0;
+    transition.subresourceRange.layerCount = 1;
+    if (m_pfnTransitionImageLayout(m_vkDevice, 1, &transition) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to transition image layout on the host!");
+    }
+
+    VkMemoryToImageCopyEXT region{};
+    region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+    region.pHostPointer = pPixels;
+    region.memoryRowLength = 0;
+    region.memoryImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { width, height, 1 };
+
+    VkCopyMemoryToImageInfoEXT copyInfo{};
+    copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copyInfo.dstImage = image;
+    copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    copyInfo.regionCount = 1;
+    copyInfo.pRegions = &region;
+    if (m_pfnCopyMemoryToImage(m_vkDevice, &copyInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to copy memory to image!");
+    }
+}
+
 // This function will be used by the swap chain
 void MyDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) 
+    MyMemoryAllocator::Allocation &imageMemory) 
 {
    if (vkCreateImage(m_vkDevice, &imageInfo, nullptr, &image) != VK_SUCCESS)
    {
        throw std::runtime_error("failed to create image!");
    }
 
-   VkMemoryRequirements memRequirements;
-   vkGetImageMemoryRequirements(m_vkDevice, image, &memRequirements);
-
-   VkMemoryAllocateInfo allocInfo{};
-   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-   allocInfo.allocationSize = memRequirements.size;
-   allocInfo.memoryTypeIndex = _findMemoryType(memRequirements.memoryTypeBits, properties);
-
-   if (vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+   // The driver may want render targets in memory of their own (e.g. for compression)
+   VkImageMemoryRequirementsInfo2 requirementsInfo{};
+   requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+   requirementsInfo.image = image;
+
+   VkMemoryDedicatedRequirements dedicatedRequirements{};
+   dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+   VkMemoryRequirements2 memRequirements{};
+   memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+   memRequirements.pNext = &dedicatedRequirements;
+   vkGetImageMemoryRequirements2(m_vkDevice, &requirementsInfo, &memRequirements);
+
+   MyMemoryAllocator::Category category = MyMemoryAllocator::CATEGORY_OTHER;
+   if (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+       category = MyMemoryAllocator::CATEGORY_RENDER_TARGET;
+   else if (imageInfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+       category = MyMemoryAllocator::CATEGORY_TEXTURE;
+
+   // Transient attachments never leave tile memory on tile based GPUs, lazily allocated
+   // memory is only committed if the driver needs it after all
+   VkMemoryPropertyFlags lazyProperties = properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+   if ((imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+       m_pMyMemoryAllocator->hasMemoryType(memRequirements.memoryRequirements.memoryTypeBits, lazyProperties))
+   {
+       imageMemory = m_pMyMemoryAllocator->allocateDedicated(memRequirements.memoryRequirements, lazyProperties, category, image);
+   }
+   else if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation ||
+       memRequirements.memoryRequirements.size > MyMemoryAllocator::DEDICATED_THRESHOLD)
+   {
+       imageMemory = m_pMyMemoryAllocator->allocateDedicated(memRequirements.memoryRequirements, properties, category, image);
+   }
+   else
    {
-       throw std::runtime_error("failed to allocate image memory!");
+       MyMemoryAllocator::ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? MyMemoryAllocator::RESOURCE_OPTIMAL : MyMemoryAllocator::RESOURCE_LINEAR;
+       imageMemory = m_pMyMemoryAllocator->allocate(memRequirements.memoryRequirements, properties, kind, category);
    }
 
-   if (vkBindImageMemory(m_vkDevice, image, imageMemory, 0) != VK_SUCCESS)
+   if (vkBindImageMemory(m_vkDevice, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS)
    {
        throw std::runtime_error("failed to bind image memory!");
    }
@@ -2,11 +2,16 @@
 #define __MY_DEVICE_H__
 
 #include "my_window.h"
+#include "my_memory_allocator.h"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
+class MyStagingPool;
+class MyUploadBatch;
+
 struct SwapChainSupportDetails
 {
     VkSurfaceCapabilitiesKHR        capabilities;
@@ -18,8 +23,10 @@ struct QueueFamilyIndices
 {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily; // optional, a family without graphics (usually the DMA engine)
     bool     graphicsFamilyHasValue = false;
     bool     presentFamilyHasValue = false;
+    bool     transferFamilyHasValue = false;
     bool     isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -47,24 +54,44 @@ class MyDevice
     VkQueue graphicsQueue()           { return m_vkGraphicsQueue; }
     VkQueue presentQueue()            { return m_vkPresentQueue; }
 
+    // Dedicated transfer queue if the device has one, otherwise the graphics queue
+    // Note: queues are externally synchronized, only submit from the main thread
+    VkQueue  transferQueue()          { return m_vkTransferQueue; }
+    uint32_t graphicsQueueFamily()    { return m_iGraphicsQueueFamily; }
+    uint32_t transferQueueFamily()    { return m_iTransferQueueFamily; }
+    bool     hasTransferQueue()       { return m_iTransferQueueFamily != m_iGraphicsQueueFamily; }
+
     // For GUI
     VkInstance       instance()       { return m_vkInstance; }
     VkPhysicalDevice physicalDevice() { return m_vkPhysicalDevice; }
 
+    const VkPhysicalDeviceLimits& limits() const { return m_vkProperties.limits; }
+
     // Used by Swap Chain
     SwapChainSupportDetails getSwapChainSupport()  { return _querySwapChainSupport(m_vkPhysicalDevice); }
     QueueFamilyIndices findPhysicalQueueFamilies() { return _findQueueFamilies(m_vkPhysicalDevice); }
     VkFormat findSupportedFormat(
         const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
+    // Note: end waits on a fence for this command buffer only, not for the queue to go idle
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
+    // Staging memory shared by all uploads, see MyUploadBatch
+    MyStagingPool& stagingPool()      { return *m_pMyStagingPool; }
+
+    // Records every copy, layout transition and mip blit of 'batch' into one
+    // command buffer on the graphics queue, submits it and waits for it
+    void submitUploads(const MyUploadBatch& batch);
+
+    // Memory comes from the device's MyMemoryAllocator, release it with freeMemory()
+    // after destroying the image. Transient attachments get lazily allocated memory
+    // where the device has it
     void createImageWithInfo(
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory);
+        MyMemoryAllocator::Allocation &imageMemory);
 
     void createImageViewWithInfo(
         const VkImageViewCreateInfo& imageInfo,
@@ -80,9 +107,56 @@ class MyDevice
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory);
+        MyMemoryAllocator::Allocation &bufferMemory);
+
+    void freeMemory(MyMemoryAllocator::Allocation &memory) { m_pMyMemoryAllocator->free(memory); }
+    MyMemoryAllocator::Stats memoryStats() const            { return m_pMyMemoryAllocator->stats(); }
+    MyMemoryAllocator& memoryAllocator()                     { return *m_pMyMemoryAllocator; }
+
+    // Device local memory left before the heap budget is reached; loaders check it
+    // before large uploads. See MyMemoryAllocator::heapBudget()
+    VkDeviceSize remainingBudget() const { return m_pMyMemoryAllocator->remainingBudget(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT); }
+    bool         hasMemoryBudget() const { return m_bMemoryBudget; } // VK_EXT_memory_budget
+
+    // Unified memory: the main device local heap is host visible as well (integrated
+    // GPUs, resizable BAR, lavapipe). Geometry and per-frame buffers are then written
+    // in place instead of going through the staging pool, and textures are copied
+    // from the host with VK_EXT_host_image_copy where the device supports it
+    void setUnifiedMemory(bool bEnable) { m_bUseUnifiedMemory = bEnable; }
+    bool unifiedMemory() const          { return m_bUnifiedMemory && m_bUseUnifiedMemory; }
+    bool hostImageCopy() const          { return unifiedMemory() && m_bHostImageCopy; }
+
+    // 'properties' plus DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT with unified memory,
+    // for buffers the CPU fills and the GPU reads
+    VkMemoryPropertyFlags unifiedMemoryProperties(VkMemoryPropertyFlags properties) const
+    {
+        const VkMemoryPropertyFlags unified = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        return unifiedMemory() ? properties | unified : properties;
+    }
+
+    // Image usage the host copy needs, 0 without it
+    VkImageUsageFlags hostImageCopyUsage() const { return hostImageCopy() ? VkImageUsageFlags{ VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT } : 0; }
+
+    // Writes mip level 0 of an image created with hostImageCopyUsage() from the host,
+    // every level ends up in TRANSFER_DST_OPTIMAL like after a staged copy
+    void hostCopyToImage(const void* pPixels, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    // VK_KHR_draw_indirect_count with multiDrawIndirect and drawIndirectFirstInstance,
+    // for GPU-driven draws (MyGpuCuller)
+    bool drawIndirectCount() const { return m_bDrawIndirectCount; }
+
+    void cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+        VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
+    {
+        m_pfnCmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+    }
+    void cmdDrawIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+        VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
+    {
+        m_pfnCmdDrawIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+    }
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 	bool formatIsFilterable(VkFormat format, VkImageTiling tiling);
     bool resetCommandPool();
@@ -104,7 +178,6 @@ class MyDevice
     void _createSurface();
     void _createLogicalDevice();
     void _createCommandPool();
-    uint32_t _findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
     // helper functions
     std::vector<const char *> _getRequiredExtensions();
@@ -113,10 +186,13 @@ class MyDevice
     void _populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
     void _hasGflwRequiredInstanceExtensions();
     bool _checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool _hasDeviceExtension(VkPhysicalDevice device, const char* extensionName);
     SwapChainSupportDetails _querySwapChainSupport(VkPhysicalDevice device);
     VkSampleCountFlagBits   _getMaxUsableSampleCount();
-    unsigned int            _getMaxPushContantSize();
     unsigned int            _rateDevice(VkPhysicalDevice device);
+    bool                    _hasUnifiedMemory(VkPhysicalDevice device);
+    bool                    _checkHostImageCopySupport(VkPhysicalDevice device);
+    bool                    _checkDrawIndirectCountSupport(VkPhysicalDevice device);
 
     VkInstance                 m_vkInstance;
     VkDebugUtilsMessengerEXT   m_vkDebugMessenger;
@@ -124,11 +200,16 @@ class MyDevice
 
     MyWindow                  &m_myWindow;
     VkCommandPool              m_vkCommandPool;
+    std::unique_ptr<MyMemoryAllocator> m_pMyMemoryAllocator;
+    std::unique_ptr<MyStagingPool> m_pMyStagingPool;
 
     VkDevice                   m_vkDevice;
     VkSurfaceKHR               m_vkSurface;
     VkQueue                    m_vkGraphicsQueue;
     VkQueue                    m_vkPresentQueue;
+    VkQueue                    m_vkTransferQueue;
+    uint32_t                   m_iGraphicsQueueFamily = 0;
+    uint32_t                   m_iTransferQueueFamily = 0;
 
     VkSampleCountFlagBits      m_vkMSAASamples = VK_SAMPLE_COUNT_1_BIT;
     VkPhysicalDeviceProperties m_vkProperties;
@@ -138,6 +219,19 @@ class MyDevice
 
     // enable/disable MSAA
     bool                       m_bSupportMSAA;
+    bool                       m_bMemoryBudget = false;
+
+    // Unified memory fast path, see unifiedMemory()
+    bool                       m_bUnifiedMemory = false;
+    bool                       m_bUseUnifiedMemory = true;
+    bool                       m_bHostImageCopy = false;
+    PFN_vkCopyMemoryToImageEXT     m_pfnCopyMemoryToImage = nullptr;
+    PFN_vkTransitionImageLayoutEXT m_pfnTransitionImageLayout = nullptr;
+
+    // GPU-driven draws, see drawIndirectCount()
+    bool                       m_bDrawIndirectCount = false;
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_pfnCmdDrawIndexedIndirectCount = nullptr;
+    PFN_vkCmdDrawIndirectCountKHR        m_pfnCmdDrawIndirectCount = nullptr;
 };
 
 #endif
@@ -0,0 +1,62 @@
+#include "my_frame_allocator.h"
+
+// Std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+MyFrameAllocator::MyFrameAllocator(MyDevice& device, uint32_t frameCount, VkDeviceSize frameSize)
+{
+	const VkPhysicalDeviceLimits& limits = device.limits();
+	m_vkUniformAlignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+	m_vkStorageAlignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 1);
+
+	// Every region starts at an offset that suits both kinds of descriptor
+	VkDeviceSize regionAlignment = std::max(m_vkUniformAlignment, m_vkStorageAlignment);
+	m_vkFrameSize = (frameSize + regionAlignment - 1) / regionAlignment * regionAlignment;
+	assert(m_vkFrameSize * frameCount <= UINT32_MAX && "Dynamic offsets are 32 bit");
+
+	m_pMyBuffer = std::make_unique<MyBuffer>(
+		device,
+		m_vkFrameSize,
+		frameCount,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, // indirect: MyGpuCuller
+		device.unifiedMemoryProperties(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)); // device local too with unified memory
+
+	// Note: it will unmap in the destructor
+	m_pMyBuffer->map();
+	m_pData = static_cast<char*>(m_pMyBuffer->mappedMemory());
+
+	beginFrame(0);
+}
+
+void MyFrameAllocator::beginFrame(uint32_t frameIndex)
+{
+	m_vkFrameBegin = m_vkFrameSize * frameIndex;
+	m_vkFrameEnd = m_vkFrameBegin + m_vkFrameSize;
+	m_vkHead.store(m_vkFrameBegin, std::memory_order_relaxed);
+}
+
+MyFrameAllocator::Allocation MyFrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	assert(alignment > 0 && "Alignment must not be 0");
+
+	// Other threads may bump the head between the load and the exchange, then try again
+	VkDeviceSize head = m_vkHead.load(std::memory_order_relaxed);
+	VkDeviceSize offset;
+	do
+	{
+		offset = (head + alignment - 1) / alignment * alignment;
+		if (offset + size > m_vkFrameEnd)
+		{
+			throw std::runtime_error("failed to allocate frame memory, increase the frame size!");
+		}
+	} while (!m_vkHead.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+	Allocation allocation{};
+	allocation.buffer = m_pMyBuffer->buffer();
+	allocation.offset = static_cast<uint32_t>(offset);
+	allocation.pData = m_pData + offset;
+	return allocation;
+}
+
@@ -0,0 +1,83 @@
+#ifndef __MY_FRAME_ALLOCATOR_H__
+#define __MY_FRAME_ALLOCATOR_H__
+
+#include "my_device.h"
+#include "my_buffer.h"
+
+// Std
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+//
+// Linear allocator for data that lives for one frame, e.g. uniform blocks and
+// per-draw data. One persistently mapped buffer is split into a region per
+// frame in flight; allocations bump a pointer through the current region and
+// the whole region is reset by beginFrame() once the frame's fence has
+// signaled, so there is nothing to free. Descriptor sets point at the buffer
+// as UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC and each bind passes the
+// allocation's offset, so new data needs neither new buffers nor descriptor
+// writes (or as a STORAGE_BUFFER over the whole buffer, indexed from its start
+// as MyRenderQueue's instances). allocate() may be called from any thread.
+//
+class MyFrameAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4 * 1024 * 1024;
+
+	struct Allocation
+	{
+		VkBuffer     buffer = VK_NULL_HANDLE;
+		uint32_t     offset = 0;       // from the start of the buffer, the dynamic offset
+		void*        pData = nullptr;
+	};
+
+	MyFrameAllocator(MyDevice& device, uint32_t frameCount, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+
+	MyFrameAllocator(const MyFrameAllocator&) = delete;
+	MyFrameAllocator& operator=(const MyFrameAllocator&) = delete;
+
+	// The GPU must be done with the frame's previous use, i.e. after MyRenderer::beginFrame
+	void beginFrame(uint32_t frameIndex);
+
+	// Throws if the frame's region is full
+	Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+	Allocation allocateUniform(VkDeviceSize size) { return allocate(size, m_vkUniformAlignment); }
+	Allocation allocateStorage(VkDeviceSize size) { return allocate(size, m_vkStorageAlignment); }
+
+	// 'count' elements for a descriptor over the whole buffer, indexed from its start: the
+	// offset is a multiple of 'elementSize', so offset / elementSize is the first element
+	Allocation allocateArray(VkDeviceSize count, VkDeviceSize elementSize) { return allocate(count * elementSize, elementSize); }
+
+	// Copies 'data' into a new uniform block, returns its dynamic offset
+	template<typename T>
+	uint32_t pushUniform(const T& data)
+	{
+		Allocation allocation = allocateUniform(sizeof(T));
+		memcpy(allocation.pData, &data, sizeof(T));
+		return allocation.offset;
+	}
+
+	// For a dynamic descriptor, 'range' is the size the shader sees at each offset
+	VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const { return { m_pMyBuffer->buffer(), 0, range }; }
+
+	VkBuffer     buffer() const { return m_pMyBuffer->buffer(); }
+	VkDeviceSize frameSize() const { return m_vkFrameSize; }
+
+	// Bytes handed out in the current frame, including the alignment padding
+	VkDeviceSize used() const { return m_vkHead.load(std::memory_order_relaxed) - m_vkFrameBegin; }
+
+private:
+	std::unique_ptr<MyBuffer> m_pMyBuffer;
+	char*                     m_pData;
+	VkDeviceSize              m_vkFrameSize;
+	VkDeviceSize              m_vkUniformAlignment;
+	VkDeviceSize              m_vkStorageAlignment;
+
+	VkDeviceSize              m_vkFrameBegin = 0;
+	VkDeviceSize              m_vkFrameEnd = 0;
+	std::atomic<VkDeviceSize> m_vkHead{ 0 };
+};
+
+#endif
+
@@ -0,0 +1,68 @@
+#include "my_frame_arena.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+MyFrameArena::MyFrameArena(size_t chunkSize)
+{
+	_addChunk(chunkSize);
+}
+
+void MyFrameArena::reset()
+{
+	m_iHighWater = std::max(m_iHighWater, used());
+
+	// The last frame overflowed: one chunk big enough for all of it
+	if (m_chunks.size() > 1)
+	{
+		size_t total = capacity();
+		m_chunks.clear();
+		_addChunk(total);
+	}
+
+	m_iHead = 0;
+	m_iUsedBefore = 0;
+}
+
+void* MyFrameArena::allocate(size_t size, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+	const Chunk* pChunk = &m_chunks.back();
+	size_t offset = _alignedOffset(*pChunk, m_iHead, alignment);
+	if (offset + size > pChunk->size)
+	{
+		m_iUsedBefore += m_iHead;
+		_addChunk(std::max(size + alignment, pChunk->size * 2));
+		pChunk = &m_chunks.back();
+		offset = _alignedOffset(*pChunk, 0, alignment);
+	}
+
+	m_iHead = offset + size;
+	return pChunk->pData.get() + offset;
+}
+
+size_t MyFrameArena::capacity() const
+{
+	size_t total = 0;
+	for (const auto& chunk : m_chunks)
+		total += chunk.size;
+	return total;
+}
+
+size_t MyFrameArena::_alignedOffset(const Chunk& chunk, size_t offset, size_t alignment)
+{
+	// Align the address, new[] only guarantees the default new alignment
+	uintptr_t base = reinterpret_cast<uintptr_t>(chunk.pData.get());
+	return ((base + offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - base;
+}
+
+void MyFrameArena::_addChunk(size_t minSize)
+{
+	Chunk chunk;
+	chunk.pData.reset(new char[minSize]); // not zeroed
+	chunk.size = minSize;
+	m_chunks.push_back(std::move(chunk));
+	m_iHead = 0;
+}
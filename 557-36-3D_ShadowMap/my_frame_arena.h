@@ -0,0 +1,92 @@
+#ifndef __MY_FRAME_ARENA_H__
+#define __MY_FRAME_ARENA_H__
+
+// Std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//
+// Host memory for containers that live for one frame on the render thread,
+// e.g. draw lists and sort keys. A bump allocator over one chunk, reset() at the
+// start of the frame hands all of it out again. When a frame needs more, the
+// arena chains a new chunk and reset() replaces them all with one chunk of the
+// total size, so after the first few frames the loop stops touching the heap.
+// deallocate() does nothing, the memory is reused after the next reset().
+//
+class MyFrameArena
+{
+public:
+	static constexpr size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+	explicit MyFrameArena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+	MyFrameArena(const MyFrameArena&) = delete;
+	MyFrameArena& operator=(const MyFrameArena&) = delete;
+
+	// Everything allocated before is invalid afterwards
+	void reset();
+
+	void* allocate(size_t size, size_t alignment);
+
+	template<typename T>
+	T* allocateArray(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+	// Bytes handed out since reset(), including the alignment padding
+	size_t used() const { return m_iUsedBefore + m_iHead; }
+	size_t capacity() const;
+
+	// Peak of used() over the frames so far
+	size_t highWater() const { return m_iHighWater; }
+
+private:
+	struct Chunk
+	{
+		std::unique_ptr<char[]> pData;
+		size_t                  size;
+	};
+
+	static size_t _alignedOffset(const Chunk& chunk, size_t offset, size_t alignment);
+	void _addChunk(size_t minSize);
+
+	std::vector<Chunk> m_chunks;           // the last one is current
+	size_t             m_iHead = 0;        // in the current chunk
+	size_t             m_iUsedBefore = 0;  // in the chunks before it
+	size_t             m_iHighWater = 0;
+};
+
+//
+// Standard allocator over a MyFrameArena, containers using it must not outlive
+// the frame
+//
+template<typename T>
+class MyFrameArenaAllocator
+{
+public:
+	using value_type = T;
+
+	MyFrameArenaAllocator(MyFrameArena& arena) noexcept : m_pArena{ &arena } {}
+
+	template<typename U>
+	MyFrameArenaAllocator(const MyFrameArenaAllocator<U>& other) noexcept : m_pArena{ other.arena() } {}
+
+	T* allocate(size_t count) { return m_pArena->allocateArray<T>(count); }
+	void deallocate(T*, size_t) noexcept {}
+
+	MyFrameArena* arena() const noexcept { return m_pArena; }
+
+	template<typename U>
+	bool operator==(const MyFrameArenaAllocator<U>& other) const noexcept { return m_pArena == other.arena(); }
+	template<typename U>
+	bool operator!=(const MyFrameArenaAllocator<U>& other) const noexcept { return m_pArena != other.arena(); }
+
+private:
+	MyFrameArena* m_pArena;
+};
+
+// e.g. MyFrameVector<uint32_t> list{ arena }; list.reserve(count);
+template<typename T>
+using MyFrameVector = std::vector<T, MyFrameArenaAllocator<T>>;
+
+#endif
@@ -2,11 +2,17 @@
 #define __MY_FRAMEINFO_H__
 
 #include "my_camera.h"
+#include "my_frame_allocator.h"
+#include "my_frame_arena.h"
 #include "my_game_object.h"
+#include "my_meshlet_culler.h"
+#include "my_render_queue.h"
 
 // lib
 #include <vulkan/vulkan.h>
 
+class MyGpuCuller;
+
 struct MyPointLight 
 {
 	glm::mat4 lightMVP;
@@ -29,12 +35,6 @@ struct MySSBO
 	float id;
 };
 
-struct MySimplePushConstantData
-{
-	glm::mat4 modelMatrix{ 1.0f };
-	glm::mat4 normalMatrix{ 1.0f };
-};
-
 struct MyFrameInfo
 {
 	int                frameIndex;
@@ -43,7 +43,36 @@ struct MyFrameInfo
 	MyCamera&          camera;
 	VkDescriptorSet    globalDescriptorSet;
 	VkDescriptorSet    offscreenDescriptorSet;
-	MyGameObject::Map& gameObjects;
+	const MyRenderQueue& renderQueue; // the draws of the passes, in key order
+	MyResourcePool<MyModel>& models;  // resolves MyGameObject::model
+
+	// Both descriptor sets read MyGlobalUBO at this dynamic offset of the frame allocator
+	uint32_t           globalUboOffset = 0;
+
+	// Per-frame uniform/storage data for the factories, reset with the frame
+	MyFrameAllocator*  pFrameAllocator = nullptr;
+
+	// Host memory for the frame's transient containers (MyFrameVector), reset with the frame
+	MyFrameArena*      pFrameArena = nullptr;
+
+	// LOD selection, see MyModel::selectLod
+	float              viewportHeight = 0.0f;
+	float              lodPixelError = 0.0f;  // 0 = always LOD 0
+
+	// Meshlet culling against the camera and the light frustum, nullptr = draw whole LODs
+	MyMeshletCuller*   pViewCuller = nullptr;
+	MyMeshletCuller*   pShadowCuller = nullptr;
+
+	// Set when the GPU culled the passes it culls(), the factories draw its groups instead
+	MyGpuCuller*       pGpuCuller = nullptr;
+
+	// Triangles drawn by the main pass, for the GUI
+	uint32_t           triangleCount = 0;
+
+	// The factories draw share shareIndex of shareCount of their pass's draws,
+	// a thread's share when recording in parallel (MyParallelRecorder)
+	uint32_t           shareIndex = 0;
+	uint32_t           shareCount = 1;
 };
 
 #endif
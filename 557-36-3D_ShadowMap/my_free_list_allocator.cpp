@@ -0,0 +1,102 @@
+#include "my_free_list_allocator.h"
+
+// Std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+MyFreeListAllocator::MyFreeListAllocator(VkDeviceSize size) :
+	m_vkSize{ size }
+{
+	if (size > 0)
+		m_freeBlocks.emplace(0, size);
+}
+
+bool MyFreeListAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	assert(size > 0 && alignment > 0 && "Allocation size and alignment must not be 0");
+
+	// Best fit: the smallest block that holds the aligned range, to keep the large blocks whole
+	auto best = m_freeBlocks.end();
+	VkDeviceSize bestWaste = 0;
+	for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it)
+	{
+		VkDeviceSize alignedOffset = (it->first + alignment - 1) / alignment * alignment;
+		VkDeviceSize padding = alignedOffset - it->first;
+		if (it->second < padding + size)
+			continue;
+
+		VkDeviceSize waste = it->second - size;
+		if (best == m_freeBlocks.end() || waste < bestWaste)
+		{
+			best = it;
+			bestWaste = waste;
+			if (waste == padding)
+				break; // exact fit
+		}
+	}
+
+	if (best == m_freeBlocks.end())
+		return false;
+
+	VkDeviceSize blockOffset = best->first;
+	VkDeviceSize blockSize = best->second;
+	offset = (blockOffset + alignment - 1) / alignment * alignment;
+	m_freeBlocks.erase(best);
+
+	// The alignment padding in front and the rest behind stay free
+	if (offset > blockOffset)
+		m_freeBlocks.emplace(blockOffset, offset - blockOffset);
+	if (blockOffset + blockSize > offset + size)
+		m_freeBlocks.emplace(offset + size, blockOffset + blockSize - offset - size);
+
+	m_vkUsed += size;
+	m_iAllocationCount++;
+	return true;
+}
+
+void MyFreeListAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+{
+	assert(offset + size <= m_vkSize && m_iAllocationCount > 0 && "Freeing a range that was not allocated");
+
+	m_vkUsed -= size;
+	m_iAllocationCount--;
+
+	auto next = m_freeBlocks.lower_bound(offset);
+	assert((next == m_freeBlocks.end() || next->first >= offset + size) && "Freeing a free range");
+
+	// Merge with the free block in front
+	if (next != m_freeBlocks.begin())
+	{
+		auto previous = std::prev(next);
+		assert(previous->first + previous->second <= offset && "Freeing a free range");
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			m_freeBlocks.erase(previous);
+		}
+	}
+
+	// and with the one behind
+	if (next != m_freeBlocks.end() && next->first == offset + size)
+	{
+		size += next->second;
+		m_freeBlocks.erase(next);
+	}
+
+	m_freeBlocks.emplace(offset, size);
+}
+
+MyFreeListAllocator::Stats MyFreeListAllocator::stats() const
+{
+	Stats stats{};
+	stats.size = m_vkSize;
+	stats.used = m_vkUsed;
+	stats.allocationCount = m_iAllocationCount;
+	stats.freeBlockCount = static_cast<uint32_t>(m_freeBlocks.size());
+	for (const auto& block : m_freeBlocks)
+		stats.largestFreeBlock = std::max(stats.largestFreeBlock, block.second);
+	return stats;
+}
+
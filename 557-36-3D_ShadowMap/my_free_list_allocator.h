@@ -0,0 +1,52 @@
+#ifndef __MY_FREE_LIST_ALLOCATOR_H__
+#define __MY_FREE_LIST_ALLOCATOR_H__
+
+#include <vulkan/vulkan.h>
+
+// Std
+#include <map>
+
+//
+// Offset allocator for a fixed range [0, size), e.g. a region of a GPU buffer.
+// Free space is kept as a list of blocks sorted by offset; allocations take the
+// best fitting block and freed ranges are merged with their free neighbours.
+// It only hands out offsets, the memory itself belongs to the caller.
+//
+class MyFreeListAllocator
+{
+public:
+	struct Stats
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize used = 0;
+		VkDeviceSize largestFreeBlock = 0;
+		uint32_t     allocationCount = 0;
+		uint32_t     freeBlockCount = 0;
+
+		// 0 = all free space in one block, towards 1 = scattered in small blocks
+		float fragmentation() const
+		{
+			VkDeviceSize free = size - used;
+			return free > 0 ? 1.0f - static_cast<float>(largestFreeBlock) / static_cast<float>(free) : 0.0f;
+		}
+	};
+
+	explicit MyFreeListAllocator(VkDeviceSize size);
+
+	// Returns false when no free block can hold 'size' bytes at 'alignment'
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	// 'offset' and 'size' as passed to / returned by allocate()
+	void free(VkDeviceSize offset, VkDeviceSize size);
+
+	Stats stats() const;
+
+private:
+	VkDeviceSize                           m_vkSize;
+	VkDeviceSize                           m_vkUsed = 0;
+	uint32_t                               m_iAllocationCount = 0;
+	std::map<VkDeviceSize, VkDeviceSize>   m_freeBlocks; // offset -> size
+};
+
+#endif
+
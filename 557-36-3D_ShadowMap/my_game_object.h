@@ -2,6 +2,7 @@
 #define __MY_GAMEOBJECT_H__
 
 #include "my_model.h"
+#include "my_resource_manager.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
@@ -47,8 +48,9 @@ public:
 	MyGameObject& operator=(MyGameObject&&) = default;
 
 	id_t                     getID() const { return m_iID; }
-	std::shared_ptr<MyModel> model{};
+	MyModelHandle            model{};  // into MyResourceManager::models(), the object holds a reference
 	glm::vec3                color{};
+	uint32_t                 textureIndex{};  // TEXTURE objects: texSampler[] of texture_shader.frag
 	TransformComponent       transform{};
 	GameObjectType           type() { return m_type; }
 
@@ -0,0 +1,254 @@
+#include "my_geometry_arena.h"
+
+// Std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+MyGeometryArena::MyGeometryArena(MyDevice& device, const std::vector<uint32_t>& vertexStrides) :
+	m_myDevice{ device },
+	m_vertexStrides{ vertexStrides }
+{
+	assert(!m_vertexStrides.empty() && m_vertexStrides.size() <= MAX_VERTEX_STREAMS && "Unsupported number of vertex streams");
+
+	// The first page is created up front and never released
+	m_pages.push_back(_createPage(PAGE_VERTICES, PAGE_INDEX_BYTES));
+}
+
+MyGeometryArena::Allocation MyGeometryArena::allocate(uint32_t vertexCount, VkDeviceSize indexSize, VkDeviceSize indexAlignment)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	Allocation allocation{};
+	for (uint32_t page = 0; page < m_pages.size(); page++)
+	{
+		if (m_pages[page] && _allocate(page, vertexCount, indexSize, indexAlignment, allocation))
+			return allocation;
+	}
+
+	// Out of space (or fragmented), add a page
+	auto empty = std::find(m_pages.begin(), m_pages.end(), nullptr);
+	uint32_t page = static_cast<uint32_t>(empty - m_pages.begin());
+	auto pPage = _createPage(std::max(vertexCount, PAGE_VERTICES), std::max(indexSize, PAGE_INDEX_BYTES));
+	if (empty == m_pages.end())
+		m_pages.push_back(std::move(pPage));
+	else
+		*empty = std::move(pPage);
+
+	if (!_allocate(page, vertexCount, indexSize, indexAlignment, allocation))
+	{
+		throw std::runtime_error("failed to allocate geometry arena range!");
+	}
+
+	return allocation;
+}
+
+bool MyGeometryArena::_allocate(uint32_t page, uint32_t vertexCount, VkDeviceSize indexSize, VkDeviceSize indexAlignment, Allocation& allocation)
+{
+	Page& arenaPage = *m_pages[page];
+
+	VkDeviceSize firstVertex = 0;
+	if (!arenaPage.vertexAllocator.allocate(vertexCount, 1, firstVertex))
+		return false;
+
+	VkDeviceSize indexOffset = 0;
+	if (indexSize > 0 && !arenaPage.indexAllocator.allocate(indexSize, indexAlignment, indexOffset))
+	{
+		arenaPage.vertexAllocator.free(firstVertex, vertexCount);
+		return false;
+	}
+
+	allocation.page = page;
+	allocation.firstVertex = static_cast<uint32_t>(firstVertex);
+	allocation.vertexCount = vertexCount;
+	allocation.indexOffset = indexOffset;
+	allocation.indexSize = indexSize;
+	allocation.pBuffers = &arenaPage.buffers;
+	return true;
+}
+
+void MyGeometryArena::free(const Allocation& allocation)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	assert(allocation.page < m_pages.size() && m_pages[allocation.page] && "Freeing an allocation of another arena");
+	Page& arenaPage = *m_pages[allocation.page];
+
+	arenaPage.vertexAllocator.free(allocation.firstVertex, allocation.vertexCount);
+	if (allocation.indexSize > 0)
+		arenaPage.indexAllocator.free(allocation.indexOffset, allocation.indexSize);
+
+	if (allocation.page != 0 && arenaPage.vertexAllocator.stats().allocationCount == 0)
+		m_pages[allocation.page].reset();
+}
+
+std::unique_ptr<MyGeometryArena::Page> MyGeometryArena::_createPage(uint32_t vertexCount, VkDeviceSize indexSize)
+{
+	auto pPage = std::make_unique<Page>(vertexCount, indexSize);
+
+	for (uint32_t stream = 0; stream < streamCount(); stream++)
+	{
+		pPage->vertexBuffers.push_back(_createVertexBuffer(m_vertexStrides[stream], vertexCount));
+		pPage->buffers.vertexBuffers[stream] = pPage->vertexBuffers[stream]->buffer();
+		pPage->buffers.pMappedVertexBuffers[stream] = pPage->vertexBuffers[stream]->memory().pMapped;
+	}
+
+	pPage->indexBuffer = _createIndexBuffer(indexSize);
+	pPage->buffers.indexBuffer = pPage->indexBuffer->buffer();
+	pPage->buffers.pMappedIndexBuffer = pPage->indexBuffer->memory().pMapped;
+
+	return pPage;
+}
+
+// Note: TRANSFER_SRC so relocate() can copy them. With unified memory they
+// are host visible too, the models write their data in place
+std::unique_ptr<MyBuffer> MyGeometryArena::_createVertexBuffer(uint32_t stride, uint32_t vertexCount)
+{
+	return std::make_unique<MyBuffer>(
+		m_myDevice,
+		stride,
+		vertexCount,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		m_myDevice.unifiedMemoryProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+}
+
+std::unique_ptr<MyBuffer> MyGeometryArena::_createIndexBuffer(VkDeviceSize indexSize)
+{
+	return std::make_unique<MyBuffer>(
+		m_myDevice,
+		indexSize,
+		1,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		m_myDevice.unifiedMemoryProperties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+}
+
+VkDeviceSize MyGeometryArena::relocate(const MyMemoryAllocator::Block* pBlock, VkCommandBuffer commandBuffer, VkDeviceSize budget,
+	std::vector<std::unique_ptr<MyBuffer>>& retired)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	auto inBlock = [pBlock](const std::unique_ptr<MyBuffer>& pBuffer) { return pBuffer->memory().pBlock == pBlock; };
+
+	VkDeviceSize copied = 0;
+	bool bBarrier = false;
+	for (auto& pPage : m_pages)
+	{
+		if (copied >= budget)
+			break;
+		if (!pPage)
+			continue;
+
+		// Only the buffers in the block move, the page's others stay where they are
+		std::vector<VkBuffer> sources;
+		std::vector<VkBuffer> destinations;
+		std::vector<VkDeviceSize> sizes;
+		for (uint32_t stream = 0; stream < streamCount(); stream++)
+		{
+			auto& pBuffer = pPage->vertexBuffers[stream];
+			if (!inBlock(pBuffer))
+				continue;
+
+			auto pMoved = _createVertexBuffer(m_vertexStrides[stream], static_cast<uint32_t>(pPage->vertexAllocator.stats().size));
+			sources.push_back(pBuffer->buffer());
+			destinations.push_back(pMoved->buffer());
+			sizes.push_back(pBuffer->bufferSize());
+			pPage->buffers.vertexBuffers[stream] = pMoved->buffer();
+			pPage->buffers.pMappedVertexBuffers[stream] = pMoved->memory().pMapped;
+			retired.push_back(std::move(pBuffer));
+			pBuffer = std::move(pMoved);
+		}
+
+		if (inBlock(pPage->indexBuffer))
+		{
+			auto pMoved = _createIndexBuffer(pPage->indexAllocator.stats().size);
+			sources.push_back(pPage->indexBuffer->buffer());
+			destinations.push_back(pMoved->buffer());
+			sizes.push_back(pPage->indexBuffer->bufferSize());
+			pPage->buffers.indexBuffer = pMoved->buffer();
+			pPage->buffers.pMappedIndexBuffer = pMoved->memory().pMapped;
+			retired.push_back(std::move(pPage->indexBuffer));
+			pPage->indexBuffer = std::move(pMoved);
+		}
+
+		if (sources.empty())
+			continue;
+
+		// Uploads into the page must be visible to the copies
+		if (!bBarrier)
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				1, &barrier,
+				0, nullptr,
+				0, nullptr);
+			bBarrier = true;
+		}
+
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			VkBufferCopy copyRegion{};
+			copyRegion.size = sizes[i];
+			vkCmdCopyBuffer(commandBuffer, sources[i], destinations[i], 1, &copyRegion);
+			copied += sizes[i];
+		}
+	}
+
+	if (bBarrier)
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	return copied;
+}
+
+VkDeviceSize MyGeometryArena::vertexSize() const
+{
+	VkDeviceSize size = 0;
+	for (uint32_t stride : m_vertexStrides)
+		size += stride;
+	return size;
+}
+
+MyGeometryArena::Stats MyGeometryArena::stats() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	auto accumulate = [](MyFreeListAllocator::Stats& total, const MyFreeListAllocator::Stats& page)
+	{
+		total.size += page.size;
+		total.used += page.used;
+		total.largestFreeBlock = std::max(total.largestFreeBlock, page.largestFreeBlock);
+		total.allocationCount += page.allocationCount;
+		total.freeBlockCount += page.freeBlockCount;
+	};
+
+	Stats stats{};
+	for (const auto& pPage : m_pages)
+	{
+		if (!pPage)
+			continue;
+
+		stats.pageCount++;
+		accumulate(stats.vertices, pPage->vertexAllocator.stats());
+		accumulate(stats.indices, pPage->indexAllocator.stats());
+	}
+
+	return stats;
+}
+
@@ -0,0 +1,116 @@
+#ifndef __MY_GEOMETRY_ARENA_H__
+#define __MY_GEOMETRY_ARENA_H__
+
+#include "my_device.h"
+#include "my_buffer.h"
+#include "my_free_list_allocator.h"
+
+// Std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//
+// Shared vertex and index buffers for every model of one vertex layout.
+// A model gets a range of vertices (the same range in each vertex stream)
+// and a range of the index buffer, and draws with vertexOffset/firstIndex,
+// so consecutive draws from the same page do not rebind anything and the
+// number of memory allocations does not grow with the number of models.
+// Pages of PAGE_VERTICES / PAGE_INDEX_BYTES are added when the free lists
+// run out; a larger mesh gets a page of its own size. The index buffer holds
+// 16 and 32 bit indices side by side, an index range is aligned to its index
+// size so firstIndex = offset / index size.
+// relocate() moves pages to new buffers for MyDefragmenter; allocations
+// point at their page's buffers, so the models draw from the new ones.
+// allocate() and free() may be called from any thread.
+//
+class MyGeometryArena
+{
+public:
+	static constexpr uint32_t     MAX_VERTEX_STREAMS = 3;
+	static constexpr uint32_t     PAGE_VERTICES = 256 * 1024;
+	static constexpr VkDeviceSize PAGE_INDEX_BYTES = 4 * 1024 * 1024;
+
+	// The buffers of a page, the handles change when the page is relocated.
+	// With unified memory the pages are host visible and the mapped pointers
+	// are set, uploads write through them (see MyUploadBatch::copyToBuffer)
+	struct Buffers
+	{
+		VkBuffer     vertexBuffers[MAX_VERTEX_STREAMS]{};
+		VkBuffer     indexBuffer = VK_NULL_HANDLE;
+		void*        pMappedVertexBuffers[MAX_VERTEX_STREAMS]{};
+		void*        pMappedIndexBuffer = nullptr;
+	};
+
+	struct Allocation
+	{
+		uint32_t     page = UINT32_MAX;
+		uint32_t     firstVertex = 0;
+		uint32_t     vertexCount = 0;
+		VkDeviceSize indexOffset = 0;  // bytes
+		VkDeviceSize indexSize = 0;    // bytes, 0 = no indices
+
+		// The page's buffers, so drawing does not need to look the page up
+		const Buffers* pBuffers = nullptr;
+	};
+
+	// Over all pages; vertices counts vertices, indices counts bytes
+	struct Stats
+	{
+		uint32_t                   pageCount = 0;
+		MyFreeListAllocator::Stats vertices;
+		MyFreeListAllocator::Stats indices;
+	};
+
+	// One vertex buffer per stride, i.e. per vertex binding of the layout
+	MyGeometryArena(MyDevice& device, const std::vector<uint32_t>& vertexStrides);
+
+	MyGeometryArena(const MyGeometryArena&) = delete;
+	MyGeometryArena& operator=(const MyGeometryArena&) = delete;
+
+	// indexAlignment is the index size
+	Allocation allocate(uint32_t vertexCount, VkDeviceSize indexSize, VkDeviceSize indexAlignment);
+
+	// The GPU must be done with the ranges, an empty page (except the first) is released
+	void free(const Allocation& allocation);
+
+	uint32_t     streamCount() const { return static_cast<uint32_t>(m_vertexStrides.size()); }
+	uint32_t     vertexStride(uint32_t stream) const { return m_vertexStrides[stream]; }
+
+	// Bytes per vertex over all streams
+	VkDeviceSize vertexSize() const;
+
+	Stats stats() const;
+
+	// Records copies of every page with a buffer in 'pBlock' into new buffers, until
+	// 'budget' bytes are copied. The old buffers go to 'retired', they must live until
+	// the GPU has executed 'commandBuffer'. Returns the bytes copied, 0 = none left
+	VkDeviceSize relocate(const MyMemoryAllocator::Block* pBlock, VkCommandBuffer commandBuffer, VkDeviceSize budget,
+		std::vector<std::unique_ptr<MyBuffer>>& retired);
+
+private:
+	struct Page
+	{
+		std::vector<std::unique_ptr<MyBuffer>> vertexBuffers;
+		std::unique_ptr<MyBuffer>              indexBuffer;
+		Buffers                                buffers;
+		MyFreeListAllocator                    vertexAllocator;
+		MyFreeListAllocator                    indexAllocator;
+
+		Page(uint32_t vertexCount, VkDeviceSize indexSize) : vertexAllocator{ vertexCount }, indexAllocator{ indexSize } {}
+	};
+
+	bool _allocate(uint32_t page, uint32_t vertexCount, VkDeviceSize indexSize, VkDeviceSize indexAlignment, Allocation& allocation);
+	std::unique_ptr<Page> _createPage(uint32_t vertexCount, VkDeviceSize indexSize);
+	std::unique_ptr<MyBuffer> _createVertexBuffer(uint32_t stride, uint32_t vertexCount);
+	std::unique_ptr<MyBuffer> _createIndexBuffer(VkDeviceSize indexSize);
+
+	MyDevice&                          m_myDevice;
+	std::vector<uint32_t>              m_vertexStrides;
+
+	mutable std::mutex                 m_mutex;
+	std::vector<std::unique_ptr<Page>> m_pages; // null = released, the slot is reused
+};
+
+#endif
+
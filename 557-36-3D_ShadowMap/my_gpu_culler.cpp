@@ -0,0 +1,230 @@
+#include "my_gpu_culler.h"
+#include "my_frame_info.h"
+
+// std
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+MyGpuCuller::MyGpuCuller(MyDevice& device, uint32_t frameCount)
+	: m_myDevice{ device }, m_frameCounts(frameCount)
+{
+	m_pSetLayout = MyDescriptorSetLayout::Builder(m_myDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.build();
+
+	_createPipelineLayout();
+	m_pPipeline = std::make_unique<MyComputePipeline>(m_myDevice, "shaders/cull_shader.comp.spv", m_vkPipelineLayout);
+}
+
+MyGpuCuller::~MyGpuCuller()
+{
+	m_pPipeline = nullptr;
+	vkDestroyPipelineLayout(m_myDevice.device(), m_vkPipelineLayout, nullptr);
+}
+
+void MyGpuCuller::_createPipelineLayout()
+{
+	VkDescriptorSetLayout setLayout = m_pSetLayout->descriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	if (vkCreatePipelineLayout(m_myDevice.device(), &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+}
+
+void MyGpuCuller::beginFrame(uint32_t frameIndex)
+{
+	// The frame's fence has signaled and its region is not reused yet, the counts are still there
+	FrameCounts& frameCounts = m_frameCounts[frameIndex];
+	m_stats.visibleCount = 0;
+	for (uint32_t i = 0; i < frameCounts.count; i++)
+		m_stats.visibleCount += frameCounts.pCounts[i];
+
+	frameCounts = FrameCounts{};
+}
+
+void MyGpuCuller::cull(const MyFrameInfo& frameInfo, uint32_t passMask, MyDescriptorAllocator& descriptors,
+	const MyMeshletCuller& view, const MyMeshletCuller& light)
+{
+	assert(frameInfo.pFrameAllocator && "The records and commands live in the frame allocator");
+	assert(m_myDevice.drawIndirectCount() && "Needs VK_KHR_draw_indirect_count");
+
+	MyFrameAllocator& frameAllocator = *frameInfo.pFrameAllocator;
+	const MyRenderQueue& renderQueue = frameInfo.renderQueue;
+
+	m_groups.clear();
+	m_iPassMask = passMask;
+	m_vkBuffer = frameAllocator.buffer();
+	m_stats.recordCount = 0;
+	m_stats.groupCount = 0;
+
+	// Groups: the batches of a pass that one indirect draw can take, commands numbered from 0 for now
+	uint32_t recordCount = 0;
+	m_groupBegin[0] = 0;
+	for (uint32_t p = 0; p < MyRenderQueue::PASS_COUNT; p++)
+	{
+		MyRenderQueue::Pass pass = static_cast<MyRenderQueue::Pass>(p);
+		if (culls(pass))
+		{
+			const MyModel* pLast = nullptr;
+			for (const auto& batch : renderQueue.batches(pass))
+			{
+				MyModel* pModel = renderQueue.object(batch.object).pModel;
+				if (!pLast || pModel->geometryPage() != pLast->geometryPage() ||
+					pModel->hasIndexBuffer() != pLast->hasIndexBuffer() || pModel->indexType() != pLast->indexType())
+				{
+					m_groups.push_back({ pModel, recordCount, 0, 0, &batch, &batch });
+				}
+
+				Group& group = m_groups.back();
+				group.maxCount += batch.instanceCount;
+				group.pBatchEnd = &batch + 1;
+				recordCount += batch.instanceCount;
+				pLast = pModel;
+			}
+		}
+		m_groupBegin[p + 1] = static_cast<uint32_t>(m_groups.size());
+	}
+
+	uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+	if (groupCount == 0)
+		return;
+
+	m_stats.recordCount = recordCount;
+	m_stats.groupCount = groupCount;
+
+	// All three arrays are indexed from the start of the buffer, the shader and the draws get element indices
+	MyFrameAllocator::Allocation counts = frameAllocator.allocateArray(groupCount, sizeof(uint32_t));
+	std::memset(counts.pData, 0, groupCount * sizeof(uint32_t));
+	uint32_t firstCount = counts.offset / sizeof(uint32_t);
+
+	MyFrameAllocator::Allocation commands = frameAllocator.allocateArray(recordCount, sizeof(VkDrawIndexedIndirectCommand));
+	uint32_t firstCommand = commands.offset / sizeof(VkDrawIndexedIndirectCommand);
+
+	MyFrameAllocator::Allocation records = frameAllocator.allocateArray(recordCount, sizeof(DrawRecord));
+	DrawRecord* pRecord = static_cast<DrawRecord*>(records.pData);
+
+	// A record per instance of every batch, the same draw arguments but its own transform
+	for (uint32_t g = 0; g < groupCount; g++)
+	{
+		Group& group = m_groups[g];
+		group.firstCommand += firstCommand;
+		group.countIndex = firstCount + g;
+
+		uint32_t flags = 0;
+		if (group.pModel->hasIndexBuffer())
+			flags |= FLAG_INDEXED;
+		if (g < m_groupBegin[MyRenderQueue::PASS_SHADOW + 1])
+			flags |= FLAG_LIGHT;
+
+		for (const MyRenderQueue::Batch* pBatch = group.pBatchBegin; pBatch != group.pBatchEnd; pBatch++)
+		{
+			const MyRenderQueue::Object& object = renderQueue.object(pBatch->object);
+			VkDrawIndexedIndirectCommand command = object.pModel->drawCommand(object.lod, pBatch->firstInstance);
+			glm::vec4 sphere = object.pModel->storedBoundingSphere();
+
+			for (uint32_t i = 0; i < pBatch->instanceCount; i++)
+			{
+				pRecord->sphere = sphere;
+				pRecord->count = command.indexCount;
+				pRecord->first = command.firstIndex;
+				pRecord->vertexOffset = command.vertexOffset;
+				pRecord->instance = pBatch->firstInstance + i;
+				pRecord->countIndex = group.countIndex;
+				pRecord->firstCommand = group.firstCommand;
+				pRecord->flags = flags;
+				pRecord->padding = 0;
+				pRecord++;
+			}
+		}
+	}
+
+	CullUniforms uniforms{};
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		uniforms.planes[i] = view.planes()[i];
+		uniforms.planes[6 + i] = light.planes()[i];
+	}
+	uniforms.firstRecord = records.offset / sizeof(DrawRecord);
+	uniforms.recordCount = recordCount;
+	uint32_t uniformOffset = frameAllocator.pushUniform(uniforms);
+
+	// Same buffer and ranges every frame, so the set comes from the cache
+	VkDescriptorBufferInfo uniformInfo = frameAllocator.descriptorInfo(sizeof(CullUniforms));
+	VkDescriptorBufferInfo storageInfo = frameAllocator.descriptorInfo(VK_WHOLE_SIZE);
+	VkDescriptorSet descriptorSet = MyDescriptorWriter(*m_pSetLayout, descriptors)
+		.writeBuffer(0, &uniformInfo)
+		.writeBuffer(1, &storageInfo)
+		.writeBuffer(2, &storageInfo)
+		.writeBuffer(3, &storageInfo)
+		.writeBuffer(4, &storageInfo)
+		.buildCached();
+
+	m_pPipeline->bind(frameInfo.commandBuffer);
+	vkCmdBindDescriptorSets(
+		frameInfo.commandBuffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		m_vkPipelineLayout,
+		0,
+		1,
+		&descriptorSet,
+		1,
+		&uniformOffset);
+	vkCmdDispatch(frameInfo.commandBuffer, (recordCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+	// The commands and counts are complete before the draws read them
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(
+		frameInfo.commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+
+	m_frameCounts[frameInfo.frameIndex] = { static_cast<const uint32_t*>(counts.pData), groupCount };
+}
+
+MyRenderQueue::Range<MyGpuCuller::Group> MyGpuCuller::groups(MyRenderQueue::Pass pass, uint32_t shareIndex, uint32_t shareCount) const
+{
+	uint64_t begin = m_groupBegin[pass];
+	uint64_t size = m_groupBegin[pass + 1] - begin;
+	const Group* pGroups = m_groups.data();
+
+	return MyRenderQueue::Range<Group>{
+		pGroups + begin + size * shareIndex / shareCount,
+		pGroups + begin + size * (shareIndex + 1) / shareCount };
+}
+
+void MyGpuCuller::draw(VkCommandBuffer commandBuffer, const Group& group, MyModel::BindState* pBindState) const
+{
+	// Every command of a multi-draw is its own draw, a texture per instance is still uniform
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	group.pModel->bind(commandBuffer, pBindState);
+	if (group.pModel->hasIndexBuffer())
+	{
+		m_myDevice.cmdDrawIndexedIndirectCount(commandBuffer, m_vkBuffer, VkDeviceSize{ group.firstCommand } * stride,
+			m_vkBuffer, VkDeviceSize{ group.countIndex } * sizeof(uint32_t), group.maxCount, stride);
+	}
+	else
+	{
+		m_myDevice.cmdDrawIndirectCount(commandBuffer, m_vkBuffer, VkDeviceSize{ group.firstCommand } * stride,
+			m_vkBuffer, VkDeviceSize{ group.countIndex } * sizeof(uint32_t), group.maxCount, stride);
+	}
+}
@@ -0,0 +1,133 @@
+#ifndef __MY_GPU_CULLER_H__
+#define __MY_GPU_CULLER_H__
+
+#include "my_compute_pipeline.h"
+#include "my_descriptors.h"
+#include "my_device.h"
+#include "my_meshlet_culler.h"
+#include "my_model.h"
+#include "my_render_queue.h"
+
+// libs
+#include <glm/glm.hpp>
+
+// Std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct MyFrameInfo;
+
+//
+// GPU-driven draws: frustum culling of MyRenderQueue's draws in a compute
+// shader, which writes the visible ones as compacted indirect commands, so a
+// pass costs the CPU one vkCmdDrawIndexedIndirectCount per group instead of a
+// draw per batch. A group is the draws of a pass in one geometry arena page
+// with one index type, the buffers an indirect draw can use.
+//
+// Everything lives in the frame allocator's buffer: the transforms are the
+// render queue's instances, cull() adds a record per draw (model space bounds
+// and draw arguments), the command slots and a zeroed count per group. The
+// render queue is built without CPU culling; the shadow pass is culled
+// against the light frustum, the other passes against the camera's.
+// Meshlets are not culled, a draw is its whole LOD.
+//
+// Needs MyDevice::drawIndirectCount().
+//
+class MyGpuCuller
+{
+public:
+	struct Group
+	{
+		MyModel*                   pModel;        // of the first draw, binds the page's buffers
+		uint32_t                   firstCommand;  // in the frame allocator's buffer, in commands
+		uint32_t                   maxCount;      // draws before culling
+		uint32_t                   countIndex;    // in the frame allocator's buffer, in uint32_t
+		const MyRenderQueue::Batch* pBatchBegin;  // the render queue's batches of the group
+		const MyRenderQueue::Batch* pBatchEnd;
+	};
+
+	struct Stats
+	{
+		uint32_t recordCount = 0;   // draws culled on the GPU in the last cull()
+		uint32_t groupCount = 0;    // indirect draws
+		uint32_t visibleCount = 0;  // draws the GPU kept, from the frame's previous use
+	};
+
+	MyGpuCuller(MyDevice& device, uint32_t frameCount);
+	~MyGpuCuller();
+
+	MyGpuCuller(const MyGpuCuller&) = delete;
+	MyGpuCuller& operator=(const MyGpuCuller&) = delete;
+
+	// Right after MyFrameAllocator::beginFrame, before anything else is allocated:
+	// reads the counts the GPU wrote the last time the frame was used
+	void beginFrame(uint32_t frameIndex);
+
+	// Records the culling of the draws in 'passMask' of frameInfo.renderQueue on
+	// frameInfo.commandBuffer, outside a render pass; the draws wait for it.
+	// 'view' and 'light' give the frustums
+	void cull(const MyFrameInfo& frameInfo, uint32_t passMask, MyDescriptorAllocator& descriptors,
+		const MyMeshletCuller& view, const MyMeshletCuller& light);
+
+	bool culls(MyRenderQueue::Pass pass) const { return (m_iPassMask & MyRenderQueue::passBit(pass)) != 0; }
+
+	// The groups of 'pass', or share 'shareIndex' of 'shareCount' of them for parallel recording
+	MyRenderQueue::Range<Group> groups(MyRenderQueue::Pass pass, uint32_t shareIndex = 0, uint32_t shareCount = 1) const;
+
+	// Binds the group's buffers (skipped as in MyModel::bind) and draws its visible draws
+	void draw(VkCommandBuffer commandBuffer, const Group& group, MyModel::BindState* pBindState) const;
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+	static constexpr uint32_t GROUP_SIZE = 64;  // local_size_x of cull_shader.comp
+
+	// std430 layout of DrawRecord in cull_shader.comp
+	struct DrawRecord
+	{
+		glm::vec4 sphere;
+		uint32_t  count;
+		uint32_t  first;
+		int32_t   vertexOffset;
+		uint32_t  instance;
+		uint32_t  countIndex;
+		uint32_t  firstCommand;
+		uint32_t  flags;
+		uint32_t  padding;
+	};
+	static_assert(sizeof(DrawRecord) == 48, "DrawRecord must match the std430 layout of the shader");
+
+	static constexpr uint32_t FLAG_INDEXED = 1;
+	static constexpr uint32_t FLAG_LIGHT = 2;
+
+	// std140 layout of CullUBO in cull_shader.comp
+	struct CullUniforms
+	{
+		glm::vec4 planes[12];
+		uint32_t  firstRecord;
+		uint32_t  recordCount;
+	};
+
+	struct FrameCounts
+	{
+		const uint32_t* pCounts = nullptr;
+		uint32_t        count = 0;
+	};
+
+	void _createPipelineLayout();
+
+	MyDevice&                              m_myDevice;
+	std::unique_ptr<MyDescriptorSetLayout> m_pSetLayout;
+	VkPipelineLayout                       m_vkPipelineLayout = VK_NULL_HANDLE;
+	std::unique_ptr<MyComputePipeline>     m_pPipeline;
+
+	std::vector<Group>       m_groups;
+	uint32_t                 m_groupBegin[MyRenderQueue::PASS_COUNT + 1] = {};
+	uint32_t                 m_iPassMask = 0;
+	VkBuffer                 m_vkBuffer = VK_NULL_HANDLE;  // the frame allocator's
+	std::vector<FrameCounts> m_frameCounts;
+	Stats                    m_stats;
+};
+
+#endif
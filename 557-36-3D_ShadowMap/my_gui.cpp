@@ -1,5 +1,6 @@
 #include "my_gui.h"
 #include "imgui/imgui_internal.h"
+#include <algorithm>
 #include <chrono>
 #include <stdexcept>
 
@@ -138,9 +139,96 @@ void MyGUI::_guiLayout(MyGUIData& data)
 
 	ImGui::Checkbox("Pick Mode", &data.bPickMode);
 	ImGui::SameLine();
-	ImGui::Text("-- Picked object = %s", data.sPickObject.c_str());
+	ImGui::Text("-- Picked object = %s", data.sPickObject);
 	ImGui::Spacing();
 
 	ImGui::Checkbox("Show Shadow Map Debug", &data.bShowDebug);
+	ImGui::Text("Shadow pass (GPU): %.3f ms", data.fShadowPassTime);
+	ImGui::SliderFloat("LOD pixel error", &data.fLodPixelError, 0.0f, 8.0f); // 0 = full detail
+	ImGui::Text("Triangles: %u", data.iTriangleCount);
+	ImGui::Checkbox("Parallel recording", &data.bParallelRecording);
+	ImGui::SameLine();
+	ImGui::Text("(%u thread(s))", data.iRecordingThreads);
+
+	// State changes the sorted order saves over drawing in object order
+	const MyRenderQueue::Stats& queue = data.renderQueueStats;
+	ImGui::Text("Render queue: %u draw(s) of %u object(s), %u culled", queue.drawCount, queue.objectCount, queue.culledCount);
+	ImGui::Checkbox("Frustum culling", &data.bFrustumCulling);
+	ImGui::SameLine();
+	ImGui::Text("-- view %u visible/%u culled, light %u/%u", queue.viewTested - queue.viewCulled, queue.viewCulled,
+		queue.shadowTested - queue.shadowCulled, queue.shadowCulled);
+	ImGui::Text("-- buffer binds %u (%d avoided), model changes %u (%d avoided)",
+		queue.bufferBinds, static_cast<int>(queue.unsortedBufferBinds) - static_cast<int>(queue.bufferBinds),
+		queue.modelChanges, static_cast<int>(queue.unsortedModelChanges) - static_cast<int>(queue.modelChanges));
+	ImGui::Checkbox("Instancing", &data.bInstancing);
+	ImGui::SameLine();
+	ImGui::Text("-- %u draw call(s)", queue.batchCount);
+	if (data.bGpuCullingSupported)
+	{
+		ImGui::Checkbox("GPU culling", &data.bGpuCulling);
+		ImGui::SameLine();
+		ImGui::Text("-- %u/%u draw(s) visible, %u indirect draw(s)",
+			data.gpuCullStats.visibleCount, data.gpuCullStats.recordCount, data.gpuCullStats.groupCount);
+	}
+	ImGui::Text("Heap allocations/frame: %u (%llu bytes), frame arena %.1f KB", data.iFrameAllocations,
+		static_cast<unsigned long long>(data.iFrameAllocatedBytes), data.iFrameArenaBytes / 1024.0f);
+
+	ImGui::Checkbox("Meshlet culling", &data.bMeshletCulling);
+	ImGui::SameLine();
+	ImGui::Checkbox("Backface", &data.bMeshletBackfaceCulling);
+	ImGui::Text("Clusters culled (view): %u/%u (frustum %u, backface %u)",
+		data.viewCullStats.frustumCulled + data.viewCullStats.backfaceCulled, data.viewCullStats.meshletCount,
+		data.viewCullStats.frustumCulled, data.viewCullStats.backfaceCulled);
+	ImGui::Text("Clusters culled (shadow): %u/%u",
+		data.shadowCullStats.frustumCulled, data.shadowCullStats.meshletCount);
+	ImGui::Spacing();
+
+	const MyGeometryArena::Stats& geometry = data.geometryStats;
+	ImGui::Text("Geometry arena: %u page(s), %u model(s)", geometry.pageCount, geometry.vertices.allocationCount);
+	ImGui::Text("-- vertices %.1f/%.1f K, %u free block(s), fragmentation %.0f%%",
+		geometry.vertices.used / 1024.0f, geometry.vertices.size / 1024.0f,
+		geometry.vertices.freeBlockCount, geometry.vertices.fragmentation() * 100.0f);
+	ImGui::Text("-- indices %.1f/%.1f KB, %u free block(s), fragmentation %.0f%%",
+		geometry.indices.used / 1024.0f, geometry.indices.size / 1024.0f,
+		geometry.indices.freeBlockCount, geometry.indices.fragmentation() * 100.0f);
+	ImGui::Spacing();
+
+	const MyMemoryAllocator::Stats& memory = data.memoryStats;
+	ImGui::Text("Device memory: %u block(s), %u allocation(s)", memory.blockCount, memory.allocationCount);
+	ImGui::Text("-- used %.1f/%.1f MB, free %.1f MB, fragmentation %.0f%%",
+		memory.usedBytes / 1048576.0f, memory.blockBytes / 1048576.0f,
+		(memory.blockBytes - memory.usedBytes) / 1048576.0f, memory.fragmentation() * 100.0f);
+	ImGui::Text("-- dedicated %u, %.1f MB", memory.dedicatedCount, memory.dedicatedBytes / 1048576.0f);
+
+	const MyDescriptorAllocator::Stats& descriptors = data.descriptorStats;
+	ImGui::Text("Descriptor pools: %u + %u transient, %llu set(s) allocated", descriptors.poolCount, descriptors.transientPoolCount,
+		static_cast<unsigned long long>(descriptors.allocationCount));
+	ImGui::Text("-- cache %u set(s), %llu hit(s), %llu miss(es)", descriptors.cachedSetCount,
+		static_cast<unsigned long long>(descriptors.cacheHits), static_cast<unsigned long long>(descriptors.cacheMisses));
+
+	ImGui::Checkbox("Defragment", &data.bDefragment);
+	ImGui::SameLine();
+	ImGui::Text("%llu move(s), %.1f MB, %u block(s) evacuated", static_cast<unsigned long long>(data.defragStats.moveCount),
+		data.defragStats.movedBytes / 1048576.0f, data.defragStats.evacuatedBlocks);
+	ImGui::Spacing();
+
+	if (ImGui::CollapsingHeader("Memory budget"))
+	{
+		ImGui::Text("Budget from %s", data.bDriverBudget ? "VK_EXT_memory_budget" : "80%% of the heap size (no VK_EXT_memory_budget)");
+		for (size_t i = 0; i < data.heapBudgets.size(); i++)
+		{
+			const MyMemoryAllocator::HeapBudget& heap = data.heapBudgets[i];
+			float usage = heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f;
+			ImGui::Text("Heap %u%s: %.1f/%.1f MB (heap %.0f MB), ours %.1f MB", static_cast<uint32_t>(i), heap.bDeviceLocal ? " (device local)" : "",
+				heap.usage / 1048576.0f, heap.budget / 1048576.0f, heap.size / 1048576.0f, heap.allocated / 1048576.0f);
+			ImGui::ProgressBar(std::min(usage, 1.0f), ImVec2(-1.0f, 0.0f));
+		}
+
+		const char* categoryNames[MyMemoryAllocator::CATEGORY_COUNT] = { "Geometry", "Textures", "Render targets", "Uniform", "Staging", "Other" };
+		for (int i = 0; i < MyMemoryAllocator::CATEGORY_COUNT; i++)
+		{
+			ImGui::Text("-- %s: %.1f MB", categoryNames[i], memory.categoryBytes[i] / 1048576.0f);
+		}
+	}
 }
 
@@ -3,6 +3,12 @@
 
 #include "my_device.h"
 #include "my_renderer.h"
+#include "my_meshlet_culler.h"
+#include "my_geometry_arena.h"
+#include "my_defragmenter.h"
+#include "my_descriptors.h"
+#include "my_render_queue.h"
+#include "my_gpu_culler.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_vulkan.h"
@@ -16,7 +22,32 @@ struct MyGUIData
 	bool   bShowDebug;
 	float  fMoveValues[3];
 	ImVec4 vColor;
-	std::string sPickObject;
+	const char* sPickObject;  // a literal, so picking does not allocate
+	float  fShadowPassTime;
+	float  fLodPixelError;
+	uint32_t iTriangleCount;
+	bool   bFrustumCulling;          // objects outside the camera or light frustum are not drawn, see MyBoundsCuller
+	bool   bMeshletCulling;
+	bool   bMeshletBackfaceCulling;
+	MyMeshletCuller::Stats viewCullStats;
+	MyMeshletCuller::Stats shadowCullStats;
+	MyGeometryArena::Stats geometryStats;
+	MyMemoryAllocator::Stats memoryStats;
+	std::vector<MyMemoryAllocator::HeapBudget> heapBudgets;
+	bool   bDriverBudget;
+	bool   bDefragment;
+	MyDefragmenter::Stats defragStats;
+	uint32_t iFrameAllocations;      // operator new calls of the render thread in the last frame
+	uint64_t iFrameAllocatedBytes;
+	size_t   iFrameArenaBytes;       // MyFrameArena use in the last frame
+	MyDescriptorAllocator::Stats descriptorStats;
+	bool     bParallelRecording;     // shadow and main pass objects in secondary buffers, see MyParallelRecorder
+	uint32_t iRecordingThreads;
+	MyRenderQueue::Stats renderQueueStats;
+	bool     bInstancing;            // one draw call per batch of same model objects, see MyRenderQueue
+	bool     bGpuCullingSupported;   // MyDevice::drawIndirectCount()
+	bool     bGpuCulling;            // frustum culling and indirect draws on the GPU, see MyGpuCuller
+	MyGpuCuller::Stats gpuCullStats;
 	
 	void init()
 	{
@@ -29,6 +60,31 @@ struct MyGUIData
 		fMoveValues[2] = 0.5f;
 		vColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 		sPickObject = "None";
+		fShadowPassTime = 0.0f;
+		fLodPixelError = 1.0f;
+		iTriangleCount = 0;
+		bFrustumCulling = true;
+		bMeshletCulling = true;
+		bMeshletBackfaceCulling = false; // the pipelines draw back faces, open meshes would lose them
+		viewCullStats = {};
+		shadowCullStats = {};
+		geometryStats = {};
+		memoryStats = {};
+		heapBudgets.clear();
+		bDriverBudget = false;
+		bDefragment = true;
+		defragStats = {};
+		iFrameAllocations = 0;
+		iFrameAllocatedBytes = 0;
+		iFrameArenaBytes = 0;
+		descriptorStats = {};
+		bParallelRecording = true;
+		iRecordingThreads = 1;
+		renderQueueStats = {};
+		bInstancing = true;
+		bGpuCullingSupported = false;
+		bGpuCulling = false;
+		gpuCullStats = {};
 	}
 };
 
@@ -0,0 +1,82 @@
+#include "my_heap_stats.h"
+
+// std
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	// Constant initialized, safe to use before main and in any thread
+	thread_local uint64_t t_iAllocations = 0;
+	thread_local uint64_t t_iAllocatedBytes = 0;
+
+	void* countedAlloc(std::size_t size)
+	{
+		t_iAllocations++;
+		t_iAllocatedBytes += size;
+		return std::malloc(size > 0 ? size : 1);
+	}
+}
+
+uint64_t MyHeapStats::threadAllocations()
+{
+	return t_iAllocations;
+}
+
+uint64_t MyHeapStats::threadAllocatedBytes()
+{
+	return t_iAllocatedBytes;
+}
+
+// The replaceable forms without an alignment argument
+void* operator new(std::size_t size)
+{
+	if (void* p = countedAlloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
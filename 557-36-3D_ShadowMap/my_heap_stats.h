@@ -0,0 +1,22 @@
+#ifndef __MY_HEAP_STATS_H__
+#define __MY_HEAP_STATS_H__
+
+// Std
+#include <cstdint>
+
+//
+// Counts the calls of the global operator new, which my_heap_stats.cpp
+// replaces. The counts are per thread, so the frame loop can compare them
+// before and after a frame while the loader threads allocate as they like.
+// Only the C++ allocations are seen: ImGui, stb_image and the driver call
+// malloc directly, and so does the aligned operator new of some libraries.
+//
+class MyHeapStats
+{
+public:
+	// Since the calling thread started
+	static uint64_t threadAllocations();
+	static uint64_t threadAllocatedBytes();
+};
+
+#endif
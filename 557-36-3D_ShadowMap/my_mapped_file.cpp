@@ -0,0 +1,74 @@
+#include "my_mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MyMappedFile::MyMappedFile(const std::string& filepath)
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(hFile);
+	if (hMapping == nullptr)
+		return;
+
+	// Note: the view keeps the mapping alive after the handle is closed
+	m_pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (m_pData != nullptr)
+		m_iSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fd = ::open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return;
+	}
+
+	void* pData = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (pData == MAP_FAILED)
+		return;
+
+	m_pData = pData;
+	m_iSize = static_cast<size_t>(st.st_size);
+#endif
+}
+
+MyMappedFile::~MyMappedFile()
+{
+	if (m_pData == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_pData);
+#else
+	munmap(m_pData, m_iSize);
+#endif
+}
+
@@ -0,0 +1,34 @@
+#ifndef __MY_MAPPED_FILE_H__
+#define __MY_MAPPED_FILE_H__
+
+// Std
+#include <cstddef>
+#include <string>
+
+//
+// Read-only memory mapping of a whole file (mmap on Linux/macOS,
+// MapViewOfFile on Windows). A missing or empty file leaves the
+// object closed rather than throwing, callers check isOpen().
+//
+class MyMappedFile
+{
+public:
+	MyMappedFile(const std::string& filepath);
+	~MyMappedFile();
+
+	MyMappedFile(const MyMappedFile&) = delete;
+	MyMappedFile& operator=(const MyMappedFile&) = delete;
+	MyMappedFile(MyMappedFile&&) = delete;
+	MyMappedFile& operator=(MyMappedFile&&) = delete;
+
+	bool        isOpen() const { return m_pData != nullptr; }
+	const char* data() const   { return static_cast<const char*>(m_pData); }
+	size_t      size() const   { return m_iSize; }
+
+private:
+	void*  m_pData = nullptr;
+	size_t m_iSize = 0;
+};
+
+#endif
+
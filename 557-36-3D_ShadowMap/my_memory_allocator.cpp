@@ -0,0 +1,369 @@
+#include "my_memory_allocator.h"
+
+// Std
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+MyMemoryAllocator::MyMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool bMemoryBudget) :
+	m_vkPhysicalDevice{ physicalDevice },
+	m_vkDevice{ device },
+	m_bMemoryBudget{ bMemoryBudget }
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_vkMemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_vkBufferImageGranularity = properties.limits.bufferImageGranularity;
+	m_vkNonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+
+	// Blocks are created on first use; a small heap (e.g. the 256 MB BAR heap) gets smaller blocks
+	m_pools.resize(m_vkMemoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < m_pools.size(); i++)
+	{
+		uint32_t memoryType = i / 2;
+		VkDeviceSize heapSize = m_vkMemoryProperties.memoryHeaps[m_vkMemoryProperties.memoryTypes[memoryType].heapIndex].size;
+		m_pools[i].memoryType = memoryType;
+		m_pools[i].blockSize = std::min(BLOCK_SIZE, heapSize / 8);
+	}
+
+	updateBudget();
+}
+
+MyMemoryAllocator::~MyMemoryAllocator()
+{
+	uint32_t leakCount = m_iDedicatedCount;
+	for (auto& pool : m_pools)
+	{
+		for (auto& pBlock : pool.blocks)
+		{
+			leakCount += pBlock->allocator.stats().allocationCount;
+			_freeMemory(pBlock->memory, pBlock->pMapped);
+		}
+	}
+
+	if (leakCount > 0)
+	{
+		std::cerr << "Warning: " << leakCount << " device memory allocation(s) were not freed" << std::endl;
+	}
+}
+
+bool MyMemoryAllocator::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_vkMemoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) &&
+			(m_vkMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t MyMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_vkMemoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) &&
+			(m_vkMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceMemory MyMemoryAllocator::_allocateMemory(VkDeviceSize size, uint32_t memoryType, const void* pNext, void*& pMapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = pNext;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	// Mapped for good, a memory object can only be mapped once
+	pMapped = nullptr;
+	if (m_vkMemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(m_vkDevice, memory, 0, VK_WHOLE_SIZE, 0, &pMapped) != VK_SUCCESS)
+		{
+			vkFreeMemory(m_vkDevice, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	return memory;
+}
+
+void MyMemoryAllocator::_freeMemory(VkDeviceMemory memory, void* pMapped)
+{
+	if (pMapped)
+		vkUnmapMemory(m_vkDevice, memory);
+	vkFreeMemory(m_vkDevice, memory, nullptr);
+}
+
+MyMemoryAllocator::Allocation MyMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind, Category category)
+{
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+	// Linear and optimal resources only need pools of their own when they could share a granularity page
+	uint32_t poolIndex = memoryType * 2 + (m_vkBufferImageGranularity > 1 && kind == RESOURCE_OPTIMAL ? 1 : 0);
+	Pool& pool = m_pools[poolIndex];
+
+	if (requirements.size > DEDICATED_THRESHOLD || requirements.size > pool.blockSize / 2)
+		return allocateDedicated(requirements, properties, category);
+
+	// Flushes of non-coherent memory work on whole atoms, an allocation must not share one
+	VkDeviceSize size = requirements.size;
+	VkDeviceSize alignment = requirements.alignment;
+	VkMemoryPropertyFlags flags = m_vkMemoryProperties.memoryTypes[memoryType].propertyFlags;
+	if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		alignment = std::max(alignment, m_vkNonCoherentAtomSize);
+		size = (size + m_vkNonCoherentAtomSize - 1) / m_vkNonCoherentAtomSize * m_vkNonCoherentAtomSize;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		Allocation allocation{};
+		allocation.size = size;
+		allocation.pool = poolIndex;
+		allocation.memoryType = memoryType;
+		allocation.category = category;
+
+		auto place = [&](Block* pBlock)
+		{
+			if (!pBlock->allocator.allocate(size, alignment, allocation.offset, allocation.handle))
+				return false;
+
+			allocation.memory = pBlock->memory;
+			allocation.pBlock = pBlock;
+			allocation.pMapped = pBlock->pMapped ? static_cast<char*>(pBlock->pMapped) + allocation.offset : nullptr;
+			m_categoryBytes[category] += size;
+			return true;
+		};
+
+		for (auto& pBlock : pool.blocks)
+		{
+			if (pBlock.get() != m_pEvacuatingBlock && place(pBlock.get()))
+				return allocation;
+		}
+
+		void* pMapped;
+		VkDeviceMemory memory = _allocateMemory(pool.blockSize, memoryType, nullptr, pMapped);
+		if (memory != VK_NULL_HANDLE)
+		{
+			pool.blocks.push_back(std::make_unique<Block>(memory, pMapped, pool.blockSize));
+			m_heapAllocated[_heap(memoryType)] += pool.blockSize;
+			place(pool.blocks.back().get());
+			return allocation;
+		}
+	}
+
+	// No room for another block, the resource may still fit on its own
+	std::cerr << "Warning: failed to allocate a " << pool.blockSize << " byte memory block, trying a dedicated allocation" << std::endl;
+	return allocateDedicated(requirements, properties, category);
+}
+
+MyMemoryAllocator::Allocation MyMemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	Category category, VkImage image, VkBuffer buffer)
+{
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	dedicatedInfo.buffer = buffer;
+	bool bDedicatedInfo = image != VK_NULL_HANDLE || buffer != VK_NULL_HANDLE;
+
+	Allocation allocation{};
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.category = category;
+	allocation.memory = _allocateMemory(requirements.size, memoryType, bDedicatedInfo ? &dedicatedInfo : nullptr, allocation.pMapped);
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_iDedicatedCount++;
+	m_vkDedicatedBytes += allocation.size;
+	m_heapAllocated[_heap(memoryType)] += allocation.size;
+	m_categoryBytes[category] += allocation.size;
+	return allocation;
+}
+
+void MyMemoryAllocator::free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	if (!allocation.pBlock)
+	{
+		_freeMemory(allocation.memory, allocation.pMapped);
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_iDedicatedCount--;
+		m_vkDedicatedBytes -= allocation.size;
+		m_heapAllocated[_heap(allocation.memoryType)] -= allocation.size;
+		m_categoryBytes[allocation.category] -= allocation.size;
+		allocation = Allocation{};
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	Block* pBlock = allocation.pBlock;
+	pBlock->allocator.free(allocation.handle);
+	m_categoryBytes[allocation.category] -= allocation.size;
+
+	// Keep one block per pool around, so a pool that is used at all does not
+	// allocate and free a block over and over
+	Pool& pool = m_pools[allocation.pool];
+	if (pBlock->allocator.empty() && pool.blocks.size() > 1)
+	{
+		auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [pBlock](const auto& pOther) { return pOther.get() == pBlock; });
+		_freeMemory(pBlock->memory, pBlock->pMapped);
+		pool.blocks.erase(it);
+		m_heapAllocated[_heap(pool.memoryType)] -= pool.blockSize;
+
+		// A new block may get the same address
+		if (m_pEvacuatingBlock == pBlock)
+			m_pEvacuatingBlock = nullptr;
+	}
+
+	allocation = Allocation{};
+}
+
+MyMemoryAllocator::Stats MyMemoryAllocator::stats() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	Stats stats{};
+	stats.dedicatedCount = m_iDedicatedCount;
+	stats.dedicatedBytes = m_vkDedicatedBytes;
+	std::copy(std::begin(m_categoryBytes), std::end(m_categoryBytes), stats.categoryBytes);
+	for (const auto& pool : m_pools)
+	{
+		for (const auto& pBlock : pool.blocks)
+		{
+			MyTlsfAllocator::Stats blockStats = pBlock->allocator.stats();
+			stats.blockCount++;
+			stats.allocationCount += blockStats.allocationCount;
+			stats.blockBytes += blockStats.size;
+			stats.usedBytes += blockStats.used;
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, blockStats.largestFreeBlock);
+			stats.scatteredBytes += blockStats.size - blockStats.used - blockStats.largestFreeBlock;
+		}
+	}
+	return stats;
+}
+
+const MyMemoryAllocator::Block* MyMemoryAllocator::sparsestBlock(float maxUsage, const std::vector<const Block*>& skip) const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	const Block* pSparsest = nullptr;
+	float sparsestUsage = maxUsage;
+	for (const auto& pool : m_pools)
+	{
+		if (pool.blocks.size() < 2)
+			continue;
+
+		VkDeviceSize poolFree = 0;
+		for (const auto& pBlock : pool.blocks)
+		{
+			MyTlsfAllocator::Stats blockStats = pBlock->allocator.stats();
+			poolFree += blockStats.size - blockStats.used;
+		}
+
+		for (const auto& pBlock : pool.blocks)
+		{
+			if (std::find(skip.begin(), skip.end(), pBlock.get()) != skip.end())
+				continue;
+
+			MyTlsfAllocator::Stats blockStats = pBlock->allocator.stats();
+			float usage = static_cast<float>(blockStats.used) / static_cast<float>(blockStats.size);
+
+			// Moving it out must not need a new block
+			VkDeviceSize otherFree = poolFree - (blockStats.size - blockStats.used);
+			if (usage < sparsestUsage && blockStats.used <= otherFree)
+			{
+				pSparsest = pBlock.get();
+				sparsestUsage = usage;
+			}
+		}
+	}
+	return pSparsest;
+}
+
+void MyMemoryAllocator::setEvacuating(const Block* pBlock)
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	m_pEvacuatingBlock = pBlock;
+}
+
+const MyMemoryAllocator::Block* MyMemoryAllocator::evacuatingBlock() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_pEvacuatingBlock;
+}
+
+void MyMemoryAllocator::updateBudget()
+{
+	if (!m_bMemoryBudget)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(m_vkPhysicalDevice, &memoryProperties);
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	for (uint32_t i = 0; i < m_vkMemoryProperties.memoryHeapCount; i++)
+	{
+		m_driverHeapUsage[i] = budgetProperties.heapUsage[i];
+		m_driverHeapBudget[i] = budgetProperties.heapBudget[i];
+		m_heapAllocatedAtUpdate[i] = m_heapAllocated[i];
+	}
+}
+
+MyMemoryAllocator::HeapBudget MyMemoryAllocator::heapBudget(uint32_t heap) const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	HeapBudget budget{};
+	budget.size = m_vkMemoryProperties.memoryHeaps[heap].size;
+	budget.allocated = m_heapAllocated[heap];
+	budget.bDeviceLocal = (m_vkMemoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+	if (m_bMemoryBudget)
+	{
+		// The driver's numbers plus what this allocator did since
+		budget.budget = m_driverHeapBudget[heap];
+		budget.usage = m_driverHeapUsage[heap] + budget.allocated;
+		budget.usage = budget.usage > m_heapAllocatedAtUpdate[heap] ? budget.usage - m_heapAllocatedAtUpdate[heap] : 0;
+	}
+	else
+	{
+		budget.budget = budget.size / 10 * 8;
+		budget.usage = budget.allocated;
+	}
+	return budget;
+}
+
+VkDeviceSize MyMemoryAllocator::remainingBudget(VkMemoryPropertyFlags properties) const
+{
+	return heapBudget(_heap(findMemoryType(UINT32_MAX, properties))).remaining();
+}
@@ -0,0 +1,185 @@
+#ifndef __MY_MEMORY_ALLOCATOR_H__
+#define __MY_MEMORY_ALLOCATOR_H__
+
+#include "my_tlsf_allocator.h"
+
+// Std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//
+// Suballocates buffers and images from large VkDeviceMemory blocks instead of
+// calling vkAllocateMemory per resource, which is slow and limited to
+// maxMemoryAllocationCount allocations. Every memory type has its own pool of
+// BLOCK_SIZE blocks (smaller on small heaps), each block hands out ranges with
+// a MyTlsfAllocator. Host visible blocks are mapped once for their lifetime.
+// If the device has a bufferImageGranularity above 1, linear resources
+// (buffers) and optimal tiling images go to separate pools, so they never
+// share a granularity page. Resources above DEDICATED_THRESHOLD, or that the
+// driver wants dedicated, get a VkDeviceMemory of their own.
+// A pool only shrinks when a block becomes empty; MyDefragmenter empties
+// sparse blocks by moving their resources into the other blocks.
+// Keeps the bytes allocated per heap and used per category, and with
+// VK_EXT_memory_budget the driver's usage and budget of every heap.
+// Thread safe.
+//
+class MyMemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+	static constexpr VkDeviceSize DEDICATED_THRESHOLD = BLOCK_SIZE / 2;
+
+	enum ResourceKind
+	{
+		RESOURCE_LINEAR,  // buffers and linear tiling images
+		RESOURCE_OPTIMAL  // optimal tiling images
+	};
+
+	// What the memory is for, only used for the statistics
+	enum Category
+	{
+		CATEGORY_GEOMETRY,      // vertex and index buffers
+		CATEGORY_TEXTURE,       // sampled images
+		CATEGORY_RENDER_TARGET, // attachments
+		CATEGORY_UNIFORM,       // uniform buffers
+		CATEGORY_STAGING,       // upload staging
+		CATEGORY_OTHER,
+		CATEGORY_COUNT
+	};
+
+	// One VkDeviceMemory of a pool
+	struct Block
+	{
+		VkDeviceMemory  memory;
+		void*           pMapped;
+		MyTlsfAllocator allocator;
+
+		Block(VkDeviceMemory memory, void* pMapped, VkDeviceSize size) : memory{ memory }, pMapped{ pMapped }, allocator{ size } {}
+	};
+
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize   offset = 0;
+		VkDeviceSize   size = 0;
+		void*          pMapped = nullptr;  // at 'offset', null unless host visible
+		Block*         pBlock = nullptr;   // null = dedicated
+		uint32_t       pool = 0;
+		uint32_t       handle = MyTlsfAllocator::INVALID_HANDLE;
+		uint32_t       memoryType = 0;
+		Category       category = CATEGORY_OTHER;
+	};
+
+	struct Stats
+	{
+		uint32_t     blockCount = 0;
+		uint32_t     dedicatedCount = 0;
+		uint32_t     allocationCount = 0;     // in blocks, without the dedicated ones
+		VkDeviceSize blockBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		VkDeviceSize largestFreeBlock = 0;       // of any block
+		VkDeviceSize scatteredBytes = 0;         // free bytes outside the largest free block of their block
+		VkDeviceSize categoryBytes[CATEGORY_COUNT] = {}; // used, in blocks and dedicated
+
+		// 0 = the free space of every block in one piece, towards 1 = scattered
+		float fragmentation() const
+		{
+			VkDeviceSize free = blockBytes - usedBytes;
+			return free > 0 ? static_cast<float>(scatteredBytes) / static_cast<float>(free) : 0.0f;
+		}
+	};
+
+	// One memory heap
+	struct HeapBudget
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;     // how much the process should stay below
+		VkDeviceSize usage = 0;      // by the process (with VK_EXT_memory_budget) or by this allocator
+		VkDeviceSize allocated = 0;  // by this allocator, blocks and dedicated
+		bool         bDeviceLocal = false;
+
+		VkDeviceSize remaining() const { return budget > usage ? budget - usage : 0; }
+	};
+
+	// 'bMemoryBudget' = the device has VK_EXT_memory_budget enabled
+	MyMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool bMemoryBudget = false);
+	~MyMemoryAllocator();
+
+	MyMemoryAllocator(const MyMemoryAllocator&) = delete;
+	MyMemoryAllocator& operator=(const MyMemoryAllocator&) = delete;
+
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind, Category category);
+
+	// A VkDeviceMemory for one resource; 'image' or 'buffer' fill VkMemoryDedicatedAllocateInfo
+	Allocation allocateDedicated(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, Category category,
+		VkImage image = VK_NULL_HANDLE, VkBuffer buffer = VK_NULL_HANDLE);
+
+	// The GPU must be done with the resource; resets 'allocation'
+	void free(Allocation& allocation);
+
+	// Over all pools
+	Stats stats() const;
+
+	// Fetches the driver's heap usage and budget, about once per frame is enough;
+	// in between the usage follows this allocator. No-op without VK_EXT_memory_budget
+	void updateBudget();
+
+	// Without VK_EXT_memory_budget the usage is this allocator's and the budget 80% of the heap
+	uint32_t   heapCount() const { return m_vkMemoryProperties.memoryHeapCount; }
+	HeapBudget heapBudget(uint32_t heap) const;
+	bool       hasDriverBudget() const { return m_bMemoryBudget; }
+
+	// Left on the heap that memory with 'properties' comes from, e.g. before a large upload
+	VkDeviceSize remainingBudget(VkMemoryPropertyFlags properties) const;
+
+	// The emptiest block below 'maxUsage' (used / size) of a pool whose other
+	// blocks have room for its contents; blocks in 'skip' are left out.
+	// nullptr if there is none. Only compare the result, it may be freed any time
+	const Block* sparsestBlock(float maxUsage, const std::vector<const Block*>& skip) const;
+
+	// allocate() places nothing in 'pBlock' any more, nullptr = every block again
+	void setEvacuating(const Block* pBlock);
+
+	// nullptr once free() released the evacuating block
+	const Block* evacuatingBlock() const;
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	bool     hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+	struct Pool
+	{
+		uint32_t                            memoryType;
+		VkDeviceSize                        blockSize;
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+
+	VkDeviceMemory _allocateMemory(VkDeviceSize size, uint32_t memoryType, const void* pNext, void*& pMapped);
+	void           _freeMemory(VkDeviceMemory memory, void* pMapped);
+	uint32_t       _heap(uint32_t memoryType) const { return m_vkMemoryProperties.memoryTypes[memoryType].heapIndex; }
+
+	VkPhysicalDevice                 m_vkPhysicalDevice;
+	VkDevice                         m_vkDevice;
+	VkPhysicalDeviceMemoryProperties m_vkMemoryProperties;
+	VkDeviceSize                     m_vkBufferImageGranularity;
+	VkDeviceSize                     m_vkNonCoherentAtomSize;
+
+	mutable std::mutex               m_mutex;
+	std::vector<Pool>                m_pools;       // memory type * 2 + kind
+	uint32_t                         m_iDedicatedCount = 0;
+	VkDeviceSize                     m_vkDedicatedBytes = 0;
+	const Block*                     m_pEvacuatingBlock = nullptr;
+
+	// Budget, under m_mutex
+	bool                             m_bMemoryBudget;
+	VkDeviceSize                     m_heapAllocated[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize                     m_heapAllocatedAtUpdate[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize                     m_driverHeapUsage[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize                     m_driverHeapBudget[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize                     m_categoryBytes[CATEGORY_COUNT] = {};
+};
+
+#endif
+
@@ -0,0 +1,247 @@
+#include "my_mesh_cache.h"
+
+// Std
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+bool MyMeshCache::s_bEnabled = true;
+
+namespace
+{
+	// On-disk header, followed by the vertex array, the index array, the LOD
+	// table and the meshlet table (all starting on a 16 byte boundary)
+	struct MyMeshCacheHeader
+	{
+		char     magic[4];
+		uint32_t version;
+		uint64_t layoutHash;
+		uint64_t pathHash;
+		int64_t  sourceTime;
+		uint64_t sourceSize;
+		uint32_t id;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		float    weldEpsilon;
+		uint32_t optimized;
+		uint32_t generateLods;
+		uint32_t buildMeshlets;
+		uint32_t lodCount;
+		uint32_t meshletCount;
+		uint32_t reserved;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+		uint64_t meshletOffset;
+	};
+
+	const char MESH_CACHE_MAGIC[4] = { 'M', 'Y', 'M', 'C' };
+
+	// FNV-1a, stable across runs and compilers unlike std::hash
+	uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Fill in the fields that identify the source model
+	bool fillSourceKey(const std::string& filepath, unsigned int id, const MyModel::Builder& settings, MyMeshCacheHeader& header)
+	{
+		std::error_code ec;
+		auto time = std::filesystem::last_write_time(filepath, ec);
+		if (ec)
+			return false;
+
+		auto size = std::filesystem::file_size(filepath, ec);
+		if (ec)
+			return false;
+
+		std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+		header.version = MyMeshCache::VERSION;
+		header.layoutHash = MyMeshCache::vertexLayoutHash();
+		header.pathHash = fnv1a(filepath.data(), filepath.size());
+		header.sourceTime = static_cast<int64_t>(time.time_since_epoch().count());
+		header.sourceSize = static_cast<uint64_t>(size);
+		header.id = id;
+		header.weldEpsilon = settings.weldEpsilon;
+		header.optimized = settings.optimizeMesh ? 1 : 0;
+		header.generateLods = settings.generateLods ? 1 : 0;
+		header.buildMeshlets = settings.buildMeshlets ? 1 : 0;
+		return true;
+	}
+}
+
+std::string MyMeshCache::cachePath(const std::string& filepath)
+{
+	return filepath + ".meshcache";
+}
+
+uint64_t MyMeshCache::vertexLayoutHash()
+{
+	// Any change to the Vertex struct shows up in the stride or in the
+	// attribute descriptions used to build the pipelines
+	// Note: the cache always stores MyModel::Vertex, whichever layout is uploaded
+	auto bindings = MyModel::getBindingDescriptions(MyModel::VERTEX_FORMAT_FLOAT);
+	auto attributes = MyModel::getAttributeDescriptions(MyModel::VERTEX_FORMAT_FLOAT);
+
+	uint32_t stride = bindings[0].stride;
+	uint64_t hash = fnv1a(&stride, sizeof(stride));
+	for (const auto& attribute : attributes)
+	{
+		uint32_t fields[3] = { attribute.location, static_cast<uint32_t>(attribute.format), attribute.offset };
+		hash = fnv1a(fields, sizeof(fields), hash);
+	}
+
+	return hash;
+}
+
+std::unique_ptr<MyMeshCache::View> MyMeshCache::open(const std::string& filepath, unsigned int id, const MyModel::Builder& settings)
+{
+	if (!s_bEnabled)
+		return nullptr;
+
+	MyMeshCacheHeader expected{};
+	if (!fillSourceKey(filepath, id, settings, expected))
+		return nullptr;
+
+	std::unique_ptr<View> pView{ new View(cachePath(filepath)) };
+	if (!pView->m_mappedFile.isOpen())
+		return nullptr;
+
+	const char* pBytes = pView->m_mappedFile.data();
+	size_t size = pView->m_mappedFile.size();
+	if (size < sizeof(MyMeshCacheHeader))
+		return nullptr;
+
+	MyMeshCacheHeader header;
+	std::memcpy(&header, pBytes, sizeof(header));
+
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+		header.version != expected.version ||
+		header.layoutHash != expected.layoutHash ||
+		header.pathHash != expected.pathHash ||
+		header.sourceTime != expected.sourceTime ||
+		header.sourceSize != expected.sourceSize ||
+		header.id != expected.id ||
+		header.weldEpsilon != expected.weldEpsilon ||
+		header.optimized != expected.optimized ||
+		header.generateLods != expected.generateLods ||
+		header.buildMeshlets != expected.buildMeshlets)
+	{
+		return nullptr;
+	}
+
+	uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(MyModel::Vertex);
+	uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+	uint64_t lodBytes = static_cast<uint64_t>(header.lodCount) * sizeof(MyModel::Lod);
+	uint64_t meshletBytes = static_cast<uint64_t>(header.meshletCount) * sizeof(MyModel::Meshlet);
+	if (header.vertexOffset % 16 != 0 || header.indexOffset % 16 != 0 ||
+		header.lodOffset % 16 != 0 || header.meshletOffset % 16 != 0 ||
+		header.vertexOffset + vertexBytes > size || header.indexOffset + indexBytes > size ||
+		header.lodOffset + lodBytes > size || header.meshletOffset + meshletBytes > size)
+	{
+		return nullptr;
+	}
+
+	// Every LOD and meshlet range must lie inside the index array
+	const MyModel::Lod* pLods = reinterpret_cast<const MyModel::Lod*>(pBytes + header.lodOffset);
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		if (static_cast<uint64_t>(pLods[i].firstIndex) + pLods[i].indexCount > header.indexCount)
+			return nullptr;
+	}
+
+	const MyModel::Meshlet* pMeshlets = reinterpret_cast<const MyModel::Meshlet*>(pBytes + header.meshletOffset);
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		if (static_cast<uint64_t>(pMeshlets[i].firstIndex) + pMeshlets[i].indexCount > header.indexCount)
+			return nullptr;
+	}
+
+	pView->m_pVertices = reinterpret_cast<const MyModel::Vertex*>(pBytes + header.vertexOffset);
+	pView->m_iVertexCount = header.vertexCount;
+	pView->m_pIndices = reinterpret_cast<const uint32_t*>(pBytes + header.indexOffset);
+	pView->m_iIndexCount = header.indexCount;
+	pView->m_pLods = header.lodCount > 0 ? pLods : nullptr;
+	pView->m_iLodCount = header.lodCount;
+	pView->m_pMeshlets = header.meshletCount > 0 ? pMeshlets : nullptr;
+	pView->m_iMeshletCount = header.meshletCount;
+
+	return pView;
+}
+
+bool MyMeshCache::write(const std::string& filepath, unsigned int id, const MyModel::Builder& builder)
+{
+	if (!s_bEnabled)
+		return false;
+
+	MyMeshCacheHeader header{};
+	if (!fillSourceKey(filepath, id, builder, header))
+		return false;
+
+	header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+	header.indexCount = static_cast<uint32_t>(builder.indices.size());
+	header.vertexOffset = alignUp(sizeof(MyMeshCacheHeader), 16);
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexCount * sizeof(MyModel::Vertex), 16);
+	header.lodCount = static_cast<uint32_t>(builder.lods.size());
+	header.lodOffset = alignUp(header.indexOffset + header.indexCount * sizeof(uint32_t), 16);
+	header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+	header.meshletOffset = alignUp(header.lodOffset + header.lodCount * sizeof(MyModel::Lod), 16);
+
+	// Write to a temporary file first so a crash never leaves a truncated cache behind
+	// Note: one per thread, loader threads may write the cache of the same model at once
+	std::string path = cachePath(filepath);
+	std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	{
+		std::ofstream file{ tmpPath, std::ios::binary | std::ios::trunc };
+		if (!file)
+		{
+			std::cerr << "Warning: cannot write mesh cache " << path << std::endl;
+			return false;
+		}
+
+		const char padding[16] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(padding, header.vertexOffset - sizeof(header));
+		file.write(reinterpret_cast<const char*>(builder.vertices.data()), header.vertexCount * sizeof(MyModel::Vertex));
+		file.write(padding, header.indexOffset - (header.vertexOffset + header.vertexCount * sizeof(MyModel::Vertex)));
+		file.write(reinterpret_cast<const char*>(builder.indices.data()), header.indexCount * sizeof(uint32_t));
+		file.write(padding, header.lodOffset - (header.indexOffset + header.indexCount * sizeof(uint32_t)));
+		file.write(reinterpret_cast<const char*>(builder.lods.data()), header.lodCount * sizeof(MyModel::Lod));
+		file.write(padding, header.meshletOffset - (header.lodOffset + header.lodCount * sizeof(MyModel::Lod)));
+		file.write(reinterpret_cast<const char*>(builder.meshlets.data()), header.meshletCount * sizeof(MyModel::Meshlet));
+
+		if (!file)
+		{
+			file.close();
+			std::remove(tmpPath.c_str());
+			std::cerr << "Warning: failed writing mesh cache " << path << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
+	{
+		std::remove(tmpPath.c_str());
+		std::cerr << "Warning: cannot replace mesh cache " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
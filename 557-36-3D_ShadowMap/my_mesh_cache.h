@@ -0,0 +1,79 @@
+#ifndef __MY_MESH_CACHE_H__
+#define __MY_MESH_CACHE_H__
+
+#include "my_model.h"
+#include "my_mapped_file.h"
+
+// Std
+#include <memory>
+#include <string>
+
+//
+// Versioned binary cache for the deduplicated vertex and index arrays that
+// MyModel::Builder::loadModel produces from an OBJ file.
+//
+// The cache file lives next to the model ("<model>.meshcache") and is only
+// used while the source path, source mtime/size, picking id, builder settings
+// (weld epsilon, mesh optimization, LODs, meshlets) and the layout of MyModel::Vertex all match what was recorded in its header. Warm loads
+// memory-map the file so the arrays can be handed to the staging upload
+// without parsing or copying.
+//
+class MyMeshCache
+{
+public:
+	// Bump when the file layout below changes
+	static constexpr uint32_t VERSION = 5;
+
+	// Read-only, memory-mapped view of a valid cache file
+	class View
+	{
+	public:
+		View(const View&) = delete;
+		View& operator=(const View&) = delete;
+
+		const MyModel::Vertex* vertices() const { return m_pVertices; }
+		uint32_t               vertexCount() const { return m_iVertexCount; }
+		const uint32_t*        indices() const { return m_pIndices; }
+		uint32_t               indexCount() const { return m_iIndexCount; }
+		const MyModel::Lod*    lods() const { return m_pLods; }
+		uint32_t               lodCount() const { return m_iLodCount; }
+		const MyModel::Meshlet* meshlets() const { return m_pMeshlets; }
+		uint32_t               meshletCount() const { return m_iMeshletCount; }
+
+	private:
+		friend class MyMeshCache;
+		View(const std::string& path) : m_mappedFile{ path } {}
+
+		MyMappedFile           m_mappedFile;
+		const MyModel::Vertex* m_pVertices = nullptr;
+		uint32_t               m_iVertexCount = 0;
+		const uint32_t*        m_pIndices = nullptr;
+		uint32_t               m_iIndexCount = 0;
+		const MyModel::Lod*    m_pLods = nullptr;
+		uint32_t               m_iLodCount = 0;
+		const MyModel::Meshlet* m_pMeshlets = nullptr;
+		uint32_t               m_iMeshletCount = 0;
+	};
+
+	// Returns nullptr if there is no up-to-date cache for the model built with
+	// the settings of 'settings' (its vertex and index arrays are not used)
+	static std::unique_ptr<View> open(const std::string& filepath, unsigned int id, const MyModel::Builder& settings = {});
+
+	// Write the builder arrays to the cache; returns false if the file could not be written
+	static bool write(const std::string& filepath, unsigned int id, const MyModel::Builder& builder);
+
+	static std::string cachePath(const std::string& filepath);
+
+	// Disable to force OBJ parsing, e.g. to time cold loads
+	static void setEnabled(bool bEnable) { s_bEnabled = bEnable; }
+	static bool enabled() { return s_bEnabled; }
+
+	// Hash of the MyModel::Vertex memory layout (stride and attribute formats/offsets)
+	static uint64_t vertexLayoutHash();
+
+private:
+	static bool s_bEnabled;
+};
+
+#endif
+
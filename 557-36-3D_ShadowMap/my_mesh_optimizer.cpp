@@ -0,0 +1,298 @@
+#include "my_mesh_optimizer.h"
+
+// Std
+#include <algorithm>
+
+namespace
+{
+	const uint32_t NONE = 0xFFFFFFFFu;
+
+	//
+	// FIFO post-transform cache: a vertex is cached while fewer than CACHE_SIZE
+	// misses happened since it was transformed. Advancing the clock by
+	// CACHE_SIZE + 1 flushes it.
+	//
+	class CacheSimulator
+	{
+	public:
+		CacheSimulator(size_t vertexCount, uint32_t cacheSize) :
+			m_cacheTime(vertexCount, 0),
+			m_iCacheSize{ cacheSize },
+			m_iTime{ cacheSize + 1 }
+		{
+		}
+
+		bool cached(uint32_t vertex) const { return m_iTime - m_cacheTime[vertex] <= m_iCacheSize; }
+		uint32_t age(uint32_t vertex) const { return m_iTime - m_cacheTime[vertex]; }
+
+		// Returns 1 on a miss
+		uint32_t access(uint32_t vertex)
+		{
+			if (cached(vertex))
+				return 0;
+
+			m_cacheTime[vertex] = m_iTime++;
+			return 1;
+		}
+
+		uint32_t accessTriangle(const uint32_t* pTriangle)
+		{
+			return access(pTriangle[0]) + access(pTriangle[1]) + access(pTriangle[2]);
+		}
+
+		void flush() { m_iTime += m_iCacheSize + 1; }
+
+	private:
+		std::vector<uint32_t> m_cacheTime;
+		uint32_t              m_iCacheSize;
+		uint32_t              m_iTime;
+	};
+}
+
+void MyMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles using each vertex, and how many of them are still to be emitted
+	std::vector<uint32_t> liveCount(vertexCount, 0);
+	for (uint32_t index : indices)
+		liveCount[index]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + liveCount[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	CacheSimulator cache{ vertexCount, CACHE_SIZE };
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	deadEnds.reserve(indices.size());
+	result.reserve(indices.size());
+
+	// Next vertex in input order that still has triangles, when everything else failed
+	uint32_t cursor = 0;
+	auto skipDeadEnd = [&]() -> uint32_t
+	{
+		while (!deadEnds.empty())
+		{
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCount[vertex] > 0)
+				return vertex;
+		}
+
+		while (cursor < vertexCount)
+		{
+			if (liveCount[cursor] > 0)
+				return cursor;
+			cursor++;
+		}
+
+		return NONE;
+	};
+
+	uint32_t fanning = skipDeadEnd();
+	while (fanning != NONE)
+	{
+		// Emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++)
+		{
+			uint32_t triangle = adjacency[k];
+			if (emitted[triangle])
+				continue;
+
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t vertex = indices[3 * triangle + c];
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCount[vertex]--;
+				cache.access(vertex);
+			}
+			emitted[triangle] = 1;
+		}
+
+		// Continue with the oldest candidate that will still be in the cache
+		// after its own triangles are emitted
+		uint32_t next = NONE;
+		int bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveCount[vertex] == 0)
+				continue;
+
+			int priority = 0;
+			if (cache.age(vertex) + 2 * liveCount[vertex] <= CACHE_SIZE)
+				priority = static_cast<int>(cache.age(vertex));
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		fanning = next != NONE ? next : skipDeadEnd();
+	}
+
+	indices.swap(result);
+}
+
+void MyMeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MyModel::Vertex>& vertices, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	CacheSimulator cache{ vertices.size(), CACHE_SIZE };
+
+	// Hard boundaries: triangles with three misses start from a cold cache,
+	// so the clusters in between can be moved around for free
+	std::vector<uint32_t> hardClusters{ 0 };
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (cache.accessTriangle(&indices[3 * t]) == 3 && t > 0)
+			hardClusters.push_back(static_cast<uint32_t>(t));
+	}
+	hardClusters.push_back(static_cast<uint32_t>(triangleCount));
+
+	// Soft boundaries: split a hard cluster further wherever the triangles so
+	// far are already within 'threshold' of the cluster's cache efficiency
+	std::vector<uint32_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		uint32_t begin = hardClusters[c];
+		uint32_t end = hardClusters[c + 1];
+
+		cache.flush();
+		uint32_t clusterMisses = 0;
+		for (uint32_t t = begin; t < end; t++)
+			clusterMisses += cache.accessTriangle(&indices[3 * t]);
+
+		float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+		clusters.push_back(begin);
+		cache.flush();
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+		for (uint32_t t = begin; t < end; t++)
+		{
+			runningMisses += cache.accessTriangle(&indices[3 * t]);
+			runningTriangles++;
+
+			if (t + 1 < end && static_cast<float>(runningMisses) / runningTriangles <= clusterThreshold)
+			{
+				clusters.push_back(t + 1);
+				cache.flush();
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+	}
+	clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+	// Draw outward facing clusters on the outside of the mesh first, they are
+	// the most likely to occlude the rest
+	glm::vec3 meshCentroid{ 0.0f };
+	for (const auto& vertex : vertices)
+		meshCentroid += vertex.position;
+	meshCentroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+	const size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid{ 0.0f };
+		glm::vec3 normal{ 0.0f };
+		float area = 0.0f;
+
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+			const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+			const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+
+			glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(triangleNormal);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		float normalLength = glm::length(normal);
+		if (area > 0.0f && normalLength > 0.0f)
+			sortKeys[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+		else
+			sortKeys[c] = 0.0f;
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = static_cast<uint32_t>(c);
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order)
+		result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+
+	indices.swap(result);
+}
+
+void MyMeshOptimizer::optimizeVertexFetch(std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), NONE);
+	std::vector<MyModel::Vertex> result;
+	result.reserve(vertices.size());
+
+	// Note: vertices no triangle refers to are dropped
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == NONE)
+		{
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+void MyMeshOptimizer::optimize(std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	optimizeVertexCache(indices, vertices.size());
+	optimizeOverdraw(indices, vertices);
+	optimizeVertexFetch(vertices, indices);
+}
+
+MyMeshOptimizer::VertexCacheStats MyMeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats{};
+	if (indices.size() < 3 || vertexCount == 0)
+		return stats;
+
+	CacheSimulator cache{ vertexCount, cacheSize };
+	for (uint32_t index : indices)
+		stats.transformedCount += cache.access(index);
+
+	stats.acmr = static_cast<float>(stats.transformedCount) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(stats.transformedCount) / vertexCount;
+	return stats;
+}
+
@@ -0,0 +1,47 @@
+#ifndef __MY_MESH_OPTIMIZER_H__
+#define __MY_MESH_OPTIMIZER_H__
+
+#include "my_model.h"
+
+// Std
+#include <vector>
+
+//
+// Reorders the output of MyModel::Builder for the GPU, in this order:
+//
+// 1. optimizeVertexCache - Tipsify triangle order for post-transform cache reuse
+//    (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and
+//    Reduced Overdraw", 2007)
+// 2. optimizeOverdraw    - splits that order into clusters and sorts the clusters
+//    so outward facing ones are drawn first, keeping the cache efficiency
+//    within 'threshold' of step 1
+// 3. optimizeVertexFetch - renumbers vertices in order of first use so the
+//    vertex fetch walks memory mostly forward
+//
+// None of the steps change what is rendered, only the order.
+//
+class MyMeshOptimizer
+{
+public:
+	// FIFO cache size used for the reordering and for the statistics
+	static constexpr uint32_t CACHE_SIZE = 16;
+
+	struct VertexCacheStats
+	{
+		uint32_t transformedCount = 0;
+		float    acmr = 0.0f; // transformed vertices per triangle, 0.5 - 3.0, lower is better
+		float    atvr = 0.0f; // transformed vertices per vertex, 1.0 is optimal
+	};
+
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+	static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MyModel::Vertex>& vertices, float threshold = 1.05f);
+	static void optimizeVertexFetch(std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Runs all three steps
+	static void optimize(std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+};
+
+#endif
+
@@ -0,0 +1,584 @@
+#include "my_mesh_simplifier.h"
+#include "my_mesh_optimizer.h"
+
+// Std
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const uint32_t NONE = 0xFFFFFFFFu;
+
+	// Edge quadrics keep open borders and seams in place, relative to the face quadrics
+	const double BORDER_WEIGHT = 10.0;
+	const double SEAM_WEIGHT = 1.0;
+
+	// Shading error of moving a vertex onto one with a different normal:
+	// (1 - cos(angle)) * edge length^2, so it is in the same units as the distance error
+	const float NORMAL_WEIGHT = 1.0f;
+
+	// A pass stops at collapses this much costlier than the one that would reach the target
+	const float PASS_ERROR_BOUND = 1.5f;
+
+	// Triangles around a moved vertex may turn by at most acos(0.25) = 75 degrees
+	const float MAX_FLIP_COSINE = 0.25f;
+
+	enum VertexKind
+	{
+		KIND_MANIFOLD, // one wedge, not on a border
+		KIND_BORDER,   // one wedge, on one open border loop
+		KIND_SEAM,     // two wedges, on one seam
+		KIND_LOCKED
+	};
+
+	//
+	// Symmetric 4x4 quadric of the squared distance to a set of weighted planes
+	//
+	struct Quadric
+	{
+		double a00 = 0, a11 = 0, a22 = 0;
+		double a10 = 0, a20 = 0, a21 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double w = 0;
+
+		void addPlane(const glm::vec3& n, float d, double weight)
+		{
+			a00 += weight * n.x * n.x;
+			a11 += weight * n.y * n.y;
+			a22 += weight * n.z * n.z;
+			a10 += weight * n.y * n.x;
+			a20 += weight * n.z * n.x;
+			a21 += weight * n.z * n.y;
+			b0 += weight * n.x * d;
+			b1 += weight * n.y * d;
+			b2 += weight * n.z * d;
+			c += weight * d * d;
+			w += weight;
+		}
+
+		void add(const Quadric& other)
+		{
+			a00 += other.a00; a11 += other.a11; a22 += other.a22;
+			a10 += other.a10; a20 += other.a20; a21 += other.a21;
+			b0 += other.b0;   b1 += other.b1;   b2 += other.b2;
+			c += other.c;
+			w += other.w;
+		}
+
+		// Weighted mean squared distance of p to the planes
+		double error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double result =
+				a00 * x * x + a11 * y * y + a22 * z * z +
+				2.0 * (a10 * x * y + a20 * x * z + a21 * y * z) +
+				2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+			return w > 0.0 ? std::max(result / w, 0.0) : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t vertex;  // moves onto target
+		uint32_t target;
+		float    error;   // squared, model space
+	};
+
+	inline uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	inline bool hasEdge(const std::vector<uint64_t>& sortedEdges, uint32_t a, uint32_t b)
+	{
+		return std::binary_search(sortedEdges.begin(), sortedEdges.end(), edgeKey(a, b));
+	}
+
+	//
+	// Topology of the current index list: which vertices may move and along
+	// which edges. Rebuilt every pass because collapses change the loops.
+	//
+	struct Topology
+	{
+		std::vector<uint64_t> positionEdges; // directed, by position
+		std::vector<uint64_t> vertexEdges;   // directed, by vertex
+		std::vector<uint8_t>  kind;
+		std::vector<uint32_t> wedge;         // next vertex with the same position, circular
+		std::vector<uint32_t> borderNext, borderPrev;
+		std::vector<uint32_t> seamNext, seamPrev;
+
+		void build(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionRemap)
+		{
+			const size_t vertexCount = positionRemap.size();
+
+			positionEdges.clear();
+			vertexEdges.clear();
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					uint32_t a = indices[i + e];
+					uint32_t b = indices[i + (e + 1) % 3];
+					positionEdges.push_back(edgeKey(positionRemap[a], positionRemap[b]));
+					vertexEdges.push_back(edgeKey(a, b));
+				}
+			}
+			std::sort(positionEdges.begin(), positionEdges.end());
+			std::sort(vertexEdges.begin(), vertexEdges.end());
+
+			// Wedges of the vertices still in use
+			wedge.assign(vertexCount, NONE);
+			std::vector<uint32_t> first(vertexCount, NONE);
+			std::vector<uint32_t> wedgeCount(vertexCount, 0);
+			for (uint32_t index : indices)
+			{
+				if (wedge[index] != NONE)
+					continue;
+
+				uint32_t position = positionRemap[index];
+				if (first[position] == NONE)
+				{
+					first[position] = index;
+					wedge[index] = index;
+				}
+				else
+				{
+					wedge[index] = wedge[first[position]];
+					wedge[first[position]] = index;
+				}
+				wedgeCount[position]++;
+			}
+
+			std::vector<uint8_t> borderOut(vertexCount, 0), borderIn(vertexCount, 0);
+			std::vector<uint8_t> seamOut(vertexCount, 0), seamIn(vertexCount, 0);
+			borderNext.assign(vertexCount, NONE);
+			borderPrev.assign(vertexCount, NONE);
+			seamNext.assign(vertexCount, NONE);
+			seamPrev.assign(vertexCount, NONE);
+
+			auto increment = [](uint8_t& count) { count = static_cast<uint8_t>(std::min(count + 1, 2)); };
+
+			for (uint64_t edge : vertexEdges)
+			{
+				uint32_t a = static_cast<uint32_t>(edge >> 32);
+				uint32_t b = static_cast<uint32_t>(edge);
+
+				if (!hasEdge(positionEdges, positionRemap[b], positionRemap[a]))
+				{
+					increment(borderOut[a]);
+					increment(borderIn[b]);
+					borderNext[a] = b;
+					borderPrev[b] = a;
+				}
+				else if (!hasEdge(vertexEdges, b, a))
+				{
+					increment(seamOut[a]);
+					increment(seamIn[b]);
+					seamNext[a] = b;
+					seamPrev[b] = a;
+				}
+			}
+
+			kind.assign(vertexCount, KIND_LOCKED);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				if (wedge[v] == NONE)
+					continue;
+
+				uint32_t count = wedgeCount[positionRemap[v]];
+				if (count == 1)
+				{
+					if (borderOut[v] == 0 && borderIn[v] == 0 && seamOut[v] == 0 && seamIn[v] == 0)
+						kind[v] = KIND_MANIFOLD;
+					else if (borderOut[v] == 1 && borderIn[v] == 1 && seamOut[v] == 0 && seamIn[v] == 0)
+						kind[v] = KIND_BORDER;
+				}
+				else if (count == 2)
+				{
+					uint32_t s = wedge[v];
+					if (borderOut[v] == 0 && borderIn[v] == 0 && borderOut[s] == 0 && borderIn[s] == 0 &&
+						seamOut[v] == 1 && seamIn[v] == 1 && seamOut[s] == 1 && seamIn[s] == 1)
+					{
+						kind[v] = KIND_SEAM;
+					}
+				}
+			}
+		}
+	};
+
+	// The wedge of 'target' that 'sibling' (the other wedge of a seam vertex) follows
+	// the seam to; 'target' itself where the seam ends
+	uint32_t siblingTarget(const Topology& topology, uint32_t sibling, uint32_t target)
+	{
+		uint32_t t = target;
+		do
+		{
+			t = topology.wedge[t];
+			if (topology.seamNext[sibling] == t || topology.seamPrev[sibling] == t)
+				return t;
+		} while (t != target);
+
+		return NONE;
+	}
+}
+
+void MyMeshSimplifier::buildPositionRemap(const std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& positionRemap)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	std::vector<uint32_t> order(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		order[v] = v;
+
+	auto less = [&](uint32_t a, uint32_t b)
+	{
+		const glm::vec3& pa = vertices[a].position;
+		const glm::vec3& pb = vertices[b].position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		if (pa.z != pb.z) return pa.z < pb.z;
+		return a < b;
+	};
+	std::sort(order.begin(), order.end(), less);
+
+	positionRemap.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		uint32_t v = order[i];
+		if (i > 0 && vertices[order[i - 1]].position == vertices[v].position)
+		{
+			positionRemap[v] = positionRemap[order[i - 1]];
+		}
+		else
+		{
+			positionRemap[v] = v;
+		}
+	}
+}
+
+float MyMeshSimplifier::simplify(
+	const std::vector<MyModel::Vertex>& vertices,
+	const std::vector<uint32_t>& indices,
+	size_t targetIndexCount,
+	float targetError,
+	std::vector<uint32_t>& result)
+{
+	result = indices;
+	const size_t vertexCount = vertices.size();
+	if (vertexCount == 0 || indices.size() <= targetIndexCount)
+		return 0.0f;
+
+	// Vertices that only differ in their attributes share one position, its
+	// quadric and its adjacency
+	std::vector<uint32_t> positionRemap;
+	buildPositionRemap(vertices, positionRemap);
+
+	Topology topology{};
+	topology.build(result, positionRemap);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::vec3& p0 = vertices[result[i + 0]].position;
+		const glm::vec3& p1 = vertices[result[i + 1]].position;
+		const glm::vec3& p2 = vertices[result[i + 2]].position;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+
+		normal /= length;
+		for (int c = 0; c < 3; c++)
+			quadrics[positionRemap[result[i + c]]].addPlane(normal, -glm::dot(normal, p0), 0.5 * length);
+
+		// Planes through border and seam edges, perpendicular to the triangle
+		for (int e = 0; e < 3; e++)
+		{
+			uint32_t a = result[i + e];
+			uint32_t b = result[i + (e + 1) % 3];
+
+			double weight = 0.0;
+			if (topology.borderNext[a] == b)
+				weight = BORDER_WEIGHT;
+			else if (topology.seamNext[a] == b)
+				weight = SEAM_WEIGHT;
+			else
+				continue;
+
+			glm::vec3 edge = vertices[b].position - vertices[a].position;
+			glm::vec3 edgeNormal = glm::cross(edge, normal);
+			float edgeLength = glm::length(edgeNormal);
+			if (edgeLength == 0.0f)
+				continue;
+
+			edgeNormal /= edgeLength;
+			double edgeWeight = weight * glm::dot(edge, edge);
+			float d = -glm::dot(edgeNormal, vertices[a].position);
+			quadrics[positionRemap[a]].addPlane(edgeNormal, d, edgeWeight);
+			quadrics[positionRemap[b]].addPlane(edgeNormal, d, edgeWeight);
+		}
+	}
+
+	const float errorLimit = targetError * targetError;
+	float resultError = 0.0f;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<uint8_t> locked(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+
+	while (result.size() > targetIndexCount)
+	{
+		// Triangles around every position
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[positionRemap[index] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++)
+				adjacency[fill[positionRemap[result[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// Cost of moving 'vertex' onto 'target', or a negative value if that is not allowed
+		auto collapseError = [&](uint32_t vertex, uint32_t target) -> float
+		{
+			uint32_t sibling = NONE;
+			switch (topology.kind[vertex])
+			{
+			case KIND_MANIFOLD:
+				break;
+			case KIND_BORDER:
+				if (topology.borderNext[vertex] != target && topology.borderPrev[vertex] != target)
+					return -1.0f;
+				break;
+			case KIND_SEAM:
+				if (topology.seamNext[vertex] != target && topology.seamPrev[vertex] != target)
+					return -1.0f;
+				sibling = topology.wedge[vertex];
+				if (siblingTarget(topology, sibling, target) == NONE)
+					return -1.0f;
+				break;
+			default:
+				return -1.0f;
+			}
+
+			const MyModel::Vertex& v = vertices[vertex];
+			const MyModel::Vertex& t = vertices[target];
+			glm::vec3 edge = t.position - v.position;
+			float edgeLength2 = glm::dot(edge, edge);
+
+			auto normalError = [&](const glm::vec3& a, const glm::vec3& b)
+			{
+				float la = glm::length(a);
+				float lb = glm::length(b);
+				if (la == 0.0f || lb == 0.0f)
+					return 0.0f;
+				return NORMAL_WEIGHT * (1.0f - glm::dot(a, b) / (la * lb)) * edgeLength2;
+			};
+
+			// A seam moves both wedges, the worse side counts
+			float shadingError = normalError(v.normal, t.normal);
+			if (sibling != NONE)
+			{
+				uint32_t siblingT = siblingTarget(topology, sibling, target);
+				shadingError = std::max(shadingError, normalError(vertices[sibling].normal, vertices[siblingT].normal));
+			}
+
+			return static_cast<float>(quadrics[positionRemap[vertex]].error(t.position)) + shadingError;
+		};
+
+		// Cheapest allowed direction of every edge
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = result[i + e];
+				uint32_t b = result[i + (e + 1) % 3];
+				uint32_t pa = positionRemap[a];
+				uint32_t pb = positionRemap[b];
+
+				// Interior edges show up twice, take them from one side only
+				if (pa == pb || (pa > pb && hasEdge(topology.positionEdges, pb, pa)))
+					continue;
+
+				float ab = collapseError(a, b);
+				float ba = collapseError(b, a);
+				if (ab >= 0.0f && (ba < 0.0f || ab <= ba))
+					collapses.push_back({ a, b, ab });
+				else if (ba >= 0.0f)
+					collapses.push_back({ b, a, ba });
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		// Borders remove one triangle per collapse, everything else two
+		auto removedTriangles = [&](const Collapse& collapse) { return topology.kind[collapse.vertex] == KIND_BORDER ? 1u : 2u; };
+
+		const size_t triangleGoal = (result.size() - targetIndexCount) / 3 + 1;
+		float passErrorLimit = errorLimit;
+		{
+			size_t removed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				removed += removedTriangles(collapse);
+				if (removed >= triangleGoal)
+				{
+					passErrorLimit = std::min(errorLimit, collapse.error * PASS_ERROR_BOUND);
+					break;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+			collapseRemap[v] = static_cast<uint32_t>(v);
+		std::fill(locked.begin(), locked.end(), 0);
+
+		// True if moving position 'from' onto 'to' folds a triangle over
+		auto hasFlips = [&](uint32_t from, uint32_t to)
+		{
+			const glm::vec3& target = vertices[to].position;
+			for (uint32_t k = adjacencyOffsets[positionRemap[from]]; k < adjacencyOffsets[positionRemap[from] + 1]; k++)
+			{
+				uint32_t triangle = adjacency[k];
+				glm::vec3 before[3];
+				glm::vec3 after[3];
+				bool bRemoved = false;
+
+				for (int c = 0; c < 3; c++)
+				{
+					uint32_t corner = collapseRemap[result[3 * triangle + c]];
+					uint32_t position = positionRemap[corner];
+					bRemoved = bRemoved || position == positionRemap[to];
+					before[c] = vertices[corner].position;
+					after[c] = position == positionRemap[from] ? target : before[c];
+				}
+
+				// Triangles on the collapsed edge disappear
+				if (bRemoved)
+					continue;
+
+				glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+				if (glm::dot(n0, n1) < MAX_FLIP_COSINE * glm::length(n0) * glm::length(n1))
+					return true;
+			}
+			return false;
+		};
+
+		size_t removed = 0;
+		size_t performed = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > passErrorLimit || removed >= triangleGoal)
+				break;
+
+			uint32_t pv = positionRemap[collapse.vertex];
+			uint32_t pt = positionRemap[collapse.target];
+			if (locked[pv] || locked[pt])
+				continue;
+
+			if (hasFlips(collapse.vertex, collapse.target))
+				continue;
+
+			// Move all wedges of the vertex
+			collapseRemap[collapse.vertex] = collapse.target;
+			if (topology.kind[collapse.vertex] == KIND_SEAM)
+			{
+				uint32_t sibling = topology.wedge[collapse.vertex];
+				collapseRemap[sibling] = siblingTarget(topology, sibling, collapse.target);
+			}
+
+			quadrics[pt].add(quadrics[pv]);
+			locked[pv] = 1;
+			locked[pt] = 1;
+
+			removed += removedTriangles(collapse);
+			performed++;
+			resultError = std::max(resultError, collapse.error);
+		}
+
+		if (performed == 0)
+			break;
+
+		// Drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = collapseRemap[result[i + 0]];
+			uint32_t b = collapseRemap[result[i + 1]];
+			uint32_t c = collapseRemap[result[i + 2]];
+			if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[c] == positionRemap[a])
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+
+		topology.build(result, positionRemap);
+	}
+
+	return std::sqrt(resultError);
+}
+
+void MyMeshSimplifier::buildLodChain(
+	const std::vector<MyModel::Vertex>& vertices,
+	std::vector<uint32_t>& indices,
+	std::vector<MyModel::Lod>& lods,
+	bool bOptimize)
+{
+	lods.clear();
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+	if (vertices.empty() || indices.empty())
+		return;
+
+	glm::vec3 minPosition = vertices[0].position;
+	glm::vec3 maxPosition = vertices[0].position;
+	for (const auto& vertex : vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.position);
+		maxPosition = glm::max(maxPosition, vertex.position);
+	}
+	const float errorLimit = MAX_LOD_ERROR * 0.5f * glm::length(maxPosition - minPosition);
+
+	// Every LOD is simplified from LOD 0 so its error is measured against the original surface
+	const std::vector<uint32_t> base = indices;
+	std::vector<uint32_t> lodIndices;
+	while (lods.size() < MAX_LOD_COUNT)
+	{
+		const MyModel::Lod& previous = lods.back();
+		size_t target = static_cast<size_t>(previous.indexCount / 3 * LOD_REDUCTION) * 3;
+		if (target < MIN_LOD_TRIANGLES * 3)
+			break;
+
+		float error = simplify(vertices, base, target, errorLimit, lodIndices);
+
+		// Not worth another draw range if the simplifier got stuck
+		if (lodIndices.size() > previous.indexCount * 9 / 10)
+			break;
+
+		if (bOptimize)
+			MyMeshOptimizer::optimizeVertexCache(lodIndices, vertices.size());
+
+		MyModel::Lod lod{};
+		lod.firstIndex = static_cast<uint32_t>(indices.size());
+		lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+		lod.error = std::max(error, previous.error);
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+		lods.push_back(lod);
+	}
+}
+
@@ -0,0 +1,61 @@
+#ifndef __MY_MESH_SIMPLIFIER_H__
+#define __MY_MESH_SIMPLIFIER_H__
+
+#include "my_model.h"
+
+// Std
+#include <vector>
+
+//
+// Quadric error edge collapse (Garland, Heckbert, "Surface Simplification
+// Using Quadric Error Metrics", 1997) on the indices of MyModel::Builder.
+//
+// Collapses are half-edge: a vertex moves onto a neighbour, so the simplified
+// index lists keep referring to the original vertex array and all LODs can
+// share one vertex buffer. To keep the attributes intact:
+// - a vertex with one wedge (one position, one set of attributes) may move
+//   anywhere, open border vertices only along the border
+// - a vertex on a UV or normal seam (two wedges) only moves along the seam,
+//   both wedges together, so the texture charts stay closed
+// - everything else (chart corners, non-manifold vertices) never moves
+// The collapse cost adds the normal difference of the two vertices on top
+// of the distance to the original surface, and collapses that fold a
+// triangle over are rejected.
+//
+class MyMeshSimplifier
+{
+public:
+	static constexpr uint32_t MAX_LOD_COUNT = 5;
+
+	// Every LOD has about half the triangles of the one before
+	static constexpr float LOD_REDUCTION = 0.5f;
+
+	// No LOD below this many triangles, or with an error above this fraction of the mesh radius
+	static constexpr uint32_t MIN_LOD_TRIANGLES = 64;
+	static constexpr float    MAX_LOD_ERROR = 0.1f;
+
+	// Simplifies 'indices' towards 'targetIndexCount' without exceeding 'targetError'
+	// (in model space units). Returns the error of the result in model space units.
+	static float simplify(
+		const std::vector<MyModel::Vertex>& vertices,
+		const std::vector<uint32_t>& indices,
+		size_t targetIndexCount,
+		float targetError,
+		std::vector<uint32_t>& result);
+
+	// Treats 'indices' as LOD 0, appends the simplified LODs to it and fills in
+	// 'lods', LOD 0 first. bOptimize reorders every new LOD for the vertex cache,
+	// see MyMeshOptimizer.
+	static void buildLodChain(
+		const std::vector<MyModel::Vertex>& vertices,
+		std::vector<uint32_t>& indices,
+		std::vector<MyModel::Lod>& lods,
+		bool bOptimize = false);
+
+	// Maps every vertex to the first vertex with the same position, so vertices
+	// split by a UV or normal seam still count as neighbours
+	static void buildPositionRemap(const std::vector<MyModel::Vertex>& vertices, std::vector<uint32_t>& positionRemap);
+};
+
+#endif
+
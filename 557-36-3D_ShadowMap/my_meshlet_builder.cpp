@@ -0,0 +1,268 @@
+#include "my_meshlet_builder.h"
+#include "my_mesh_simplifier.h"
+
+// Std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	const uint32_t NONE = 0xFFFFFFFFu;
+
+	// How much a triangle facing away from the meshlet normal counts as extra distance
+	const float CONE_WEIGHT = 0.5f;
+
+	// Cones wider than acos(0.1) (84 degrees) would hardly ever cull
+	const float MIN_CONE_DOT = 0.1f;
+
+	// When nothing connected fits any more, look this many triangles ahead for
+	// the closest one (the optimized index order keeps them nearby)
+	const uint32_t SEARCH_WINDOW = 256;
+}
+
+std::vector<MyModel::Meshlet> MyMeshletBuilder::build(
+	const std::vector<MyModel::Vertex>& vertices,
+	std::vector<uint32_t>& indices,
+	size_t indexCount)
+{
+	std::vector<MyModel::Meshlet> meshlets;
+	const size_t triangleCount = indexCount / 3;
+	const size_t vertexCount = vertices.size();
+	if (triangleCount == 0)
+		return meshlets;
+
+	// Triangles around every position, seams and flat shading split the
+	// vertices but not the surface
+	std::vector<uint32_t> positionRemap;
+	MyMeshSimplifier::buildPositionRemap(vertices, positionRemap);
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		offsets[positionRemap[indices[i]] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+			adjacency[fill[positionRemap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<glm::vec3> centroids(triangleCount);
+	std::vector<glm::vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+		const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+		const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+
+		centroids[t] = (p0 + p1 + p2) / 3.0f;
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3{ 0.0f };
+	}
+
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> vertexMeshlet(vertexCount, NONE);     // meshlet that already has the vertex
+	std::vector<uint32_t> candidateMeshlet(triangleCount, NONE); // meshlet that already lists the triangle
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> triangles;
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+
+	uint32_t cursor = 0;
+	for (size_t done = 0; done < triangleCount; )
+	{
+		while (emitted[cursor])
+			cursor++;
+
+		const uint32_t id = static_cast<uint32_t>(meshlets.size());
+		uint32_t meshletVertices = 0;
+		glm::vec3 centroidSum{ 0.0f };
+		glm::vec3 normalSum{ 0.0f };
+		candidates.clear();
+		triangles.clear();
+
+		auto add = [&](uint32_t triangle)
+		{
+			emitted[triangle] = 1;
+			triangles.push_back(triangle);
+			centroidSum += centroids[triangle];
+			normalSum += normals[triangle];
+
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t vertex = indices[3 * triangle + c];
+				if (vertexMeshlet[vertex] == id)
+					continue;
+
+				vertexMeshlet[vertex] = id;
+				meshletVertices++;
+
+				uint32_t position = positionRemap[vertex];
+				for (uint32_t k = offsets[position]; k < offsets[position + 1]; k++)
+				{
+					uint32_t neighbour = adjacency[k];
+					if (!emitted[neighbour] && candidateMeshlet[neighbour] != id)
+					{
+						candidateMeshlet[neighbour] = id;
+						candidates.push_back(neighbour);
+					}
+				}
+			}
+		};
+
+		add(cursor);
+
+		while (triangles.size() < MAX_TRIANGLES)
+		{
+			glm::vec3 center = centroidSum / static_cast<float>(triangles.size());
+			float normalLength = glm::length(normalSum);
+			glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3{ 0.0f };
+
+			uint32_t best = NONE;
+			uint32_t bestNew = 4;
+			float bestScore = std::numeric_limits<float>::max();
+
+			auto consider = [&](uint32_t triangle)
+			{
+				uint32_t newVertices = 0;
+				for (int c = 0; c < 3; c++)
+					newVertices += vertexMeshlet[indices[3 * triangle + c]] != id ? 1 : 0;
+
+				if (meshletVertices + newVertices > MAX_VERTICES)
+					return;
+
+				float score = glm::length(centroids[triangle] - center) * (1.0f + CONE_WEIGHT * (1.0f - glm::dot(normals[triangle], axis)));
+				if (newVertices < bestNew || (newVertices == bestNew && score < bestScore))
+				{
+					best = triangle;
+					bestNew = newVertices;
+					bestScore = score;
+				}
+			};
+
+			size_t write = 0;
+			for (uint32_t triangle : candidates)
+			{
+				if (emitted[triangle])
+					continue;
+				candidates[write++] = triangle;
+				consider(triangle);
+			}
+			candidates.resize(write);
+
+			// Nothing connected fits, continue with the closest triangle nearby
+			// in the index order (a separate part, e.g. a loose prop)
+			if (best == NONE)
+			{
+				const uint32_t end = static_cast<uint32_t>(std::min<size_t>(cursor + SEARCH_WINDOW, triangleCount));
+				for (uint32_t triangle = cursor; triangle < end; triangle++)
+				{
+					if (!emitted[triangle])
+						consider(triangle);
+				}
+			}
+
+			if (best == NONE)
+				break;
+
+			add(best);
+		}
+
+		MyModel::Meshlet meshlet{};
+		meshlet.firstIndex = static_cast<uint32_t>(result.size());
+		meshlet.indexCount = static_cast<uint32_t>(3 * triangles.size());
+		meshlet.vertexCount = meshletVertices;
+		for (uint32_t triangle : triangles)
+			result.insert(result.end(), indices.begin() + 3 * triangle, indices.begin() + 3 * triangle + 3);
+
+		meshlets.push_back(meshlet);
+		done += triangles.size();
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+
+	for (auto& meshlet : meshlets)
+		computeBounds(vertices, indices, meshlet);
+
+	return meshlets;
+}
+
+void MyMeshletBuilder::computeBounds(
+	const std::vector<MyModel::Vertex>& vertices,
+	const std::vector<uint32_t>& indices,
+	MyModel::Meshlet& meshlet)
+{
+	const uint32_t begin = meshlet.firstIndex;
+	const uint32_t end = meshlet.firstIndex + meshlet.indexCount;
+
+	glm::vec3 minPosition = vertices[indices[begin]].position;
+	glm::vec3 maxPosition = minPosition;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		minPosition = glm::min(minPosition, vertices[indices[i]].position);
+		maxPosition = glm::max(maxPosition, vertices[indices[i]].position);
+	}
+
+	meshlet.center = 0.5f * (minPosition + maxPosition);
+	meshlet.radius = 0.0f;
+	for (uint32_t i = begin; i < end; i++)
+		meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+
+	// Normal cone (the same test as meshoptimizer's meshopt_computeMeshletBounds):
+	// every triangle faces away from an eye for which
+	// dot(normalize(apex - eye), axis) >= cutoff
+	glm::vec3 normalSum{ 0.0f };
+	for (uint32_t i = begin; i < end; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i + 0]].position;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+			normalSum += normal / length;
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3{ 0.0f };
+	meshlet.coneCutoff = 1.0f;
+
+	float sumLength = glm::length(normalSum);
+	if (sumLength == 0.0f)
+		return;
+
+	glm::vec3 axis = normalSum / sumLength;
+	float minDot = 1.0f;
+	for (uint32_t i = begin; i < end; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i + 0]].position;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+			minDot = std::min(minDot, glm::dot(normal / length, axis));
+	}
+
+	if (minDot <= MIN_CONE_DOT)
+		return;
+
+	// Move the apex back along the axis until it is behind every triangle plane
+	float maxT = 0.0f;
+	for (uint32_t i = begin; i < end; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i + 0]].position;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+
+		normal /= length;
+		maxT = std::max(maxT, glm::dot(meshlet.center - p0, normal) / glm::dot(axis, normal));
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
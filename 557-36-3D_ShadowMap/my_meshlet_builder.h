@@ -0,0 +1,37 @@
+#ifndef __MY_MESHLET_BUILDER_H__
+#define __MY_MESHLET_BUILDER_H__
+
+#include "my_model.h"
+
+// Std
+#include <vector>
+
+//
+// Splits a triangle list into meshlets (clusters) and reorders the indices so
+// every meshlet is one contiguous range. A meshlet grows from a seed triangle
+// by adding the neighbouring triangle that brings in the fewest new vertices,
+// then the one closest to the meshlet and facing the same way, which keeps
+// the bounding spheres small and the normal cones narrow.
+//
+class MyMeshletBuilder
+{
+public:
+	// Sizes that also suit mesh shaders (NVIDIA recommends 64 / 126)
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+	// Reorders 'indices' and returns the meshlets of its [0, indexCount) range
+	static std::vector<MyModel::Meshlet> build(
+		const std::vector<MyModel::Vertex>& vertices,
+		std::vector<uint32_t>& indices,
+		size_t indexCount);
+
+	// Bounding sphere and normal cone of the triangles in [firstIndex, firstIndex + indexCount)
+	static void computeBounds(
+		const std::vector<MyModel::Vertex>& vertices,
+		const std::vector<uint32_t>& indices,
+		MyModel::Meshlet& meshlet);
+};
+
+#endif
+
@@ -0,0 +1,93 @@
+#include "my_meshlet_culler.h"
+#include "my_camera.h"
+
+// Std
+#include <algorithm>
+#include <cmath>
+
+void MyMeshletCuller::setView(const glm::mat4& viewProjection, const glm::vec3& eyePosition)
+{
+	MyCamera::extractFrustumPlanes(viewProjection, m_planes);
+	m_v3Eye = eyePosition;
+}
+
+bool MyMeshletCuller::isVisible(const glm::vec3& center, float radius) const
+{
+	for (const auto& plane : m_planes)
+	{
+		if (glm::dot(glm::vec3{ plane.x, plane.y, plane.z }, center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+void MyMeshletCuller::setViewFrom(const MyMeshletCuller& other)
+{
+	std::copy(std::begin(other.m_planes), std::end(other.m_planes), std::begin(m_planes));
+	m_v3Eye = other.m_v3Eye;
+	m_bBackfaceCulling = other.m_bBackfaceCulling;
+	m_bMeshletCulling = other.m_bMeshletCulling;
+	resetStats();
+}
+
+void MyMeshletCuller::addStats(const Stats& stats)
+{
+	m_stats.meshletCount += stats.meshletCount;
+	m_stats.frustumCulled += stats.frustumCulled;
+	m_stats.backfaceCulled += stats.backfaceCulled;
+	m_stats.drawCount += stats.drawCount;
+}
+
+const std::vector<MyMeshletCuller::IndexRange>& MyMeshletCuller::cull(
+	const std::vector<MyModel::Meshlet>& meshlets, const glm::mat4& modelMatrix)
+{
+	m_ranges.clear();
+
+	glm::vec3 axes[3] = { glm::vec3{ modelMatrix[0] }, glm::vec3{ modelMatrix[1] }, glm::vec3{ modelMatrix[2] } };
+	float scales[3] = { glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) };
+	float maxScale = std::max({ scales[0], scales[1], scales[2] });
+	float minScale = std::min({ scales[0], scales[1], scales[2] });
+
+	// Normal cones survive rotation and uniform scale, not stretching or mirroring
+	bool bBackface = m_bBackfaceCulling &&
+		maxScale <= minScale * 1.001f &&
+		glm::dot(glm::cross(axes[0], axes[1]), axes[2]) > 0.0f;
+
+	for (const auto& meshlet : meshlets)
+	{
+		m_stats.meshletCount++;
+
+		glm::vec3 center{ modelMatrix * glm::vec4{ meshlet.center, 1.0f } };
+		float radius = meshlet.radius * maxScale;
+
+		if (!isVisible(center, radius))
+		{
+			m_stats.frustumCulled++;
+			continue;
+		}
+
+		if (bBackface && meshlet.coneCutoff < 1.0f)
+		{
+			glm::vec3 apex{ modelMatrix * glm::vec4{ meshlet.coneApex, 1.0f } };
+			glm::vec3 axis = (axes[0] * meshlet.coneAxis.x + axes[1] * meshlet.coneAxis.y + axes[2] * meshlet.coneAxis.z) / maxScale;
+			glm::vec3 view = apex - m_v3Eye;
+			float distance = glm::length(view);
+
+			if (distance > 0.0f && glm::dot(view / distance, axis) >= meshlet.coneCutoff)
+			{
+				m_stats.backfaceCulled++;
+				continue;
+			}
+		}
+
+		// Meshlets are stored back to back, so neighbours extend the last range
+		if (!m_ranges.empty() && m_ranges.back().firstIndex + m_ranges.back().indexCount == meshlet.firstIndex)
+			m_ranges.back().indexCount += meshlet.indexCount;
+		else
+			m_ranges.push_back({ meshlet.firstIndex, meshlet.indexCount });
+	}
+
+	m_stats.drawCount += static_cast<uint32_t>(m_ranges.size());
+	return m_ranges;
+}
+
@@ -0,0 +1,75 @@
+#ifndef __MY_MESHLET_CULLER_H__
+#define __MY_MESHLET_CULLER_H__
+
+#include "my_model.h"
+
+// libs
+#include <glm/glm.hpp>
+
+// Std
+#include <vector>
+
+//
+// Per-pass CPU culling of MyModel::Meshlet clusters: a meshlet is rejected
+// when its bounding sphere is outside the view frustum, or (optionally) when
+// its normal cone says every triangle faces away from the eye. The meshlets
+// that are left come back as index ranges, neighbours merged, so a mostly
+// visible model still costs only a few draw calls.
+//
+class MyMeshletCuller
+{
+public:
+	struct IndexRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// Counters since the last resetStats()
+	struct Stats
+	{
+		uint32_t meshletCount = 0;
+		uint32_t frustumCulled = 0;
+		uint32_t backfaceCulled = 0;
+		uint32_t drawCount = 0;   // index ranges emitted
+	};
+
+	// 'viewProjection' gives the frustum (camera or light), 'eyePosition' the backface test
+	void setView(const glm::mat4& viewProjection, const glm::vec3& eyePosition);
+
+	// Only correct if back faces would not be seen, e.g. closed meshes
+	void setBackfaceCulling(bool bEnable) { m_bBackfaceCulling = bEnable; }
+
+	// Off, MyModel::draw draws whole LODs and only the objects are culled (MyRenderQueue)
+	void setMeshletCulling(bool bEnable) { m_bMeshletCulling = bEnable; }
+	bool meshletCulling() const { return m_bMeshletCulling; }
+
+	// Bounding sphere against the frustum, e.g. for whole objects (MyRenderQueue)
+	bool isVisible(const glm::vec3& center, float radius) const;
+
+	// The frustum planes (xyz normal, w distance) for culling on the GPU (MyGpuCuller)
+	const glm::vec4* planes() const { return m_planes; }
+
+	// Same frustum, eye and settings as 'other' with stats of its own,
+	// for a copy per recording thread (see MyParallelRecorder)
+	void setViewFrom(const MyMeshletCuller& other);
+
+	void         resetStats() { m_stats = Stats{}; }
+	void         addStats(const Stats& stats);
+	const Stats& stats() const { return m_stats; }
+
+	// Visible index ranges of 'meshlets' for an object with 'modelMatrix'.
+	// The result is valid until the next call.
+	const std::vector<IndexRange>& cull(const std::vector<MyModel::Meshlet>& meshlets, const glm::mat4& modelMatrix);
+
+private:
+	glm::vec4               m_planes[6]{}; // all zero culls nothing
+	glm::vec3               m_v3Eye{ 0.0f };
+	bool                    m_bBackfaceCulling = true;
+	bool                    m_bMeshletCulling = true;
+	Stats                   m_stats;
+	std::vector<IndexRange> m_ranges;
+};
+
+#endif
+
@@ -1,158 +1,335 @@
 #include "my_model.h"
+#include "my_mesh_cache.h"
+#include "my_meshlet_builder.h"
+#include "my_meshlet_culler.h"
+#include "my_upload_batch.h"
+#include "my_mesh_optimizer.h"
+#include "my_mesh_simplifier.h"
+#include "my_obj_parser.h"
 #include "my_utils.h"
+#include "my_vertex_welder.h"
 
 // libs
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
-#include <unordered_map>
-
-namespace std {
-	template <>
-	struct hash<MyModel::Vertex> {
-		size_t operator()(MyModel::Vertex const& vertex) const {
-			size_t seed = 0;
-			myHashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
-		}
-	};
-}
+
+MyModel::VertexFormat MyModel::s_vertexFormat = MyModel::VERTEX_FORMAT_FLOAT;
+std::weak_ptr<MyGeometryArena> MyModel::s_geometryArena;
+std::mutex MyModel::s_geometryArenaMutex;
 
 MyModel::MyModel(MyDevice& device, const std::vector<Vertex>& vertices) :
 	m_myDevice{ device },
 	m_iVertexCount{ 0 }
 {
-	_createVertexBuffer(vertices, false);
+	_createBuffers(vertices.data(), static_cast<uint32_t>(vertices.size()), nullptr, 0, nullptr);
+	_createLods(vertices.data(), nullptr, 0);
+}
+
+MyModel::MyModel(MyDevice& device, const MyModel::Builder& builder, MyUploadBatch* pUploadBatch) : 
+	m_myDevice{ device },
+	m_iVertexCount{ 0 }
+{
+	_createBuffers(
+		builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()),
+		builder.indices.data(), static_cast<uint32_t>(builder.indices.size()), pUploadBatch);
+	_createLods(builder.vertices.data(), builder.lods.data(), static_cast<uint32_t>(builder.lods.size()));
+	m_meshlets = builder.meshlets;
 }
 
-MyModel::MyModel(MyDevice& device, const MyModel::Builder& builder) : 
+MyModel::MyModel(MyDevice& device, const Vertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+	const Lod* pLods, uint32_t lodCount, const Meshlet* pMeshlets, uint32_t meshletCount, MyUploadBatch* pUploadBatch) :
 	m_myDevice{ device },
 	m_iVertexCount{ 0 }
 {
-	_createVertexBuffer(builder.vertices, true);
-	_createIndexBuffers(builder.indices);
+	_createBuffers(pVertices, vertexCount, pIndices, indexCount, pUploadBatch);
+	_createLods(pVertices, pLods, lodCount);
+
+	if (meshletCount > 0)
+		m_meshlets.assign(pMeshlets, pMeshlets + meshletCount);
+}
+
+MyModel::~MyModel()
+{
+	// Note: like destroying a buffer, the GPU must be done with the model
+	if (m_pGeometryArena)
+		m_pGeometryArena->free(m_allocation);
 }
 
 std::unique_ptr<MyModel> MyModel::createModelFromFile(
-	MyDevice& device, const std::string& filepath, unsigned int id) 
+	MyDevice& device, const std::string& filepath, unsigned int id, bool bOptimize, bool bGenerateLods, bool bBuildMeshlets,
+	MyUploadBatch* pUploadBatch) 
 {
 	Builder builder{};
+	builder.optimizeMesh = bOptimize;
+	builder.generateLods = bGenerateLods;
+	builder.buildMeshlets = bBuildMeshlets;
+
+	// Warm start: upload straight from the memory-mapped cache file
+	if (auto pCache = MyMeshCache::open(filepath, id, builder))
+	{
+		return std::make_unique<MyModel>(
+			device, pCache->vertices(), pCache->vertexCount(), pCache->indices(), pCache->indexCount(),
+			pCache->lods(), pCache->lodCount(), pCache->meshlets(), pCache->meshletCount(), pUploadBatch);
+	}
+
 	builder.loadModel(filepath, id);
-	return std::make_unique<MyModel>(device, builder);
+	return std::make_unique<MyModel>(device, builder, pUploadBatch);
 }
 
-void MyModel::_createVertexBuffer(const std::vector<Vertex>& vertices, bool bUseIndexBuffer)
+std::shared_ptr<MyGeometryArena> MyModel::_geometryArena(MyDevice& device)
 {
-    m_iVertexCount = static_cast<uint32_t>(vertices.size());
-    assert(m_iVertexCount >= 3 && "Vertex count must be at least 3");
-    
-    // number of bytes need to store the vertex buffer
-    // Note: we assume Color and Position are interleaved here
-    // inside the vertex buffer
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * m_iVertexCount;
-	uint32_t vertexSize = sizeof(vertices[0]);
-    
-    // Create buffer handle and allocate buffer memory on GPU side
-    // Note: Host - CPU
-    //       Device - GPU
-    // VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT - make sure the GPU memory is visible to the host
-    // VK_MEMORY_PROPERTY_HOST_COHERENT_BIT - make sure the host and device memory is consistent
-
-    // Note: Use stage buffer to copy memory buffer can be faster
-	// because VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT can be slower
-	MyBuffer stagingBuffer
+	std::lock_guard<std::mutex> lock{ s_geometryArenaMutex };
+
+	std::shared_ptr<MyGeometryArena> pArena = s_geometryArena.lock();
+	if (!pArena)
 	{
-	  m_myDevice,
-	  vertexSize,     // size of an instance
-	  m_iVertexCount, // number of instances
-	  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	// Note: it will unmap in the destructor
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)vertices.data());
-
-	m_pMyVertexBuffer = std::make_unique<MyBuffer>(
-		m_myDevice,
-		vertexSize,
-		m_iVertexCount,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	// Copy from stage buffer to device local buffer
-	// Note: because device local buffer can perform faster, but cannot access by CPU
-	// thus we need to copy to a stage buffer first then copy from the stage buffer
-	// to the device local buffer
-	m_myDevice.copyBuffer(stagingBuffer.buffer(), m_pMyVertexBuffer->buffer(), bufferSize);
+		std::vector<uint32_t> strides;
+		for (const auto& binding : getBindingDescriptions(s_vertexFormat))
+			strides.push_back(binding.stride);
+
+		pArena = std::make_shared<MyGeometryArena>(device, strides);
+		s_geometryArena = pArena;
+	}
+
+	return pArena;
 }
 
-void MyModel::_createIndexBuffers(const std::vector<uint32_t>& indices) 
+std::shared_ptr<MyGeometryArena> MyModel::geometryArena()
 {
-	m_iIndexCount = static_cast<uint32_t>(indices.size());
+	std::lock_guard<std::mutex> lock{ s_geometryArenaMutex };
+	return s_geometryArena.lock();
+}
+
+MyGeometryArena::Stats MyModel::geometryArenaStats()
+{
+	std::lock_guard<std::mutex> lock{ s_geometryArenaMutex };
+
+	std::shared_ptr<MyGeometryArena> pArena = s_geometryArena.lock();
+	return pArena ? pArena->stats() : MyGeometryArena::Stats{};
+}
+
+void MyModel::_createBuffers(const Vertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount, MyUploadBatch* pUploadBatch)
+{
+	m_iVertexCount = vertexCount;
+	assert(m_iVertexCount >= 3 && "Vertex count must be at least 3");
+
+	m_iIndexCount = indexCount;
 	m_bHasIndexBuffer = m_iIndexCount > 0;
 
-	if (!m_bHasIndexBuffer) 
+	// 16 bit indices halve the index memory whenever every vertex can be addressed,
+	// the indices are relative to the model's first vertex in the arena (vertexOffset)
+	// Note: primitive restart is off, so 0xFFFF is an ordinary index
+	m_vkIndexType = m_iVertexCount <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	VkDeviceSize indexSize = m_vkIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	m_pGeometryArena = _geometryArena(m_myDevice);
+	m_allocation = m_pGeometryArena->allocate(m_iVertexCount, indexSize * m_iIndexCount, indexSize);
+	m_iFirstIndex = static_cast<uint32_t>(m_allocation.indexOffset / indexSize);
+
+	// Every stream reserves the model's vertex range, even the color stream of a mesh without colors
+	m_iVertexMemorySize = m_iVertexCount * m_pGeometryArena->vertexSize();
+	m_iIndexMemorySize = indexSize * m_iIndexCount;
+
+	// Note: device local memory is faster but usually cannot be accessed by the CPU, so the data
+	// goes through staging memory. Without the caller's batch all copies go in one submission,
+	// or a few when they do not fit the staging pool at once. With unified memory the arena's
+	// pages are mapped and the copies write in place
+	const MyGeometryArena::Buffers& buffers = *m_allocation.pBuffers;
+	MyUploadBatch localBatch{ m_myDevice, true };
+	MyUploadBatch& batch = pUploadBatch ? *pUploadBatch : localBatch;
+	if (s_vertexFormat == VERTEX_FORMAT_PACKED)
 	{
-		return;
+		PackedVertices packed = packVertices(pVertices, vertexCount);
+		m_positionTransform = packed.positionTransform;
+
+		batch.copyToBuffer(packed.positions.data(), sizeof(PackedPosition) * m_iVertexCount,
+			buffers.vertexBuffers[0], sizeof(PackedPosition) * m_allocation.firstVertex, buffers.pMappedVertexBuffers[0]);
+		batch.copyToBuffer(packed.attributes.data(), sizeof(PackedAttributes) * m_iVertexCount,
+			buffers.vertexBuffers[1], sizeof(PackedAttributes) * m_allocation.firstVertex, buffers.pMappedVertexBuffers[1]);
+
+		// Without colors the shaders ignore binding 2, because position.w is 0
+		if (!packed.colors.empty())
+		{
+			batch.copyToBuffer(packed.colors.data(), sizeof(uint32_t) * m_iVertexCount,
+				buffers.vertexBuffers[2], sizeof(uint32_t) * m_allocation.firstVertex, buffers.pMappedVertexBuffers[2]);
+		}
+	}
+	else
+	{
+		batch.copyToBuffer(pVertices, sizeof(Vertex) * m_iVertexCount,
+			buffers.vertexBuffers[0], sizeof(Vertex) * m_allocation.firstVertex, buffers.pMappedVertexBuffers[0]);
 	}
 
-	VkDeviceSize bufferSize = sizeof(indices[0]) * m_iIndexCount;
-	uint32_t indexSize = sizeof(indices[0]);
+	if (!m_bHasIndexBuffer)
+		return;
 
-	MyBuffer stagingBuffer{
-	  m_myDevice,
-	  indexSize,
-	  m_iIndexCount,
-	  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
+	if (m_vkIndexType == VK_INDEX_TYPE_UINT16)
+	{
+		std::vector<uint16_t> shortIndices(pIndices, pIndices + m_iIndexCount);
+		batch.copyToBuffer(shortIndices.data(), m_iIndexMemorySize, buffers.indexBuffer, m_allocation.indexOffset, buffers.pMappedIndexBuffer);
+	}
+	else
+	{
+		batch.copyToBuffer(pIndices, m_iIndexMemorySize, buffers.indexBuffer, m_allocation.indexOffset, buffers.pMappedIndexBuffer);
+	}
+}
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)indices.data());
+void MyModel::_createLods(const Vertex* pVertices, const Lod* pLods, uint32_t lodCount)
+{
+	if (lodCount > 0)
+		m_lods.assign(pLods, pLods + lodCount);
+	else
+		m_lods.assign(1, Lod{ 0, m_iIndexCount, 0.0f });
 
-	m_pMyIndexBuffer = std::make_unique<MyBuffer>(
-		m_myDevice,
-		indexSize,
-		m_iIndexCount,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// Bounding box, and a sphere around its center: the LOD selection measures the distance to it
+	glm::vec3 minPosition = pVertices[0].position;
+	glm::vec3 maxPosition = pVertices[0].position;
+	for (uint32_t i = 0; i < m_iVertexCount; i++)
+	{
+		minPosition = glm::min(minPosition, pVertices[i].position);
+		maxPosition = glm::max(maxPosition, pVertices[i].position);
+	}
 
-	m_myDevice.copyBuffer(stagingBuffer.buffer(), m_pMyIndexBuffer->buffer(), bufferSize);
+	m_v3BoundingCenter = 0.5f * (minPosition + maxPosition);
+	m_v3BoundingExtent = 0.5f * (maxPosition - minPosition);
+	m_fBoundingRadius = 0.0f;
+	for (uint32_t i = 0; i < m_iVertexCount; i++)
+		m_fBoundingRadius = std::max(m_fBoundingRadius, glm::length(pVertices[i].position - m_v3BoundingCenter));
 }
 
-void MyModel::bind(VkCommandBuffer commandBuffer)
+void MyModel::bind(VkCommandBuffer commandBuffer, BindState* pState)
 {
-	// Bind vertex buffer and index buffer
-	VkBuffer buffers[] = { m_pMyVertexBuffer->buffer() };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	// All streams of an arena page are bound at offset 0, draws select the model with vertexOffset
+	const MyGeometryArena::Buffers& buffers = *m_allocation.pBuffers;
+	if (pState == nullptr || pState->vertexBuffer != buffers.vertexBuffers[0])
+	{
+		VkDeviceSize offsets[MyGeometryArena::MAX_VERTEX_STREAMS] = {};
+		vkCmdBindVertexBuffers(commandBuffer, 0, m_pGeometryArena->streamCount(), buffers.vertexBuffers, offsets);
+	}
 
-	if (m_bHasIndexBuffer) 
+	if (m_bHasIndexBuffer && (pState == nullptr || pState->indexBuffer != buffers.indexBuffer || pState->indexType != m_vkIndexType))
 	{
-		vkCmdBindIndexBuffer(commandBuffer, m_pMyIndexBuffer->buffer(), 0, VK_INDEX_TYPE_UINT32); // can store up to 2^32 -1 indices
+		vkCmdBindIndexBuffer(commandBuffer, buffers.indexBuffer, 0, m_vkIndexType); // uint16 when the vertex count allows it
+	}
+
+	if (pState)
+	{
+		pState->vertexBuffer = buffers.vertexBuffers[0];
+		if (m_bHasIndexBuffer)
+		{
+			pState->indexBuffer = buffers.indexBuffer;
+			pState->indexType = m_vkIndexType;
+		}
 	}
 }
 
-void MyModel::draw(VkCommandBuffer commandBuffer)
+uint32_t MyModel::draw(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount)
 {
+	int32_t vertexOffset = static_cast<int32_t>(m_allocation.firstVertex);
 	if (m_bHasIndexBuffer)
 	{
-		vkCmdDrawIndexed(commandBuffer, m_iIndexCount, 1, 0, 0, 0);
+		const Lod& range = m_lods[std::min(lod, lodCount() - 1)];
+		vkCmdDrawIndexed(commandBuffer, range.indexCount, instanceCount, m_iFirstIndex + range.firstIndex, vertexOffset, firstInstance);
+		return range.indexCount / 3 * instanceCount;
 	}
 	else
 	{
-		vkCmdDraw(commandBuffer, m_iVertexCount, 1, 0, 0);
+		vkCmdDraw(commandBuffer, m_iVertexCount, instanceCount, m_allocation.firstVertex, firstInstance);
+		return m_iVertexCount / 3 * instanceCount;
+	}
+}
+
+VkDrawIndexedIndirectCommand MyModel::drawCommand(uint32_t lod, uint32_t firstInstance) const
+{
+	VkDrawIndexedIndirectCommand command{};
+	command.instanceCount = 1;
+	command.firstInstance = firstInstance;
+	if (m_bHasIndexBuffer)
+	{
+		const Lod& range = m_lods[std::min(lod, lodCount() - 1)];
+		command.indexCount = range.indexCount;
+		command.firstIndex = m_iFirstIndex + range.firstIndex;
+		command.vertexOffset = static_cast<int32_t>(m_allocation.firstVertex);
+	}
+	else
+	{
+		command.indexCount = m_iVertexCount;
+		command.firstIndex = m_allocation.firstVertex;
+	}
+	return command;
+}
+
+glm::vec4 MyModel::storedBoundingSphere() const
+{
+	// positionTransform scales and translates per axis, the smallest scale bounds the radius
+	glm::vec3 scale{ m_positionTransform[0][0], m_positionTransform[1][1], m_positionTransform[2][2] };
+	glm::vec3 center = (m_v3BoundingCenter - glm::vec3{ m_positionTransform[3] }) / scale;
+	return glm::vec4{ center, m_fBoundingRadius / std::min({ scale.x, scale.y, scale.z }) };
+}
+
+uint32_t MyModel::selectLod(const glm::mat4& modelMatrix, const MyCamera& camera, float viewportHeight, float pixelError) const
+{
+	return selectLod(m_lods.data(), lodCount(), m_v3BoundingCenter, m_fBoundingRadius, modelMatrix, camera, viewportHeight, pixelError);
+}
+
+uint32_t MyModel::selectLod(
+	const Lod* pLods, uint32_t lodCount, const glm::vec3& boundingCenter, float boundingRadius,
+	const glm::mat4& modelMatrix, const MyCamera& camera, float viewportHeight, float pixelError)
+{
+	if (pixelError <= 0.0f || lodCount < 2)
+		return 0;
+
+	// The LOD errors are in model space, scale them like the largest axis of the object
+	float scale = std::max({
+		glm::length(glm::vec3{ modelMatrix[0] }),
+		glm::length(glm::vec3{ modelMatrix[1] }),
+		glm::length(glm::vec3{ modelMatrix[2] }) });
+
+	glm::vec3 center{ modelMatrix * glm::vec4{ boundingCenter, 1.0f } };
+	float pixelsPerUnit = camera.pixelsPerUnit(center, boundingRadius * scale, viewportHeight);
+
+	for (uint32_t lod = lodCount - 1; lod > 0; lod--)
+	{
+		if (pLods[lod].error * scale * pixelsPerUnit <= pixelError)
+			return lod;
 	}
+
+	return 0;
 }
 
-std::vector<VkVertexInputBindingDescription> MyModel::getBindingDescriptions()
+uint32_t MyModel::draw(VkCommandBuffer commandBuffer, uint32_t lod, MyMeshletCuller* pCuller, const glm::mat4& modelMatrix,
+	uint32_t firstInstance)
 {
+	// Meshlets only exist for LOD 0, the coarser LODs are small enough to draw whole
+	if (lod != 0 || pCuller == nullptr || !pCuller->meshletCulling() || m_meshlets.empty())
+		return draw(commandBuffer, lod, firstInstance);
+
+	uint32_t indexCount = 0;
+	for (const auto& range : pCuller->cull(m_meshlets, modelMatrix))
+	{
+		vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, m_iFirstIndex + range.firstIndex, static_cast<int32_t>(m_allocation.firstVertex), firstInstance);
+		indexCount += range.indexCount;
+	}
+
+	return indexCount / 3;
+}
+
+std::vector<VkVertexInputBindingDescription> MyModel::getBindingDescriptions(VertexFormat format)
+{
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(3);
+		bindingDescriptions[0] = { 0, sizeof(PackedPosition), VK_VERTEX_INPUT_RATE_VERTEX };
+		bindingDescriptions[1] = { 1, sizeof(PackedAttributes), VK_VERTEX_INPUT_RATE_VERTEX };
+		bindingDescriptions[2] = { 2, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_VERTEX };
+		return bindingDescriptions;
+	}
+
     std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
     bindingDescriptions[0].binding = 0;
     bindingDescriptions[0].stride = sizeof(Vertex);
@@ -161,10 +338,21 @@ std::vector<VkVertexInputBindingDescription> MyModel::getBindingDescriptions()
     return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> MyModel::getAttributeDescriptions()
+std::vector<VkVertexInputAttributeDescription> MyModel::getAttributeDescriptions(VertexFormat format)
 {
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{}; // now we have more info passing to shaders
 
+	// Note: the shaders see the same locations for both layouts
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedPosition, x) });
+		attributeDescriptions.push_back({ 1, 2, VK_FORMAT_R8G8B8A8_UNORM, 0 });
+		attributeDescriptions.push_back({ 2, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedAttributes, normal) });
+		attributeDescriptions.push_back({ 3, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedAttributes, uv) });
+		attributeDescriptions.push_back({ 4, 1, VK_FORMAT_R32_SFLOAT, offsetof(PackedAttributes, id) }); // for picking
+		return attributeDescriptions;
+	}
+
 	attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
 	attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
 	attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
@@ -174,83 +362,209 @@ std::vector<VkVertexInputAttributeDescription> MyModel::getAttributeDescriptions
 	return attributeDescriptions;
 }
 
-void MyModel::Builder::loadModel(const std::string& filepath, unsigned int id)
+const VkSpecializationInfo* MyModel::vertexSpecializationInfo()
 {
-	// Note: attrib contains vertex, color, normal, texture coordinate...
-	// shapes contain the index elements for the geometry
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
-
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-		throw std::runtime_error(warn + err);
-	}
+	static VkBool32 bPacked;
+	static const VkSpecializationMapEntry entry{ 0, 0, sizeof(VkBool32) };
+	static const VkSpecializationInfo info{ 1, &entry, sizeof(VkBool32), &bPacked };
 
-	// Clear the original data if any
-	vertices.clear();
-	indices.clear();
-
-	// This will look for duplicate
-	// using overrrite hash funciton myHashCombine in my_untils.h
-	// and need to implement == operator in MyModel::Vertex
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	bPacked = s_vertexFormat == VERTEX_FORMAT_PACKED ? VK_TRUE : VK_FALSE;
+	return &info;
+}
 
-	for (const auto& shape : shapes)
+MyModel::PackedVertices MyModel::packVertices(const Vertex* pVertices, uint32_t vertexCount)
+{
+	PackedVertices packed{};
+	if (vertexCount == 0)
+		return packed;
+
+	// Quantize positions to 16 bits across the mesh bounds
+	glm::vec3 minPosition = pVertices[0].position;
+	glm::vec3 maxPosition = pVertices[0].position;
+	bool bHasColors = false;
+	for (uint32_t i = 0; i < vertexCount; i++)
 	{
-		for (const auto& index : shape.mesh.indices)
+		const Vertex& vertex = pVertices[i];
+		for (int k = 0; k < 3; k++)
 		{
-			Vertex vertex{};
+			minPosition[k] = std::min(minPosition[k], vertex.position[k]);
+			maxPosition[k] = std::max(maxPosition[k], vertex.position[k]);
+		}
 
-			if (index.vertex_index >= 0)
-			{
-				vertex.position = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2],
-				};
-
-				// Color may be appended to the postion field in the same line
-				// please see colored_cube.obj file
-				vertex.color = {
-					attrib.colors[3 * index.vertex_index + 0],
-					attrib.colors[3 * index.vertex_index + 1],
-					attrib.colors[3 * index.vertex_index + 2],
-				};
-			}
+		bHasColors = bHasColors || vertex.color != glm::vec3{ 1.0f, 1.0f, 1.0f };
+	}
 
-			if (index.normal_index >= 0)
-			{
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2],
-				};
-			}
+	glm::vec3 extent = maxPosition - minPosition;
+	for (int k = 0; k < 3; k++)
+	{
+		if (extent[k] <= 0.0f)
+			extent[k] = 1.0f;
+	}
 
-			if (index.texcoord_index >= 0)
-			{
-				vertex.uv = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1],
-				};
-			}
+	packed.positionTransform = glm::mat4{ 1.0f };
+	packed.positionTransform[0][0] = extent.x;
+	packed.positionTransform[1][1] = extent.y;
+	packed.positionTransform[2][2] = extent.z;
+	packed.positionTransform[3] = glm::vec4{ minPosition, 1.0f };
+
+	auto unorm16 = [](float value) { return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f)); };
+	auto snorm16 = [](float value) { return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f)); };
+	auto unorm8 = [](float value) { return static_cast<uint32_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f)); };
 
-			// add ID to vertex for picking
-			vertex.id = (float)id; // cast to float because the vertex binding is 32 bit float
+	packed.positions.resize(vertexCount);
+	packed.attributes.resize(vertexCount);
+	if (bHasColors)
+		packed.colors.resize(vertexCount);
 
-			if (uniqueVertices.count(vertex) == 0)
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		const Vertex& vertex = pVertices[i];
+
+		PackedPosition& position = packed.positions[i];
+		position.x = unorm16((vertex.position.x - minPosition.x) / extent.x);
+		position.y = unorm16((vertex.position.y - minPosition.y) / extent.y);
+		position.z = unorm16((vertex.position.z - minPosition.z) / extent.z);
+		position.w = bHasColors ? 0xFFFF : 0;
+
+		// Octahedral normal: project onto |x| + |y| + |z| = 1 and fold the lower half over
+		glm::vec3 n = vertex.normal;
+		float length1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+		float ox = 0.0f;
+		float oy = 0.0f;
+		if (length1 > 0.0f)
+		{
+			ox = n.x / length1;
+			oy = n.y / length1;
+			if (n.z < 0.0f)
 			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
+				float fx = (1.0f - std::fabs(oy)) * (ox >= 0.0f ? 1.0f : -1.0f);
+				float fy = (1.0f - std::fabs(ox)) * (oy >= 0.0f ? 1.0f : -1.0f);
+				ox = fx;
+				oy = fy;
 			}
+		}
 
-			indices.push_back(uniqueVertices[vertex]);
+		PackedAttributes& attributes = packed.attributes[i];
+		attributes.normal[0] = snorm16(ox);
+		attributes.normal[1] = snorm16(oy);
+		attributes.uv = glm::packHalf2x16(vertex.uv);
+		attributes.id = vertex.id;
 
-			// None optimized way. Not using index buffer
-			// more vertex to load
-			//vertices.push_back(vertex);
+		if (bHasColors)
+		{
+			packed.colors[i] = unorm8(vertex.color.r) | (unorm8(vertex.color.g) << 8) |
+				(unorm8(vertex.color.b) << 16) | (0xFFu << 24);
 		}
 	}
+
+	return packed;
 }
 
+void MyModel::Builder::loadModel(const std::string& filepath, unsigned int id)
+{
+	// Warm start: skip OBJ parsing when an up-to-date mesh cache exists
+	if (auto pCache = MyMeshCache::open(filepath, id, *this))
+	{
+		vertices.assign(pCache->vertices(), pCache->vertices() + pCache->vertexCount());
+		indices.assign(pCache->indices(), pCache->indices() + pCache->indexCount());
+		lods.assign(pCache->lods(), pCache->lods() + pCache->lodCount());
+		meshlets.assign(pCache->meshlets(), pCache->meshlets() + pCache->meshletCount());
+		return;
+	}
+
+	// Note: obj contains vertex, color, normal, texture coordinate...
+	// and the triangle corners of all shapes in file order.
+	// MyObjParser gives the same result as tinyobj::LoadObj but parses
+	// the file in parallel
+	MyObjParser obj{};
+	obj.parse(filepath);
+
+	// One vertex per triangle corner, MyVertexWelder removes the duplicates below
+	std::vector<Vertex> corners;
+	corners.reserve(obj.indices.size());
+
+	const int vertexCount = static_cast<int>(obj.vertices.size() / 3);
+	const int normalCount = static_cast<int>(obj.normals.size() / 3);
+	const int texcoordCount = static_cast<int>(obj.texcoords.size() / 2);
+
+	for (size_t i = 0; i < obj.indices.size(); i++)
+	{
+		// A triangle with a position out of range is skipped, as tinyobj skips such quads
+		if (i % 3 == 0 &&
+			(obj.indices[i].vertex_index >= vertexCount ||
+			 obj.indices[i + 1].vertex_index >= vertexCount ||
+			 obj.indices[i + 2].vertex_index >= vertexCount))
+		{
+			i += 2;
+			continue;
+		}
+
+		const auto& index = obj.indices[i];
+		Vertex& vertex = corners.emplace_back();
+
+		if (index.vertex_index >= 0)
+		{
+			vertex.position = {
+				obj.vertices[3 * index.vertex_index + 0],
+				obj.vertices[3 * index.vertex_index + 1],
+				obj.vertices[3 * index.vertex_index + 2],
+			};
+
+			// Color may be appended to the postion field in the same line
+			// please see colored_cube.obj file
+			vertex.color = {
+				obj.colors[3 * index.vertex_index + 0],
+				obj.colors[3 * index.vertex_index + 1],
+				obj.colors[3 * index.vertex_index + 2],
+			};
+		}
+
+		// Out of range normals and texture coordinates count as missing
+		if (index.normal_index >= 0 && index.normal_index < normalCount)
+		{
+			vertex.normal = {
+				obj.normals[3 * index.normal_index + 0],
+				obj.normals[3 * index.normal_index + 1],
+				obj.normals[3 * index.normal_index + 2],
+			};
+		}
+
+		if (index.texcoord_index >= 0 && index.texcoord_index < texcoordCount)
+		{
+			vertex.uv = {
+				obj.texcoords[2 * index.texcoord_index + 0],
+				obj.texcoords[2 * index.texcoord_index + 1],
+			};
+		}
+
+		// add ID to vertex for picking
+		vertex.id = (float)id; // cast to float because the vertex binding is 32 bit float
+	}
+
+	// Replaces the original data if any
+	// Note: with weldEpsilon == 0 this gives the same vertices and indices as
+	// the std::unordered_map<Vertex, uint32_t> lookup it replaces
+	MyVertexWelder welder{ weldEpsilon };
+	welder.weld(corners, vertices, indices);
+
+	if (optimizeMesh)
+	{
+		MyMeshOptimizer::optimize(vertices, indices);
+	}
+
+	// Before the LODs are appended, meshlets only cover LOD 0
+	meshlets.clear();
+	if (buildMeshlets)
+	{
+		meshlets = MyMeshletBuilder::build(vertices, indices, indices.size());
+	}
+
+	lods.clear();
+	if (generateLods)
+	{
+		MyMeshSimplifier::buildLodChain(vertices, indices, lods, optimizeMesh);
+	}
+
+	// Save the deduplicated arrays for the next start
+	MyMeshCache::write(filepath, id, *this);
+}
@@ -2,7 +2,9 @@
 #define __MY_MODEL_H__
 
 #include "my_buffer.h"
+#include "my_camera.h"
 #include "my_device.h"
+#include "my_geometry_arena.h"
 
 // use radian rather degree for angle
 #define GLM_FORCE_RADIANS
@@ -11,8 +13,12 @@
 
 // Std
 #include <memory>
+#include <mutex>
 #include <vector>
 
+class MyMeshletCuller;
+class MyUploadBatch;
+
 // Read vertex data from CPU and copy the data into GPU
 class MyModel
 {
@@ -33,41 +39,232 @@ public:
 		}
 	};
 
+	// Vertex buffer layout, chosen once before any model or pipeline is created
+	enum VertexFormat
+	{
+		VERTEX_FORMAT_FLOAT,  // one interleaved stream of Vertex (48 bytes)
+		VERTEX_FORMAT_PACKED  // three streams, 20 or 24 bytes, see PackedVertices
+	};
+
+	//
+	// Packed layout, split so depth-only passes fetch the position stream alone
+	//   binding 0: position  RGBA16_UNORM, quantized to the mesh bounds; w = 1 if the mesh has colors
+	//   binding 1: normal    RG16_SNORM octahedral, uv RG16_SFLOAT, id R32_SFLOAT
+	//   binding 2: color     RGBA8_UNORM, not stored when every vertex is white (the OBJ has none)
+	// positionTransform maps the quantized [0, 1] positions back to model space.
+	//
+	struct PackedPosition
+	{
+		uint16_t x, y, z, w;
+	};
+
+	struct PackedAttributes
+	{
+		int16_t  normal[2];
+		uint32_t uv;        // 2 x half
+		float    id;
+	};
+
+	struct PackedVertices
+	{
+		std::vector<PackedPosition>   positions{};
+		std::vector<PackedAttributes> attributes{};
+		std::vector<uint32_t>         colors{};
+		glm::mat4                     positionTransform{ 1.0f };
+	};
+
+	//
+	// Range of the index buffer drawn for one level of detail. All LODs share the
+	// vertex buffer; error is how far the LOD may be from LOD 0 in model space.
+	//
+	struct Lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float    error;
+	};
+
+	//
+	// Cluster of up to MyMeshletBuilder::MAX_VERTICES vertices / MAX_TRIANGLES
+	// triangles of LOD 0, drawn from a contiguous index range. The bounds are in
+	// model space: a sphere for frustum culling and a normal cone (apex, axis,
+	// cutoff) for backface culling, see MyMeshletCuller.
+	//
+	struct Meshlet
+	{
+		uint32_t  firstIndex;
+		uint32_t  indexCount;
+		glm::vec3 center;
+		float     radius;
+		glm::vec3 coneApex;
+		float     coneCutoff; // sin of the cone spread, 1 = never backfacing
+		glm::vec3 coneAxis;
+		uint32_t  vertexCount;
+	};
+
 	struct Builder
 	{
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
 
+		// Index ranges of the LODs in 'indices', empty = 'indices' is the only LOD
+		std::vector<Lod> lods{};
+
+		// Clusters of LOD 0, empty = not split
+		std::vector<Meshlet> meshlets{};
+
+		// 0 = weld bit-identical vertices only, see MyVertexWelder
+		float weldEpsilon = 0.0f;
+
+		// Reorder triangles and vertices for the GPU, see MyMeshOptimizer
+		bool optimizeMesh = false;
+
+		// Append simplified LODs to 'indices', see MyMeshSimplifier
+		bool generateLods = false;
+
+		// Split LOD 0 into meshlets for cluster culling, see MyMeshletBuilder
+		bool buildMeshlets = false;
+
 		void loadModel(const std::string& filepath, unsigned int id);
 	};
 
-	static std::vector<VkVertexInputBindingDescription>   getBindingDescriptions();
-	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	static void         setVertexFormat(VertexFormat format) { s_vertexFormat = format; }
+	static VertexFormat vertexFormat() { return s_vertexFormat; }
+
+	static std::vector<VkVertexInputBindingDescription>   getBindingDescriptions(VertexFormat format = s_vertexFormat);
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format = s_vertexFormat);
+
+	// Vertex shader specialization, constant_id 0 = packed layout (octahedral normals)
+	static const VkSpecializationInfo* vertexSpecializationInfo();
+
+	static PackedVertices packVertices(const Vertex* pVertices, uint32_t vertexCount);
 
 	MyModel(MyDevice &device, const std::vector<Vertex>& vertices);
-	MyModel(MyDevice& device, const MyModel::Builder& builder);
+	// With an upload batch the model is only usable once the batch has run on the GPU
+	MyModel(MyDevice& device, const MyModel::Builder& builder, MyUploadBatch* pUploadBatch = nullptr);
+	MyModel(MyDevice& device, const Vertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+		const Lod* pLods = nullptr, uint32_t lodCount = 0, const Meshlet* pMeshlets = nullptr, uint32_t meshletCount = 0,
+		MyUploadBatch* pUploadBatch = nullptr);
+	~MyModel();
+
+	MyModel(const MyModel&) = delete;
+	MyModel& operator=(const MyModel&) = delete;
+
+	// Takes over the arena range, so the loader's model can move into a MyResourcePool
+	MyModel(MyModel&&) = default;
 
 	// note: id is used for picking
 	// if id == 0.0f; no picking
+	// bOptimize runs MyMeshOptimizer on the loaded mesh
+	// bGenerateLods builds the LOD chain drawn by draw(commandBuffer, lod)
+	// bBuildMeshlets splits LOD 0 into meshlets for cluster culling
+	// pUploadBatch defers the uploads, see MyAssetLoader
 	static std::unique_ptr<MyModel> createModelFromFile(
-		MyDevice& device, const std::string& filepath, unsigned int id = 0);
+		MyDevice& device, const std::string& filepath, unsigned int id = 0,
+		bool bOptimize = false, bool bGenerateLods = false, bool bBuildMeshlets = false,
+		MyUploadBatch* pUploadBatch = nullptr);
+
+	// Buffers bound on a command buffer. Pass the same state to bind() for every
+	// model of a pass, models in the same geometry arena page then bind nothing.
+	// Reset it when something else binds vertex or index buffers.
+	struct BindState
+	{
+		VkBuffer    vertexBuffer = VK_NULL_HANDLE;
+		VkBuffer    indexBuffer = VK_NULL_HANDLE;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+	};
+
+	void bind(VkCommandBuffer commandBuffer, BindState* pState = nullptr);
+	// Draws LOD 'lod' 'instanceCount' times, gl_InstanceIndex starts at 'firstInstance'.
+	// Returns the triangles drawn.
+	uint32_t draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
+
+	// Draws LOD 'lod' once; for LOD 0 with a culler only the meshlets it keeps for an
+	// object with 'modelMatrix' (without positionTransform). Returns the triangles drawn.
+	uint32_t draw(VkCommandBuffer commandBuffer, uint32_t lod, MyMeshletCuller* pCuller, const glm::mat4& modelMatrix,
+		uint32_t firstInstance = 0);
+
+	// Arguments of draw(commandBuffer, lod) for an indirect draw of one instance at 'firstInstance'.
+	// Without an index buffer indexCount and firstIndex are the vertex count and first vertex
+	VkDrawIndexedIndirectCommand drawCommand(uint32_t lod, uint32_t firstInstance) const;
+	bool        hasIndexBuffer() const { return m_bHasIndexBuffer; }
+	VkIndexType indexType() const { return m_vkIndexType; }
+
+	const std::vector<Meshlet>& meshlets() const { return m_meshlets; }
+
+	// Model space bounding sphere (without positionTransform)
+	const glm::vec3& boundingCenter() const { return m_v3BoundingCenter; }
+	float            boundingRadius() const { return m_fBoundingRadius; }
+
+	// Model space bounding box around boundingCenter(), half its size per axis
+	const glm::vec3& boundingExtent() const { return m_v3BoundingExtent; }
 
-	void bind(VkCommandBuffer commandBuffer);
-	void draw(VkCommandBuffer commandBuffer);
+	// The bounding sphere (center, radius) for the model matrix times positionTransform,
+	// i.e. around the positions as stored; conservative for the packed layout
+	glm::vec4        storedBoundingSphere() const;
+
+	// Models in the same geometry arena page share their buffers, see BindState
+	uint32_t   geometryPage() const { return m_allocation.page; }
+
+	uint32_t   lodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+	const Lod& lod(uint32_t index) const { return m_lods[index]; }
+
+	// Coarsest LOD whose error covers at most 'pixelError' pixels on screen, for an
+	// object with 'modelMatrix' (without positionTransform) seen through 'camera'.
+	// pixelError <= 0 always selects LOD 0.
+	uint32_t selectLod(const glm::mat4& modelMatrix, const MyCamera& camera, float viewportHeight, float pixelError) const;
+
+	// Same for a LOD chain with the given model space bounding sphere
+	static uint32_t selectLod(
+		const Lod* pLods, uint32_t lodCount, const glm::vec3& boundingCenter, float boundingRadius,
+		const glm::mat4& modelMatrix, const MyCamera& camera, float viewportHeight, float pixelError);
+
+	// Multiply the model matrix by this, it undoes the position quantization
+	// of the packed layout (identity for the float layout)
+	const glm::mat4& positionTransform() const { return m_positionTransform; }
+
+	// Geometry arena memory of the vertex streams and indices in bytes
+	VkDeviceSize vertexMemorySize() const { return m_iVertexMemorySize; }
+	VkDeviceSize indexMemorySize() const { return m_iIndexMemorySize; }
+
+	// Occupancy of the arena the models of the current vertex format share
+	static MyGeometryArena::Stats geometryArenaStats();
+
+	// That arena, null while there are no models
+	static std::shared_ptr<MyGeometryArena> geometryArena();
 
 private:
 
-	void _createVertexBuffer(const std::vector<Vertex>& vertices, bool bUseIndexBuffer = false);
-	void _createIndexBuffers(const std::vector<uint32_t>& indices);
+	void _createBuffers(const Vertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount, MyUploadBatch* pUploadBatch);
+	void _createLods(const Vertex* pVertices, const Lod* pLods, uint32_t lodCount);
+
+	// Created with the first model, released with the last
+	static std::shared_ptr<MyGeometryArena> _geometryArena(MyDevice& device);
+
+	static VertexFormat                   s_vertexFormat;
+	static std::weak_ptr<MyGeometryArena> s_geometryArena;
+	static std::mutex                     s_geometryArenaMutex;
+
+	// Vertex and index ranges in the shared geometry arena
+	MyDevice&                        m_myDevice;
+	std::shared_ptr<MyGeometryArena> m_pGeometryArena;
+	MyGeometryArena::Allocation      m_allocation;
+	uint32_t                         m_iVertexCount = 0;
+	glm::mat4                        m_positionTransform{ 1.0f };
+
+	bool                             m_bHasIndexBuffer = false;
+	uint32_t                         m_iFirstIndex = 0;  // of the model's range, in indices of m_vkIndexType
+	uint32_t                         m_iIndexCount = 0;
+	VkIndexType                      m_vkIndexType = VK_INDEX_TYPE_UINT32;
 
-	// Use the new MyBuffer for vertex and index buffers
-	MyDevice&                 m_myDevice;
-	std::unique_ptr<MyBuffer> m_pMyVertexBuffer;
-	uint32_t                  m_iVertexCount = 0;
+	std::vector<Lod>                 m_lods;
+	std::vector<Meshlet>             m_meshlets;
+	glm::vec3                        m_v3BoundingCenter{ 0.0f }; // model space bounding sphere
+	float                            m_fBoundingRadius = 0.0f;
+	glm::vec3                        m_v3BoundingExtent{ 0.0f }; // model space bounding box
 
-	bool                      m_bHasIndexBuffer = false;
-	std::unique_ptr<MyBuffer> m_pMyIndexBuffer;
-	uint32_t                  m_iIndexCount = 0;
+	VkDeviceSize                     m_iVertexMemorySize = 0;
+	VkDeviceSize                     m_iIndexMemorySize = 0;
 };
 
 #endif
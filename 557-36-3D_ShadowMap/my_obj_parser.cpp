@@ -0,0 +1,574 @@
+#include "my_obj_parser.h"
+#include "my_mapped_file.h"
+
+// libs
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+// Std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+unsigned int MyObjParser::s_iThreadCount = 0;
+
+namespace
+{
+	// Don't bother spinning up threads for less than this per chunk
+	const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+	struct Corner
+	{
+		int v;
+		int vt;
+		int vn;
+	};
+
+	// Everything parsed from one line-aligned range of the file
+	struct Chunk
+	{
+		const char*           begin = nullptr;
+		const char*           end = nullptr;
+
+		std::vector<float>    v;
+		std::vector<float>    vc;
+		std::vector<float>    vn;
+		std::vector<float>    vt;
+		std::vector<Corner>   corners;
+		std::vector<uint32_t> faceSizes;
+
+		// Corners that used relative (negative) indices, these are only
+		// resolved within the chunk until the chunk base offsets are known
+		std::vector<size_t>   relativeV;
+		std::vector<size_t>   relativeVt;
+		std::vector<size_t>   relativeVn;
+
+		bool                  bHasPolygons = false; // faces with more than 4 corners
+		std::string           error;
+	};
+
+	inline bool isSpace(char c)    { return c == ' ' || c == '\t'; }
+	inline bool isDigit(char c)    { return c >= '0' && c <= '9'; }
+	inline bool isNewLine(char c)  { return c == '\r' || c == '\n' || c == '\0'; }
+
+	// Advance to the first character of 'stop' (or 'end')
+	inline const char* skipUntil(const char* s, const char* end, bool (*stop)(char))
+	{
+		while (s < end && !stop(*s))
+			s++;
+		return s;
+	}
+
+	inline bool isSpaceOrCR(char c)      { return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isSlashOrSpace(char c)   { return c == '/' || c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isNotSpace(char c)       { return !isSpace(c); }
+	inline bool isNotSpaceOrCR(char c)   { return !isSpaceOrCR(c); }
+
+	//
+	// Range based float parser. It follows tinyobj's tryParseDouble step by
+	// step (including its rounding) so the parsed values are bit-identical
+	// to what tinyobj::LoadObj returns.
+	//
+	bool parseDouble(const char* s, const char* end, double* result)
+	{
+		if (s >= end)
+			return false;
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		char sign = '+';
+		char expSign = '+';
+		const char* curr = s;
+		int read = 0;
+		bool bLeadingDot = false;
+
+		if (*curr == '+' || *curr == '-')
+		{
+			sign = *curr;
+			curr++;
+			if (curr != end && *curr == '.')
+				bLeadingDot = true;
+		}
+		else if (*curr == '.')
+		{
+			bLeadingDot = true;
+		}
+		else if (!isDigit(*curr))
+		{
+			return false;
+		}
+
+		// integer part
+		if (!bLeadingDot)
+		{
+			while (curr != end && isDigit(*curr))
+			{
+				mantissa *= 10;
+				mantissa += static_cast<int>(*curr - '0');
+				curr++;
+				read++;
+			}
+
+			if (read == 0)
+				return false;
+		}
+
+		if (curr != end)
+		{
+			// fraction part
+			if (*curr == '.')
+			{
+				static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+				const int lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+				curr++;
+				read = 1;
+				while (curr != end && isDigit(*curr))
+				{
+					mantissa += static_cast<int>(*curr - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+					read++;
+					curr++;
+				}
+			}
+
+			// exponent part
+			if (curr != end && (*curr == 'e' || *curr == 'E'))
+			{
+				curr++;
+				if (curr != end && (*curr == '+' || *curr == '-'))
+				{
+					expSign = *curr;
+					curr++;
+				}
+				else if (curr == end || !isDigit(*curr))
+				{
+					return false;
+				}
+
+				read = 0;
+				while (curr != end && isDigit(*curr))
+				{
+					if (exponent > (2147483647 / 10))
+						return false;
+
+					exponent *= 10;
+					exponent += static_cast<int>(*curr - '0');
+					curr++;
+					read++;
+				}
+				exponent *= (expSign == '+' ? 1 : -1);
+				if (read == 0)
+					return false;
+			}
+		}
+
+		*result = (sign == '+' ? 1 : -1) *
+			(exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+		return true;
+	}
+
+	// Parse the next whitespace separated real, 'found' tells if it was a number
+	inline float parseReal(const char*& s, const char* end, double defaultValue, bool* found = nullptr)
+	{
+		s = skipUntil(s, end, isNotSpace);
+		const char* tokenEnd = skipUntil(s, end, isSpaceOrCR);
+
+		double value = defaultValue;
+		bool bFound = parseDouble(s, tokenEnd, &value);
+		if (found)
+			*found = bFound;
+
+		s = tokenEnd;
+		return static_cast<float>(value);
+	}
+
+	// Same as atoi() but bounded by 'end'
+	inline int parseInt(const char* s, const char* end)
+	{
+		while (s < end && (isSpace(*s) || *s == '\r' || *s == '\v' || *s == '\f'))
+			s++;
+
+		int sign = 1;
+		if (s < end && (*s == '+' || *s == '-'))
+		{
+			sign = (*s == '-') ? -1 : 1;
+			s++;
+		}
+
+		int value = 0;
+		while (s < end && isDigit(*s))
+		{
+			value = value * 10 + (*s - '0');
+			s++;
+		}
+
+		return sign * value;
+	}
+
+	// OBJ indices are 1 based, negative ones are relative to the attributes read so far
+	inline bool fixIndex(int idx, size_t localCount, bool bAllowZero, int* ret, bool* bRelative)
+	{
+		*bRelative = false;
+
+		if (idx > 0)
+		{
+			*ret = idx - 1;
+			return true;
+		}
+
+		if (idx == 0)
+		{
+			*ret = -1;
+			return bAllowZero;
+		}
+
+		*ret = static_cast<int>(localCount) + idx;
+		*bRelative = true;
+		return true;
+	}
+
+	// Parse i, i/j, i//k or i/j/k
+	bool parseCorner(const char*& s, const char* end, Chunk& chunk)
+	{
+		Corner corner{ -1, -1, -1 };
+		bool bRelativeV = false;
+		bool bRelativeVt = false;
+		bool bRelativeVn = false;
+
+		if (!fixIndex(parseInt(s, end), chunk.v.size() / 3, false, &corner.v, &bRelativeV))
+			return false;
+
+		s = skipUntil(s, end, isSlashOrSpace);
+		if (s < end && *s == '/')
+		{
+			s++;
+
+			// i//k
+			if (s < end && *s == '/')
+			{
+				s++;
+				if (!fixIndex(parseInt(s, end), chunk.vn.size() / 3, true, &corner.vn, &bRelativeVn))
+					return false;
+				s = skipUntil(s, end, isSlashOrSpace);
+			}
+			else
+			{
+				if (!fixIndex(parseInt(s, end), chunk.vt.size() / 2, true, &corner.vt, &bRelativeVt))
+					return false;
+
+				s = skipUntil(s, end, isSlashOrSpace);
+				if (s < end && *s == '/')
+				{
+					s++;
+					if (!fixIndex(parseInt(s, end), chunk.vn.size() / 3, true, &corner.vn, &bRelativeVn))
+						return false;
+					s = skipUntil(s, end, isSlashOrSpace);
+				}
+			}
+		}
+
+		size_t position = chunk.corners.size();
+		if (bRelativeV)
+			chunk.relativeV.push_back(position);
+		if (bRelativeVt)
+			chunk.relativeVt.push_back(position);
+		if (bRelativeVn)
+			chunk.relativeVn.push_back(position);
+
+		chunk.corners.push_back(corner);
+		return true;
+	}
+
+	void parseLine(const char* s, const char* end, Chunk& chunk)
+	{
+		s = skipUntil(s, end, isNotSpace);
+		if (s == end || *s == '#')
+			return;
+
+		const char c1 = (s + 1 < end) ? s[1] : '\0';
+		const char c2 = (s + 2 < end) ? s[2] : '\0';
+
+		// vertex, with optional color
+		if (s[0] == 'v' && isSpace(c1))
+		{
+			s += 2;
+			float x = parseReal(s, end, 0.0);
+			float y = parseReal(s, end, 0.0);
+			float z = parseReal(s, end, 0.0);
+
+			bool bFound = false;
+			float r = parseReal(s, end, 0.0, &bFound);
+			float g = 0.0f;
+			float b = 0.0f;
+			if (bFound)
+				g = parseReal(s, end, 0.0, &bFound);
+			if (bFound)
+				b = parseReal(s, end, 0.0, &bFound);
+			if (!bFound)
+				r = g = b = 1.0f;
+
+			chunk.v.insert(chunk.v.end(), { x, y, z });
+			chunk.vc.insert(chunk.vc.end(), { r, g, b });
+			return;
+		}
+
+		// normal
+		if (s[0] == 'v' && c1 == 'n' && isSpace(c2))
+		{
+			s += 3;
+			float x = parseReal(s, end, 0.0);
+			float y = parseReal(s, end, 0.0);
+			float z = parseReal(s, end, 0.0);
+			chunk.vn.insert(chunk.vn.end(), { x, y, z });
+			return;
+		}
+
+		// texture coordinate
+		if (s[0] == 'v' && c1 == 't' && isSpace(c2))
+		{
+			s += 3;
+			float u = parseReal(s, end, 0.0);
+			float v = parseReal(s, end, 0.0);
+			chunk.vt.insert(chunk.vt.end(), { u, v });
+			return;
+		}
+
+		// face
+		if (s[0] == 'f' && isSpace(c1))
+		{
+			s += 2;
+			s = skipUntil(s, end, isNotSpace);
+
+			uint32_t count = 0;
+			while (s < end && !isNewLine(*s))
+			{
+				if (!parseCorner(s, end, chunk))
+				{
+					chunk.error = "Failed to parse `f' line (e.g. a zero value for vertex index)";
+					return;
+				}
+
+				count++;
+				s = skipUntil(s, end, isNotSpaceOrCR);
+			}
+
+			chunk.faceSizes.push_back(count);
+			chunk.bHasPolygons |= (count > 4);
+		}
+	}
+
+	void parseChunk(Chunk& chunk)
+	{
+		// Note: '\r' on its own also ends a line, same as tinyobj's safeGetline
+		const char* s = chunk.begin;
+		while (s < chunk.end && chunk.error.empty())
+		{
+			const char* lineEnd = s;
+			while (lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r')
+				lineEnd++;
+
+			parseLine(s, lineEnd, chunk);
+			s = lineEnd + 1;
+		}
+	}
+}
+
+void MyObjParser::parse(const std::string& filepath)
+{
+	vertices.clear();
+	colors.clear();
+	normals.clear();
+	texcoords.clear();
+	indices.clear();
+
+	MyMappedFile file{ filepath };
+	if (!file.isOpen())
+	{
+		throw std::runtime_error("Cannot open file [" + filepath + "]");
+	}
+
+	// Split into line aligned chunks, one per thread
+	unsigned int threadCount = s_iThreadCount ? s_iThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.size() / MIN_CHUNK_SIZE));
+
+	std::vector<Chunk> chunks(chunkCount);
+	const char* fileBegin = file.data();
+	const char* fileEnd = file.data() + file.size();
+	const char* chunkBegin = fileBegin;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = fileEnd;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = std::max(chunkBegin, fileBegin + file.size() * (i + 1) / chunkCount);
+			while (chunkEnd < fileEnd && *chunkEnd != '\n')
+				chunkEnd++;
+			if (chunkEnd < fileEnd)
+				chunkEnd++;
+		}
+
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	// Parse the first chunk on this thread
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		workers.emplace_back(parseChunk, std::ref(chunks[i]));
+	}
+	parseChunk(chunks[0]);
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	bool bHasPolygons = false;
+	size_t vCount = 0, vnCount = 0, vtCount = 0, cornerCount = 0;
+	for (const auto& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			throw std::runtime_error(chunk.error + " in [" + filepath + "]");
+		}
+
+		bHasPolygons |= chunk.bHasPolygons;
+		vCount += chunk.v.size();
+		vnCount += chunk.vn.size();
+		vtCount += chunk.vt.size();
+		cornerCount += chunk.corners.size();
+	}
+
+	// tinyobj triangulates polygons with more than 4 corners by ear clipping,
+	// let it handle those (rare) files so the output stays identical
+	if (bHasPolygons)
+	{
+		_parseWithTinyObj(filepath);
+		return;
+	}
+
+	vertices.reserve(vCount);
+	colors.reserve(vCount);
+	normals.reserve(vnCount);
+	texcoords.reserve(vtCount);
+
+	// Merge attributes and turn chunk relative indices into file indices
+	for (auto& chunk : chunks)
+	{
+		int baseV = static_cast<int>(vertices.size() / 3);
+		int baseVt = static_cast<int>(texcoords.size() / 2);
+		int baseVn = static_cast<int>(normals.size() / 3);
+
+		bool bValid = true;
+		for (size_t position : chunk.relativeV)
+			bValid &= (chunk.corners[position].v += baseV) >= 0;
+		for (size_t position : chunk.relativeVt)
+			bValid &= (chunk.corners[position].vt += baseVt) >= 0;
+		for (size_t position : chunk.relativeVn)
+			bValid &= (chunk.corners[position].vn += baseVn) >= 0;
+
+		if (!bValid)
+		{
+			throw std::runtime_error("Invalid relative face index in [" + filepath + "]");
+		}
+
+		vertices.insert(vertices.end(), chunk.v.begin(), chunk.v.end());
+		colors.insert(colors.end(), chunk.vc.begin(), chunk.vc.end());
+		normals.insert(normals.end(), chunk.vn.begin(), chunk.vn.end());
+		texcoords.insert(texcoords.end(), chunk.vt.begin(), chunk.vt.end());
+	}
+
+	const int vertexCount = static_cast<int>(vertices.size() / 3);
+
+	auto emit = [this](const Corner& corner)
+	{
+		indices.push_back({ corner.v, corner.vn, corner.vt });
+	};
+
+	// Triangulate the same way as tinyobj
+	indices.reserve(cornerCount);
+	for (const auto& chunk : chunks)
+	{
+		const Corner* pCorners = chunk.corners.data();
+		for (uint32_t faceSize : chunk.faceSizes)
+		{
+			const Corner* pFace = pCorners;
+			pCorners += faceSize;
+
+			// degenerated face
+			if (faceSize < 3)
+				continue;
+
+			// Like tinyobj, triangles keep out of range indices, MyModel::Builder skips them
+			if (faceSize == 3)
+			{
+				emit(pFace[0]);
+				emit(pFace[1]);
+				emit(pFace[2]);
+				continue;
+			}
+
+			// A quad with a position out of range is dropped, tinyobj warns about it
+			if (pFace[0].v >= vertexCount || pFace[1].v >= vertexCount ||
+				pFace[2].v >= vertexCount || pFace[3].v >= vertexCount)
+				continue;
+
+			// Quad: split along the shorter diagonal
+			const float* v0 = &vertices[3 * pFace[0].v];
+			const float* v1 = &vertices[3 * pFace[1].v];
+			const float* v2 = &vertices[3 * pFace[2].v];
+			const float* v3 = &vertices[3 * pFace[3].v];
+
+			float e02x = v2[0] - v0[0];
+			float e02y = v2[1] - v0[1];
+			float e02z = v2[2] - v0[2];
+			float e13x = v3[0] - v1[0];
+			float e13y = v3[1] - v1[1];
+			float e13z = v3[2] - v1[2];
+
+			float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+			float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+			if (sqr02 < sqr13)
+			{
+				emit(pFace[0]); emit(pFace[1]); emit(pFace[2]);
+				emit(pFace[0]); emit(pFace[2]); emit(pFace[3]);
+			}
+			else
+			{
+				emit(pFace[0]); emit(pFace[1]); emit(pFace[3]);
+				emit(pFace[1]); emit(pFace[2]); emit(pFace[3]);
+			}
+		}
+	}
+}
+
+void MyObjParser::_parseWithTinyObj(const std::string& filepath)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+	{
+		throw std::runtime_error(warn + err);
+	}
+
+	vertices = std::move(attrib.vertices);
+	colors = std::move(attrib.colors);
+	normals = std::move(attrib.normals);
+	texcoords = std::move(attrib.texcoords);
+
+	indices.clear();
+	for (const auto& shape : shapes)
+	{
+		for (const auto& index : shape.mesh.indices)
+		{
+			indices.push_back({ index.vertex_index, index.normal_index, index.texcoord_index });
+		}
+	}
+}
+
@@ -0,0 +1,53 @@
+#ifndef __MY_OBJ_PARSER_H__
+#define __MY_OBJ_PARSER_H__
+
+// Std
+#include <string>
+#include <vector>
+
+//
+// Multithreaded OBJ front end for MyModel::Builder.
+//
+// The file is memory-mapped and split into line-aligned chunks which are
+// parsed in parallel; the per-chunk attribute arrays are then merged in
+// file order. The output follows tinyobj::LoadObj (triangulate = true,
+// white fallback vertex colors) value for value, so the builder produces
+// the same vertex and index buffers as before. That includes out of range
+// face indices, which are passed on (triangles) or skipped (quads) the way
+// tinyobj does. Only geometry is read, materials, lines and points are ignored.
+//
+class MyObjParser
+{
+public:
+	// Same meaning as tinyobj::index_t, -1 if the attribute is not present
+	struct Index
+	{
+		int vertex_index;
+		int normal_index;
+		int texcoord_index;
+	};
+
+	// Laid out like tinyobj::attrib_t
+	std::vector<float> vertices{};  // xyz
+	std::vector<float> colors{};    // rgb, one per vertex
+	std::vector<float> normals{};   // xyz
+	std::vector<float> texcoords{}; // uv
+
+	// Triangle corners of all shapes, in file order. May be out of range of the attributes
+	std::vector<Index> indices{};
+
+	// Throws std::runtime_error if the file cannot be read or is malformed
+	// (a zero or invalid relative vertex index), where tinyobj::LoadObj fails
+	void parse(const std::string& filepath);
+
+	// Number of parsing threads, 0 = std::thread::hardware_concurrency()
+	static void setThreadCount(unsigned int count) { s_iThreadCount = count; }
+
+private:
+	void _parseWithTinyObj(const std::string& filepath);
+
+	static unsigned int s_iThreadCount;
+};
+
+#endif
+
@@ -1,4 +1,5 @@
 #include "my_offscreen_render_factory.h"
+#include "my_gpu_culler.h"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -7,6 +8,7 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
@@ -25,19 +27,14 @@ MyOffScreenRenderFactory::~MyOffScreenRenderFactory()
 
 void MyOffScreenRenderFactory::_createPipelineLayout(VkDescriptorSetLayout offscreenSetLayout)
 {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(MySimplePushConstantData);
-
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ offscreenSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
     if (vkCreatePipelineLayout(m_myDevice.device(), &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -56,6 +53,13 @@ void MyOffScreenRenderFactory::_createPipeline(VkRenderPass renderPass)
     pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
     pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 
+    // Depth only: the shadow shader reads just the position, with the packed
+    // vertex layout that is binding 0 alone (8 bytes per vertex)
+    auto& attributes = pipelineConfig.attributeDescriptions;
+    attributes.erase(
+        std::remove_if(attributes.begin(), attributes.end(), [](const VkVertexInputAttributeDescription& a) { return a.location != 0; }),
+        attributes.end());
+
     pipelineConfig.colorBlendInfo.attachmentCount = 0;
     pipelineConfig.colorBlendInfo.pAttachments = nullptr;
 
@@ -83,38 +87,32 @@ void MyOffScreenRenderFactory::renderGameObjects(MyFrameInfo& frameInfo)
         0, // only bind set 0 for now
         1, // count of 1
         &frameInfo.offscreenDescriptorSet,
-        0,
-        nullptr);
+        1, // the dynamic offset of the global UBO
+        &frameInfo.globalUboOffset);
+
+    // Models in the same geometry arena page share their buffers, bind them once
+    MyModel::BindState bindState{};
+
+    // Culled on the GPU: one indirect draw per group, the visible draws only
+    if (frameInfo.pGpuCuller && frameInfo.pGpuCuller->culls(MyRenderQueue::PASS_SHADOW))
+    {
+        for (const auto& group : frameInfo.pGpuCuller->groups(MyRenderQueue::PASS_SHADOW, frameInfo.shareIndex, frameInfo.shareCount))
+            frameInfo.pGpuCuller->draw(frameInfo.commandBuffer, group, &bindState);
+        return;
+    }
 
-    // Now loop through all key-value pair of the game objects
-    for (auto& kv : frameInfo.gameObjects) 
+    // The batches of this pass (or of this thread's share), in MyRenderQueue key order. The
+    // shaders read the instances with gl_InstanceIndex; a single object still culls its meshlets
+    for (const auto& batch : frameInfo.renderQueue.batches(MyRenderQueue::PASS_SHADOW, frameInfo.shareIndex, frameInfo.shareCount))
     {
-	    auto& obj = kv.second;
-        if (obj.type() == MyGameObject::DEBUG) continue;
-
-        //if (obj.getID() == 2) continue;
-        // Note: X to the right, Y up and Z out of the screen
-        // obj.transform.rotation.y = glm::mod(obj.transform.rotation.y + 0.0005f, glm::two_pi<float>());  // Y up
-        // obj.transform.rotation.x = glm::mod(obj.transform.rotation.x + 0.0005f, glm::two_pi<float>());  // X to the right
-        // obj.transform.rotation.z = glm::mod(obj.transform.rotation.z + 0.0005f, glm::two_pi<float>());  // Z out of the screen
-
-        MySimplePushConstantData push{};
-
-        // Note: do this for now to perform on CPU
-        // We will do it later to perform it on GPU
-        push.modelMatrix = obj.transform.mat4();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            m_vkPipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT,
-            0,
-            sizeof(MySimplePushConstantData),
-            &push);
-
-        obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
+        const MyRenderQueue::Object& object = frameInfo.renderQueue.object(batch.object);
+        MyModel& model = *object.pModel;
+
+        model.bind(frameInfo.commandBuffer, &bindState);
+        if (batch.instanceCount == 1)
+            model.draw(frameInfo.commandBuffer, object.lod, frameInfo.pShadowCuller, object.modelMatrix, batch.firstInstance);
+        else
+            model.draw(frameInfo.commandBuffer, object.lod, batch.firstInstance, batch.instanceCount);
     }
 }
 
@@ -122,7 +120,7 @@ void MyOffScreenRenderFactory::recratePipeline(VkRenderPass renderPass)
 {
     // delete the original one if exists
 
-    std::shared_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
+    std::unique_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
 
     _createPipeline(renderPass);
 
@@ -0,0 +1,229 @@
+#include "my_parallel_recorder.h"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+MyParallelRecorder::MyParallelRecorder(MyDevice& device, uint32_t frameCount, uint32_t threadCount) :
+	m_myDevice{ device }
+{
+	m_iThreadCount = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // reset as a whole, not per buffer
+	poolInfo.queueFamilyIndex = m_myDevice.graphicsQueueFamily();
+
+	m_threadFrames.resize(frameCount * m_iThreadCount);
+	for (auto& threadFrame : m_threadFrames)
+	{
+		if (vkCreateCommandPool(m_myDevice.device(), &poolInfo, nullptr, &threadFrame.pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+	}
+
+	m_shares.resize(m_iThreadCount);
+	m_viewCullers.resize(m_iThreadCount);
+	m_shadowCullers.resize(m_iThreadCount);
+	m_executeBuffers.reserve(m_iThreadCount);
+
+	// Thread 0 is the one calling record()
+	for (uint32_t i = 1; i < m_iThreadCount; i++)
+	{
+		m_workers.emplace_back(&MyParallelRecorder::_workerLoop, this, i);
+	}
+}
+
+MyParallelRecorder::~MyParallelRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_startCondition.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	// Destroying a pool frees its buffers
+	for (auto& threadFrame : m_threadFrames)
+	{
+		vkDestroyCommandPool(m_myDevice.device(), threadFrame.pool, nullptr);
+	}
+}
+
+void MyParallelRecorder::beginFrame(uint32_t frameIndex)
+{
+	m_iFrameIndex = frameIndex;
+
+	for (uint32_t thread = 0; thread < m_iThreadCount; thread++)
+	{
+		ThreadFrame& threadFrame = m_threadFrames[frameIndex * m_iThreadCount + thread];
+		vkResetCommandPool(m_myDevice.device(), threadFrame.pool, 0);
+		threadFrame.usedCount = 0;
+	}
+}
+
+VkCommandBuffer MyParallelRecorder::beginSecondary(const VkCommandBufferInheritanceInfo& inheritance)
+{
+	return _beginBuffer(0, inheritance);
+}
+
+void MyParallelRecorder::executeSecondary(VkCommandBuffer primaryBuffer, VkCommandBuffer secondaryBuffer)
+{
+	if (vkEndCommandBuffer(secondaryBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record secondary command buffer!");
+	}
+
+	vkCmdExecuteCommands(primaryBuffer, 1, &secondaryBuffer);
+}
+
+VkCommandBuffer MyParallelRecorder::_beginBuffer(uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance)
+{
+	ThreadFrame& threadFrame = m_threadFrames[m_iFrameIndex * m_iThreadCount + thread];
+	if (threadFrame.usedCount == threadFrame.buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = threadFrame.pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(m_myDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		threadFrame.buffers.push_back(commandBuffer);
+	}
+
+	VkCommandBuffer commandBuffer = threadFrame.buffers[threadFrame.usedCount++];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	return commandBuffer;
+}
+
+void MyParallelRecorder::_beginShare(uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance, MyFrameInfo& info)
+{
+	m_shares[thread] = Share{};
+
+	info.shareIndex = thread;
+	info.shareCount = m_iThreadCount;
+	info.commandBuffer = _beginBuffer(thread, inheritance);
+	info.triangleCount = 0;
+
+	if (info.pViewCuller)
+	{
+		m_viewCullers[thread].setViewFrom(*info.pViewCuller);
+		info.pViewCuller = &m_viewCullers[thread];
+	}
+	if (info.pShadowCuller)
+	{
+		m_shadowCullers[thread].setViewFrom(*info.pShadowCuller);
+		info.pShadowCuller = &m_shadowCullers[thread];
+	}
+}
+
+void MyParallelRecorder::_endShare(uint32_t thread, const MyFrameInfo& info)
+{
+	if (vkEndCommandBuffer(info.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record secondary command buffer!");
+	}
+
+	m_shares[thread].commandBuffer = info.commandBuffer;
+	m_shares[thread].triangleCount = info.triangleCount;
+}
+
+void MyParallelRecorder::_run(void* pShare, void (*pfnShare)(void*, uint32_t))
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pShare = pShare;
+		m_pfnShare = pfnShare;
+		m_iPendingCount = m_iThreadCount - 1;
+		m_iGeneration++;
+	}
+	m_startCondition.notify_all();
+
+	_runShare(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_iPendingCount == 0; });
+}
+
+void MyParallelRecorder::_runShare(uint32_t thread)
+{
+	try
+	{
+		m_pfnShare(m_pShare, thread);
+	}
+	catch (...)
+	{
+		m_shares[thread].error = std::current_exception();
+	}
+}
+
+void MyParallelRecorder::_finish(MyFrameInfo& frameInfo)
+{
+	m_executeBuffers.clear();
+	for (uint32_t thread = 0; thread < m_iThreadCount; thread++)
+	{
+		const Share& share = m_shares[thread];
+		if (share.error)
+		{
+			std::rethrow_exception(share.error);
+		}
+
+		if (share.commandBuffer == VK_NULL_HANDLE)
+			continue;
+
+		m_executeBuffers.push_back(share.commandBuffer);
+		frameInfo.triangleCount += share.triangleCount;
+		if (frameInfo.pViewCuller)
+			frameInfo.pViewCuller->addStats(m_viewCullers[thread].stats());
+		if (frameInfo.pShadowCuller)
+			frameInfo.pShadowCuller->addStats(m_shadowCullers[thread].stats());
+	}
+
+	if (!m_executeBuffers.empty())
+	{
+		vkCmdExecuteCommands(frameInfo.commandBuffer, static_cast<uint32_t>(m_executeBuffers.size()), m_executeBuffers.data());
+	}
+}
+
+void MyParallelRecorder::_workerLoop(uint32_t thread)
+{
+	uint64_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startCondition.wait(lock, [&] { return m_bStop || m_iGeneration != generation; });
+			if (m_bStop)
+				return;
+			generation = m_iGeneration;
+		}
+
+		_runShare(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_iPendingCount == 0)
+				m_doneCondition.notify_one();
+		}
+	}
+}
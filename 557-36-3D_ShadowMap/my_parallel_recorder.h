@@ -0,0 +1,114 @@
+#ifndef __MY_PARALLEL_RECORDER_H__
+#define __MY_PARALLEL_RECORDER_H__
+
+#include "my_device.h"
+#include "my_frame_info.h"
+#include "my_meshlet_culler.h"
+
+// Std
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// Records the draws of a render pass on several threads. The pass begins with
+// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the MyRenderQueue slice of each
+// factory is split into one contiguous share per thread, every thread records its
+// shares into a secondary command buffer and the primary buffer executes them in
+// order. The calling thread records the first share itself.
+//
+// Every thread has a command pool per frame in flight, beginFrame() resets it
+// as a whole once the frame's fence has signaled and its buffers are reused.
+// Meshlets are culled with a copy of the pass's MyMeshletCuller per thread,
+// their stats are added to the pass's culler afterwards.
+//
+class MyParallelRecorder
+{
+public:
+	// threadCount 0 = std::thread::hardware_concurrency(), including the calling thread
+	MyParallelRecorder(MyDevice& device, uint32_t frameCount, uint32_t threadCount = 0);
+	~MyParallelRecorder();
+
+	MyParallelRecorder(const MyParallelRecorder&) = delete;
+	MyParallelRecorder& operator=(const MyParallelRecorder&) = delete;
+
+	uint32_t threadCount() const { return m_iThreadCount; }
+
+	// The GPU must be done with the frame's previous use, i.e. after MyRenderer::beginFrame
+	void beginFrame(uint32_t frameIndex);
+
+	// Calls recordShare(info) on every thread with a copy of frameInfo, where info.commandBuffer
+	// is a secondary buffer continuing the render pass of 'inheritance', shareIndex/shareCount
+	// the thread's share and pViewCuller/pShadowCuller the thread's copies. Secondary buffers
+	// do not inherit dynamic state, recordShare sets the viewport and scissor.
+	// Returns once the buffers are executed on frameInfo.commandBuffer, with their triangle
+	// counts added to frameInfo's. Rethrows what a thread has thrown.
+	template<typename F>
+	void record(MyFrameInfo& frameInfo, const VkCommandBufferInheritanceInfo& inheritance, F&& recordShare)
+	{
+		auto share = [&](uint32_t thread)
+		{
+			MyFrameInfo info = frameInfo;
+			_beginShare(thread, inheritance, info);
+			recordShare(info);
+			_endShare(thread, info);
+		};
+
+		_run(&share, [](void* pShare, uint32_t thread) { (*static_cast<decltype(share)*>(pShare))(thread); });
+		_finish(frameInfo);
+	}
+
+	// A secondary buffer of the calling thread for the current frame, for what stays on the
+	// main thread in a pass of secondary buffers (e.g. the GUI). executeSecondary() ends it
+	// and executes it on the primary buffer
+	VkCommandBuffer beginSecondary(const VkCommandBufferInheritanceInfo& inheritance);
+	void            executeSecondary(VkCommandBuffer primaryBuffer, VkCommandBuffer secondaryBuffer);
+
+private:
+	struct ThreadFrame
+	{
+		VkCommandPool                pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t                     usedCount = 0;
+	};
+
+	// Result of one thread's share in the current record()
+	struct Share
+	{
+		VkCommandBuffer    commandBuffer = VK_NULL_HANDLE;  // none if the share threw
+		uint32_t           triangleCount = 0;
+		std::exception_ptr error;
+	};
+
+	VkCommandBuffer _beginBuffer(uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance);
+	void _beginShare(uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance, MyFrameInfo& info);
+	void _endShare(uint32_t thread, const MyFrameInfo& info);
+	void _run(void* pShare, void (*pfnShare)(void*, uint32_t));
+	void _runShare(uint32_t thread);
+	void _finish(MyFrameInfo& frameInfo);
+	void _workerLoop(uint32_t thread);
+
+	MyDevice&                     m_myDevice;
+	uint32_t                      m_iThreadCount;
+	uint32_t                      m_iFrameIndex = 0;
+	std::vector<ThreadFrame>      m_threadFrames;    // [frame * m_iThreadCount + thread]
+	std::vector<Share>            m_shares;          // per thread
+	std::vector<MyMeshletCuller>  m_viewCullers;     // per thread
+	std::vector<MyMeshletCuller>  m_shadowCullers;   // per thread
+	std::vector<VkCommandBuffer>  m_executeBuffers;  // scratch for vkCmdExecuteCommands
+
+	// Shared with the workers
+	std::mutex                    m_mutex;
+	std::condition_variable       m_startCondition;
+	std::condition_variable       m_doneCondition;
+	void*                         m_pShare = nullptr;
+	void                        (*m_pfnShare)(void*, uint32_t) = nullptr;
+	uint64_t                      m_iGeneration = 0;  // bumped per record()
+	uint32_t                      m_iPendingCount = 0;
+	bool                          m_bStop = false;
+	std::vector<std::thread>      m_workers;
+};
+
+#endif
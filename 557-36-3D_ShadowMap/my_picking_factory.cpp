@@ -7,6 +7,7 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
@@ -25,19 +26,14 @@ MyPickingFactory::~MyPickingFactory()
 
 void MyPickingFactory::_createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(MySimplePushConstantData);
-
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
     if (vkCreatePipelineLayout(m_myDevice.device(), &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -73,6 +69,11 @@ void MyPickingFactory::_createPipeline(MyRenderer& renderer)
     pipelineConfig.renderPass = renderer.pickRenderPass();
     pipelineConfig.pipelineLayout = m_vkPipelineLayout;
 
+    // The pick ID comes from the instance (MyRenderQueue::Instance::pickID), not the vertex id
+    auto& attributes = pipelineConfig.attributeDescriptions;
+    attributes.erase(std::remove_if(attributes.begin(), attributes.end(),
+        [](const VkVertexInputAttributeDescription& attribute) { return attribute.location == 4; }), attributes.end());
+
     // Rasterizer // should be the same as the regular rendering pipeline
     /*pipelineConfig.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     pipelineConfig.rasterizationInfo.depthClampEnable = VK_FALSE;
@@ -116,44 +117,31 @@ void MyPickingFactory::renderPickScene(MyFrameInfo& frameInfo)
         0, // only bind set 0 for now
         1, // count of 1
         &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
+        1, // the dynamic offset of the global UBO
+        &frameInfo.globalUboOffset);
+
+    // Models in the same geometry arena page share their buffers, bind them once
+    MyModel::BindState bindState{};
 
-    // Now loop through all key-value pair of the game objects
-    for (auto& kv : frameInfo.gameObjects) 
+    // The batches of this pass (or of this thread's share), in MyRenderQueue key order. The
+    // shaders read the instances with gl_InstanceIndex; a single object still culls its meshlets
+    for (const auto& batch : frameInfo.renderQueue.batches(MyRenderQueue::PASS_PICK, frameInfo.shareIndex, frameInfo.shareCount))
     {
-	    auto& obj = kv.second;
-        if (obj.type() == MyGameObject::DEBUG) continue;
-
-        // Note: X to the right, Y up and Z out of the screen
-        // obj.transform.rotation.y = glm::mod(obj.transform.rotation.y + 0.0005f, glm::two_pi<float>());  // Y up
-        // obj.transform.rotation.x = glm::mod(obj.transform.rotation.x + 0.0005f, glm::two_pi<float>());  // X to the right
-        // obj.transform.rotation.z = glm::mod(obj.transform.rotation.z + 0.0005f, glm::two_pi<float>());  // Z out of the screen
-
-        MySimplePushConstantData push{};
-
-        // Note: do this for now to perform on CPU
-        // We will do it later to perform it on GPU
-        push.modelMatrix = obj.transform.mat4();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            m_vkPipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(MySimplePushConstantData),
-            &push);
-
-        obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
+        const MyRenderQueue::Object& object = frameInfo.renderQueue.object(batch.object);
+        MyModel& model = *object.pModel;
+
+        model.bind(frameInfo.commandBuffer, &bindState);
+        if (batch.instanceCount == 1)
+            model.draw(frameInfo.commandBuffer, object.lod, frameInfo.pViewCuller, object.modelMatrix, batch.firstInstance);
+        else
+            model.draw(frameInfo.commandBuffer, object.lod, batch.firstInstance, batch.instanceCount);
     }
 }
 
 void MyPickingFactory::recratePipeline(MyRenderer &render)
 {
     // delete the original one if exists
-    std::shared_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
+    std::unique_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
 
     _createPipeline(render);
 
@@ -28,7 +28,7 @@ MyPipeline::~MyPipeline()
     vkDestroyPipeline(m_myDevice.device(), m_vkGraphicsPipeline, nullptr);
 }
 
-std::vector<char> MyPipeline::_readFile(const std::string& filename)
+std::vector<char> MyPipeline::readFile(const std::string& filename)
 {
     std::ifstream file{ filename, std::ios::ate | std::ios::binary };
 
@@ -54,8 +54,8 @@ void MyPipeline::_createGraphicsPipeline(
     assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Pipeline cannot be created with null pipeline layout");
     assert(configInfo.renderPass != VK_NULL_HANDLE && "RenderPass cannot be created with null pipeline layout");
 
-    auto vertCode = _readFile(vertFilepath);
-    auto fragCode = _readFile(fragFilepath);
+    auto vertCode = readFile(vertFilepath);
+    auto fragCode = readFile(fragFilepath);
 
     std::cout << "Vertex Shader Code Size: " << vertCode.size() << '\n';
     std::cout << "Fragment Shader Code Size: " << fragCode.size() << '\n';
@@ -72,7 +72,7 @@ void MyPipeline::_createGraphicsPipeline(
     shaderStages[0].pName = "main"; // the main funciton of teh vertex shader
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = configInfo.vertexSpecializationInfo;
 
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -134,7 +134,7 @@ void MyPipeline::_createGraphicsPipeline(
     assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Pipeline cannot be created with null pipeline layout");
     assert(configInfo.renderPass != VK_NULL_HANDLE && "RenderPass cannot be created with null pipeline layout");
 
-    auto vertCode = _readFile(vertFilepath);
+    auto vertCode = readFile(vertFilepath);
 
     std::cout << "Vertex Shader Code Size: " << vertCode.size() << '\n';
 
@@ -151,7 +151,7 @@ void MyPipeline::_createGraphicsPipeline(
     shaderStages[0].pName = "main"; // the main funciton of teh vertex shader
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = configInfo.vertexSpecializationInfo;
 
     // Descriptions can now be set by defaultPipelineConfigInfo
     auto& bindingDescriptions = configInfo.bindingDescriptions;
@@ -304,5 +304,6 @@ void MyPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
     // Descriptions
     configInfo.bindingDescriptions = MyModel::getBindingDescriptions();
     configInfo.attributeDescriptions = MyModel::getAttributeDescriptions();
+    configInfo.vertexSpecializationInfo = MyModel::vertexSpecializationInfo();
 }
 
@@ -12,6 +12,7 @@ struct PipelineConfigInfo
 
 	std::vector<VkVertexInputBindingDescription>   bindingDescriptions{};
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+	const VkSpecializationInfo*                    vertexSpecializationInfo = nullptr;
 
 	VkPipelineViewportStateCreateInfo      viewportInfo;
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo; // how configure how different stages of the pipeline work
@@ -45,8 +46,10 @@ public:
     void bind(VkCommandBuffer commandBuffer);
 	static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo);
 
+	// SPIR-V code of a shader, also for MyComputePipeline
+	static std::vector<char> readFile(const std::string& filename);
+
 private:
-	static std::vector<char> _readFile(const std::string& filename);
 
 	void _createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
 	void _createGraphicsPipeline(const std::string& vertFilepath, const PipelineConfigInfo& configInfo);
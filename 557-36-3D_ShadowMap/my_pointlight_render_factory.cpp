@@ -95,8 +95,8 @@ void MyPointLightRenderFactory::render(MyFrameInfo& frameInfo)
         0,
         1,
         &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
+        1, // the dynamic offset of the global UBO
+        &frameInfo.globalUboOffset);
 
     vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 }
@@ -104,7 +104,7 @@ void MyPointLightRenderFactory::render(MyFrameInfo& frameInfo)
 void MyPointLightRenderFactory::recratePipeline(VkRenderPass renderPass)
 {
 	// delete the original one if exists
-    std::shared_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
+    std::unique_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
 
     _createPipeline(renderPass);
 
@@ -84,8 +84,8 @@ void MyPointLightRenderSystem::render(MyFrameInfo& frameInfo)
         0,
         1,
         &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
+        1, // the dynamic offset of the global UBO
+        &frameInfo.globalUboOffset);
 
     vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 }
@@ -0,0 +1,297 @@
+#include "my_render_queue.h"
+#include "my_frame_info.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+
+void MyRenderQueue::build(const MyFrameInfo& frameInfo, MyGameObject* const* ppObjects, uint32_t objectCount,
+	uint32_t passMask, const glm::vec3& lightPosition)
+{
+	m_objects.clear();
+	m_draws.clear();
+	m_batches.clear();
+	m_iFirstInstance = 0;
+	m_stats = Stats{};
+	m_stats.objectCount = objectCount;
+
+	uint32_t passCounts[PASS_COUNT] = {};
+	uint32_t lastPages[PASS_COUNT];
+	uint32_t lastModels[PASS_COUNT];
+	std::fill(std::begin(lastPages), std::end(lastPages), UINT32_MAX);
+	std::fill(std::begin(lastModels), std::end(lastModels), UINT32_MAX);
+
+	glm::vec3 eye{ frameInfo.camera.inverseViewMatrix()[3] };
+
+	// The objects some pass draws and their world space bounds
+	m_candidates.clear();
+	m_passMasks.clear();
+	m_bounds.clear();
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		MyGameObject& gameObject = *ppObjects[i];
+
+		uint32_t passes;
+		switch (gameObject.type())
+		{
+		case MyGameObject::TEXTURE:
+			passes = passBit(PASS_SHADOW) | passBit(PASS_TEXTURE) | passBit(PASS_PICK);
+			break;
+		case MyGameObject::SIMPLE:
+			passes = passBit(PASS_SHADOW) | passBit(PASS_SIMPLE) | passBit(PASS_PICK);
+			break;
+		default:
+			passes = passBit(PASS_DEBUG);
+			break;
+		}
+
+		passes &= passMask;
+		if (passes == 0)
+			continue;
+
+		MyModel& model = frameInfo.models[gameObject.model]; // no refcount traffic, see MyResourcePool
+		glm::mat4 modelMatrix = gameObject.transform.mat4();
+
+		m_candidates.push_back({ modelMatrix, &model, &gameObject });
+		m_passMasks.push_back(passes);
+		if (passes & passBit(PASS_SHADOW))
+			m_stats.shadowTested++;
+		if (passes & ~passBit(PASS_SHADOW))
+			m_stats.viewTested++;
+		m_bounds.add(modelMatrix, model.boundingCenter(), model.boundingExtent(), model.boundingRadius());
+	}
+
+	// The light sees the shadow pass, the camera all the others; whole batches of objects at a time
+	if (frameInfo.pShadowCuller && (passMask & passBit(PASS_SHADOW)))
+		m_stats.shadowCulled = m_bounds.cull(frameInfo.pShadowCuller->planes(), ~passBit(PASS_SHADOW), m_passMasks.data());
+	if (frameInfo.pViewCuller && (passMask & ~passBit(PASS_SHADOW)))
+		m_stats.viewCulled = m_bounds.cull(frameInfo.pViewCuller->planes(), passBit(PASS_SHADOW), m_passMasks.data());
+
+	for (uint32_t c = 0; c < static_cast<uint32_t>(m_candidates.size()); c++)
+	{
+		const Candidate& candidate = m_candidates[c];
+		uint32_t passes = m_passMasks[c];
+		if (passes == 0)
+		{
+			m_stats.culledCount++;
+			continue;
+		}
+
+		MyGameObject& gameObject = *candidate.pObject;
+		MyModel& model = *candidate.pModel;
+		const glm::mat4& modelMatrix = candidate.modelMatrix;
+		glm::vec3 center = m_bounds.center(c);
+
+		uint32_t objectIndex = static_cast<uint32_t>(m_objects.size());
+		Object object;
+		object.modelMatrix = modelMatrix;
+		object.normalMatrix = glm::mat4{ gameObject.transform.normalMatrix() };
+		object.pModel = &model;
+		object.pObject = &gameObject;
+		// Note: the shadow pass uses the LOD of the main view too, a different
+		// shadow caster would shadow its own receiver (acne)
+		object.lod = model.selectLod(modelMatrix, frameInfo.camera, frameInfo.viewportHeight, frameInfo.lodPixelError);
+		m_objects.push_back(object);
+
+		// Squared distances sort the same as distances
+		float viewDepth = glm::dot(center - eye, center - eye);
+		float lightDepth = glm::dot(center - lightPosition, center - lightPosition);
+
+		uint32_t page = model.geometryPage();
+		uint32_t modelIndex = gameObject.model.index();
+		uint32_t material = gameObject.type() == MyGameObject::TEXTURE ? gameObject.textureIndex : 0; // selects the texture
+
+		for (uint32_t p = 0; p < PASS_COUNT; p++)
+		{
+			Pass pass = static_cast<Pass>(p);
+			if ((passes & passBit(pass)) == 0)
+				continue;
+
+			m_draws.push_back({ makeKey(pass, page, modelIndex, object.lod, material, pass == PASS_SHADOW ? lightDepth : viewDepth), objectIndex });
+			passCounts[pass]++;
+
+			if (page != lastPages[pass])
+			{
+				m_stats.unsortedBufferBinds++;
+				lastPages[pass] = page;
+			}
+			if (modelIndex != lastModels[pass])
+			{
+				m_stats.unsortedModelChanges++;
+				lastModels[pass] = modelIndex;
+			}
+		}
+	}
+
+	// The pass is the top of the key, so the slices follow each other in pass order
+	m_passBegin[0] = 0;
+	for (uint32_t p = 0; p < PASS_COUNT; p++)
+		m_passBegin[p + 1] = m_passBegin[p] + passCounts[p];
+
+	m_scratch.resize(m_draws.size());
+	sortDraws(m_draws.data(), m_scratch.data(), static_cast<uint32_t>(m_draws.size()));
+
+	m_stats.drawCount = static_cast<uint32_t>(m_draws.size());
+	_countStateChanges();
+
+	if (frameInfo.pFrameAllocator)
+		_writeInstances(frameInfo);
+	_buildBatches();
+}
+
+MyRenderQueue::Range<MyRenderQueue::Draw> MyRenderQueue::draws(Pass pass, uint32_t shareIndex, uint32_t shareCount) const
+{
+	uint64_t begin = m_passBegin[pass];
+	uint64_t size = m_passBegin[pass + 1] - begin;
+	const Draw* pDraws = m_draws.data();
+
+	return Range<Draw>{
+		pDraws + begin + size * shareIndex / shareCount,
+		pDraws + begin + size * (shareIndex + 1) / shareCount };
+}
+
+MyRenderQueue::Range<MyRenderQueue::Batch> MyRenderQueue::batches(Pass pass, uint32_t shareIndex, uint32_t shareCount) const
+{
+	uint64_t begin = m_batchBegin[pass];
+	uint64_t size = m_batchBegin[pass + 1] - begin;
+	const Batch* pBatches = m_batches.data();
+
+	return Range<Batch>{
+		pBatches + begin + size * shareIndex / shareCount,
+		pBatches + begin + size * (shareIndex + 1) / shareCount };
+}
+
+void MyRenderQueue::sortDraws(Draw* pDraws, Draw* pScratch, uint32_t count)
+{
+	constexpr uint32_t DIGITS = sizeof(uint64_t);
+
+	// All histograms in one read over the keys
+	uint32_t histograms[DIGITS][256] = {};
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint64_t key = pDraws[i].key;
+		for (uint32_t digit = 0; digit < DIGITS; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	Draw* pSrc = pDraws;
+	Draw* pDst = pScratch;
+	for (uint32_t digit = 0; digit < DIGITS && count > 0; digit++)
+	{
+		uint32_t* histogram = histograms[digit];
+		uint32_t shift = digit * 8;
+
+		// Every key has the same byte here, the order would not change
+		if (histogram[(pSrc[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+			pDst[histogram[(pSrc[i].key >> shift) & 0xFF]++] = pSrc[i];
+
+		std::swap(pSrc, pDst);
+	}
+
+	if (pSrc != pDraws)
+		std::copy(pSrc, pSrc + count, pDraws);
+}
+
+uint64_t MyRenderQueue::makeKey(Pass pass, uint32_t page, uint32_t model, uint32_t lod, uint32_t material, float depth)
+{
+	// The bits of a non-negative float sort like the float, the top 24 of the 31 are enough
+	uint32_t depthBits;
+	depth = std::max(depth, 0.0f);
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	return (static_cast<uint64_t>(pass) << 60) |
+		(static_cast<uint64_t>(std::min(page, 0xFFu)) << 52) |
+		(static_cast<uint64_t>(model & 0xFFFF) << 36) |
+		(static_cast<uint64_t>(std::min(lod, 0xFu)) << 32) |
+		(static_cast<uint64_t>(material & 0xFF) << 24) |
+		static_cast<uint64_t>(depthBits >> 7);
+}
+
+void MyRenderQueue::_writeInstances(const MyFrameInfo& frameInfo)
+{
+	if (m_draws.empty())
+		return;
+
+	// Instances are addressed by index from the start of the buffer, see MyFrameAllocator::allocateArray
+	MyFrameAllocator::Allocation allocation = frameInfo.pFrameAllocator->allocateArray(m_draws.size(), sizeof(Instance));
+	m_iFirstInstance = allocation.offset / sizeof(Instance);
+	Instance* pInstances = static_cast<Instance*>(allocation.pData);
+
+	for (const Draw& draw : m_draws)
+	{
+		const Object& object = m_objects[draw.object];
+
+		// Written once in order, the mapping may be write-combined
+		Instance instance;
+		instance.modelMatrix = object.modelMatrix * object.pModel->positionTransform();
+		instance.normalMatrix = object.normalMatrix;
+		instance.textureID = object.pObject->textureIndex;
+		instance.pickID = pickID(object.pObject->getID());
+		instance.padding[0] = instance.padding[1] = 0;
+		*pInstances++ = instance;
+	}
+}
+
+void MyRenderQueue::_buildBatches()
+{
+	m_batchBegin[0] = 0;
+	for (uint32_t p = 0; p < PASS_COUNT; p++)
+	{
+		const Object* pLast = nullptr;
+		for (uint32_t i = m_passBegin[p]; i < m_passBegin[p + 1]; i++)
+		{
+			const Object& object = m_objects[m_draws[i].object];
+
+			// The texture is uniform per draw, a new one starts a new batch
+			if (m_bInstancing && pLast && object.pModel == pLast->pModel && object.lod == pLast->lod &&
+				(p != PASS_TEXTURE || object.pObject->textureIndex == pLast->pObject->textureIndex))
+			{
+				m_batches.back().instanceCount++;
+				continue;
+			}
+
+			m_batches.push_back({ m_iFirstInstance + i, 1, m_draws[i].object });
+			pLast = &object;
+		}
+		m_batchBegin[p + 1] = static_cast<uint32_t>(m_batches.size());
+	}
+
+	m_stats.batchCount = static_cast<uint32_t>(m_batches.size());
+}
+
+void MyRenderQueue::_countStateChanges()
+{
+	for (uint32_t p = 0; p < PASS_COUNT; p++)
+	{
+		uint32_t lastPage = UINT32_MAX;
+		uint32_t lastModel = UINT32_MAX;
+		for (const Draw& draw : draws(static_cast<Pass>(p)))
+		{
+			const Object& object = m_objects[draw.object];
+			uint32_t page = object.pModel->geometryPage();
+			uint32_t modelIndex = object.pObject->model.index();
+
+			if (page != lastPage)
+			{
+				m_stats.bufferBinds++;
+				lastPage = page;
+			}
+			if (modelIndex != lastModel)
+			{
+				m_stats.modelChanges++;
+				lastModel = modelIndex;
+			}
+		}
+	}
+}
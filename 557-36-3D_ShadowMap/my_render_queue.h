@@ -0,0 +1,181 @@
+#ifndef __MY_RENDER_QUEUE_H__
+#define __MY_RENDER_QUEUE_H__
+
+#include "my_bounds_culler.h"
+#include "my_game_object.h"
+#include "my_model.h"
+
+// libs
+#include <glm/glm.hpp>
+
+// Std
+#include <cstdint>
+#include <vector>
+
+struct MyFrameInfo;
+
+//
+// The draws of a frame, built once from the object list and sorted, instead of
+// every factory walking all objects and filtering by type. Every object that
+// a pass draws (and that is in the pass's frustum) becomes a draw with a 64-bit
+// key, high to low bits:
+//
+//   pass 4 | geometry arena page 8 | model 16 | LOD 4 | material 8 | depth 24
+//
+// Each factory has one pipeline, so the pass also orders the pipelines. The
+// arena page comes first because MyModel::bind is the state that costs here.
+// Depth is front to back (from the camera, from the light for the shadow pass).
+// A radix sort puts every pass in a contiguous slice.
+//
+// The per-draw data (Instance) of the sorted draws is written to a storage
+// block of the frame allocator, draw i of the frame at instance firstInstance()
+// + i; the shaders read it with gl_InstanceIndex. Draws of the same model, LOD
+// and material are neighbours in key order and become one batch, drawn with a
+// single instanced vkCmdDrawIndexed. The material selects the texture, which
+// has to be the same for a whole draw (no non-uniform indexing).
+//
+// The model matrix, normal matrix and LOD of an object are computed once and
+// shared by its draws in all passes.
+//
+class MyRenderQueue
+{
+public:
+	enum Pass : uint32_t
+	{
+		PASS_SHADOW,   // MyOffScreenRenderFactory, every object but DEBUG
+		PASS_TEXTURE,  // MyTextureRenderFactory, TEXTURE objects
+		PASS_SIMPLE,   // MySimpleRenderFactory, SIMPLE objects
+		PASS_DEBUG,    // MyDebugRenderFactory, DEBUG objects
+		PASS_PICK,     // MyPickingFactory, every object but DEBUG
+		PASS_COUNT
+	};
+
+	static constexpr uint32_t passBit(Pass pass) { return 1u << pass; }
+
+	struct Object
+	{
+		glm::mat4     modelMatrix;   // without positionTransform
+		glm::mat4     normalMatrix;
+		MyModel*      pModel;
+		MyGameObject* pObject;
+		uint32_t      lod;
+	};
+
+	struct Draw
+	{
+		uint64_t key;
+		uint32_t object;  // index for object()
+	};
+
+	// Shader side of a draw, std430 layout of the Instance block in the vertex shaders
+	struct Instance
+	{
+		glm::mat4 modelMatrix;   // with positionTransform
+		glm::mat4 normalMatrix;
+		uint32_t  textureID;     // MyTextureRenderFactory, MyGameObject::textureIndex
+		uint32_t  pickID;        // MyPickingFactory and the selection color, pickID() of the object
+		uint32_t  padding[2];
+	};
+	static_assert(sizeof(Instance) == 144, "Instance must match the std430 layout of the shaders");
+
+	// Consecutive draws of one model, LOD and material. instanceCount 1 is a single object,
+	// which may still cull its meshlets
+	struct Batch
+	{
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t object;         // of the first instance, for the model and LOD
+	};
+
+	// Contiguous draws or batches of one pass
+	template<typename T>
+	struct Range
+	{
+		const T* pBegin;
+		const T* pEnd;
+
+		const T* begin() const { return pBegin; }
+		const T* end() const { return pEnd; }
+		uint32_t size() const { return static_cast<uint32_t>(pEnd - pBegin); }
+	};
+
+	// Counters of the last build(). Buffer binds are the arena page changes
+	// between consecutive draws of a pass (what MyModel::bind does not skip),
+	// model changes the same for models; "unsorted" counts them in the order
+	// of the object list, as the factories drew before
+	struct Stats
+	{
+		uint32_t objectCount = 0;
+		uint32_t culledCount = 0;          // outside the frustum of every pass that would draw them
+		uint32_t viewTested = 0;           // objects with a camera pass
+		uint32_t viewCulled = 0;           // of those outside the camera frustum
+		uint32_t shadowTested = 0;         // objects with the shadow pass
+		uint32_t shadowCulled = 0;         // of those outside the light frustum
+		uint32_t drawCount = 0;
+		uint32_t batchCount = 0;           // draw calls, less than drawCount with instancing
+		uint32_t bufferBinds = 0;
+		uint32_t unsortedBufferBinds = 0;
+		uint32_t modelChanges = 0;
+		uint32_t unsortedModelChanges = 0;
+	};
+
+	// Draws the passes in 'passMask' (passBit()) of the objects. Frustum culling of the
+	// objects (MyBoundsCuller, bounding box and sphere) uses the planes of
+	// frameInfo.pViewCuller and pShadowCuller when set, LOD selection the
+	// camera. 'lightPosition' orders the shadow pass. The instances go to
+	// frameInfo.pFrameAllocator; without one only the draws are built (benchmarks)
+	void build(const MyFrameInfo& frameInfo, MyGameObject* const* ppObjects, uint32_t objectCount,
+		uint32_t passMask, const glm::vec3& lightPosition);
+
+	// The draws of 'pass', or share 'shareIndex' of 'shareCount' of them for parallel recording
+	Range<Draw>  draws(Pass pass, uint32_t shareIndex = 0, uint32_t shareCount = 1) const;
+
+	// The same for the batches, the factories draw these
+	Range<Batch> batches(Pass pass, uint32_t shareIndex = 0, uint32_t shareCount = 1) const;
+
+	// Off, every draw is a batch of one: one draw call per object as without instancing
+	void setInstancing(bool bInstancing) { m_bInstancing = bInstancing; }
+	bool instancing() const { return m_bInstancing; }
+
+	// Pick ID of the object with MyGameObject ID 'id', 0 = nothing picked
+	static uint32_t pickID(uint32_t id) { return id + 1; }
+
+	// Instance of the first draw of the frame in the frame allocator's buffer
+	uint32_t firstInstance() const { return m_iFirstInstance; }
+
+	const Object& object(uint32_t index) const { return m_objects[index]; }
+	const Stats&  stats() const { return m_stats; }
+
+	// LSD radix sort by key, 8 bits per pass; passes over a byte that all keys share
+	// are skipped. Stable. 'pScratch' needs room for 'count' draws
+	static void sortDraws(Draw* pDraws, Draw* pScratch, uint32_t count);
+
+	static uint64_t makeKey(Pass pass, uint32_t page, uint32_t model, uint32_t lod, uint32_t material, float depth);
+
+private:
+	struct Candidate
+	{
+		glm::mat4     modelMatrix;
+		MyModel*      pModel;
+		MyGameObject* pObject;
+	};
+
+	void _writeInstances(const MyFrameInfo& frameInfo);
+	void _buildBatches();
+	void _countStateChanges();
+
+	std::vector<Candidate> m_candidates;  // objects some pass draws, before culling
+	std::vector<uint32_t>  m_passMasks;   // of the candidates, MyBoundsCuller clears the culled passes
+	MyBoundsCuller         m_bounds;      // of the candidates
+	std::vector<Object>    m_objects;
+	std::vector<Draw>      m_draws;
+	std::vector<Draw>      m_scratch;
+	std::vector<Batch>     m_batches;
+	uint32_t               m_passBegin[PASS_COUNT + 1] = {};
+	uint32_t               m_batchBegin[PASS_COUNT + 1] = {};
+	uint32_t               m_iFirstInstance = 0;
+	bool                   m_bInstancing = true;
+	Stats                  m_stats;
+};
+
+#endif
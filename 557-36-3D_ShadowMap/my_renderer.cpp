@@ -15,11 +15,40 @@ MyRenderer::MyRenderer(MyWindow& window, MyDevice& device)
 
     _recreateSwapChain();
     _createCommandBuffers();
+    _createTimestampQueries();
 }
 
 MyRenderer::~MyRenderer() 
 { 
     _freeCommandBuffers();
+
+    if (m_vkTimestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(m_myDevice.device(), m_vkTimestampQueryPool, nullptr);
+    }
+}
+
+void MyRenderer::_createTimestampQueries()
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_myDevice.physicalDevice(), &properties);
+
+    // Note: timing is optional, without support shadowPassTime() stays 0
+    if (!properties.limits.timestampComputeAndGraphics)
+        return;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * MySwapChain::MAX_FRAMES_IN_FLIGHT;
+
+    if (vkCreateQueryPool(m_myDevice.device(), &queryPoolInfo, nullptr, &m_vkTimestampQueryPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+
+    m_fTimestampPeriod = properties.limits.timestampPeriod;
+    m_vbTimestampsWritten.assign(MySwapChain::MAX_FRAMES_IN_FLIGHT, false);
 }
 
 void MyRenderer::_recreateSwapChain()
@@ -122,6 +151,24 @@ VkCommandBuffer MyRenderer::beginFrame()
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    if (m_vkTimestampQueryPool != VK_NULL_HANDLE)
+    {
+        // The fence of this frame has been waited on, so its previous timestamps are available
+        uint32_t firstQuery = 2 * m_iCurrentFrameIndex;
+        if (m_vbTimestampsWritten[m_iCurrentFrameIndex])
+        {
+            uint64_t timestamps[2];
+            if (vkGetQueryPoolResults(m_myDevice.device(), m_vkTimestampQueryPool, firstQuery, 2,
+                sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+            {
+                m_fShadowPassTime = static_cast<float>((timestamps[1] - timestamps[0]) * m_fTimestampPeriod * 1e-6);
+            }
+        }
+
+        vkCmdResetQueryPool(commandBuffer, m_vkTimestampQueryPool, firstQuery, 2);
+        m_vbTimestampsWritten[m_iCurrentFrameIndex] = false;
+    }
+
     return commandBuffer;
 }
 
@@ -161,7 +208,7 @@ int MyRenderer::endFrame()
     return retVal;
 }
 
-void MyRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+void MyRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
     assert(m_bIsFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
     assert(
@@ -182,8 +229,17 @@ void MyRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
 
+    // Secondary buffers set it themselves, the primary cannot record draws in this pass
+    if (contents == VK_SUBPASS_CONTENTS_INLINE)
+    {
+        setSwapChainDynamicState(commandBuffer);
+    }
+}
+
+void MyRenderer::setSwapChainDynamicState(VkCommandBuffer commandBuffer)
+{
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -196,6 +252,18 @@ void MyRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
+VkCommandBufferInheritanceInfo MyRenderer::swapChainInheritance() const
+{
+    assert(m_bIsFrameStarted && "Can't get the render pass inheritance if frame is not in progress");
+
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = m_mySwapChain->renderPass();
+    inheritance.subpass = 0;
+    inheritance.framebuffer = m_mySwapChain->frameBuffer(m_iCurrentImageIndex);
+    return inheritance;
+}
+
 void MyRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) 
 {
     assert(m_bIsFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
@@ -205,7 +273,7 @@ void MyRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
     vkCmdEndRenderPass(commandBuffer);
 }
 
-void MyRenderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer)
+void MyRenderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
     assert(m_bIsFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
     assert(
@@ -224,8 +292,21 @@ void MyRenderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer)
     renderPassBeginInfo.clearValueCount = 1;
     renderPassBeginInfo.pClearValues = clearValues;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (m_vkTimestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vkTimestampQueryPool, 2 * m_iCurrentFrameIndex);
+    }
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, contents);
+
+    if (contents == VK_SUBPASS_CONTENTS_INLINE)
+    {
+        setOffscreenDynamicState(commandBuffer);
+    }
+}
 
+void MyRenderer::setOffscreenDynamicState(VkCommandBuffer commandBuffer)
+{
     VkViewport viewport{};
     viewport.width = (float)m_mySwapChain->m_vShadowMapSize[0];
     viewport.height = (float)m_mySwapChain->m_vShadowMapSize[1];
@@ -257,9 +338,25 @@ void MyRenderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer)
         depthBiasSlope);
 }
 
+VkCommandBufferInheritanceInfo MyRenderer::offscreenInheritance() const
+{
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = m_mySwapChain->shadowMapRenderPass();
+    inheritance.subpass = 0;
+    inheritance.framebuffer = m_mySwapChain->shadowMapFrameBuffer();
+    return inheritance;
+}
+
 void MyRenderer::endOffscreenRenderPass(VkCommandBuffer commandBuffer)
 {
     vkCmdEndRenderPass(commandBuffer);
+
+    if (m_vkTimestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_vkTimestampQueryPool, 2 * m_iCurrentFrameIndex + 1);
+        m_vbTimestampsWritten[m_iCurrentFrameIndex] = true;
+    }
 }
 
 VkExtent2D MyRenderer::swapChainExtent()
@@ -31,14 +31,22 @@ public:
     int             endFrame();
 
     // For normal scene rendering
-    void            beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    void            beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void            endSwapChainRenderPass(VkCommandBuffer commandBuffer);
     void            recreateSwapChain();
 
     // For shadow map rendering
-    void            beginOffscreenRenderPass(VkCommandBuffer commandBuffer);
+    void            beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void            endOffscreenRenderPass(VkCommandBuffer commandBuffer);
 
+    // Secondary command buffers recorded into the passes above (VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+    // continue the current frame's render pass and framebuffer, and must set the viewport,
+    // scissor and depth bias themselves: dynamic state is not inherited
+    VkCommandBufferInheritanceInfo swapChainInheritance() const;
+    VkCommandBufferInheritanceInfo offscreenInheritance() const;
+    void            setSwapChainDynamicState(VkCommandBuffer commandBuffer);
+    void            setOffscreenDynamicState(VkCommandBuffer commandBuffer);
+
     int frameIndex() const 
 	{
         assert(m_bIsFrameStarted && "Cannot get frame index when frame not in progress");
@@ -53,7 +61,11 @@ public:
     // Shadow map
     VkDescriptorImageInfo shadowMapDescriptorInfo() { return m_mySwapChain->shadowMapDescriptorInfo(); }
 
+    // GPU time of the last finished shadow pass in ms (timestamp queries), 0 if not supported
+    float           shadowPassTime() const { return m_fShadowPassTime; }
+
 private:
+    void _createTimestampQueries();
     void _createCommandBuffers();
     void _freeCommandBuffers();
     void _recreateSwapChain();
@@ -72,6 +84,12 @@ private:
     uint32_t                     m_iCurrentImageIndex;
     int                          m_iCurrentFrameIndex;
     bool                         m_bIsFrameStarted;
+
+    // Two timestamps (begin, end of the shadow pass) per frame in flight
+    VkQueryPool                  m_vkTimestampQueryPool = VK_NULL_HANDLE;
+    float                        m_fTimestampPeriod = 0.0f;
+    std::vector<bool>            m_vbTimestampsWritten;
+    float                        m_fShadowPassTime = 0.0f;
 };
 
 #endif
@@ -0,0 +1,19 @@
+#include "my_resource_manager.h"
+
+MyResourceManager::MyResourceManager(uint32_t frameCount) :
+	m_models{ frameCount },
+	m_textures{ frameCount }
+{
+}
+
+void MyResourceManager::beginFrame(uint32_t frameIndex)
+{
+	m_models.beginFrame(frameIndex);
+	m_textures.beginFrame(frameIndex);
+}
+
+void MyResourceManager::flush()
+{
+	m_models.flush();
+	m_textures.flush();
+}
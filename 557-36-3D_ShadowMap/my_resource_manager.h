@@ -0,0 +1,42 @@
+#ifndef __MY_RESOURCE_MANAGER_H__
+#define __MY_RESOURCE_MANAGER_H__
+
+#include "my_model.h"
+#include "my_resource_pool.h"
+#include "my_texture.h"
+
+using MyModelHandle = MyHandle<MyModel>;
+using MyTextureHandle = MyHandle<MyTexture>;
+
+//
+// The shared resources of the scene, in pools addressed by MyHandle. Game
+// objects hold model handles and the draw loops resolve them through
+// models(); the defragmenter moves the textures of textures().
+// Pipelines and buffers are not pooled: every one has a single owner (its
+// render factory, swap chain or arena) that holds it in a unique_ptr.
+// Only for the render thread, see MyResourcePool.
+//
+class MyResourceManager
+{
+public:
+	explicit MyResourceManager(uint32_t frameCount);
+
+	MyResourceManager(const MyResourceManager&) = delete;
+	MyResourceManager& operator=(const MyResourceManager&) = delete;
+
+	MyResourcePool<MyModel>&   models()   { return m_models; }
+	MyResourcePool<MyTexture>& textures() { return m_textures; }
+
+	// Destroys what was released by the last use of this frame index,
+	// after the frame's fence has signaled (MyRenderer::beginFrame)
+	void beginFrame(uint32_t frameIndex);
+
+	// Destroys everything released, the GPU must be idle
+	void flush();
+
+private:
+	MyResourcePool<MyModel>   m_models;
+	MyResourcePool<MyTexture> m_textures;
+};
+
+#endif
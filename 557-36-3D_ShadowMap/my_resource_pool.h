@@ -0,0 +1,200 @@
+#ifndef __MY_RESOURCE_POOL_H__
+#define __MY_RESOURCE_POOL_H__
+
+// Std
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//
+// 32-bit handle of a resource in a MyResourcePool<T>: the slot index in the
+// low INDEX_BITS, the slot's generation above them. A handle goes stale when
+// its resource is released, the slot's next resource has a new generation.
+// 0 is never a valid handle.
+//
+template <typename T>
+struct MyHandle
+{
+	static constexpr uint32_t INDEX_BITS = 20;
+	static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	uint32_t value = 0;
+
+	uint32_t index() const      { return value & INDEX_MASK; }
+	uint32_t generation() const { return value >> INDEX_BITS; }
+
+	explicit operator bool() const            { return value != 0; }
+	bool operator==(const MyHandle& other) const { return value == other.value; }
+	bool operator!=(const MyHandle& other) const { return value != other.value; }
+};
+
+//
+// Resources of one type, constructed in place in chunks of CHUNK_SIZE so they
+// never move and neighbours share cache lines. Resolving a handle is an index
+// into the generation array and the chunk, no reference count is touched.
+//
+// Lifetime is reference counted by hand: create() returns the first reference,
+// every other holder calls addRef() and release(). The last release makes the
+// handles stale at once, but the resource is only destroyed by beginFrame()
+// of the same frame index, when the frames in flight that may still draw it
+// have finished (the same scheme as MyDefragmenter). flush() destroys all of
+// them, the GPU must be idle.
+// Only for the render thread; the loader threads build their resources on
+// their own and the main thread moves them in.
+//
+template <typename T>
+class MyResourcePool
+{
+public:
+	static constexpr uint32_t CHUNK_SIZE = 256;
+	static constexpr uint32_t MAX_RESOURCES = 1u << MyHandle<T>::INDEX_BITS;
+
+	using Handle = MyHandle<T>;
+
+	explicit MyResourcePool(uint32_t frameCount) : m_retired(frameCount) {}
+
+	~MyResourcePool()
+	{
+		flush();
+		for (uint32_t i = 0; i < m_refCounts.size(); i++)
+		{
+			if (m_refCounts[i] > 0)
+				_slot(i)->~T();
+		}
+	}
+
+	MyResourcePool(const MyResourcePool&) = delete;
+	MyResourcePool& operator=(const MyResourcePool&) = delete;
+
+	// Constructs T(args...) in a free slot, the caller holds the first reference
+	template <typename... Args>
+	Handle create(Args&&... args)
+	{
+		uint32_t index;
+		if (!m_freeSlots.empty())
+		{
+			index = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_generations.size());
+			assert(index < MAX_RESOURCES && "Resource pool is full");
+			if (index % CHUNK_SIZE == 0)
+				m_chunks.push_back(std::make_unique<Storage[]>(CHUNK_SIZE));
+			m_generations.push_back(1);
+			m_refCounts.push_back(0);
+		}
+
+		new (_slot(index)) T(std::forward<Args>(args)...);
+		m_refCounts[index] = 1;
+		m_iLiveCount++;
+
+		return Handle{ (m_generations[index] << Handle::INDEX_BITS) | index };
+	}
+
+	// nullptr once the handle is stale
+	T* get(Handle handle)
+	{
+		return valid(handle) ? _slot(handle.index()) : nullptr;
+	}
+
+	const T* get(Handle handle) const
+	{
+		return valid(handle) ? _slot(handle.index()) : nullptr;
+	}
+
+	// For handles known to be alive, e.g. held by a game object
+	T& operator[](Handle handle)
+	{
+		assert(valid(handle) && "Stale resource handle");
+		return *_slot(handle.index());
+	}
+
+	bool valid(Handle handle) const
+	{
+		uint32_t index = handle.index();
+		return index < m_generations.size() && m_generations[index] == handle.generation() && m_refCounts[index] > 0;
+	}
+
+	void addRef(Handle handle)
+	{
+		assert(valid(handle) && "Stale resource handle");
+		m_refCounts[handle.index()]++;
+	}
+
+	// The last reference retires the resource, see beginFrame
+	void release(Handle handle)
+	{
+		assert(valid(handle) && "Stale resource handle");
+		uint32_t index = handle.index();
+		if (--m_refCounts[index] > 0)
+			return;
+
+		// Skip 0, so no handle is ever 0
+		m_generations[index] = (m_generations[index] + 1) & Handle::GENERATION_MASK;
+		if (m_generations[index] == 0)
+			m_generations[index] = 1;
+
+		m_iLiveCount--;
+		m_retired[m_iFrameIndex].push_back(index);
+	}
+
+	// After the frame's fence has signaled, i.e. after MyRenderer::beginFrame
+	void beginFrame(uint32_t frameIndex)
+	{
+		m_iFrameIndex = frameIndex;
+
+		for (uint32_t index : m_retired[frameIndex])
+		{
+			_slot(index)->~T();
+			m_freeSlots.push_back(index);
+		}
+		m_retired[frameIndex].clear();
+	}
+
+	// Destroys everything retired, the GPU must be idle
+	void flush()
+	{
+		uint32_t frameIndex = m_iFrameIndex;
+		for (uint32_t i = 0; i < m_retired.size(); i++)
+			beginFrame(i);
+		m_iFrameIndex = frameIndex;
+	}
+
+	// Calls f(handle, resource) for every live resource
+	template <typename F>
+	void forEach(F f)
+	{
+		for (uint32_t i = 0; i < m_refCounts.size(); i++)
+		{
+			if (m_refCounts[i] > 0)
+				f(Handle{ (m_generations[i] << Handle::INDEX_BITS) | i }, *_slot(i));
+		}
+	}
+
+	uint32_t size() const { return m_iLiveCount; }
+
+private:
+	using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+	T* _slot(uint32_t index) const
+	{
+		return std::launder(reinterpret_cast<T*>(&m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]));
+	}
+
+	std::vector<std::unique_ptr<Storage[]>> m_chunks;
+	std::vector<uint32_t>                   m_generations;   // per slot
+	std::vector<uint32_t>                   m_refCounts;     // per slot, 0 = free or retired
+	std::vector<uint32_t>                   m_freeSlots;
+	std::vector<std::vector<uint32_t>>      m_retired;       // per frame in flight
+	uint32_t                                m_iFrameIndex = 0;
+	uint32_t                                m_iLiveCount = 0;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "my_staging_pool.h"
+
+MyStagingPool::MyStagingPool(MyDevice& device) :
+	m_myDevice{ device }
+{
+	m_blocks[0] = std::make_unique<MyStagingRing>(device, BLOCK_SIZE);
+	m_iBlockCount.store(1, std::memory_order_release);
+}
+
+bool MyStagingPool::allocate(VkDeviceSize size, Allocation& allocation)
+{
+	uint32_t blockCount = m_iBlockCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < blockCount; i++)
+	{
+		if (m_blocks[i]->allocate(size, allocation))
+		{
+			allocation.block = i;
+			return true;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{ m_growMutex };
+
+	// Another thread may have added a block while this one waited for the lock
+	uint32_t newCount = m_iBlockCount.load(std::memory_order_acquire);
+	for (uint32_t i = blockCount; i < newCount; i++)
+	{
+		if (m_blocks[i]->allocate(size, allocation))
+		{
+			allocation.block = i;
+			return true;
+		}
+	}
+
+	if (newCount == MAX_BLOCKS)
+		return false;
+
+	m_blocks[newCount] = std::make_unique<MyStagingRing>(m_myDevice, BLOCK_SIZE);
+	m_iBlockCount.store(newCount + 1, std::memory_order_release);
+
+	if (!m_blocks[newCount]->allocate(size, allocation))
+		return false;
+
+	allocation.block = newCount;
+	return true;
+}
+
+void MyStagingPool::release(const Allocation& allocation)
+{
+	if (allocation.id == 0)
+		return;
+
+	m_blocks[allocation.block]->release(allocation);
+}
+
+VkDeviceSize MyStagingPool::used() const
+{
+	VkDeviceSize used = 0;
+	uint32_t blockCount = m_iBlockCount.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < blockCount; i++)
+		used += m_blocks[i]->used();
+	return used;
+}
+
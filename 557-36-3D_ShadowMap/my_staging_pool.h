@@ -0,0 +1,55 @@
+#ifndef __MY_STAGING_POOL_H__
+#define __MY_STAGING_POOL_H__
+
+#include "my_staging_ring.h"
+
+// Std
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+//
+// The staging memory of every CPU to GPU upload, owned by MyDevice: up to
+// MAX_BLOCKS persistently mapped MyStagingRing blocks. The first block is
+// created up front; another one is added when the existing blocks are all
+// taken by uploads in flight, so a burst of loads does not fall back to
+// staging buffers of its own. Ranges come back when the batch that staged
+// them is destroyed, which its owner does after the upload's fence signaled.
+// Uploads larger than CHUNK_SIZE are split by MyUploadBatch, so no single
+// range needs more than a chunk of contiguous space. Thread safe.
+//
+class MyStagingPool
+{
+public:
+	static constexpr VkDeviceSize BLOCK_SIZE = 32 * 1024 * 1024;
+	static constexpr uint32_t     MAX_BLOCKS = 4;
+	static constexpr VkDeviceSize CHUNK_SIZE = BLOCK_SIZE / 4;
+
+	using Allocation = MyStagingRing::Allocation;
+
+	explicit MyStagingPool(MyDevice& device);
+
+	MyStagingPool(const MyStagingPool&) = delete;
+	MyStagingPool& operator=(const MyStagingPool&) = delete;
+
+	// Returns false when every block is full and no block can be added
+	bool allocate(VkDeviceSize size, Allocation& allocation);
+
+	// Once the GPU has executed the copies reading from it
+	void release(const Allocation& allocation);
+
+	uint32_t     blockCount() const { return m_iBlockCount.load(std::memory_order_acquire); }
+	VkDeviceSize size() const { return BLOCK_SIZE * blockCount(); }
+	VkDeviceSize used() const;
+
+private:
+	MyDevice&                      m_myDevice;
+
+	// Slots are filled once and never cleared, readers only look below the count
+	std::unique_ptr<MyStagingRing> m_blocks[MAX_BLOCKS];
+	std::atomic<uint32_t>          m_iBlockCount{ 0 };
+	std::mutex                     m_growMutex;
+};
+
+#endif
+
@@ -0,0 +1,92 @@
+#include "my_staging_ring.h"
+
+// Std
+#include <cassert>
+
+MyStagingRing::MyStagingRing(MyDevice& device, VkDeviceSize size) :
+	m_vkSize{ size }
+{
+	m_pMyBuffer = std::make_unique<MyBuffer>(
+		device,
+		size,
+		1,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Note: it will unmap in the destructor
+	m_pMyBuffer->map();
+}
+
+bool MyStagingRing::allocate(VkDeviceSize size, Allocation& allocation)
+{
+	size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	if (size == 0 || size > m_vkSize)
+		return false;
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	// Free space is [head, tail), wrapping around the end. head == tail means empty
+	// or full, the entries tell which
+	VkDeviceSize begin = m_vkHead;
+	VkDeviceSize offset = m_vkHead;
+	if (m_entries.empty())
+	{
+		m_vkHead = m_vkTail = begin = offset = 0;
+	}
+	else if (m_vkHead > m_vkTail)
+	{
+		// Skip the rest of the ring if the range does not fit in front of the end
+		if (m_vkSize - m_vkHead < size)
+		{
+			if (m_vkTail < size)
+				return false;
+			offset = 0;
+		}
+	}
+	else if (m_vkTail - m_vkHead < size) // also full when head == tail
+	{
+		return false;
+	}
+
+	m_vkHead = offset + size;
+	if (m_vkHead == m_vkSize)
+		m_vkHead = 0;
+
+	// A wrapped entry also owns the skipped end of the ring, it comes back with the entry
+	m_entries.push_back({ begin, offset + size, false });
+
+	allocation.buffer = m_pMyBuffer->buffer();
+	allocation.offset = offset;
+	allocation.pData = static_cast<char*>(m_pMyBuffer->mappedMemory()) + offset;
+	allocation.id = m_iFirstId + m_entries.size() - 1;
+	return true;
+}
+
+void MyStagingRing::release(const Allocation& allocation)
+{
+	if (allocation.id == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	assert(allocation.id >= m_iFirstId && allocation.id - m_iFirstId < m_entries.size() && "Releasing a staging range twice");
+	m_entries[allocation.id - m_iFirstId].bReleased = true;
+
+	while (!m_entries.empty() && m_entries.front().bReleased)
+	{
+		m_vkTail = m_entries.front().end == m_vkSize ? 0 : m_entries.front().end;
+		m_entries.pop_front();
+		m_iFirstId++;
+	}
+}
+
+VkDeviceSize MyStagingRing::used() const
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	VkDeviceSize used = 0;
+	for (const auto& entry : m_entries)
+		used += entry.end > entry.begin ? entry.end - entry.begin : entry.end + m_vkSize - entry.begin;
+	return used;
+}
+
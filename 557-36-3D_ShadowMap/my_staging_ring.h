@@ -0,0 +1,70 @@
+#ifndef __MY_STAGING_RING_H__
+#define __MY_STAGING_RING_H__
+
+#include "my_device.h"
+#include "my_buffer.h"
+
+// Std
+#include <deque>
+#include <memory>
+#include <mutex>
+
+//
+// Persistently mapped host visible buffer that staging data is written into
+// instead of creating a staging buffer per upload. Space is handed out from
+// the head and comes back at the tail once the GPU has read it; releases may
+// come out of order, the tail only moves past the oldest released range.
+// When the ring has no room allocate() fails and the caller uses a buffer of
+// its own, so a full ring never blocks. Thread safe.
+// MyDevice owns a MyStagingPool of these.
+//
+class MyStagingRing
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_SIZE = 64 * 1024 * 1024;
+
+	// Offsets are aligned for buffer to buffer and buffer to image copies
+	static constexpr VkDeviceSize ALIGNMENT = 16;
+
+	struct Allocation
+	{
+		VkBuffer     buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		void*        pData = nullptr;
+		uint64_t     id = 0;          // 0 = not from the ring
+		uint32_t     block = 0;       // which ring of MyStagingPool
+	};
+
+	MyStagingRing(MyDevice& device, VkDeviceSize size = DEFAULT_SIZE);
+
+	MyStagingRing(const MyStagingRing&) = delete;
+	MyStagingRing& operator=(const MyStagingRing&) = delete;
+
+	bool allocate(VkDeviceSize size, Allocation& allocation);
+
+	// Once the GPU has executed the copies reading from it
+	void release(const Allocation& allocation);
+
+	VkDeviceSize size() const { return m_vkSize; }
+	VkDeviceSize used() const;
+
+private:
+	struct Entry
+	{
+		VkDeviceSize begin;     // including the unused end of the ring when it wrapped
+		VkDeviceSize end;
+		bool         bReleased;
+	};
+
+	VkDeviceSize              m_vkSize;
+	std::unique_ptr<MyBuffer> m_pMyBuffer;
+
+	mutable std::mutex        m_mutex;
+	std::deque<Entry>         m_entries;     // oldest first
+	uint64_t                  m_iFirstId = 1; // id of m_entries.front()
+	VkDeviceSize              m_vkHead = 0;
+	VkDeviceSize              m_vkTail = 0;
+};
+
+#endif
+
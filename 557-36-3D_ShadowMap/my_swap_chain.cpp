@@ -1,6 +1,7 @@
 #include "my_swap_chain.h"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -46,6 +47,14 @@ void MySwapChain::_init()
     _createFramebuffers();
     _createSyncObjects();
 
+    // Where the pick targets can't be lazily allocated they share the shadow map's memory
+    m_bAliasedTargets = !m_myDevice.memoryAllocator().hasMemoryType(
+        UINT32_MAX, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    _createPickingImageBuffers();
+    _createOffscreenImageBuffers();
+    if (m_bAliasedTargets)
+        _bindAliasedTargets();
+
     // For picking
     _createPickingResources();
 
@@ -74,14 +83,14 @@ MySwapChain::~MySwapChain()
     {
         vkDestroyImageView(m_myDevice.device(), m_vVkColorImageViews[i], nullptr);
         vkDestroyImage(m_myDevice.device(), m_vVkColorImages[i], nullptr);
-        vkFreeMemory(m_myDevice.device(), m_vVkColorImageMemorys[i], nullptr);
+        m_myDevice.freeMemory(m_vColorImageMemorys[i]);
     }
 
     for (int i = 0; i < m_vVkDepthImages.size(); i++)
     {
         vkDestroyImageView(m_myDevice.device(), m_vVkDepthImageViews[i], nullptr);
         vkDestroyImage(m_myDevice.device(), m_vVkDepthImages[i], nullptr);
-        vkFreeMemory(m_myDevice.device(), m_vVkDepthImageMemorys[i], nullptr);
+        m_myDevice.freeMemory(m_vDepthImageMemorys[i]);
     }
 
     for (auto framebuffer : m_vVkSwapChainFramebuffers)
@@ -96,15 +105,16 @@ MySwapChain::~MySwapChain()
     vkDestroyImageView(m_myDevice.device(), m_vkPickDepthImageView, nullptr);
     vkDestroyImage(m_myDevice.device(), m_vkPickColorImage, nullptr);
     vkDestroyImage(m_myDevice.device(), m_vkPickDepthImage, nullptr);
-    vkFreeMemory(m_myDevice.device(), m_vkPickColorImageMemory, nullptr);
-    vkFreeMemory(m_myDevice.device(), m_vkPickDepthImageMemory, nullptr);
+    m_myDevice.freeMemory(m_pickColorImageMemory);
+    m_myDevice.freeMemory(m_pickDepthImageMemory);
     vkDestroyFramebuffer(m_myDevice.device(), m_vkPickFrameBuffer, nullptr);
     vkDestroyRenderPass(m_myDevice.device(), m_vkPickRenderPass, nullptr);
 
     // Offscrren
     vkDestroyImageView(m_myDevice.device(), m_vkOffscreenImageView, nullptr);
     vkDestroyImage(m_myDevice.device(), m_vkOffscreenImage, nullptr);
-    vkFreeMemory(m_myDevice.device(), m_vkOffscreenImageMemory, nullptr);
+    m_myDevice.freeMemory(m_offscreenImageMemory);
+    m_myDevice.freeMemory(m_aliasedTargetMemory);
 
     // Sampler
     vkDestroySampler(m_myDevice.device(), m_vkShadowMapSampler, nullptr);
@@ -301,7 +311,8 @@ void MySwapChain::_createRenderPass()
     colorAttachment.format = swapChainImageFormat();
     colorAttachment.samples = m_myDevice.msaaSamples();
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    // The multisampled target is only resolved, nothing reads it after the pass
+    colorAttachment.storeOp = m_myDevice.msaaSamples() == VK_SAMPLE_COUNT_1_BIT ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -490,8 +501,12 @@ void MySwapChain::_createColorResources()
     VkFormat colorFormat = surfaceFormat.format;
     m_vkSwapChainColorFormat = colorFormat;
 
+    // Without MSAA the pass renders straight to the swap chain images
+    if (m_myDevice.msaaSamples() == VK_SAMPLE_COUNT_1_BIT)
+        return;
+
     m_vVkColorImages.resize(imageCount());
-    m_vVkColorImageMemorys.resize(imageCount());
+    m_vColorImageMemorys.resize(imageCount());
     m_vVkColorImageViews.resize(imageCount());
 
     for (int i = 0; i < m_vVkColorImages.size(); i++)
@@ -516,7 +531,7 @@ void MySwapChain::_createColorResources()
             imageInfo,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             m_vVkColorImages[i],
-            m_vVkColorImageMemorys[i]);
+            m_vColorImageMemorys[i]);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -542,7 +557,7 @@ void MySwapChain::_createDepthResources()
     m_vkSwapChainDepthFormat = depthFormat;
 
     m_vVkDepthImages.resize(imageCount());
-    m_vVkDepthImageMemorys.resize(imageCount());
+    m_vDepthImageMemorys.resize(imageCount());
     m_vVkDepthImageViews.resize(imageCount());
 
     for (int i = 0; i < m_vVkDepthImages.size(); i++)
@@ -558,7 +573,7 @@ void MySwapChain::_createDepthResources()
         imageInfo.format = depthFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; // never stored
         imageInfo.samples = m_myDevice.msaaSamples();
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -567,7 +582,7 @@ void MySwapChain::_createDepthResources()
             imageInfo,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             m_vVkDepthImages[i],
-            m_vVkDepthImageMemorys[i]);
+            m_vDepthImageMemorys[i]);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -685,9 +700,66 @@ VkFormat MySwapChain::findDepthFormat()
 //
 // Picking
 //
+void MySwapChain::_createTargetImage(const VkImageCreateInfo& imageInfo, VkImage& image, MyMemoryAllocator::Allocation& imageMemory)
+{
+    if (!m_bAliasedTargets)
+    {
+        m_myDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+        return;
+    }
+
+    // Bound in _bindAliasedTargets()
+    if (vkCreateImage(m_myDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create image!");
+    }
+}
+
+void MySwapChain::_bindAliasedTargets()
+{
+    VkMemoryRequirements pickColor, pickDepth, shadowMap;
+    vkGetImageMemoryRequirements(m_myDevice.device(), m_vkPickColorImage, &pickColor);
+    vkGetImageMemoryRequirements(m_myDevice.device(), m_vkPickDepthImage, &pickDepth);
+    vkGetImageMemoryRequirements(m_myDevice.device(), m_vkOffscreenImage, &shadowMap);
+
+    auto bind = [this](VkImage image, const MyMemoryAllocator::Allocation& memory, VkDeviceSize offset)
+    {
+        if (vkBindImageMemory(m_myDevice.device(), image, memory.memory, memory.offset + offset) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to bind image memory!");
+        }
+    };
+
+    // The pick targets one after the other, the shadow map over both
+    VkDeviceSize pickDepthOffset = (pickColor.size + pickDepth.alignment - 1) / pickDepth.alignment * pickDepth.alignment;
+
+    VkMemoryRequirements requirements{};
+    requirements.size = std::max(pickDepthOffset + pickDepth.size, shadowMap.size);
+    requirements.alignment = std::max({ pickColor.alignment, pickDepth.alignment, shadowMap.alignment });
+    requirements.memoryTypeBits = pickColor.memoryTypeBits & pickDepth.memoryTypeBits & shadowMap.memoryTypeBits;
+
+    MyMemoryAllocator& allocator = m_myDevice.memoryAllocator();
+    if (requirements.memoryTypeBits == 0)
+    {
+        // No memory type suits all three, each gets memory of its own
+        m_pickColorImageMemory = allocator.allocate(pickColor, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MyMemoryAllocator::RESOURCE_OPTIMAL, MyMemoryAllocator::CATEGORY_RENDER_TARGET);
+        m_pickDepthImageMemory = allocator.allocate(pickDepth, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MyMemoryAllocator::RESOURCE_OPTIMAL, MyMemoryAllocator::CATEGORY_RENDER_TARGET);
+        m_offscreenImageMemory = allocator.allocate(shadowMap, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MyMemoryAllocator::RESOURCE_OPTIMAL, MyMemoryAllocator::CATEGORY_RENDER_TARGET);
+        bind(m_vkPickColorImage, m_pickColorImageMemory, 0);
+        bind(m_vkPickDepthImage, m_pickDepthImageMemory, 0);
+        bind(m_vkOffscreenImage, m_offscreenImageMemory, 0);
+        return;
+    }
+
+    m_aliasedTargetMemory = allocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MyMemoryAllocator::RESOURCE_OPTIMAL, MyMemoryAllocator::CATEGORY_RENDER_TARGET);
+    bind(m_vkPickColorImage, m_aliasedTargetMemory, 0);
+    bind(m_vkPickDepthImage, m_aliasedTargetMemory, pickDepthOffset);
+    bind(m_vkOffscreenImage, m_aliasedTargetMemory, 0);
+}
+
 void MySwapChain::_createPickingResources()
 {
-    _createPickingImageBuffers();
+    _createPickingImageViews();
     _createPickRenderPass();
     _createPickFramebuffers();
 }
@@ -713,33 +785,9 @@ void MySwapChain::_createPickingImageBuffers()
     imageInfoColor.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfoColor.flags = 0;
 
-    m_myDevice.createImageWithInfo(
-        imageInfoColor,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_vkPickColorImage,
-        m_vkPickColorImageMemory);
-
-    VkImageViewCreateInfo viewInfoColor{};
-    viewInfoColor.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfoColor.image = m_vkPickColorImage;
-    viewInfoColor.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfoColor.format = VK_FORMAT_R32_SFLOAT;
-    viewInfoColor.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfoColor.subresourceRange.baseMipLevel = 0;
-    viewInfoColor.subresourceRange.levelCount = 1;
-    viewInfoColor.subresourceRange.baseArrayLayer = 0;
-    viewInfoColor.subresourceRange.layerCount = 1;
-
-    if (vkCreateImageView(m_myDevice.device(), &viewInfoColor, nullptr, &m_vkPickColorImageView) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create pick color image view!");
-    }
+    _createTargetImage(imageInfoColor, m_vkPickColorImage, m_pickColorImageMemory);
 
     // Create depth image
-    VkFormat depthFormat = findDepthFormat();
-
-    //depthFormat = VK_FORMAT_D32_SFLOAT;
-
     VkImageCreateInfo imageInfoDepth{};
     imageInfoDepth.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfoDepth.imageType = VK_IMAGE_TYPE_2D;
@@ -748,7 +796,7 @@ void MySwapChain::_createPickingImageBuffers()
     imageInfoDepth.extent.depth = 1;
     imageInfoDepth.mipLevels = 1;
     imageInfoDepth.arrayLayers = 1;
-    imageInfoDepth.format = depthFormat;
+    imageInfoDepth.format = findDepthFormat();
     imageInfoDepth.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfoDepth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfoDepth.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
@@ -756,17 +804,32 @@ void MySwapChain::_createPickingImageBuffers()
     imageInfoDepth.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfoDepth.flags = 0;
 
-    m_myDevice.createImageWithInfo(
-        imageInfoDepth,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_vkPickDepthImage,
-        m_vkPickDepthImageMemory);
+    _createTargetImage(imageInfoDepth, m_vkPickDepthImage, m_pickDepthImageMemory);
+}
+
+void MySwapChain::_createPickingImageViews()
+{
+    VkImageViewCreateInfo viewInfoColor{};
+    viewInfoColor.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfoColor.image = m_vkPickColorImage;
+    viewInfoColor.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfoColor.format = VK_FORMAT_R32_SFLOAT;
+    viewInfoColor.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfoColor.subresourceRange.baseMipLevel = 0;
+    viewInfoColor.subresourceRange.levelCount = 1;
+    viewInfoColor.subresourceRange.baseArrayLayer = 0;
+    viewInfoColor.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(m_myDevice.device(), &viewInfoColor, nullptr, &m_vkPickColorImageView) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create pick color image view!");
+    }
 
     VkImageViewCreateInfo viewInfoDepth{};
     viewInfoDepth.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfoDepth.image = m_vkPickDepthImage;
     viewInfoDepth.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfoDepth.format = depthFormat;
+    viewInfoDepth.format = findDepthFormat();
     viewInfoDepth.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
     viewInfoDepth.subresourceRange.baseMipLevel = 0;
     viewInfoDepth.subresourceRange.levelCount = 1;
@@ -786,7 +849,7 @@ void MySwapChain::_createPickRenderPass()
     object_picking_colorAttachment.format = VK_FORMAT_R32_SFLOAT;
     object_picking_colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     object_picking_colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    object_picking_colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    object_picking_colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // the picked ID goes to the SSBO
     object_picking_colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     object_picking_colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     object_picking_colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -824,6 +887,12 @@ void MySwapChain::_createPickRenderPass()
     object_picking_dependency.srcAccessMask = 0;
     object_picking_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     object_picking_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    if (m_bAliasedTargets)
+    {
+        // Wait for earlier frames to be done writing and sampling the shadow map in the same memory
+        object_picking_dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        object_picking_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
 
     std::array<VkAttachmentDescription, 2 > object_picking_attachments = { object_picking_colorAttachment,object_picking_depthAttachment };
     VkRenderPassCreateInfo object_picking_renderPassInfo{};
@@ -867,7 +936,7 @@ void MySwapChain::_createPickFramebuffers()
 // Offscreen shadow map
 void MySwapChain::_createOffscreenResources()
 {
-    _createOffscreenImageBuffers();
+    _createOffscreenImageView();
     _createOffscreenSampler();
     _createOffscreenRenderPass();
     _createOffscreenFramebuffers();
@@ -889,12 +958,11 @@ void MySwapChain::_createOffscreenImageBuffers()
     image.format = m_vkOffscreenDepthFormat;
     image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;	// We will sample directly from the depth attachment for the shadow mapping
 
-    m_myDevice.createImageWithInfo(
-        image,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_vkOffscreenImage,
-        m_vkOffscreenImageMemory);
+    _createTargetImage(image, m_vkOffscreenImage, m_offscreenImageMemory);
+}
 
+void MySwapChain::_createOffscreenImageView()
+{
     VkImageViewCreateInfo depthStencilView{};
     depthStencilView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -966,6 +1034,14 @@ void MySwapChain::_createOffscreenRenderPass()
     dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
     dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    if (m_bAliasedTargets)
+    {
+        // Wait for the pick pass writes to the same memory; the pick targets don't map to
+        // the shadow map pixel by pixel, so not by region
+        dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dependencyFlags = 0;
+    }
 
     dependencies[1].srcSubpass = 0;
     dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
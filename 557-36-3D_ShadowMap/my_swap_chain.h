@@ -73,15 +73,21 @@ private:
     void _createFramebuffers();
     void _createSyncObjects();
 
+    // Render target images, with memory unless m_bAliasedTargets
+    void _createTargetImage(const VkImageCreateInfo& imageInfo, VkImage& image, MyMemoryAllocator::Allocation& imageMemory);
+    void _bindAliasedTargets();
+
     // Picking
     void _createPickingResources();
     void _createPickingImageBuffers();
+    void _createPickingImageViews();
     void _createPickFramebuffers();
     void _createPickRenderPass();
 
     // Offscreen shadow map
     void _createOffscreenResources();
     void _createOffscreenImageBuffers();
+    void _createOffscreenImageView();
     void _createOffscreenSampler();
     void _createOffscreenRenderPass();
     void _createOffscreenFramebuffers();
@@ -101,12 +107,12 @@ private:
 
     // Color
     std::vector<VkImage>         m_vVkColorImages;
-    std::vector<VkDeviceMemory>  m_vVkColorImageMemorys;
+    std::vector<MyMemoryAllocator::Allocation> m_vColorImageMemorys;
     std::vector<VkImageView>     m_vVkColorImageViews;
 
     // Depth
     std::vector<VkImage>         m_vVkDepthImages;
-    std::vector<VkDeviceMemory>  m_vVkDepthImageMemorys;
+    std::vector<MyMemoryAllocator::Allocation> m_vDepthImageMemorys;
     std::vector<VkImageView>     m_vVkDepthImageViews;
 
     // Swapchain
@@ -127,22 +133,27 @@ private:
     // Picking
     VkImage                      m_vkPickColorImage;
     VkImageView                  m_vkPickColorImageView;
-    VkDeviceMemory               m_vkPickColorImageMemory;
+    MyMemoryAllocator::Allocation m_pickColorImageMemory;
     VkImage                      m_vkPickDepthImage;
     VkImageView                  m_vkPickDepthImageView;
-    VkDeviceMemory               m_vkPickDepthImageMemory;
+    MyMemoryAllocator::Allocation m_pickDepthImageMemory;
     VkFramebuffer                m_vkPickFrameBuffer;
     VkRenderPass                 m_vkPickRenderPass;
 
     // Shadow map offscreen
     VkImage                      m_vkOffscreenImage;
-    VkDeviceMemory               m_vkOffscreenImageMemory;
+    MyMemoryAllocator::Allocation m_offscreenImageMemory;
     VkImageView                  m_vkOffscreenImageView;
     VkFormat                     m_vkOffscreenDepthFormat;
 
     VkSampler                    m_vkShadowMapSampler;
     VkRenderPass                 m_vkShadowMapRenderPass;
     VkFramebuffer                m_vkShadowMapFrameBuffer;
+
+    // The pick targets and the shadow map are never drawn in the same frame, without
+    // lazily allocated memory for the pick targets they share one allocation
+    bool                         m_bAliasedTargets = false;
+    MyMemoryAllocator::Allocation m_aliasedTargetMemory;
 };
 
 #endif
@@ -1,23 +1,53 @@
 #include "my_texture.h"
+#include "my_upload_batch.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
 #include <cmath>
+#include <vector>
 
-MyTexture::MyTexture(MyDevice& device, std::string textureFileName) :
+MyTexture::MyTexture(MyDevice& device, std::string textureFileName, MyUploadBatch* pUploadBatch) :
     m_iMipLevels{ 1 },
     m_myDevice{ device }
 {
-    _createTextureImage(textureFileName);
+    _loadTextureImage(textureFileName, pUploadBatch);
     _createTextureImageView();
     _createTextureSampler();
 }
 
+MyTexture::MyTexture(MyDevice& device, const unsigned char* pPixels, uint32_t width, uint32_t height, MyUploadBatch* pUploadBatch) :
+    m_iMipLevels{ 1 },
+    m_myDevice{ device }
+{
+    _createTextureImage(pPixels, width, height, pUploadBatch);
+    _createTextureImageView();
+    _createTextureSampler();
+}
+
+MyTexture::MyTexture(MyTexture&& other) noexcept :
+    m_sTextureFile{ std::move(other.m_sTextureFile) },
+    m_myDevice{ other.m_myDevice },
+    m_iMipLevels{ other.m_iMipLevels },
+    m_iWidth{ other.m_iWidth },
+    m_iHeight{ other.m_iHeight },
+    m_vkTextureImage{ other.m_vkTextureImage },
+    m_textureImageMemory{ other.m_textureImageMemory },
+    m_vkTextureImageView{ other.m_vkTextureImageView },
+    m_vkTextureSampler{ other.m_vkTextureSampler }
+{
+    // Destroying null handles and freeing an empty allocation does nothing
+    other.m_vkTextureImage = VK_NULL_HANDLE;
+    other.m_textureImageMemory = {};
+    other.m_vkTextureImageView = VK_NULL_HANDLE;
+    other.m_vkTextureSampler = VK_NULL_HANDLE;
+}
+
 MyTexture::~MyTexture()
 {
     // Clean up
@@ -25,36 +55,58 @@ MyTexture::~MyTexture()
     vkDestroyImageView(m_myDevice.device(), m_vkTextureImageView, nullptr);
 
     vkDestroyImage(m_myDevice.device(), m_vkTextureImage, nullptr);
-    vkFreeMemory(m_myDevice.device(), m_vkTextureImageMemory, nullptr);
+    m_myDevice.freeMemory(m_textureImageMemory);
 }
 
-void MyTexture::_createTextureImage(std::string textureFileName)
+void MyTexture::_loadTextureImage(std::string textureFileName, MyUploadBatch* pUploadBatch)
 {
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(textureFileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = VkDeviceSize(texWidth * texHeight * 4);
-    m_iMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    m_myDevice.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(m_myDevice.device(), stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(m_myDevice.device(), stagingBufferMemory);
+    m_sTextureFile = textureFileName;
+    _createTextureImage(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), pUploadBatch);
 
     stbi_image_free(pixels);
+}
+
+void MyTexture::_createTextureImage(const unsigned char* pixels, uint32_t texWidth, uint32_t texHeight, MyUploadBatch* pUploadBatch)
+{
+    VkDeviceSize imageSize = VkDeviceSize(texWidth) * texHeight * 4;
+    m_iMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    m_iWidth = texWidth;
+    m_iHeight = texHeight;
+
+    // Check if image format supports linear blitting for the mipmaps
+    if (!m_myDevice.formatIsFilterable(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL)) {
+        throw std::runtime_error("texture image format does not support linear blitting!");
+    }
 
+    _createImage();
+
+    // The copy, the mipmaps and the layout transitions are recorded into the batch,
+    // without the caller's batch they are submitted in one go here
+    if (pUploadBatch)
+    {
+        pUploadBatch->copyToImage(pixels, imageSize, m_vkTextureImage, texWidth, texHeight, m_iMipLevels);
+        return;
+    }
+
+    MyUploadBatch batch{ m_myDevice, true };
+    batch.copyToImage(pixels, imageSize, m_vkTextureImage, texWidth, texHeight, m_iMipLevels);
+    m_myDevice.submitUploads(batch);
+}
+
+void MyTexture::_createImage()
+{
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = texWidth;
-    imageInfo.extent.height = texHeight;
+    imageInfo.extent.width = m_iWidth;
+    imageInfo.extent.height = m_iHeight;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = m_iMipLevels;
     imageInfo.arrayLayers = 1;
@@ -62,24 +114,89 @@ void MyTexture::_createTextureImage(std::string textureFileName)
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage |= m_myDevice.hostImageCopyUsage(); // mip 0 is written from the host, see MyUploadBatch
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    m_myDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vkTextureImage, m_vkTextureImageMemory);
+    m_myDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vkTextureImage, m_textureImageMemory);
+}
+
+std::function<void()> MyTexture::relocate(VkCommandBuffer commandBuffer)
+{
+    VkImage oldImage = m_vkTextureImage;
+    VkImageView oldImageView = m_vkTextureImageView;
+    MyMemoryAllocator::Allocation oldMemory = m_textureImageMemory;
+
+    _createImage();
+
+    // Frames submitted earlier may still sample the old image
+    VkImageMemoryBarrier barriers[2]{};
+    for (auto& barrier : barriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = m_iMipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    barriers[0].image = oldImage;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-    _transitionImageLayout(m_vkTextureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_iMipLevels);
-    m_myDevice.copyBufferToImage(stagingBuffer, m_vkTextureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1);
+    barriers[1].image = m_vkTextureImage;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-    // transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
-    //_transitionImageLayout(m_vkTextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_iMipLevels);
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        2, barriers);
+
+    std::vector<VkImageCopy> regions(m_iMipLevels);
+    for (uint32_t i = 0; i < m_iMipLevels; i++)
+    {
+        regions[i] = {};
+        regions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+        regions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+        regions[i].extent = { std::max(m_iWidth >> i, 1u), std::max(m_iHeight >> i, 1u), 1 };
+    }
+
+    vkCmdCopyImage(commandBuffer,
+        oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        m_vkTextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        m_iMipLevels, regions.data());
 
-    vkDestroyBuffer(m_myDevice.device(), stagingBuffer, nullptr);
-    vkFreeMemory(m_myDevice.device(), stagingBufferMemory, nullptr);
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-    _generateMipmaps(m_vkTextureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_iMipLevels);
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barriers[1]);
+
+    _createTextureImageView();
+
+    MyDevice& device = m_myDevice;
+    return [&device, oldImage, oldImageView, oldMemory]() mutable
+    {
+        vkDestroyImageView(device.device(), oldImageView, nullptr);
+        vkDestroyImage(device.device(), oldImage, nullptr);
+        device.freeMemory(oldMemory);
+    };
 }
 
-// Note: there is a similar function in MySwapChain to create color and depth image views for each image target in the swap chain
 void MyTexture::_createTextureImageView()
 {
     if (m_vkTextureImage == VK_NULL_HANDLE) {
@@ -130,68 +247,8 @@ void MyTexture::_createTextureSampler()
     }
 }
 
-void MyTexture::_transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
-{
-    VkCommandBuffer commandBuffer = m_myDevice.beginSingleTimeCommands();
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = mipLevels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else {
-        throw std::invalid_argument("unsupported layout transition!");
-    }
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
-
-    m_myDevice.endSingleTimeCommands(commandBuffer);
-}
-
-void MyTexture::_generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+void MyTexture::recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 {
-    // Check if image format supports linear blitting
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(m_myDevice.physicalDevice(), imageFormat, &formatProperties);
-
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting!");
-    }
-
-    VkCommandBuffer commandBuffer = m_myDevice.beginSingleTimeCommands();
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.image = image;
@@ -264,8 +321,6 @@ void MyTexture::_generateMipmaps(VkImage image, VkFormat imageFormat, int32_t te
         0, nullptr,
         0, nullptr,
         1, &barrier);
-
-    m_myDevice.endSingleTimeCommands(commandBuffer);
 }
 
 VkDescriptorImageInfo MyTexture::descriptorInfo()
@@ -3,34 +3,58 @@
 
 #include "my_device.h"
 
+// Std
+#include <functional>
+
+class MyUploadBatch;
+
 class MyTexture
 {
 public:
-	MyTexture(MyDevice& device, std::string textureFileName);
+	// With an upload batch the texture is only usable once the batch has run on the GPU
+	MyTexture(MyDevice& device, std::string textureFileName, MyUploadBatch* pUploadBatch = nullptr);
+
+	// From RGBA8 pixels, e.g. a placeholder until the real texture is loaded
+	MyTexture(MyDevice& device, const unsigned char* pPixels, uint32_t width, uint32_t height, MyUploadBatch* pUploadBatch = nullptr);
 	~MyTexture();
 
 	MyTexture(const MyTexture&) = delete;
 	MyTexture& operator=(const MyTexture&) = delete;
-	MyTexture(MyTexture&&) = delete;
 	MyTexture& operator=(const MyTexture&&) = delete;
+
+	// Takes over the image, so the loader's texture can move into a MyResourcePool
+	MyTexture(MyTexture&& other) noexcept;
 	VkDescriptorImageInfo descriptorInfo();
 
+	const MyMemoryAllocator::Allocation& memory() const { return m_textureImageMemory; }
+
+	// Records a copy into a new image (placed by the allocator, see MyDefragmenter) and
+	// switches the texture to it, descriptor sets must be rewritten before their next use.
+	// The returned function destroys the old image, call it once the GPU has executed 'commandBuffer'
+	std::function<void()> relocate(VkCommandBuffer commandBuffer);
+
+	// Fills mip levels 1.. from level 0 and leaves every level in SHADER_READ_ONLY_OPTIMAL,
+	// all levels must be in TRANSFER_DST_OPTIMAL
+	static void recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+
 private:
-	void _createTextureImage(std::string textureFileName);
+	void _loadTextureImage(std::string textureFileName, MyUploadBatch* pUploadBatch);
+	void _createTextureImage(const unsigned char* pPixels, uint32_t texWidth, uint32_t texHeight, MyUploadBatch* pUploadBatch);
+	void _createImage();
 	void _createTextureImageView();
 	void _createTextureSampler();
-	void _transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-	void _generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 	std::string    m_sTextureFile;
 	MyDevice&      m_myDevice;
 	uint32_t       m_iMipLevels;
+	uint32_t       m_iWidth = 0;
+	uint32_t       m_iHeight = 0;
 
 	// TODO: need to move these into SwapChain class
 	VkImage        m_vkTextureImage = VK_NULL_HANDLE;
-	VkDeviceMemory m_vkTextureImageMemory;
-	VkImageView    m_vkTextureImageView;
-	VkSampler      m_vkTextureSampler;
+	MyMemoryAllocator::Allocation m_textureImageMemory;
+	VkImageView    m_vkTextureImageView = VK_NULL_HANDLE;
+	VkSampler      m_vkTextureSampler = VK_NULL_HANDLE;
 };
 
 #endif
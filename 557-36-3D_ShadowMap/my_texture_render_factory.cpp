@@ -1,4 +1,5 @@
 #include "my_texture_render_factory.h"
+#include "my_gpu_culler.h"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -11,13 +12,6 @@
 #include <cassert>
 #include <stdexcept>
 
-struct MyTexturePushConstantData
-{
-    alignas(4)  unsigned int textureID = 0;
-    alignas(16) glm::mat4 modelMatrix{ 1.f };
-    alignas(16) glm::mat4 normalMatrix{ 1.f };
-};
-
 MyTextureRenderFactory::MyTextureRenderFactory(MyDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
     : m_myDevice{ device }
 {
@@ -32,19 +26,14 @@ MyTextureRenderFactory::~MyTextureRenderFactory()
 
 void MyTextureRenderFactory::_createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(MyTexturePushConstantData);
-
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
     if (vkCreatePipelineLayout(m_myDevice.device(), &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -91,41 +80,38 @@ void MyTextureRenderFactory::render(MyFrameInfo& frameInfo)
         0, // only bind set 0 for now
         1, // count of 1
         &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
+        1, // the dynamic offset of the global UBO
+        &frameInfo.globalUboOffset);
+
+    // Models in the same geometry arena page share their buffers, bind them once
+    MyModel::BindState bindState{};
+
+    // Culled on the GPU: one indirect draw per group, the visible draws only
+    if (frameInfo.pGpuCuller && frameInfo.pGpuCuller->culls(MyRenderQueue::PASS_TEXTURE))
+    {
+        for (const auto& group : frameInfo.pGpuCuller->groups(MyRenderQueue::PASS_TEXTURE, frameInfo.shareIndex, frameInfo.shareCount))
+            frameInfo.pGpuCuller->draw(frameInfo.commandBuffer, group, &bindState);
+        return;
+    }
 
-    // Now loop through all key-value pair of the game objects
-    for (auto& kv : frameInfo.gameObjects)
+    // The batches of this pass (or of this thread's share), in MyRenderQueue key order. The
+    // shaders read the instances with gl_InstanceIndex; a single object still culls its meshlets
+    for (const auto& batch : frameInfo.renderQueue.batches(MyRenderQueue::PASS_TEXTURE, frameInfo.shareIndex, frameInfo.shareCount))
     {
-        auto& obj = kv.second;
-        if (obj.type() == MyGameObject::TEXTURE)
-        {
-            MyTexturePushConstantData push{};
-
-            // Note: do this for now to perform on CPU
-            // We will do it later to perform it on GPU
-            push.modelMatrix = obj.transform.mat4();
-            push.normalMatrix = obj.transform.normalMatrix();
-
-            push.textureID = obj.getID();
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                m_vkPipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(MyTexturePushConstantData),
-                &push);
-
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
-        }
+        const MyRenderQueue::Object& object = frameInfo.renderQueue.object(batch.object);
+        MyModel& model = *object.pModel;
+
+        model.bind(frameInfo.commandBuffer, &bindState);
+        if (batch.instanceCount == 1)
+            frameInfo.triangleCount += model.draw(frameInfo.commandBuffer, object.lod, frameInfo.pViewCuller, object.modelMatrix, batch.firstInstance);
+        else
+            frameInfo.triangleCount += model.draw(frameInfo.commandBuffer, object.lod, batch.firstInstance, batch.instanceCount);
     }
 }
 
 void MyTextureRenderFactory::recratePipeline(VkRenderPass renderPass)
 {
-    std::shared_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
+    std::unique_ptr<MyPipeline> oldPipeline = std::move(m_pMyPipeline);
 
 	// delete the original one if exists
     _createPipeline(renderPass);
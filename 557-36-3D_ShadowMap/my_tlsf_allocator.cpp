@@ -0,0 +1,251 @@
+#include "my_tlsf_allocator.h"
+
+// Std
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t mostSignificantBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+
+	uint32_t leastSignificantBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+}
+
+MyTlsfAllocator::MyTlsfAllocator(VkDeviceSize size) :
+	m_vkSize{ size }
+{
+	for (auto& heads : m_freeHeads)
+		std::fill(std::begin(heads), std::end(heads), INVALID_HANDLE);
+
+	if (size > 0)
+	{
+		uint32_t node = _createNode();
+		m_nodes[node] = { 0, size, INVALID_HANDLE, INVALID_HANDLE, INVALID_HANDLE, INVALID_HANDLE, true };
+		_insertFree(node);
+	}
+}
+
+void MyTlsfAllocator::_mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+	// The first SL_COUNT sizes have a list each, above that every power of two gets SL_COUNT lists
+	if (size < SL_COUNT)
+	{
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+		return;
+	}
+
+	uint32_t msb = mostSignificantBit(size);
+	fl = msb - SL_LOG2 + 1;
+	sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) - SL_COUNT;
+}
+
+uint32_t MyTlsfAllocator::_createNode()
+{
+	if (!m_unusedNodes.empty())
+	{
+		uint32_t node = m_unusedNodes.back();
+		m_unusedNodes.pop_back();
+		return node;
+	}
+
+	m_nodes.push_back({});
+	return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void MyTlsfAllocator::_insertFree(uint32_t node)
+{
+	uint32_t fl, sl;
+	_mapping(m_nodes[node].size, fl, sl);
+
+	uint32_t head = m_freeHeads[fl][sl];
+	m_nodes[node].bFree = true;
+	m_nodes[node].prevFree = INVALID_HANDLE;
+	m_nodes[node].nextFree = head;
+	if (head != INVALID_HANDLE)
+		m_nodes[head].prevFree = node;
+	m_freeHeads[fl][sl] = node;
+
+	m_iFlBitmap |= 1ull << fl;
+	m_slBitmaps[fl] |= 1u << sl;
+	m_iFreeBlockCount++;
+}
+
+void MyTlsfAllocator::_removeFree(uint32_t node)
+{
+	// Note: the size must still be the one the node was inserted with
+	uint32_t fl, sl;
+	_mapping(m_nodes[node].size, fl, sl);
+
+	Node& n = m_nodes[node];
+	if (n.prevFree != INVALID_HANDLE)
+		m_nodes[n.prevFree].nextFree = n.nextFree;
+	else
+		m_freeHeads[fl][sl] = n.nextFree;
+	if (n.nextFree != INVALID_HANDLE)
+		m_nodes[n.nextFree].prevFree = n.prevFree;
+
+	if (m_freeHeads[fl][sl] == INVALID_HANDLE)
+	{
+		m_slBitmaps[fl] &= ~(1u << sl);
+		if (m_slBitmaps[fl] == 0)
+			m_iFlBitmap &= ~(1ull << fl);
+	}
+
+	n.bFree = false;
+	m_iFreeBlockCount--;
+}
+
+uint32_t MyTlsfAllocator::_findFree(VkDeviceSize size) const
+{
+	// Round up to the next size class, then every block in that list is large enough
+	if (size >= SL_COUNT)
+		size += (VkDeviceSize(1) << (mostSignificantBit(size) - SL_LOG2)) - 1;
+
+	uint32_t fl, sl;
+	_mapping(size, fl, sl);
+	if (fl >= FL_COUNT)
+		return INVALID_HANDLE;
+
+	uint32_t slBitmap = m_slBitmaps[fl] & (~0u << sl);
+	if (slBitmap == 0)
+	{
+		uint64_t flBitmap = fl + 1 < FL_COUNT ? m_iFlBitmap & (~0ull << (fl + 1)) : 0;
+		if (flBitmap == 0)
+			return INVALID_HANDLE;
+
+		fl = leastSignificantBit(flBitmap);
+		slBitmap = m_slBitmaps[fl];
+	}
+
+	sl = leastSignificantBit(slBitmap);
+	return m_freeHeads[fl][sl];
+}
+
+bool MyTlsfAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& handle)
+{
+	assert(size > 0 && alignment > 0 && "Allocation size and alignment must not be 0");
+
+	// Enough room to align the start within any block that is found
+	uint32_t node = _findFree(size + alignment - 1);
+	if (node == INVALID_HANDLE)
+		return false;
+
+	_removeFree(node);
+
+	VkDeviceSize alignedOffset = (m_nodes[node].offset + alignment - 1) / alignment * alignment;
+	VkDeviceSize padding = alignedOffset - m_nodes[node].offset;
+
+	// The padding in front becomes a free block of its own; the block before
+	// is in use, otherwise the two would have been merged
+	if (padding > 0)
+	{
+		uint32_t front = _createNode();
+		Node& n = m_nodes[node];
+		m_nodes[front] = { n.offset, padding, n.prevPhysical, node, INVALID_HANDLE, INVALID_HANDLE, true };
+		if (n.prevPhysical != INVALID_HANDLE)
+			m_nodes[n.prevPhysical].nextPhysical = front;
+		n.prevPhysical = front;
+		n.offset = alignedOffset;
+		n.size -= padding;
+		_insertFree(front);
+	}
+
+	// and so does the rest behind it
+	if (m_nodes[node].size - size >= MIN_BLOCK_SIZE)
+	{
+		uint32_t back = _createNode();
+		Node& n = m_nodes[node];
+		m_nodes[back] = { n.offset + size, n.size - size, node, n.nextPhysical, INVALID_HANDLE, INVALID_HANDLE, true };
+		if (n.nextPhysical != INVALID_HANDLE)
+			m_nodes[n.nextPhysical].prevPhysical = back;
+		n.nextPhysical = back;
+		n.size = size;
+		_insertFree(back);
+	}
+
+	m_vkUsed += m_nodes[node].size;
+	m_iAllocationCount++;
+
+	offset = alignedOffset;
+	handle = node;
+	return true;
+}
+
+void MyTlsfAllocator::free(uint32_t handle)
+{
+	assert(handle < m_nodes.size() && !m_nodes[handle].bFree && "Freeing a block that was not allocated");
+
+	uint32_t node = handle;
+	m_vkUsed -= m_nodes[node].size;
+	m_iAllocationCount--;
+
+	// Merge with the free block in front
+	uint32_t previous = m_nodes[node].prevPhysical;
+	if (previous != INVALID_HANDLE && m_nodes[previous].bFree)
+	{
+		_removeFree(previous);
+		m_nodes[previous].size += m_nodes[node].size;
+		m_nodes[previous].nextPhysical = m_nodes[node].nextPhysical;
+		if (m_nodes[node].nextPhysical != INVALID_HANDLE)
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = previous;
+		m_unusedNodes.push_back(node);
+		node = previous;
+	}
+
+	// and with the one behind
+	uint32_t next = m_nodes[node].nextPhysical;
+	if (next != INVALID_HANDLE && m_nodes[next].bFree)
+	{
+		_removeFree(next);
+		m_nodes[node].size += m_nodes[next].size;
+		m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+		if (m_nodes[next].nextPhysical != INVALID_HANDLE)
+			m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+		m_unusedNodes.push_back(next);
+	}
+
+	_insertFree(node);
+}
+
+MyTlsfAllocator::Stats MyTlsfAllocator::stats() const
+{
+	Stats stats{};
+	stats.size = m_vkSize;
+	stats.used = m_vkUsed;
+	stats.allocationCount = m_iAllocationCount;
+	stats.freeBlockCount = m_iFreeBlockCount;
+
+	// The largest block is in the highest non-empty list
+	if (m_iFlBitmap != 0)
+	{
+		uint32_t fl = mostSignificantBit(m_iFlBitmap);
+		uint32_t sl = mostSignificantBit(m_slBitmaps[fl]);
+		for (uint32_t node = m_freeHeads[fl][sl]; node != INVALID_HANDLE; node = m_nodes[node].nextFree)
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, m_nodes[node].size);
+	}
+	return stats;
+}
+
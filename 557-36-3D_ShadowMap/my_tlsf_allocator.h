@@ -0,0 +1,78 @@
+#ifndef __MY_TLSF_ALLOCATOR_H__
+#define __MY_TLSF_ALLOCATOR_H__
+
+#include "my_free_list_allocator.h"
+
+// Std
+#include <cstdint>
+#include <vector>
+
+//
+// Two-level segregated fit offset allocator for a fixed range [0, size).
+// Free blocks are kept in lists by size class: the first level is the power
+// of two, the second level splits it into SL_COUNT linear steps. Two bitmaps
+// say which lists are non-empty, so allocate() and free() are O(1) no matter
+// how many blocks there are. A list only holds blocks of at least the size
+// asked for once the request is rounded up to the next class, which trades a
+// little space for never having to walk a list.
+// Freed blocks are merged with their free neighbours right away. Like
+// MyFreeListAllocator it only hands out offsets.
+//
+class MyTlsfAllocator
+{
+public:
+	static constexpr uint32_t     SL_LOG2 = 5;
+	static constexpr uint32_t     SL_COUNT = 1u << SL_LOG2;
+	static constexpr uint32_t     FL_COUNT = 64 - SL_LOG2 + 1;
+	static constexpr uint32_t     INVALID_HANDLE = UINT32_MAX;
+
+	// Remainders smaller than this stay with the allocation instead of becoming a free block
+	static constexpr VkDeviceSize MIN_BLOCK_SIZE = 16;
+
+	using Stats = MyFreeListAllocator::Stats;
+
+	explicit MyTlsfAllocator(VkDeviceSize size);
+
+	// Returns false when no free block can hold 'size' bytes at 'alignment'.
+	// 'handle' identifies the allocation for free()
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& handle);
+
+	void free(uint32_t handle);
+
+	bool  empty() const { return m_iAllocationCount == 0; }
+	Stats stats() const;
+
+private:
+	struct Node
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t     prevPhysical;  // neighbours in address order
+		uint32_t     nextPhysical;
+		uint32_t     prevFree;      // neighbours in the free list of the size class
+		uint32_t     nextFree;
+		bool         bFree;
+	};
+
+	static void _mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+	uint32_t _createNode();
+	void     _insertFree(uint32_t node);
+	void     _removeFree(uint32_t node);
+	uint32_t _findFree(VkDeviceSize size) const;
+
+	VkDeviceSize          m_vkSize;
+	VkDeviceSize          m_vkUsed = 0;
+	uint32_t              m_iAllocationCount = 0;
+	uint32_t              m_iFreeBlockCount = 0;
+
+	std::vector<Node>     m_nodes;
+	std::vector<uint32_t> m_unusedNodes;   // slots of m_nodes to reuse
+
+	uint64_t              m_iFlBitmap = 0;
+	uint32_t              m_slBitmaps[FL_COUNT]{};
+	uint32_t              m_freeHeads[FL_COUNT][SL_COUNT];
+};
+
+#endif
+
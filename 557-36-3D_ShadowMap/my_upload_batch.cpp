@@ -0,0 +1,239 @@
+#include "my_upload_batch.h"
+#include "my_texture.h"
+
+// Std
+#include <algorithm>
+#include <cstring>
+
+MyUploadBatch::~MyUploadBatch()
+{
+	_releaseStaging();
+}
+
+void MyUploadBatch::_releaseStaging()
+{
+	for (const auto& allocation : m_stagingAllocations)
+		m_myDevice.stagingPool().release(allocation);
+	m_stagingAllocations.clear();
+	m_stagingBuffers.clear();
+}
+
+MyUploadBatch::Staging MyUploadBatch::_stage(const void* pData, VkDeviceSize size)
+{
+	m_vkStagedSize += size;
+
+	MyStagingPool::Allocation allocation{};
+	bool bStaged = m_myDevice.stagingPool().allocate(size, allocation);
+
+	// Run what is recorded so far, then its staging memory is free again
+	if (!bStaged && m_bSubmitWhenFull && !(m_bufferCopies.empty() && m_imageCopies.empty()))
+	{
+		m_myDevice.submitUploads(*this);
+		m_bufferCopies.clear();
+		m_imageCopies.clear();
+		_releaseStaging();
+
+		bStaged = m_myDevice.stagingPool().allocate(size, allocation);
+	}
+
+	if (bStaged)
+	{
+		std::memcpy(allocation.pData, pData, static_cast<size_t>(size));
+		m_stagingAllocations.push_back(allocation);
+		return { allocation.buffer, allocation.offset };
+	}
+
+	auto pStagingBuffer = std::make_unique<MyBuffer>(
+		m_myDevice,
+		size,
+		1,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Note: it will unmap in the destructor
+	pStagingBuffer->map();
+	pStagingBuffer->writeToBuffer(const_cast<void*>(pData), size);
+
+	m_stagingBuffers.push_back(std::move(pStagingBuffer));
+	return { m_stagingBuffers.back()->buffer(), 0 };
+}
+
+void MyUploadBatch::copyToBuffer(const void* pData, VkDeviceSize size, VkBuffer buffer, VkDeviceSize dstOffset, void* pMapped)
+{
+	// Host coherent, the next submission makes the write visible to the GPU
+	if (pMapped)
+	{
+		std::memcpy(static_cast<char*>(pMapped) + dstOffset, pData, static_cast<size_t>(size));
+		return;
+	}
+
+	const char* pBytes = static_cast<const char*>(pData);
+	for (VkDeviceSize offset = 0; offset < size; offset += MyStagingPool::CHUNK_SIZE)
+	{
+		VkDeviceSize chunkSize = std::min(MyStagingPool::CHUNK_SIZE, size - offset);
+		m_bufferCopies.push_back({ _stage(pBytes + offset, chunkSize), buffer, dstOffset + offset, chunkSize });
+	}
+}
+
+void MyUploadBatch::copyToImage(const void* pPixels, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	if (m_myDevice.hostImageCopy())
+	{
+		m_myDevice.hostCopyToImage(pPixels, image, width, height, mipLevels);
+		m_imageCopies.push_back({ {}, image, width, height, mipLevels, 0, height, false, true, true });
+		return;
+	}
+
+	// As many whole rows as fit a chunk, at least one
+	VkDeviceSize rowSize = size / height;
+	uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(MyStagingPool::CHUNK_SIZE / rowSize, 1));
+
+	const char* pBytes = static_cast<const char*>(pPixels);
+	for (uint32_t row = 0; row < height; row += rowsPerChunk)
+	{
+		uint32_t rowCount = std::min(rowsPerChunk, height - row);
+		Staging source = _stage(pBytes + row * rowSize, rowCount * rowSize);
+		m_imageCopies.push_back({ source, image, width, height, mipLevels, row, rowCount, row == 0, row + rowCount == height, false });
+	}
+}
+
+void MyUploadBatch::recordTransfer(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily) const
+{
+	// Every mip level goes to TRANSFER_DST: mip 0 is copied now, the others are blitted into later
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	for (const auto& copy : m_imageCopies)
+	{
+		if (!copy.bFirst)
+			continue;
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = copy.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = copy.mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarriers.push_back(barrier);
+	}
+
+	if (!imageBarriers.empty())
+	{
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	for (const auto& copy : m_bufferCopies)
+	{
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = copy.source.offset;
+		copyRegion.dstOffset = copy.offset;
+		copyRegion.size = copy.size;
+		vkCmdCopyBuffer(commandBuffer, copy.source.buffer, copy.destination, 1, &copyRegion);
+	}
+
+	for (const auto& copy : m_imageCopies)
+	{
+		if (copy.bHost)
+			continue;
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = copy.source.offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(copy.firstRow), 0 };
+		region.imageExtent = { copy.width, copy.rowCount, 1 };
+
+		vkCmdCopyBufferToImage(commandBuffer, copy.source.buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	if (transferFamily != graphicsFamily)
+		_ownershipBarriers(commandBuffer, transferFamily, graphicsFamily, true);
+}
+
+void MyUploadBatch::recordGraphics(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily) const
+{
+	if (transferFamily != graphicsFamily)
+		_ownershipBarriers(commandBuffer, transferFamily, graphicsFamily, false);
+
+	// Blits need a graphics queue, they also leave every level in SHADER_READ_ONLY_OPTIMAL
+	for (const auto& copy : m_imageCopies)
+	{
+		if (!copy.bLast)
+			continue;
+
+		MyTexture::recordMipmaps(
+			commandBuffer, copy.image, static_cast<int32_t>(copy.width), static_cast<int32_t>(copy.height), copy.mipLevels);
+	}
+}
+
+void MyUploadBatch::_ownershipBarriers(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily, bool bRelease) const
+{
+	// The release (transfer queue) and the acquire (graphics queue) must describe the same
+	// transfer, only the access masks of the queue that does not own the resource are ignored
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	for (const auto& copy : m_bufferCopies)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = bRelease ? VkAccessFlags{ VK_ACCESS_TRANSFER_WRITE_BIT } : 0;
+		barrier.dstAccessMask = bRelease ? 0 : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.buffer = copy.destination;
+		barrier.offset = copy.offset;
+		barrier.size = copy.size;
+		bufferBarriers.push_back(barrier);
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	for (const auto& copy : m_imageCopies)
+	{
+		// The whole image changes owner once, with its last range of rows
+		// Note: a host copy is not on any queue, the graphics queue uses the image first
+		if (!copy.bLast || copy.bHost)
+			continue;
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.image = copy.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = copy.mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = bRelease ? VkAccessFlags{ VK_ACCESS_TRANSFER_WRITE_BIT } : 0;
+		barrier.dstAccessMask = bRelease ? 0 : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarriers.push_back(barrier);
+	}
+
+	if (bufferBarriers.empty() && imageBarriers.empty())
+		return;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		bRelease ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		bRelease ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
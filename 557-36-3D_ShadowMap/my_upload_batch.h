@@ -0,0 +1,107 @@
+#ifndef __MY_UPLOAD_BATCH_H__
+#define __MY_UPLOAD_BATCH_H__
+
+#include "my_device.h"
+#include "my_buffer.h"
+#include "my_staging_pool.h"
+
+// Std
+#include <memory>
+#include <vector>
+
+//
+// Uploads of one asset, staged now and recorded later. Staging happens
+// wherever the batch is filled (e.g. a loader thread), the commands are
+// recorded by whoever owns the queues (see MyAssetLoader):
+// - recordTransfer: the copies, for the transfer queue
+// - recordGraphics: mipmap blits and final image layouts, for the graphics queue
+// When the two queues are different families, recordTransfer ends with the
+// queue family ownership release and recordGraphics starts with the acquire.
+// Only the copied buffer ranges change owner, the rest of a shared buffer
+// (see MyGeometryArena) may be in use on the graphics queue meanwhile.
+// The staging data lives in MyDevice's staging pool (or a buffer of its own
+// when the pool is full) until the batch is destroyed, which must wait until
+// the GPU has executed both parts. MyDevice::submitUploads runs a batch in
+// one submission on the graphics queue.
+// Copies are split into pieces of at most MyStagingPool::CHUNK_SIZE, images
+// by rows, so an upload of any size fits the pool. A batch made with
+// 'bSubmitWhenFull' submits and waits for the copies it has so far when the
+// pool is full, then reuses their staging memory for the rest; the owner
+// still has to submit whatever is left at the end.
+// With unified memory (see MyDevice::unifiedMemory) nothing is staged: buffers
+// given with their mapped pointer are written in place, and mip 0 of a texture
+// is copied from the host when the device has VK_EXT_host_image_copy, leaving
+// only its mipmaps to record.
+//
+class MyUploadBatch
+{
+public:
+	MyUploadBatch(MyDevice& device, bool bSubmitWhenFull = false) : m_myDevice{ device }, m_bSubmitWhenFull{ bSubmitWhenFull } {}
+	~MyUploadBatch();
+
+	MyUploadBatch(const MyUploadBatch&) = delete;
+	MyUploadBatch& operator=(const MyUploadBatch&) = delete;
+
+	// Copies 'pData' into staging memory and queues a copy to 'buffer' at 'dstOffset'.
+	// With 'pMapped', the host visible mapping of 'buffer', it is written in place instead
+	void copyToBuffer(const void* pData, VkDeviceSize size, VkBuffer buffer, VkDeviceSize dstOffset = 0, void* pMapped = nullptr);
+
+	// Copies RGBA8 'pPixels' into staging memory and queues the upload of mip 0,
+	// the blits for the other mips and the transition to SHADER_READ_ONLY_OPTIMAL.
+	// 'image' must be created in VK_IMAGE_LAYOUT_UNDEFINED.
+	void copyToImage(const void* pPixels, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	void recordTransfer(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily) const;
+	void recordGraphics(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily) const;
+
+	// Bytes staged so far
+	VkDeviceSize size() const { return m_vkStagedSize; }
+
+	// Nothing to record, e.g. when everything was written in place
+	bool empty() const { return m_bufferCopies.empty() && m_imageCopies.empty(); }
+
+private:
+	struct Staging
+	{
+		VkBuffer     buffer;
+		VkDeviceSize offset;
+	};
+
+	struct BufferCopy
+	{
+		Staging      source;
+		VkBuffer     destination;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	// One range of rows of mip 0
+	struct ImageCopy
+	{
+		Staging  source;
+		VkImage  image;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t firstRow;
+		uint32_t rowCount;
+		bool     bFirst;     // the layout transition goes before the first range
+		bool     bLast;      // mipmaps and the ownership transfer after the last one
+		bool     bHost;      // mip 0 was copied on the host, only the mipmaps are left
+	};
+
+	Staging   _stage(const void* pData, VkDeviceSize size);
+	void      _releaseStaging();
+	void      _ownershipBarriers(VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily, bool bRelease) const;
+
+	MyDevice&                              m_myDevice;
+	bool                                   m_bSubmitWhenFull;
+	std::vector<MyStagingPool::Allocation> m_stagingAllocations;
+	std::vector<std::unique_ptr<MyBuffer>> m_stagingBuffers;     // when the pool was full
+	std::vector<BufferCopy>                m_bufferCopies;
+	std::vector<ImageCopy>                 m_imageCopies;
+	VkDeviceSize                           m_vkStagedSize = 0;
+};
+
+#endif
+
@@ -0,0 +1,370 @@
+#include "my_vertex_welder.h"
+
+// Std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+unsigned int MyVertexWelder::s_iThreadCount = 0;
+
+namespace
+{
+	const uint32_t EMPTY = 0xFFFFFFFFu;
+
+	// Below this many corners sharding costs more than it saves
+	const size_t MIN_PARALLEL_CORNERS = 1 << 16;
+
+	// Attributes that take part in the comparison (the picking id does not)
+	const int WELD_COMPONENTS = 11;
+
+	inline void components(const MyModel::Vertex& v, float out[WELD_COMPONENTS])
+	{
+		out[0] = v.position.x; out[1] = v.position.y; out[2] = v.position.z;
+		out[3] = v.color.x;    out[4] = v.color.y;    out[5] = v.color.z;
+		out[6] = v.normal.x;   out[7] = v.normal.y;   out[8] = v.normal.z;
+		out[9] = v.uv.x;       out[10] = v.uv.y;
+	}
+
+	// Vertices equal under operator== must hash the same, so -0.0 and 0.0
+	// are folded together (adding 0.0f turns -0.0 into 0.0)
+	uint32_t hashVertex(const MyModel::Vertex& v)
+	{
+		float values[WELD_COMPONENTS];
+		components(v, values);
+
+		uint64_t hash = 0x2545F4914F6CDD1Dull;
+		for (int i = 0; i < WELD_COMPONENTS; i++)
+		{
+			float value = values[i] + 0.0f;
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			hash = (hash ^ bits) * 0x9E3779B97F4A7C15ull;
+			hash ^= hash >> 29;
+		}
+
+		return static_cast<uint32_t>(hash ^ (hash >> 32));
+	}
+
+	uint32_t nextPowerOfTwo(size_t value)
+	{
+		uint32_t result = 64;
+		while (result < value)
+			result <<= 1;
+		return result;
+	}
+
+	//
+	// Linear probing table from vertex value to the first corner that had it.
+	// The full hash is kept next to the corner so most mismatches are rejected
+	// without touching the vertex data.
+	//
+	class WeldTable
+	{
+	public:
+		WeldTable(size_t expectedCount)
+		{
+			m_slots.assign(nextPowerOfTwo(expectedCount * 2), Slot{ 0, EMPTY });
+		}
+
+		// Returns the representative corner for 'corner', inserting it if it is new
+		uint32_t insert(uint32_t hash, uint32_t corner, const std::vector<MyModel::Vertex>& corners)
+		{
+			if ((m_iCount + 1) * 2 > m_slots.size())
+				_grow();
+
+			uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+			for (uint32_t i = hash & mask; ; i = (i + 1) & mask)
+			{
+				Slot& slot = m_slots[i];
+				if (slot.corner == EMPTY)
+				{
+					slot.hash = hash;
+					slot.corner = corner;
+					m_iCount++;
+					return corner;
+				}
+
+				if (slot.hash == hash && corners[slot.corner] == corners[corner])
+					return slot.corner;
+			}
+		}
+
+	private:
+		struct Slot
+		{
+			uint32_t hash;
+			uint32_t corner;
+		};
+
+		void _grow()
+		{
+			std::vector<Slot> old;
+			old.swap(m_slots);
+			m_slots.assign(old.size() * 2, Slot{ 0, EMPTY });
+
+			uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+			for (const Slot& slot : old)
+			{
+				if (slot.corner == EMPTY)
+					continue;
+
+				uint32_t i = slot.hash & mask;
+				while (m_slots[i].corner != EMPTY)
+					i = (i + 1) & mask;
+				m_slots[i] = slot;
+			}
+		}
+
+		std::vector<Slot> m_slots;
+		size_t            m_iCount = 0;
+	};
+
+	//
+	// Linear probing table from a grid cell to the most recent vertex in it,
+	// older vertices of the same cell are linked through 'next'
+	//
+	class CellTable
+	{
+	public:
+		CellTable(size_t expectedCount)
+		{
+			m_slots.assign(nextPowerOfTwo(expectedCount * 2), Slot{ 0, 0, 0, EMPTY });
+		}
+
+		uint32_t* find(int64_t x, int64_t y, int64_t z, bool bCreate)
+		{
+			if (bCreate && (m_iCount + 1) * 2 > m_slots.size())
+				_grow();
+
+			uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+			for (uint32_t i = _hash(x, y, z) & mask; ; i = (i + 1) & mask)
+			{
+				Slot& slot = m_slots[i];
+				if (slot.head == EMPTY)
+				{
+					if (!bCreate)
+						return nullptr;
+
+					slot.x = x;
+					slot.y = y;
+					slot.z = z;
+					m_iCount++;
+					return &slot.head;
+				}
+
+				if (slot.x == x && slot.y == y && slot.z == z)
+					return &slot.head;
+			}
+		}
+
+	private:
+		struct Slot
+		{
+			int64_t  x, y, z;
+			uint32_t head;
+		};
+
+		static uint32_t _hash(int64_t x, int64_t y, int64_t z)
+		{
+			uint64_t hash = static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ull;
+			hash ^= static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4Full;
+			hash ^= static_cast<uint64_t>(z) * 0x165667B19E3779F9ull;
+			return static_cast<uint32_t>(hash ^ (hash >> 32));
+		}
+
+		void _grow()
+		{
+			std::vector<Slot> old;
+			old.swap(m_slots);
+			m_slots.assign(old.size() * 2, Slot{ 0, 0, 0, EMPTY });
+
+			uint32_t mask = static_cast<uint32_t>(m_slots.size() - 1);
+			for (const Slot& slot : old)
+			{
+				if (slot.head == EMPTY)
+					continue;
+
+				uint32_t i = _hash(slot.x, slot.y, slot.z) & mask;
+				while (m_slots[i].head != EMPTY)
+					i = (i + 1) & mask;
+				m_slots[i] = slot;
+			}
+		}
+
+		std::vector<Slot> m_slots;
+		size_t            m_iCount = 0;
+	};
+}
+
+void MyVertexWelder::weld(
+	const std::vector<MyModel::Vertex>& corners,
+	std::vector<MyModel::Vertex>& vertices,
+	std::vector<uint32_t>& indices)
+{
+	// First find, for every corner, the earliest corner it welds to
+	std::vector<uint32_t> representatives(corners.size());
+	if (m_fEpsilon > 0.0f)
+		_weldEpsilon(corners, representatives);
+	else
+		_weldExact(corners, representatives);
+
+	// Then number the unique vertices in order of first use
+	vertices.clear();
+	indices.resize(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		uint32_t representative = representatives[i];
+		if (representative == i)
+		{
+			indices[i] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(corners[i]);
+		}
+		else
+		{
+			indices[i] = indices[representative];
+		}
+	}
+}
+
+void MyVertexWelder::_weldExact(const std::vector<MyModel::Vertex>& corners, std::vector<uint32_t>& representatives)
+{
+	const size_t cornerCount = corners.size();
+
+	unsigned int threadCount = s_iThreadCount ? s_iThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	if (cornerCount < MIN_PARALLEL_CORNERS)
+		threadCount = 1;
+
+	std::vector<uint32_t> hashes(cornerCount);
+
+	// Each thread hashes a slice of the corners, then owns one shard of the
+	// hash space. Shards never share a vertex value so they need no locking,
+	// and walking the corners in order keeps the first corner as representative.
+	auto hashSlice = [&](unsigned int t)
+	{
+		size_t begin = cornerCount * t / threadCount;
+		size_t end = cornerCount * (t + 1) / threadCount;
+		for (size_t i = begin; i < end; i++)
+			hashes[i] = hashVertex(corners[i]);
+	};
+
+	auto weldShard = [&](unsigned int shard)
+	{
+		WeldTable table{ cornerCount / (2 * threadCount) };
+		for (size_t i = 0; i < cornerCount; i++)
+		{
+			uint32_t hash = hashes[i];
+			if ((static_cast<uint64_t>(hash) * threadCount >> 32) != shard)
+				continue;
+
+			representatives[i] = table.insert(hash, static_cast<uint32_t>(i), corners);
+		}
+	};
+
+	if (threadCount == 1)
+	{
+		hashSlice(0);
+		weldShard(0);
+		return;
+	}
+
+	for (auto pass : { 0, 1 })
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int t = 1; t < threadCount; t++)
+		{
+			if (pass == 0)
+				workers.emplace_back(hashSlice, t);
+			else
+				workers.emplace_back(weldShard, t);
+		}
+
+		if (pass == 0)
+			hashSlice(0);
+		else
+			weldShard(0);
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+}
+
+void MyVertexWelder::_weldEpsilon(const std::vector<MyModel::Vertex>& corners, std::vector<uint32_t>& representatives)
+{
+	const size_t cornerCount = corners.size();
+	const float epsilon = m_fEpsilon;
+	const double cellScale = 0.5 / epsilon;
+
+	// Cells are 2 * epsilon wide, so a match can only be in this cell or in the
+	// neighbour on the side of the nearer cell face: 2x2x2 cells to look at
+	CellTable cells{ cornerCount / 2 };
+	std::vector<uint32_t> next(cornerCount, EMPTY);
+
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		representatives[i] = static_cast<uint32_t>(i);
+
+		float values[WELD_COMPONENTS];
+		components(corners[i], values);
+
+		double px = values[0] * cellScale;
+		double py = values[1] * cellScale;
+		double pz = values[2] * cellScale;
+		double cx = std::floor(px);
+		double cy = std::floor(py);
+		double cz = std::floor(pz);
+
+		// NaN, infinity or out of grid range never welds
+		const double limit = 4.0e18;
+		if (!(std::fabs(cx) < limit && std::fabs(cy) < limit && std::fabs(cz) < limit))
+			continue;
+
+		int64_t x = static_cast<int64_t>(cx);
+		int64_t y = static_cast<int64_t>(cy);
+		int64_t z = static_cast<int64_t>(cz);
+		int64_t sx = px - cx < 0.5 ? -1 : 1;
+		int64_t sy = py - cy < 0.5 ? -1 : 1;
+		int64_t sz = pz - cz < 0.5 ? -1 : 1;
+
+		// Prefer the earliest matching vertex so the result doesn't depend on table layout
+		uint32_t best = EMPTY;
+		for (int cell = 0; cell < 8; cell++)
+		{
+			uint32_t* pHead = cells.find(
+				x + ((cell & 1) ? sx : 0),
+				y + ((cell & 2) ? sy : 0),
+				z + ((cell & 4) ? sz : 0),
+				false);
+
+			for (uint32_t candidate = pHead ? *pHead : EMPTY; candidate != EMPTY; candidate = next[candidate])
+			{
+				if (candidate >= best)
+					continue;
+
+				float other[WELD_COMPONENTS];
+				components(corners[candidate], other);
+
+				bool bClose = true;
+				for (int k = 0; k < WELD_COMPONENTS && bClose; k++)
+					bClose = std::fabs(values[k] - other[k]) <= epsilon;
+
+				if (bClose)
+					best = candidate;
+			}
+		}
+
+		if (best != EMPTY)
+		{
+			representatives[i] = best;
+			continue;
+		}
+
+		uint32_t* pHead = cells.find(x, y, z, true);
+		next[i] = *pHead;
+		*pHead = static_cast<uint32_t>(i);
+	}
+}
+
@@ -0,0 +1,46 @@
+#ifndef __MY_VERTEX_WELDER_H__
+#define __MY_VERTEX_WELDER_H__
+
+#include "my_model.h"
+
+// Std
+#include <vector>
+
+//
+// Turns one vertex per triangle corner into a unique vertex array plus an
+// index buffer, using an open-addressing hash table instead of the node
+// based std::unordered_map.
+//
+// With epsilon == 0 (the default) only vertices comparing equal with
+// MyModel::Vertex::operator== are welded and the output is the same as
+// the original unordered_map loop: vertices appear in the order of their
+// first corner. Large meshes are hashed into shards processed in parallel.
+//
+// With epsilon > 0 vertices whose position, color, normal and uv are all
+// within epsilon of an earlier vertex are welded to it. This mode looks up
+// neighbouring grid cells and runs on a single thread.
+//
+class MyVertexWelder
+{
+public:
+	MyVertexWelder(float epsilon = 0.0f) : m_fEpsilon{ epsilon } {}
+
+	void weld(
+		const std::vector<MyModel::Vertex>& corners,
+		std::vector<MyModel::Vertex>& vertices,
+		std::vector<uint32_t>& indices);
+
+	// Number of shards/threads for exact welding, 0 = std::thread::hardware_concurrency()
+	static void setThreadCount(unsigned int count) { s_iThreadCount = count; }
+
+private:
+	void _weldExact(const std::vector<MyModel::Vertex>& corners, std::vector<uint32_t>& representatives);
+	void _weldEpsilon(const std::vector<MyModel::Vertex>& corners, std::vector<uint32_t>& representatives);
+
+	float               m_fEpsilon;
+
+	static unsigned int s_iThreadCount;
+};
+
+#endif
+
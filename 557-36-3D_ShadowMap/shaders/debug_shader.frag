@@ -31,12 +31,6 @@ layout(set = 0, binding = 0) uniform GlobalUBO
 } ubo;
 
 
-layout(push_constant) uniform Pushdata
-{
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} pushdata;
-
 float LinearizeDepth(float depth)
 {
   float n = 0.1;
@@ -26,16 +26,23 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-// Note 128 bytes can only contain 2 4x4 matrices, so we have run into the limitation
-layout(push_constant) uniform Pushdata
+struct Instance
 {
-    mat4 modelMatrix;
+    mat4 modelMatrix;  // with positionTransform
     mat4 normalMatrix;
-} pushdata;
+    uint textureID;
+    uint pickID;
+};
+
+// Per-draw data written by MyRenderQueue, indexed by gl_InstanceIndex
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
 
 void main()
 {
-    vec4 positionWorld = pushdata.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = instances[gl_InstanceIndex].modelMatrix * vec4(position, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
     outUV = uv;  // vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
@@ -1,10 +1,7 @@
 #version 450
 
+// Note: depth only, the pipeline provides the position attribute alone
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec2 uv;
-layout(location = 4) in float inID; // for picking. not used for shadow rendering
 
 struct PointLight
 {
@@ -28,15 +25,22 @@ out gl_PerVertex
     vec4 gl_Position;   
 };
 
-// Note 128 bytes can only contain 2 4x4 matrices, so we have run into the limitation
-layout(push_constant) uniform Pushdata
+struct Instance
 {
-    mat4 modelMatrix;
+    mat4 modelMatrix;  // with positionTransform
     mat4 normalMatrix;
-} pushdata;
+    uint textureID;
+    uint pickID;
+};
+
+// Per-draw data written by MyRenderQueue, indexed by gl_InstanceIndex
+layout(std430, set = 0, binding = 1) readonly buffer Instances
+{
+    Instance instances[];
+};
 
 void main()
 {
-    vec4 positionWorld = pushdata.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = instances[gl_InstanceIndex].modelMatrix * vec4(position, 1.0);
 	gl_Position =  ubo.pointLight.lightMVP * positionWorld;
 }
\ No newline at end of file
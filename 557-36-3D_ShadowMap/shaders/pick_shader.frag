@@ -23,12 +23,6 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-layout(push_constant) uniform Pushdata
-{
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} pushdata;
-
 layout(set = 0, binding = 1) buffer ShaderStorageBufferObject
 {
     float Selected_ID;
@@ -4,7 +4,6 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
-layout(location = 4) in float inID; // for picking
 
 layout(location = 0) out float outID;
 
@@ -26,19 +25,27 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-// Note 128 bytes can only contain 2 4x4 matrices, so we have run into the limitation
-layout(push_constant) uniform Pushdata
+struct Instance
 {
-    mat4 modelMatrix;
+    mat4 modelMatrix;  // with positionTransform
     mat4 normalMatrix;
-} pushdata;
+    uint textureID;
+    uint pickID;
+};
+
+// Per-draw data written by MyRenderQueue, indexed by gl_InstanceIndex
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
 
 
 void main()
 {
-    vec4 positionWorld = pushdata.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = instances[gl_InstanceIndex].modelMatrix * vec4(position, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
-    outID = inID;
+    // Per object, so instances of the same model can be told apart
+    outID = float(instances[gl_InstanceIndex].pickID);
 }
 
@@ -25,12 +25,6 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-layout(push_constant) uniform Pushdata
-{
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} pushdata;
-
 // SSBO is not used in regular rendering
 // layout(set = 0, binding = 1) buffer ShaderStorageBufferObject
 //{
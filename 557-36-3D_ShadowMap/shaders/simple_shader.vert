@@ -1,11 +1,27 @@
 #version 450
 
-layout(location = 0) in vec3 position;
+layout(location = 0) in vec4 position; // w = 0 if the mesh has no vertex colors (packed layout only)
 layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
+layout(location = 2) in vec3 normal;   // octahedral xy in the packed layout
 layout(location = 3) in vec2 uv;
 layout(location = 4) in float inID; // for picking. not used for simple rendering
 
+// Set by MyModel::vertexSpecializationInfo
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
+vec3 decodeNormal(vec3 n)
+{
+    if (!PACKED_VERTEX)
+        return n;
+
+    // Octahedral: unfold the lower hemisphere
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    float t = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -t : t;
+    v.y += v.y >= 0.0 ? -t : t;
+    return normalize(v);
+}
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
@@ -28,29 +44,36 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-// Note 128 bytes can only contain 2 4x4 matrices, so we have run into the limitation
-layout(push_constant) uniform Pushdata
+struct Instance
 {
-    mat4 modelMatrix;
+    mat4 modelMatrix;  // with positionTransform
     mat4 normalMatrix;
-} pushdata;
+    uint textureID;
+    uint pickID;
+};
+
+// Per-draw data written by MyRenderQueue, indexed by gl_InstanceIndex
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
 
 
 void main()
 {
-    vec4 positionWorld = pushdata.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = instances[gl_InstanceIndex].modelMatrix * vec4(position.xyz, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
-    fragNormalWorld = normalize(mat3(pushdata.normalMatrix) * normal);
+    fragNormalWorld = normalize(mat3(instances[gl_InstanceIndex].normalMatrix) * decodeNormal(normal));
     fragPosWorld = positionWorld.xyz;
 
-    if (ubo.pickedObjectID == uint(inID)) // if select the part, render as selection color (red)
+    if (ubo.pickedObjectID == instances[gl_InstanceIndex].pickID) // if select the object, render as selection color (red)
     {
         fragColor = vec3(1.0, 0.0, 0.0);
     }
     else
     {
-        fragColor = color;
+        fragColor = position.w > 0.5 ? color : vec3(1.0);
     }
 }
 
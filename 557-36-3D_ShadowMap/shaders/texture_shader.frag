@@ -14,6 +14,7 @@ layout (location = 2) in vec3 fragNormalWorld;
 layout (location = 3) in vec2 fragTexCoord;
 layout (location = 4) in vec4 inShadowCoord;
 layout (location = 5) in float selected;
+layout (location = 6) flat in uint fragTextureID;
 
 layout (location = 0) out vec4 outColor;
 
@@ -34,13 +35,6 @@ layout(set = 0, binding = 0) uniform GlobalUBO
     PointLight pointLight;
 } ubo;
 
-layout(push_constant) uniform Pushdata
-{
-    uint textureID;
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} pushdata;
-
 // SSBO is not used in regular rendering
 // layout(set = 0, binding = 1) buffer ShaderStorageBufferObject
 //{
@@ -113,7 +107,7 @@ void main()
 
     vec3 cameraPosWorld = ubo.invView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
-    int index = int(pushdata.textureID);
+    int index = int(fragTextureID);
 
     vec4 texColor = texture(texSampler[index], fragTexCoord);
 